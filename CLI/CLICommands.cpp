@@ -47,6 +47,7 @@
 #include <GSMRadioResource.h>
 #include <NodeManager.h>
 #include <CBS.h>
+#include <CallTrace.h>
 
 std::string getARFCNsString(unsigned band);
 
@@ -525,6 +526,7 @@ static CLIStatus printStats(int argc, char** argv, ostream& os)
 	// paging table size
 	os << "PCH load: active, total: " << gBTS.PCHLoad() << ", " << GSM::gPager.pagingEntryListSize() << endl;
 	os << "AGCH load: active, pending: " << gBTS.AGCHLoad() << ", " << getAGCHPending() << endl;
+	gTRX.decodeStage().text(os);
 	os << "== GPRS ==" << endl;
 	// (pat) We are not using dynamic channel allocation so I removed GPRS.Channels.Max until such time as we do.
 	// Also I did not understand what is the point of printing out something that is in the config?
@@ -1211,7 +1213,7 @@ static void addChanInfo(vector<string> &row,	// Result returned here.
 			row.push_back(format("%ld:%ld",duration/60,duration%60));	// minutes:seconds
 		} else if (field == "Frames") {
 			DecoderStats ds = chan->getDecoderStats();
-			row.push_back(format("%d/%d/%d",ds.mStatBadFrames,ds.mStatStolenFrames,ds.mStatTotalFrames));
+			row.push_back(format("%d/%d/%d/%d",ds.mStatBadFrames,ds.mStatStolenFrames,ds.mStatTotalFrames,ds.mStatCombineRecovered));
 		} else if (field == "SNR") {
 			DecoderStats ds = chan->getDecoderStats();
 			row.push_back(format("%.3g",ds.mAveSNR));
@@ -1266,7 +1268,7 @@ static const char *chansHelp = "[-a -l -tab] -- report PHY status for active cha
 	"      'no-MMUser' to indicate that Layer 3 is connected (an MMChannel exists) but the IMSI is not yet known.\n"
 	"  Time - Channel connection duration in seconds;\n"
 	"  Timers - Internal channel timers;\n"
-	"  Frames - number of bad, stolen, and total frames sent, only for traffic channels;\n"
+	"  Frames - number of bad, stolen, and total frames sent, only for traffic channels, and frames recovered by GSM.Radio.ChaseCombining;\n"
 	"  Neighbor ARFCN and dBm - The best neighbor's channel and downlink RSSI reported by the MS;\n"
 	"  Layer1 - state of layer1 for host (TCH or DCCH) and SACCH sub-channels.\n"
 	;
@@ -1287,7 +1289,7 @@ CLIStatus printChansV4(std::ostream& os,bool showAll, int verbosity, bool tabSep
 		header2 = "_  _  type id          state _     dB     dB   dB   _   pct pct sym dBm   sym   dBm      pct    M:S  _    ARFCN(dBm)  C0:BSIC";
 		if (verbosity == 2) {
 			header1 += " Frames     Timers Layer1";
-			header2 += " bad/st/tot _      Host/SACCH";
+			header2 += " bad/st/tot/cmb _  Host/SACCH";
 		}
 	} else {
 		header1 = "CN TN chan transaction Signal SNR FER TA  TXPWR RXLEV_DL BER_DL Time IMSI";
@@ -1704,6 +1706,29 @@ static CLIStatus memStat(int argc, char** argv, ostream& os)
 }
 
 
+static const char *calltraceHelp =
+	"[recent [count] | active | clear] -- with no arguments, print the percentiles of each call setup milestone in msecs, "
+	"measured from the RACH for MOC and from the INVITE for MTC, over the last 1000 calls; "
+	"'recent' prints the traces of the most recent calls, default 10; 'active' prints the traces of calls being set up; "
+	"'clear' discards the samples and history.";
+static CLIStatus calltrace(int argc, char** argv, ostream& os)
+{
+	if (argc == 1) {
+		Control::gCallTrace.ctStats(os);
+	} else if (strcmp(argv[1],"recent") == 0 && argc <= 3) {
+		Control::gCallTrace.ctRecent(os, argc == 3 ? atoi(argv[2]) : 10);
+	} else if (strcmp(argv[1],"active") == 0 && argc == 2) {
+		Control::gCallTrace.ctActive(os);
+	} else if (strcmp(argv[1],"clear") == 0 && argc == 2) {
+		Control::gCallTrace.ctClear();
+		os << "call trace cleared" << endl;
+	} else {
+		return BAD_NUM_ARGS;
+	}
+	return SUCCESS;
+}
+
+
 //@} // CLI commands
 
 
@@ -1748,6 +1773,7 @@ void Parser::addCommands()
 	addCommand("stats", stats,"[patt] OR clear -- print all, or selected, performance counters, OR clear all counters.");
 	addCommand("handover", handover,handoverHelp);
 	addCommand("memstat", memStat, "-- internal testing command: print memory use stats.");
+	addCommand("calltrace", calltrace, calltraceHelp);
 	addCommand("cbs", cbscmd, cbsHelp);
 
 	addCommand("power", powerCommand, powerHelp);
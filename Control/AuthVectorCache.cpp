@@ -0,0 +1,155 @@
+/*
+* Copyright 2014 Range Networks, Inc.
+*
+* This software is distributed under multiple licenses;
+* see the COPYING file in the main directory for licensing
+* information for this specific distribution.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+*/
+
+#define LOG_GROUP LogGroup::Control
+#include "AuthVectorCache.h"
+#include <vector>
+#include <algorithm>
+#include <Logger.h>
+#include <Globals.h>
+#include <Timeval.h>
+#include <SIPExport.h>
+
+using namespace std;
+
+namespace Control {
+
+AuthVectorCache gAuthVectors;
+
+// How long we wait for the Registrar to answer a prefetch before we allow another one for the same IMSI.
+// This is the SIP transaction timeout, 64*T1.
+static const time_t cPrefetchTimeout = 32;
+
+
+void AuthVectorCache::avStart()
+{
+	{	ScopedLock lock(mLock);
+		if (mStarted) { return; }
+		mStarted = true;
+	}
+	mPrefetchThread.start((void*(*)(void*))prefetchLoopAdapter,this);
+}
+
+
+// Discard expired challenges and fetches that were never answered.  The caller holds mLock.
+void AuthVectorCache::avPurge(time_t now)
+{
+	while (mOrder.size() && mOrder.front().first <= now) {
+		VectorMap::iterator it = mVectors.find(mOrder.front().second);
+		if (it != mVectors.end() && it->second.avExpiry == mOrder.front().first) { mVectors.erase(it); }
+		mOrder.pop_front();
+	}
+	for (map<string,time_t>::iterator it = mRequested.begin(); it != mRequested.end(); ) {
+		if (it->second && now - it->second > cPrefetchTimeout) {
+			mRequested.erase(it++);
+		} else {
+			it++;
+		}
+	}
+}
+
+
+bool AuthVectorCache::avGet(const string &imsi, string &rand)
+{
+	if (!gConfig.getBool("Control.LUR.AuthPrefetch")) { return false; }
+	ScopedLock lock(mLock);
+	VectorMap::iterator it = mVectors.find(imsi);
+	if (it == mVectors.end()) { return false; }
+	bool valid = it->second.avExpiry > time(NULL);
+	rand = it->second.avRand;
+	mVectors.erase(it);		// A challenge is never used twice.
+	if (!valid) { return false; }
+	LOG(DEBUG) << "using prefetched challenge for"<<LOGVAR(imsi);
+	return true;
+}
+
+
+void AuthVectorCache::avPrefetch(const string &imsi)
+{
+	if (!gConfig.getBool("Control.LUR.AuthPrefetch") || imsi.empty()) { return; }
+	unsigned maxEntries = gConfig.getNum("Control.LUR.AuthPrefetch.MaxEntries");
+	ScopedLock lock(mLock);
+	if (mRequested.count(imsi) || mVectors.count(imsi)) { return; }
+	if (mPending.size() >= maxEntries) {
+		LOG(NOTICE) << "authentication prefetch queue full, dropping request for"<<LOGVAR(imsi);
+		return;
+	}
+	mPending.push_back(imsi);
+	mRequested[imsi] = 0;	// Pending, not sent yet.
+}
+
+
+void AuthVectorCache::avPut(const string &imsi, const string &rand)
+{
+	time_t now = time(NULL);
+	unsigned maxEntries = gConfig.getNum("Control.LUR.AuthPrefetch.MaxEntries");
+	time_t lifetime = gConfig.getNum("Control.LUR.AuthPrefetch.Lifetime");
+	ScopedLock lock(mLock);
+	mRequested.erase(imsi);
+	if (rand.empty()) {
+		LOG(DEBUG) << "no challenge prefetched for"<<LOGVAR(imsi);
+		return;
+	}
+	avPurge(now);
+	// The oldest entries go first when the cache is full.
+	while (mVectors.size() >= maxEntries && mOrder.size()) {
+		VectorMap::iterator it = mVectors.find(mOrder.front().second);
+		if (it != mVectors.end() && it->second.avExpiry == mOrder.front().first) { mVectors.erase(it); }
+		mOrder.pop_front();
+	}
+	AuthVector &vec = mVectors[imsi];
+	vec.avRand = rand;
+	vec.avExpiry = now + lifetime;
+	mOrder.push_back(pair<time_t,string>(vec.avExpiry,imsi));
+	LOG(DEBUG) << "prefetched challenge for"<<LOGVAR(imsi);
+}
+
+
+// The SIP side delivers the answer to a prefetch here.
+void AuthVectorCache::prefetchDone(const string &imsi, const string &rand)
+{
+	gAuthVectors.avPut(imsi,rand);
+}
+
+
+void AuthVectorCache::prefetchLoop()
+{
+	// Sending is done in ticks so the fetches are spread evenly over each second.
+	const unsigned tickms = 100;
+	while (true) {
+		msleep(tickms);
+		float rate = gConfig.getNum("Control.LUR.AuthPrefetch.Rate");
+		vector<string> batch;
+		{	ScopedLock lock(mLock);
+			time_t now = time(NULL);
+			avPurge(now);
+			mCredit = min(mCredit + rate * tickms / 1000, max(rate,1.0F));
+			while (mCredit >= 1 && mPending.size()) {
+				string imsi = mPending.front();
+				mPending.pop_front();
+				mRequested[imsi] = now;
+				batch.push_back(imsi);
+				mCredit -= 1;
+			}
+		}
+		for (vector<string>::iterator it = batch.begin(); it != batch.end(); it++) {
+			LOG(DEBUG) << "prefetching challenge for"<<LOGVAR2("imsi",*it);
+			SIP::startAuthPrefetch(*it,prefetchDone);
+		}
+	}
+}
+
+};	// namespace Control
@@ -0,0 +1,74 @@
+/*
+* Copyright 2014 Range Networks, Inc.
+*
+* This software is distributed under multiple licenses;
+* see the COPYING file in the main directory for licensing
+* information for this specific distribution.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+*/
+
+#ifndef _AUTHVECTORCACHE_H_
+#define _AUTHVECTORCACHE_H_ 1
+
+#include <map>
+#include <deque>
+#include <string>
+#include <time.h>
+
+#include <Threads.h>
+
+namespace Control {
+
+// An authentication challenge obtained from the Registrar ahead of time.
+// The Registrar keeps the Ki and checks the SRES itself, so all we can hold for an MS is the RAND
+// of the challenge it issued; the second REGISTER carrying the SRES is still needed.
+struct AuthVector {
+	std::string avRand;
+	time_t avExpiry;
+	AuthVector() : avExpiry(0) {}
+};
+
+// Prefetches authentication challenges from the Registrar in the background so the next location update
+// of an MS can send the Authentication Request immediately, without waiting for the first REGISTER.
+// A challenge is fetched after each successful registration in which the Registrar challenged the MS, and used at most once.
+// The cache is bounded by Control.LUR.AuthPrefetch.MaxEntries and entries expire after Control.LUR.AuthPrefetch.Lifetime.
+// The fetches are paced by Control.LUR.AuthPrefetch.Rate so a registration storm does not become a burst at the Registrar.
+class AuthVectorCache {
+	typedef std::map<std::string,AuthVector> VectorMap;
+	Mutex mLock;
+	VectorMap mVectors;
+	std::deque<std::pair<time_t,std::string> > mOrder;	// Insertion order, which is also expiry order.  May hold stale entries.
+	std::deque<std::string> mPending;				// IMSIs waiting to be fetched.
+	std::map<std::string,time_t> mRequested;		// IMSIs pending or in flight, and when the fetch was requested or sent.
+	float mCredit;									// Fetches we may send now, for the rate limit.
+	Thread mPrefetchThread;
+	bool mStarted;
+
+	void avPurge(time_t now);
+	void prefetchLoop();
+	static void *prefetchLoopAdapter(AuthVectorCache *cache) { cache->prefetchLoop(); return NULL; }
+	static void prefetchDone(const std::string &imsi, const std::string &rand);
+
+	public:
+	AuthVectorCache() : mCredit(0), mStarted(false) {}
+	void avStart();
+
+	/** Take the cached challenge for the IMSI, if any.  Return false if there is none. */
+	bool avGet(const std::string &imsi, std::string &rand);
+	/** Ask for a challenge for the IMSI to be fetched in the background. */
+	void avPrefetch(const std::string &imsi);
+	/** The Registrar answered a prefetch; an empty RAND means it did not issue a challenge. */
+	void avPut(const std::string &imsi, const std::string &rand);
+};
+
+extern AuthVectorCache gAuthVectors;
+
+};	// namespace Control
+#endif
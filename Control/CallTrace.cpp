@@ -0,0 +1,230 @@
+/*
+* Copyright 2014 Range Networks, Inc.
+*
+* This software is distributed under multiple licenses;
+* see the COPYING file in the main directory for licensing
+* information for this specific distribution.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+*/
+
+#define LOG_GROUP LogGroup::Control
+#include "CallTrace.h"
+#include <sstream>
+#include <algorithm>
+#include <time.h>
+#include <errno.h>
+#include <string.h>
+#include <Logger.h>
+#include <Globals.h>
+#include <Utils.h>
+
+using namespace std;
+
+namespace Control {
+
+CallTrace gCallTrace;
+
+const char *CallTraceEvent2Text(CallTraceEvent event)
+{
+	switch (event) {
+		case ctRach: return "rach";
+		case ctImmAssign: return "immassign";
+		case ctEstablish: return "sabm";
+		case ctServiceRequest: return "service";
+		case ctServiceAccept: return "accept";
+		case ctSetup: return "setup";
+		case ctInvite: return "invite";
+		case ct100: return "100";
+		case ct180: return "180";
+		case ct200: return "200";
+		case ctAssignComplete: return "assigned";
+		case ctCipher: return "cipher";
+		case ctConnect: return "connect";
+		case ctFirstRtp: return "rtp";
+		case ctNumEvents: break;
+	}
+	return "unknown";
+}
+
+
+double CallTraceRecord::ctrOrigin() const
+{
+	double origin = 0;
+	for (unsigned i = 0; i < ctNumEvents; i++) {
+		if (ctrTimes[i] && (origin == 0 || ctrTimes[i] < origin)) { origin = ctrTimes[i]; }
+	}
+	return origin;
+}
+
+int CallTraceRecord::ctrOffset(CallTraceEvent event) const
+{
+	if (ctrTimes[event] == 0) { return -1; }
+	return (int) ((ctrTimes[event] - ctrOrigin()) * 1000 + 0.5);
+}
+
+// One line, the origin as wall clock time followed by the offset in msecs of each milestone that was seen.
+void CallTraceRecord::ctrText(ostream &os) const
+{
+	double origin = ctrOrigin();
+	time_t secs = (time_t) origin;
+	struct tm tm;
+	localtime_r(&secs,&tm);
+	char buf[40];
+	strftime(buf,sizeof(buf),"%Y-%m-%d %H:%M:%S",&tm);
+	os << buf << format(".%03d",(int)((origin - secs) * 1000)) << " tran=" << ctrTranId << (ctrMT ? " MTC" : " MOC");
+	if (ctrTimes[ctRach]) { os << " rachfn=" << ctrRachFN; }
+	for (unsigned i = 0; i < ctNumEvents; i++) {
+		int offset = ctrOffset((CallTraceEvent)i);
+		if (offset >= 0) { os << " " << CallTraceEvent2Text((CallTraceEvent)i) << "=" << offset; }
+	}
+}
+
+
+CallTrace::CallTrace() : mFile(NULL)
+{
+	for (unsigned mt = 0; mt < 2; mt++) {
+		for (unsigned i = 0; i < ctNumEvents; i++) { mNextSample[mt][i] = 0; }
+	}
+}
+
+void CallTrace::ctStart(TranEntryId tid, bool mt)
+{
+	double now = timef();
+	ScopedLock lock(mLock);
+	CallTraceRecord &rec = mActive[tid];
+	rec.ctrTranId = tid;
+	rec.ctrMT = mt;
+	// An MTC starts when the INVITE arrives.
+	if (mt) { rec.ctrTimes[ctInvite] = now; }
+}
+
+void CallTrace::ctChannel(TranEntryId tid, const CallTraceChannel &chan)
+{
+	double now = timef();
+	ScopedLock lock(mLock);
+	TraceMap::iterator it = mActive.find(tid);
+	if (it == mActive.end()) { return; }
+	CallTraceRecord &rec = it->second;
+	if (rec.ctrTimes[ctServiceRequest]) { return; }		// Moved to a new channel, eg, by reassignment.
+	rec.ctrRachFN = chan.ctcRachFN;
+	rec.ctrTimes[ctRach] = chan.ctcRach;
+	rec.ctrTimes[ctImmAssign] = chan.ctcImmAssign;
+	rec.ctrTimes[ctEstablish] = chan.ctcEstablish;
+	rec.ctrTimes[ctServiceRequest] = now;
+}
+
+void CallTrace::ctMark(TranEntryId tid, CallTraceEvent event)
+{
+	double now = timef();
+	ScopedLock lock(mLock);
+	TraceMap::iterator it = mActive.find(tid);
+	if (it == mActive.end()) { return; }		// Not a call, or not traced.
+	if (it->second.ctrTimes[event] == 0) { it->second.ctrTimes[event] = now; }
+}
+
+void CallTrace::ctFinish(TranEntryId tid)
+{
+	unsigned history = gConfig.getNum("Control.CallTrace.History");
+	string filename = gConfig.getStr("Control.CallTrace.Filename");
+	ostringstream line;
+	{	ScopedLock lock(mLock);
+		TraceMap::iterator it = mActive.find(tid);
+		if (it == mActive.end()) { return; }
+		const CallTraceRecord &rec = it->second;
+		for (unsigned i = 0; i < ctNumEvents; i++) {
+			int offset = rec.ctrOffset((CallTraceEvent)i);
+			if (offset < 0) { continue; }
+			vector<int> &samples = mSamples[rec.ctrMT][i];
+			unsigned &next = mNextSample[rec.ctrMT][i];
+			if (samples.size() < cSamples) {
+				samples.push_back(offset);
+			} else {
+				samples[next] = offset;
+			}
+			next = (next + 1) % cSamples;
+		}
+		if (filename.size()) { rec.ctrText(line); }
+		mRecent.push_back(rec);
+		while (mRecent.size() > history) { mRecent.pop_front(); }
+		mActive.erase(it);
+	}
+	if (filename.size()) { ctWrite(filename,line.str()); }
+}
+
+// The file stays open until the name is changed.
+void CallTrace::ctWrite(const string &filename, const string &line)
+{
+	ScopedLock lock(mFileLock);
+	if (mFile && filename != mFileName) {
+		fclose(mFile);
+		mFile = NULL;
+	}
+	if (mFile == NULL) {
+		mFile = fopen(filename.c_str(),"a");
+		if (mFile == NULL) {
+			LOG(ERR) << "could not open call trace file " << filename << ": " << strerror(errno);
+			return;
+		}
+		mFileName = filename;
+	}
+	fprintf(mFile,"%s\n",line.c_str());
+	fflush(mFile);
+}
+
+void CallTrace::ctClear()
+{
+	ScopedLock lock(mLock);
+	mRecent.clear();
+	for (unsigned mt = 0; mt < 2; mt++) {
+		for (unsigned i = 0; i < ctNumEvents; i++) {
+			mSamples[mt][i].clear();
+			mNextSample[mt][i] = 0;
+		}
+	}
+}
+
+// The percentiles of each milestone, in msecs from the origin, over the most recent cSamples calls.
+void CallTrace::ctStats(ostream &os)
+{
+	ScopedLock lock(mLock);
+	for (unsigned mt = 0; mt < 2; mt++) {
+		os << (mt ? "MTC" : "MOC") << " milestones, msecs from " << (mt ? "INVITE" : "RACH") << ":\n";
+		os << format("%-10s %6s %6s %6s %6s %6s\n","","count","p50","p90","p99","max");
+		for (unsigned i = 0; i < ctNumEvents; i++) {
+			vector<int> sorted(mSamples[mt][i]);
+			if (sorted.empty()) { continue; }
+			sort(sorted.begin(),sorted.end());
+			unsigned n = sorted.size();
+			os << format("%-10s %6u %6d %6d %6d %6d\n",CallTraceEvent2Text((CallTraceEvent)i),n,
+				sorted[(n-1)*50/100],sorted[(n-1)*90/100],sorted[(n-1)*99/100],sorted[n-1]);
+		}
+	}
+}
+
+void CallTrace::ctRecent(ostream &os, unsigned count)
+{
+	ScopedLock lock(mLock);
+	unsigned start = mRecent.size() > count ? mRecent.size() - count : 0;
+	for (unsigned i = start; i < mRecent.size(); i++) {
+		mRecent[i].ctrText(os);
+		os << "\n";
+	}
+}
+
+void CallTrace::ctActive(ostream &os)
+{
+	ScopedLock lock(mLock);
+	for (TraceMap::iterator it = mActive.begin(); it != mActive.end(); it++) {
+		it->second.ctrText(os);
+		os << "\n";
+	}
+}
+
+};	// namespace Control
@@ -0,0 +1,113 @@
+/*
+* Copyright 2014 Range Networks, Inc.
+*
+* This software is distributed under multiple licenses;
+* see the COPYING file in the main directory for licensing
+* information for this specific distribution.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+*/
+
+#ifndef _CALLTRACE_H_
+#define _CALLTRACE_H_ 1
+
+#include <map>
+#include <deque>
+#include <vector>
+#include <string>
+#include <ostream>
+#include <stdio.h>
+
+#include <Threads.h>
+#include "ControlTransfer.h"	// For TranEntryId.
+
+namespace Control {
+
+// The call setup milestones, in the order they normally happen for an MOC.
+// Some only apply to one direction; the INVITE is sent for an MOC and received for an MTC,
+// and 100/180/200 are received for an MOC and sent for an MTC.
+enum CallTraceEvent {
+	ctRach,				// The RACH burst, timed from its frame number.
+	ctImmAssign,		// Immediate Assignment sent on the CCCH.
+	ctEstablish,		// SABM received, ie, the ESTABLISH primitive.
+	ctServiceRequest,	// The transaction was attached to the channel: CM Service Request for MOC, Paging Response for MTC.
+	ctServiceAccept,	// CM Service Accept sent, MOC only.
+	ctSetup,			// CC Setup received for MOC, sent for MTC.
+	ctInvite,
+	ct100,
+	ct180,
+	ct200,
+	ctAssignComplete,	// RR Assignment Complete on the TCH.
+	ctCipher,			// Ciphering Mode Command sent.
+	ctConnect,			// CC Connect sent for MOC, received for MTC.
+	ctFirstRtp,			// First downlink RTP frame.
+	ctNumEvents
+};
+extern const char *CallTraceEvent2Text(CallTraceEvent event);
+
+// The channel milestones happen before there is any transaction, so they are kept on the channel
+// until a call transaction is attached to it.  Times are timef(), 0 if not seen.
+struct CallTraceChannel {
+	unsigned ctcRachFN;
+	double ctcRach, ctcImmAssign, ctcEstablish;
+	CallTraceChannel() { ctcClear(); }
+	void ctcClear() { ctcRachFN = 0; ctcRach = ctcImmAssign = ctcEstablish = 0; }
+};
+
+struct CallTraceRecord {
+	TranEntryId ctrTranId;
+	bool ctrMT;
+	unsigned ctrRachFN;
+	double ctrTimes[ctNumEvents];	// timef(), 0 if not seen.
+	CallTraceRecord() : ctrTranId(0), ctrMT(false), ctrRachFN(0) { for (unsigned i = 0; i < ctNumEvents; i++) { ctrTimes[i] = 0; } }
+	// The earliest milestone, which is the RACH for an MOC and the INVITE for an MTC.
+	double ctrOrigin() const;
+	// Milliseconds from the origin, or -1 if the event was not seen.
+	int ctrOffset(CallTraceEvent event) const;
+	void ctrText(std::ostream &os) const;
+};
+
+// Timestamps the setup milestones of each MOC and MTC transaction.
+// When the transaction ends its trace is kept in a short history for the CLI, appended to the dump file
+// named by Control.CallTrace.Filename, and each milestone goes into a window of recent samples
+// from which the CLI prints percentiles.
+// Marking is a map lookup under mLock, done a dozen times per call; nothing else is done while holding it.
+class CallTrace {
+	typedef std::map<TranEntryId,CallTraceRecord> TraceMap;
+	static const unsigned cSamples = 1000;	// Per milestone and direction.
+	Mutex mLock;
+	TraceMap mActive;
+	std::deque<CallTraceRecord> mRecent;
+	std::vector<int> mSamples[2][ctNumEvents];	// Rings of offsets in msecs, indexed by ctrMT.
+	unsigned mNextSample[2][ctNumEvents];
+
+	Mutex mFileLock;
+	FILE *mFile;
+	std::string mFileName;
+	void ctWrite(const std::string &filename, const std::string &line);
+
+	public:
+	CallTrace();
+	void ctStart(TranEntryId tid, bool mt);
+	/** The transaction was attached to the channel; pick up the channel milestones. */
+	void ctChannel(TranEntryId tid, const CallTraceChannel &chan);
+	/** Only the first occurrence of each event counts. */
+	void ctMark(TranEntryId tid, CallTraceEvent event);
+	void ctFinish(TranEntryId tid);
+	void ctClear();
+
+	void ctStats(std::ostream &os);
+	void ctRecent(std::ostream &os, unsigned count);
+	void ctActive(std::ostream &os);
+};
+
+extern CallTrace gCallTrace;
+
+};	// namespace Control
+#endif
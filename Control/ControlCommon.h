@@ -154,11 +154,26 @@ enum MMState {
 
 
 
-/**@name Dispatch controllers for specific channel types. */
+/**@name Dispatch controller for the dedicated channels, SDCCH and FACCH. */
 //@{
-//void FACCHDispatcher(GSM::TCHFACCHLogicalChannel *TCHFACCH);
-//void SDCCHDispatcher(GSM::SDCCHLogicalChannel *SDCCH);
-void DCCHDispatcher(L3LogicalChannel *DCCH);
+/** Add a channel to the DCCH dispatcher.  Call once per channel at configuration time. */
+void dcchRegister(L3LogicalChannel *DCCH);
+/** Something arrived for the channel: an L2 frame or primitive, or a SIP dialog message. */
+void dcchReady(L3LogicalChannel *DCCH);
+/** Start the DCCH dispatcher worker pool. */
+void DCCHDispatchStart();
+/** Tell the dispatcher the calling thread is about to block; returns false if not called from a dispatcher worker. */
+bool dcchBlockingBegin();
+void dcchBlockingEnd();
+
+/** Scoped wrapper around dcchBlockingBegin/End.  If constructed with false, begin() may be called later, at most once takes effect. */
+class DCCHBlocking {
+	bool mBlocked;
+	public:
+	DCCHBlocking(bool now = true) : mBlocked(false) { if (now) { begin(); } }
+	void begin() { if (!mBlocked) { mBlocked = dcchBlockingBegin(); } }
+	~DCCHBlocking() { if (mBlocked) { dcchBlockingEnd(); } }
+};
 //@}
 
 
@@ -42,6 +42,7 @@ extern bool l3rewrite();
 extern void l3start();
 extern void controlInit();
 extern unsigned allocateRTPPorts();
+extern void releaseRTPPorts(unsigned rtpPort);
 
 class TMSI_t {
 	bool mValid;
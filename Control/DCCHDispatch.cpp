@@ -1,4 +1,4 @@
-/**@file Idle-mode dispatcher for dedicated control channels. */
+/**@file Worker pool dispatcher for dedicated control channels. */
 
 /*
 * Copyright 2008, 2009 Free Software Foundation, Inc.
@@ -32,6 +32,8 @@
 #undef WARNING
 #include <Reporting.h>
 #include <Globals.h>
+#include <deque>
+#include <vector>
 
 using namespace std;
 using namespace GSM;
@@ -40,81 +42,211 @@ using namespace Control;
 
 
 
-/** Example of a closed-loop, persistent-thread control function for the DCCH. */
-// (pat) DCCH is a TCHFACCHLogicalChannel or SDCCHLogicalChannel
-void Control::DCCHDispatcher(L3LogicalChannel *DCCH)
-{
-	while (! gBTS.btsShutdown()) {
-		// This 'try' is redundant, but we are ultra-cautious here since a mistake means a crash.
-		try {
-			// Wait for a transaction to start.
-			LOG(DEBUG);
-			LOG(DEBUG) << "waiting for " << *DCCH << " ESTABLISH or HANDOVER_ACCESS";
-			L3Frame *frame = DCCH->waitForEstablishOrHandover();
-			LOG(DEBUG) << *DCCH << " received " << *frame;
-			gResetWatchdog();
-			L3DCCHLoop(DCCH,frame); // This will not return until the channel is released.
-		}
-		catch (...) {
-			LOG(ERR) << "channel killed by unexpected exception ";
+namespace Control {
+
+// The dedicated channels are serviced by a fixed pool of worker threads rather than one thread per channel.
+// A channel is made ready when something arrives for it, an L2 frame or primitive in writeToL3 or a SIP dialog message,
+// and by a tick every 100ms while it is open, which covers the L3 timers, termination requests and radio link failure
+// at the same granularity the old per-channel loop polled with.
+// A channel is on the run queue at most once and is serviced by at most one worker at a time, so the L3 code,
+// which was written for a thread per channel, still sees the events on each channel one at a time.
+// Some L3 operations block: the voice traffic loop for the length of the call, LAPDm waiting for an ack,
+// and the RELEASE primitive for up to 30 seconds.  Those go through DCCHBlocking, and if that would leave
+// fewer than Control.DCCHDispatch.Workers workers free the pool starts another.  So the thread count follows
+// the peak number of simultaneously blocked channels, not the number of configured channels.  Once more than
+// Control.DCCHDispatch.Workers have been free for cWorkerIdleMsecs the tick retires one, so the pool shrinks back
+// after the peak.  The tick keeps every worker busy now and then, so it is the surplus that times out, not a worker.
+class DCCHDispatchPool {
+	enum DispatchState {
+		dsIdle,			// Nothing to do.
+		dsQueued,		// On the run queue.
+		dsRunning,		// Being serviced by a worker.
+		dsRunningAgain	// Being serviced, and something new arrived meanwhile.
+	};
+	static const unsigned cWorkerIdleMsecs = 60000;
+
+	struct Worker {
+		DCCHDispatchPool *mPool;
+		Thread mThread;
+		Worker(DCCHDispatchPool *wPool) : mPool(wPool) {}
+	};
+
+	Mutex mLock;
+	Signal mWork;
+	std::deque<L3LogicalChannel*> mRunQ;
+	std::vector<L3LogicalChannel*> mChans;
+	unsigned mMinFree;			// Configured number of workers that should be free to run.
+	unsigned mWorkers;			// Number of worker threads started.
+	unsigned mBlocked;			// Number of workers inside DCCHBlocking.
+	bool mStarted;
+	Thread mTickThread;
+	std::vector<Worker*> mRetired;	// Workers that have exited, joined by the tick thread.
+	unsigned mRetire;			// Number of workers asked to exit.
+	bool mSurplus;				// More than mMinFree workers are free, since mSurplusSince.
+	Timeval mSurplusSince;
+
+	// Caller holds mLock.
+	void makeReady(L3LogicalChannel *chan) {
+		switch (chan->mDispatchState) {
+			case dsIdle:
+				chan->mDispatchState = dsQueued;
+				mRunQ.push_back(chan);
+				if (mStarted) { mWork.signal(); }
+				break;
+			case dsRunning:
+				chan->mDispatchState = dsRunningAgain;
+				break;
+			default:	// Already queued or marked.
+				break;
 		}
+	}
 
-#if 0
-		// Catch the various error cases.
+	// Caller holds mLock.
+	void startWorker();
+	void reapWorkers();
 
-		catch (RemovedTransaction except) {
-			LOG(ERR) << "attempt to use removed transaciton " << except.transactionID();
-		}
-		catch (ChannelReadTimeout except) {
-			LOG(NOTICE) << "ChannelReadTimeout";
-			// Cause 0x03 means "abnormal release, timer expired".
-			DCCH->l2sendm(L3ChannelRelease((RRCause)0x03));
-			gTransactionTable.remove(except.transactionID());
-		}
-		catch (UnexpectedPrimitive except) {
-			LOG(NOTICE) << "UnexpectedPrimitive";
-			// Cause 0x62 means "message type not not compatible with protocol state".
-			DCCH->l2sendm(L3ChannelRelease((RRCause)0x62));
-			if (except.transactionID()) gTransactionTable.remove(except.transactionID());
+	public:
+	DCCHDispatchPool() : mMinFree(0), mWorkers(0), mBlocked(0), mStarted(false), mRetire(0), mSurplus(false) {}
+
+	void add(L3LogicalChannel *chan) {
+		ScopedLock lock(mLock);
+		if (chan->mDispatchRegistered) { return; }
+		chan->mDispatchRegistered = true;
+		mChans.push_back(chan);
+		makeReady(chan);	// In case something arrived before registration.
+	}
+
+	void ready(L3LogicalChannel *chan) {
+		if (! chan->mDispatchRegistered) { return; }	// Not a dispatched channel, eg, SACCH.
+		ScopedLock lock(mLock);
+		makeReady(chan);
+	}
+
+	void start() {
+		ScopedLock lock(mLock);
+		if (mStarted) { return; }
+		mStarted = true;
+		mMinFree = gConfig.getNum("Control.DCCHDispatch.Workers");
+		LOG(INFO) << "starting DCCH dispatcher" <<LOGVAR2("workers",mMinFree) <<LOGVAR2("channels",mChans.size());
+		while (mWorkers < mMinFree) { startWorker(); }
+		mTickThread.start((void*(*)(void*))tickLoopAdapter,this);
+	}
+
+	bool blockingBegin() {
+		ScopedLock lock(mLock);
+		mBlocked++;
+		if (mWorkers - mBlocked < mMinFree) {
+			startWorker();
+			LOG(INFO) << "DCCH dispatcher grew" <<LOGVAR2("workers",mWorkers) <<LOGVAR2("blocked",mBlocked);
 		}
-		catch (UnexpectedMessage except) {
-			LOG(NOTICE) << "UnexpectedMessage";
-			// Cause 0x62 means "message type not not compatible with protocol state".
-			DCCH->l2sendm(L3ChannelRelease((RRCause)0x62));
-			if (except.transactionID()) gTransactionTable.remove(except.transactionID());
+		return true;
+	}
+
+	void blockingEnd() {
+		ScopedLock lock(mLock);
+		assert(mBlocked);
+		mBlocked--;
+	}
+
+	void workerLoop(Worker *self);
+	void tickLoop();
+	static void *workerLoopAdapter(Worker *worker) { worker->mPool->workerLoop(worker); return NULL; }
+	static void *tickLoopAdapter(DCCHDispatchPool *pool) { pool->tickLoop(); return NULL; }
+};
+
+static DCCHDispatchPool gDCCHDispatch;
+
+// Set in the worker threads so DCCHBlocking can tell whether it is running on one.
+static __thread bool sIsDCCHWorker = false;
+
+void DCCHDispatchPool::startWorker()
+{
+	mWorkers++;
+	Worker *worker = new Worker(this);
+	worker->mThread.start((void*(*)(void*))workerLoopAdapter,worker);
+}
+
+void DCCHDispatchPool::reapWorkers()
+{
+	std::vector<Worker*> retired;
+	{	ScopedLock lock(mLock);
+		retired.swap(mRetired);
+	}
+	for (std::vector<Worker*>::iterator it = retired.begin(); it != retired.end(); it++) {
+		(*it)->mThread.join();
+		delete *it;
+	}
+}
+
+void DCCHDispatchPool::workerLoop(Worker *self)
+{
+	sIsDCCHWorker = true;
+	mLock.lock();
+	while (! gBTS.btsShutdown()) {
+		if (mRetire) {
+			mRetire--;
+			if (mWorkers - mBlocked > mMinFree) {
+				mWorkers--;
+				mRetired.push_back(self);
+				if (mRunQ.size()) { mWork.signal(); }	// In case we took the wakeup meant for a queued channel.
+				LOG(INFO) << "DCCH dispatcher shrank" <<LOGVAR2("workers",mWorkers) <<LOGVAR2("blocked",mBlocked);
+				break;
+			}
 		}
-		catch (UnsupportedMessage except) {
-			LOG(NOTICE) << "UnsupportedMessage";
-			// Cause 0x61 means "message type not implemented".
-			DCCH->l2sendm(L3ChannelRelease((RRCause)0x61));
-			if (except.transactionID()) gTransactionTable.remove(except.transactionID());
+		if (mRunQ.empty()) {
+			mWork.wait(mLock);
+			continue;
 		}
-		catch (Q931TimerExpired except) {
-			LOG(NOTICE) << "Q.931 T3xx timer expired";
-			// Cause 0x03 means "abnormal release, timer expired".
-			// TODO -- Send diagnostics.
-			DCCH->l2sendm(L3ChannelRelease((RRCause)0x03));
-			if (except.transactionID()) gTransactionTable.remove(except.transactionID());
+		L3LogicalChannel *chan = mRunQ.front();
+		mRunQ.pop_front();
+		chan->mDispatchState = dsRunning;
+		mLock.unlock();
+
+		bool more = L3DCCHService(chan);
+
+		mLock.lock();
+		if (more || chan->mDispatchState == dsRunningAgain) {
+			chan->mDispatchState = dsQueued;
+			mRunQ.push_back(chan);	// Back of the queue, so the other ready channels get a turn first.
+		} else {
+			chan->mDispatchState = dsIdle;
 		}
-		catch (SIP::SIPTimeout except) {
-			// FIXME -- The transaction ID should be an argument here.
-			LOG(WARNING) << "Uncaught SIPTimeout, will leave a stray transcation";
-			// Cause 0x03 means "abnormal release, timer expired".
-			DCCH->l2sendm(L3ChannelRelease((RRCause)0x03));
-			if (except.transactionID()) gTransactionTable.remove(except.transactionID());
+	}
+	mLock.unlock();
+}
+
+void DCCHDispatchPool::tickLoop()
+{
+	while (! gBTS.btsShutdown()) {
+		msleep(100);
+		reapWorkers();
+		ScopedLock lock(mLock);
+		if (mWorkers - mBlocked <= mMinFree) {
+			mSurplus = false;
+		} else if (! mSurplus) {
+			mSurplus = true;
+			mSurplusSince.now();
+		} else if (mSurplusSince.elapsed() >= (long)cWorkerIdleMsecs) {
+			mRetire++;
+			mWork.signal();
+			mSurplusSince.now();	// One at a time.
 		}
-		catch (SIP::SIPError except) {
-			// FIXME -- The transaction ID should be an argument here.
-			LOG(WARNING) << "Uncaught SIPError, will leave a stray transcation";
-			// Cause 0x01 means "abnormal release, unspecified".
-			DCCH->l2sendm(L3ChannelRelease((RRCause)0x01));
-			if (except.transactionID()) gTransactionTable.remove(except.transactionID());
+		for (std::vector<L3LogicalChannel*>::iterator it = mChans.begin(); it != mChans.end(); it++) {
+			if ((*it)->mDcchOpen) { makeReady(*it); }
 		}
-#endif
 	}
 }
 
 
+void dcchRegister(L3LogicalChannel *DCCH) { gDCCHDispatch.add(DCCH); }
+void dcchReady(L3LogicalChannel *DCCH) { gDCCHDispatch.ready(DCCH); }
+void DCCHDispatchStart() { gDCCHDispatch.start(); }
+bool dcchBlockingBegin() { return sIsDCCHWorker ? gDCCHDispatch.blockingBegin() : false; }
+void dcchBlockingEnd() { gDCCHDispatch.blockingEnd(); }
+
+};	// namespace Control
+
+
 
 
 // vim: ts=4 sw=4
@@ -490,6 +490,7 @@ MachineStatus MOCMachine::serviceAccept()
 	// Let the phone know we're going ahead with the transaction.
 	PROCLOG(INFO) << "sending CMServiceAccept";
 	channel()->l3sendm(GSM::L3CMServiceAccept());
+	gCallTrace.ctMark(tran()->tranID(),ctServiceAccept);
 
 	// We are now waiting for a L3Setup message.
 	// We could attach the MMContext to the MMUser at any time but it might start receiving calls or SMS immediately,
@@ -626,6 +627,7 @@ MachineStatus MOCMachine::machineRunState(int state, const GSM::L3Message *l3msg
 				LOG(DEBUG) << "ignoring duplicate L3EmergencySetup";
 				return MachineStatusOK;
 			}
+			gCallTrace.ctMark(tran()->tranID(),ctSetup);
 			const L3Setup *msg = dynamic_cast<typeof(msg)>(l3msg);
 			
 			MachineStatus stat = handleSetupMsg(msg);
@@ -682,12 +684,14 @@ MachineStatus MOCMachine::machineRunState(int state, const GSM::L3Message *l3msg
 					channel()->l3sendm(GSM::L3CipheringModeCommand(
 						GSM::L3CipheringModeSetting(true, encryptionAlgorithm),
 						GSM::L3CipheringModeResponse(false)));
+					gCallTrace.ctMark(tran()->tranID(),ctCipher);
 				} else {
 					LOG(DEBUG) << "no ki: NOT sending Ciphering Mode Command on " << *channel() << " for IMSI" << tran()->subscriberIMSI();
 				}
 			}
 
 			channel()->l3sendm(L3Connect(getL3TI()));
+			gCallTrace.ctMark(tran()->tranID(),ctConnect);
 			setGSMState(CCState::ConnectIndication);
 			getDialog()->MOCInitRTP();
 			getDialog()->MOCSendACK();
@@ -825,6 +829,7 @@ MachineStatus AssignTCHMachine::machineRunState(int state, const GSM::L3Message
 	// but reassignmentComplete knows this.
 	case L3CASE_RR(AssignmentComplete): {
 		timerStop(T3101);
+		gCallTrace.ctMark(tran()->tranID(),ctAssignComplete);
 		channel()->reassignComplete();
 		PROCLOG(INFO) << "successful assignment";
 		PROCLOG(DEBUG) << gMMLayer.printMMInfo();
@@ -929,6 +934,7 @@ MachineStatus MTCMachine::machineRunState(int state, const GSM::L3Message* l3msg
 			//setupmsg.setSignal(tone);
 			PROCLOG(INFO) << "sending L3Setup to call " << LOGVAR2("calling",tran()->calling()) << tran() <<LOGVAR(setupmsg);
 			channel()->l3sendm(setupmsg);
+			gCallTrace.ctMark(tran()->tranID(),ctSetup);
 			setGSMState(CCState::CallPresent);
 			timerStart(T303,T303ms,TimerAbortTran);	// Time state "Call Present"; start CMServiceRequest recv; stop CallProceeding recv.
 
@@ -998,6 +1004,7 @@ MachineStatus MTCMachine::machineRunState(int state, const GSM::L3Message* l3msg
 			// and we use the CCState flag to indicate when the RTP traffic can start.
 			// Setting state Active later is probably more technically correct too.
 			//old: setGSMState(CCState::Active);
+			gCallTrace.ctMark(tran()->tranID(),ctConnect);
 			setGSMState(CCState::ConnectIndication);	// Note: This may technically be an MOC only defined state.
 			if (getDialog()) { getDialog()->MTCSendOK(tran()->chooseCodec(),channel()); }
 			return MachineStatusOK;		// Wait for SIP OK-ACK
@@ -1017,6 +1024,7 @@ MachineStatus MTCMachine::machineRunState(int state, const GSM::L3Message* l3msg
 					channel()->l3sendm(GSM::L3CipheringModeCommand(
 						GSM::L3CipheringModeSetting(true, encryptionAlgorithm),
 						GSM::L3CipheringModeResponse(false)));
+					gCallTrace.ctMark(tran()->tranID(),ctCipher);
 				} else {
 					LOG(DEBUG) << "no ki: NOT sending Ciphering Mode Command on " << *channel() << " for IMSI" << tran()->subscriberIMSI();
 				}
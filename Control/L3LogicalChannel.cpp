@@ -31,6 +31,7 @@ void L3LogicalChannel::L3LogicalChannelReset()
 	ScopedLock lock(gMMLock,__FILE__,__LINE__);	// FIXMENOW Added 10-23-2013
 	// We could reset mNextChan too, but it is unused unless needed so dont bother.
 	chanFreeContext(TermCause::Local(L3Cause::No_Transaction_Expected));	// If we do cancel any dialogs, it is in error.
+	mChanTrace.ctcClear();
 	LOG(DEBUG);
 	if (mNextChan && mNextChan->mChState == chReassignTarget) {
 		// This rare case may occur for channel loss or if the MS sends, for example, an IMSI Detach
@@ -55,6 +56,10 @@ void L3LogicalChannel::L3LogicalChannelInit()
 	//mPrevChan = NULL;
 	mChState = chIdle;
 	mChContext = NULL;
+	mChGeneration = 0;
+	mDcchOpen = false;
+	mDispatchRegistered = false;
+	mDispatchState = 0;
 	L3LogicalChannelReset();
 }
 
@@ -137,7 +142,7 @@ MMContext *L3LogicalChannel::chanGetContext(bool create)
 	ScopedLock lock(gMMLock,__FILE__,__LINE__);
 	//LOG(DEBUG);
 	if (mChContext == NULL) {
-		if (create) { mChContext = new MMContext(this); }
+		if (create) { mChContext = new MMContext(this); mChGeneration++; }
 	}
 	return mChContext;
 }
@@ -154,6 +159,15 @@ string L3LogicalChannel::chanGetImsi(bool verbose) const
 	return mChContext ? mChContext->mmGetImsi(verbose) : string(verbose ? "no-MMChannel" : "");
 }
 
+// For reports taken earlier from the channel, which must not be attributed to whoever has it now.
+bool L3LogicalChannel::chanGetImsiOfGeneration(unsigned generation, string &imsi) const
+{
+	ScopedLock lock(gMMLock,__FILE__,__LINE__);
+	if (mChGeneration != generation) { return false; }
+	imsi = mChContext ? mChContext->mmGetImsi(true) : string("no-MMChannel");
+	return true;
+}
+
 // WARNING: This is called from the CLI thread.
 time_t L3LogicalChannel::chanGetDuration() const
 {
@@ -178,6 +192,7 @@ void L3LogicalChannel::chanFreeContext(TermCause cause)
 	MMContext *save = mChContext;
 	mChContext = NULL;
 	if (save) {
+		mChGeneration++;
 		LOG(DEBUG) <<this;
 		gMMLayer.mmFreeContext(save,cause);
 	}
@@ -225,6 +240,7 @@ void L3LogicalChannel::reassignStart()
 	}
 	mNextChan->chanFreeContext(TermCause::Local(L3Cause::No_Transaction_Expected));	// This is supposed to be a no-op.
 	mNextChan->mChContext = mChContext->tsDup();	// Must set directly.  Does not change the channel back pointer.
+	mNextChan->mChGeneration++;
 	// We set this state on nextChan in case of channel loss - see L3LogicalChannelReset
 	mNextChan->chanSetState(L3LogicalChannel::chReassignTarget);
 
@@ -17,6 +17,7 @@
 #define _L3LOGICALCHANNEL_H_ 1
 #include "ControlTransfer.h"
 #include "L3TermCause.h"
+#include "CallTrace.h"
 //#include <GSML3RRElements.h>
 #include <L3Enums.h>
 #include <GSMTransfer.h>
@@ -28,7 +29,8 @@ class MMContext;
 
 class L3LogicalChannel {
 	friend class AssignTCHMachine;
-	friend void L3DCCHLoop(L3LogicalChannel*dcch, L3Frame*frame);
+	friend bool L3DCCHService(L3LogicalChannel*dcch);
+	friend class DCCHDispatchPool;
 
 	// Normally only one thread accesses each LogicalChannel, however, during reassignment the LogicalChannel
 	// is accessed from the thread of the previous channel.  I dont think conflicts are possible, but to be
@@ -65,6 +67,7 @@ class L3LogicalChannel {
 	// It can be moved to a different channel by RR Procedures.
 	// (In contrast, an MMUser is associated with an IMSI.)
 	MMContext *mChContext;	// When set we increment the use count in the MMContext.
+	volatile unsigned mChGeneration;	// Bumped with gMMLock held whenever mChContext changes, so a report can tell whose it was.
 	protected:
 	L3LogicalChannel *mNextChan;	// Used in GSM during channel reassignment.
 	//L3LogicalChannel *mPrevChan;
@@ -94,6 +97,12 @@ class L3LogicalChannel {
 	static const char *ChannelState2Text(ChannelState chstate);
 	void chanSetState(ChannelState wChState) { mChState = wChState; }
 
+	// Dispatch state.  mDcchOpen is true between the ESTABLISH or HANDOVER_ACCESS and the channel release,
+	// and is only touched by the worker servicing the channel.  The others are protected by the DCCHDispatchPool lock.
+	volatile bool mDcchOpen;
+	bool mDispatchRegistered;
+	int mDispatchState;
+
 	public:
 	// Pass-throughs from Layer2.  These will be different for GSM or UMTS.
 	virtual GSM::L3Frame * l2recv(unsigned timeout_ms = 15000) = 0;
@@ -113,6 +122,9 @@ class L3LogicalChannel {
 	bool isTCHF() const;
 	bool isReleased() const { return mChState == chRequestRelease || mChState == chRequestHardRelease; }
 
+	// Set by the CCCH before the channel is established and picked up by the first call transaction on it.
+	CallTraceChannel mChanTrace;
+
 
 	// Return the L2 info given the L3LogicalChannel.
 	GSM::L2LogicalChannel *getL2Channel();	// This method will not work under UMTS.
@@ -122,6 +134,8 @@ class L3LogicalChannel {
 	MMContext *chanGetContext(bool create);
 	void chanSetHandoverPenalty(NeighborPenalty &penalty);
 	std::string chanGetImsi(bool verbose) const;	// If the IMSI is known, return it, else string("") or if verbose, something to display in error messages and CLI.
+	unsigned chanGeneration() const { return mChGeneration; }	// Cheap, no lock.
+	bool chanGetImsiOfGeneration(unsigned generation, std::string &imsi) const;	// Like chanGetImsi(true), but only if the MMContext is still that of generation.
 	time_t chanGetDuration() const;
 	//void chanSetContext(MMContext* wTranSet);
 	void chanFreeContext(TermCause cause);
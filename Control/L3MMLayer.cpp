@@ -30,6 +30,7 @@
 #include "ControlCommon.h"
 #include "L3TranEntry.h"
 #include "L3SMSControl.h"
+#include "AuthVectorCache.h"
 #include <SIPDialog.h>
 
 namespace Control {
@@ -90,9 +91,13 @@ bool MMUser::mmuServiceMTQueues()	// arg redundant with mmuContext->channel.
 
 	// TODO: Move this to the logical channel main thread.
 	// Service the MMC queues.
+	// The SIP side adds to the queues holding only mmuLock, so take it to pop them.
 	if (mmuContext->mmGetTran(MMContext::TE_CS1).isNULL()) {
-		if (mmuMTCq.size()) {
-			TranEntry *tran = mmuMTCq.pop_frontr();
+		TranEntry *tran;
+		{	ScopedLock lock(mmuLock,__FILE__,__LINE__);
+			tran = mmuMTCq.pop_frontr();
+		}
+		if (tran) {
 			LOG(INFO) << "new MTC"<<LOGVAR(tran)<<LOGVAR2("chan",mmuContext);
 
 			// Tie the transaction to this channel.
@@ -111,8 +116,11 @@ bool MMUser::mmuServiceMTQueues()	// arg redundant with mmuContext->channel.
 		}
 	}
 	if (mmuContext->mmGetTran(MMContext::TE_MTSMS).isNULL()) {
-		if (mmuMTSMSq.size()) {
-			TranEntry *tran = mmuMTSMSq.pop_frontr();
+		TranEntry *tran;
+		{	ScopedLock lock(mmuLock,__FILE__,__LINE__);
+			tran = mmuMTSMSq.pop_frontr();
+		}
+		if (tran) {
 			gMMLock.unlock();
 			mmuContext->startSMSTran(tran);
 			return true;
@@ -127,6 +135,29 @@ bool MMUser::mmuIsEmpty()
 	return mmuMTCq.size() + mmuMTSMSq.size() == 0;
 }
 
+bool MMUser::mmuIsSmsOnly() const
+{
+	ScopedLock lock(mmuLock,__FILE__,__LINE__);
+	return mmuMTCq.size() == 0 && mmuMTSMSq.size();
+}
+
+unsigned MMContext::mmPendingMTSMS()
+{
+	ScopedLock lock(gMMLock,__FILE__,__LINE__);
+	if (!mmcMMU) { return 0; }
+	ScopedLock lock2(mmcMMU->mmuLock,__FILE__,__LINE__);
+	return mmcMMU->mmuMTSMSq.size();
+}
+
+// After an MT-SMS we hold the channel briefly because SMSCs send the parts of a concatenated message,
+// and often several messages for the same MS, one right after another.  Delivering them on this channel
+// saves a page and a channel seizure each, but we dont hold it when SDCCHs are short.
+bool MMContext::mmcLingering()
+{
+	if (mmcLingerTimer.passed()) { return false; }
+	return (int)gBTS.SDCCHAvailable() > gConfig.getNum("Control.SMS.SDCCHReserve");
+}
+
 bool MMContext::mmIsEmpty()
 {
 	//devassert(gMMLock.lockcnt());		// Caller locked it.
@@ -182,7 +213,7 @@ bool MMContext::mmCheckNewActivity()
 	// What to do about that?
 	// When we detach the MMUser, if it has anything on it, just leave it there,
 	// and paging will restart.
-	if (mmIsEmpty() && mmcDuration() > 5) {
+	if (mmIsEmpty() && mmcDuration() > 5 && !mmcLingering()) {
 		LOG(DEBUG) <<"closing"<<this;
 		mmcChan->chanClose(L3RRCause::Normal_Event,L3_RELEASE_REQUEST,TermCause::Local(L3Cause::No_Transaction_Expected));
 		return true;	// This is new activity - the calling loop should skip back to the top
@@ -221,7 +252,7 @@ MMUser::MMUser(string& wImsi)
 
 GSM::ChannelType MMUser::mmuGetInitialChanType() const
 {
-	devassert(gMMLock.lockcnt());		// Caller locked it.
+	ScopedLock lock(mmuLock,__FILE__,__LINE__);
 	if (mmuMTCq.size()) {
 		TranEntry *front = this->mmuMTCq.front();
 		switch (front->servicetype()) {
@@ -239,34 +270,65 @@ GSM::ChannelType MMUser::mmuGetInitialChanType() const
 }
 
 // Caller enters with the whole MMLayer locked so no one will try to add new contexts while we are doing this.
-void MMUser::mmuFree(MMUserMap::iterator *piter, TermCause cause)	// Some callers deleted it from the MMUsers more efficiently than looking it up again.
+// The SIP side may still add transactions until we take the MMUser out of its shard, so the 'when' condition is checked
+// there, under the shard lock.  Return true if the MMUser was deleted.
+bool MMUser::mmuFree(TermCause cause, FreeWhen when)
 {
-	devassert(mmuContext == NULL);	// Caller already unlinked or verified that it was unattached.
 	devassert(gMMLock.lockcnt());		// Caller locked it.
 
 	// mmuCleanupDialogs();
 
+	{	MMUserShard &shard = gMMLayer.mmShard(mmuImsi);
+		ScopedLock lock(shard.mLock,__FILE__,__LINE__);
+		switch (when) {
+		case FreeAlways: break;
+		case FreeIfEmpty: if (! mmuIsEmpty()) { return false; } break;
+		case FreeIfExpired: if (mmuContext || ! mmuPageExpired()) { return false; } break;	// Paged successfully or repaged meanwhile.
+		}
+		devassert(mmuContext == NULL);	// Caller already unlinked or verified that it was unattached.
+		LOG(DEBUG) << "MMUser erase "<<this->mmuImsi;
+		shard.mUsers.erase(this->mmuImsi);
+		shard.mPaging.erase(this);
+	}
+	if (mmuTmsi.valid()) { gMMLayer.mmUnindexTmsi(this,mmuTmsi.value()); }
+
 	{
 	ScopedLock lock(mmuLock,__FILE__,__LINE__);			// Now redundant.
-	LOG(DEBUG) << "MMUser DELETE "<<(void*)this <<LOGVAR(!!piter);
+	LOG(DEBUG) << "MMUser DELETE "<<(void*)this;
 	// At this point the only pointer to the transaction is in the InterthreadQueue.
 	// Once the transaction moves to the MMContext it will be put in a RefCntPointer.
 	// 10-10-2014: Formerly we needed to delete tran here, but now it is done inside teCancel.
 	while (TranEntry *tran = mmuMTCq.pop_frontr()) { tran->teCancel(cause); }
 	while (TranEntry *tran = mmuMTSMSq.pop_frontr()) { tran->teCancel(cause); }
-
-	if (piter) {		// It is just an efficiency issue to use the iterator if we already have one.
-		gMMLayer.MMUsers.erase(*piter);
-	} else {
-		LOG(DEBUG) << "MMUser erase begin " << this->mmuImsi;
-		bool exists = gMMLayer.MMUsers.find(this->mmuImsi) != gMMLayer.MMUsers.end();
-		LOG(DEBUG) << "MMUser erase "<<this->mmuImsi<<LOGVAR(exists);
-		gMMLayer.MMUsers.erase(this->mmuImsi);
-	}
-	assert(gMMLayer.MMUsers.find(this->mmuImsi) == gMMLayer.MMUsers.end());
 	}
 	// The ScopedLock points into MMUser so we must release it before deleting this.
 	delete this;
+	return true;
+}
+
+// An MS waiting only for MT-SMS that mmGetPages has not paged yet cannot have failed to answer.
+bool MMUser::mmuPageExpired()
+{
+	ScopedLock lock(mmuLock,__FILE__,__LINE__);
+	if (mmuIsSmsOnly() && !mmuSmsPaged) { return false; }
+	return mmuPageTimer.passed();
+}
+
+// Paged for MT-SMS only and still waiting for the response, so it counts against the SDCCH budget.
+bool MMUser::mmuSmsPageOutstanding() const
+{
+	ScopedLock lock(mmuLock,__FILE__,__LINE__);
+	return mmuSmsPaged && mmuIsSmsOnly();
+}
+
+// Start T3113 the first time an MS waiting only for MT-SMS is actually paged.
+void MMUser::mmuStartSmsPage()
+{
+	ScopedLock lock(mmuLock,__FILE__,__LINE__);
+	if (!mmuSmsPaged) {
+		mmuSmsPaged = true;
+		mmuPageTimer.future(gConfig.GSM.Timer.T3113);
+	}
 }
 
 void MMContext::mmGetTranList(TranEntryVector &tranlist)
@@ -706,8 +768,7 @@ bool MMLayer::mmStartMTDialog(SipDialog *dialog, SipMessage *invite)
 
 void MMUser::mmuAddMT(TranEntry *tran)
 {
-	ScopedLock lock(gMMLock,__FILE__,__LINE__);	// Way overkill.
-	//ScopedLock lock(mmuLock,__FILE__,__LINE__);
+	ScopedLock lock(mmuLock,__FILE__,__LINE__);
 	mmuPageTimer.future(gConfig.GSM.Timer.T3113);
 	switch (tran->servicetype()) {
 	case L3CMServiceType::MobileTerminatedCall:
@@ -723,8 +784,8 @@ void MMUser::mmuAddMT(TranEntry *tran)
 
 void MMUser::mmuText(std::ostream&os) const
 {
-	ScopedLock lock(gMMLock,__FILE__,__LINE__);	// way overkill
-	//ScopedLock lock(mmuLock,__FILE__,__LINE__);
+	// The caller holds gMMLock or the shard lock, either of which keeps mmuContext from changing.
+	ScopedLock lock(mmuLock,__FILE__,__LINE__);
 	os << " MMUser(";
 	os <<LOGVAR2("state",mmuState) <<LOGVAR2("imsi",mmuImsi) <<LOGVAR2("tmsi",mmuTmsi);
 	if (mmuContext) {
@@ -760,6 +821,7 @@ void MMContext::MMContextInit()
 	//mVoiceTrans = NULL;
 	memset(mmcTE,0,sizeof(mmcTE));
 	mmcOpenTime = time(NULL);
+	mmcLingerTimer.now();
 	LOG(DEBUG)<<"MMContext ALLOC "<<(void*)this;
 }
 
@@ -851,6 +913,7 @@ void MMContext::mmConnectTran(ActiveTranIndex ati, TranEntry *tran)
 	}
 	mmcTE[ati] = tran;			// Takes charge of tran; increments the refcnt
 	tran->teSetContext(this);	// And set the back pointer.
+	if (ati == TE_CS1 && mmcChan) { gCallTrace.ctChannel(tran->tranID(),mmcChan->mChanTrace); }
 
 }
 
@@ -904,6 +967,7 @@ void MMContext::mmDisconnectTran(TranEntry *tran)
 				mmcTE[TE_MOSMS1] = mmcTE[TE_MOSMS2];
 				mmcTE[TE_MOSMS2] = NULL;
 			}
+			if (tx == TE_MTSMS) { mmcLingerTimer.future(gConfig.getNum("Control.SMS.Linger")); }
 			return;
 		}
 	}
@@ -923,7 +987,7 @@ void MMContext::mmcUnlink()
 		assert(mmu->mmuContext == mmc);
 		assert(mmc->mmcMMU == mmu);
 		mmc->mmcMMU = NULL;		// old comment: Deletes its RefCntPointer and may delete it.
-		mmu->mmuContext = NULL;
+		gMMLayer.mmSetContext(mmu,NULL);
 	}
 }
 
@@ -1000,7 +1064,7 @@ void MMContext::mmcLink(MMUser *mmu)
 	}
 	mmc->mmcUnlink();
 	mmc->mmcMMU = mmu;
-	mmu->mmuContext = mmc;
+	gMMLayer.mmSetContext(mmu,mmc);
 }
 
 
@@ -1055,21 +1119,30 @@ void MMLayer::mmFreeContext(MMContext *mmc,TermCause cause)
 		// because of loss of contact with the MS.  In either case, if the MMU has dialogs,
 		// dont delete it - just leave it alone and we will start repaging this MS again.
 		// TODO: But first, walk though dialogs and cancel any that need it.
-		if (mmu->mmuIsEmpty()) {
-			mmu->mmuFree(NULL,TermCause::Local(L3Cause::No_Transaction_Expected));	// TermCause is not used because there are no dialogs.
-		}
+		mmu->mmuFree(TermCause::Local(L3Cause::No_Transaction_Expected),MMUser::FreeIfEmpty);	// TermCause is not used because there are no dialogs.
 	}
 	mmc->mmcFree(cause);
 }
 
+void MMLayer::mmStartSmsPage(const string &imsi)
+{
+	MMUserShard &shard = mmShard(imsi);
+	ScopedLock lock(shard.mLock,__FILE__,__LINE__);
+	MMUserMap::iterator it = shard.mUsers.find(imsi);
+	if (it != shard.mUsers.end()) { it->second->mmuStartSmsPage(); }
+}
+
 void MMLayer::mmMTRepage(const string imsi)
 {
 	// Renew the page timer.
 	LOG(DEBUG) <<LOGVAR(imsi);
-	ScopedLock lock(gMMLock,__FILE__,__LINE__);
-	MMUser *mmu = mmFindByImsi(imsi,false);
-	if (mmu) {
+	MMUserShard &shard = mmShard(imsi);
+	ScopedLock lock(shard.mLock,__FILE__,__LINE__);
+	MMUserMap::iterator it = shard.mUsers.find(imsi);
+	if (it != shard.mUsers.end()) {
 		// This has no effect unless we are paging, ie, if the MMUser has not yet connected to an MMChannel.
+		MMUser *mmu = it->second;
+		ScopedLock ulock(mmu->mmuLock,__FILE__,__LINE__);
 		mmu->mmuPageTimer.future(gConfig.GSM.Timer.T3113);
 	} else {
 		LOG(DEBUG) << "repeated INVITE/MESSAGE with no MMUser record";
@@ -1103,7 +1176,7 @@ bool MMLayer::mmTerminateByImsi(string imsi)
 	MMContext* mmc = mmu->mmuContext;
 	if (!mmc) {
 		// There is no channel, just kill off the MMUser, which will stop paging and cancel the SIP dialogs.
-		mmu->mmuFree(NULL,TermCause::Local(L3Cause::Operator_Intervention));
+		mmu->mmuFree(TermCause::Local(L3Cause::Operator_Intervention));
 		return true;
 	}
 	if (mmc->tsChannel()->chanRunning()) {
@@ -1119,44 +1192,91 @@ bool MMLayer::mmTerminateByImsi(string imsi)
 void MMLayer::mmAddMT(TranEntry *tran)
 {
 	LOG(DEBUG) <<this<<LOGVAR(tran);
-	{	ScopedLock lock(gMMLock,__FILE__,__LINE__);
-		string imsi(tran->subscriberIMSI());
-		MMUser *mmu = mmFindByImsi(imsi,true);
+	// This needs only the shard lock, which keeps the MMUser from being deleted until the transaction is queued on it.
+	{	string imsi(tran->subscriberIMSI());
+		MMUserShard &shard = mmShard(imsi);
+		ScopedLock lock(shard.mLock,__FILE__,__LINE__);
+		MMUser *&mmu = shard.mUsers[imsi];
+		if (mmu == NULL) {
+			mmu = new MMUser(imsi);
+			shard.mPaging.insert(mmu);
+			LOG(DEBUG) << "inserting new MMUser "<<(void*)mmu;
+		}
 		// Is there a guaranteed tmsi?
 		// We will delay this until we page in case an LUR is occurring right now.
 		//if (uint32_t tmsi = gTMSITable.tmsiTabGetTMSI(imsi,true)) { mmu->mmuTmsi = /*tran->subscriber().mTmsi =*/ tmsi; }
-		assert(mmu);
 		mmu->mmuAddMT(tran);
 	}
 	mmPageSignal.signal();
 }
 
+// The FNV-1a hash of the IMSI picks the shard.
+MMUserShard &MMLayer::mmShard(const string &imsi)
+{
+	uint32_t hash = 2166136261u;
+	for (string::const_iterator it = imsi.begin(); it != imsi.end(); it++) {
+		hash = (hash ^ (unsigned char)*it) * 16777619u;
+	}
+	return mShards[hash % cNumShards];
+}
+
+// Attach the MMUser to an MMContext, or detach it if mmc is NULL.  Unattached MMUsers are paged.
+void MMLayer::mmSetContext(MMUser *mmu, MMContext *mmc)
+{
+	devassert(gMMLock.lockcnt());		// Caller locked it.
+	MMUserShard &shard = mmShard(mmu->mmuImsi);
+	ScopedLock lock(shard.mLock,__FILE__,__LINE__);
+	mmu->mmuContext = mmc;
+	{	ScopedLock ulock(mmu->mmuLock,__FILE__,__LINE__);
+		mmu->mmuSmsPaged = false;	// Any page was answered, or if we page again it is a new page.
+	}
+	if (mmc) {
+		shard.mPaging.erase(mmu);
+	} else {
+		shard.mPaging.insert(mmu);
+	}
+}
+
+void MMLayer::mmIndexTmsi(MMUser *mmu, uint32_t tmsi)
+{
+	MMTmsiShard &shard = mmTmsiShard(tmsi);
+	ScopedLock lock(shard.mLock,__FILE__,__LINE__);
+	shard.mUsers[tmsi] = mmu;
+}
+
+void MMLayer::mmUnindexTmsi(MMUser *mmu, uint32_t tmsi)
+{
+	MMTmsiShard &shard = mmTmsiShard(tmsi);
+	ScopedLock lock(shard.mLock,__FILE__,__LINE__);
+	std::map<uint32_t,MMUser*>::iterator it = shard.mUsers.find(tmsi);
+	if (it != shard.mUsers.end() && it->second == mmu) { shard.mUsers.erase(it); }
+}
+
 MMUser *MMLayer::mmFindByImsi(string imsi,	// Do not change this to a reference.  We need a copy of the string
 		// to insert into the map.  If pass by reference here the map points to the string from the caller,
 		// which may have long since gone out of scope.  What a great language.
 	bool create)
 {
 	LOG(DEBUG) <<LOGVAR(imsi) <<LOGVAR(create);
-	devassert(gMMLock.lockcnt());		// Caller locked it.
+	devassert(gMMLock.lockcnt());		// Caller locked it, so the result cannot be deleted while the caller uses it.
+	MMUserShard &shard = mmShard(imsi);
+	ScopedLock lock(shard.mLock,__FILE__,__LINE__);
 	MMUser *result;
 	const char *what = "existing ";
 	if (create) {
 		// Use insert so we only traverse the map tree once.  If element does not exist, a pair with MMUser*==NULL is inserted.
 		// This wonderful insert method returns a pair<MMUserMap::iterator,bool> but we only want the iterator.
-		//pair<MMUserMap::iterator,bool> result = MMUsers.insert(pair<string,MMUser*>(imsi,(MMUser*)NULL));
-		bool exists = MMUsers.find(imsi) != MMUsers.end();
-		LOG(DEBUG) << LOGVAR(imsi)<<LOGVAR(exists);
-		MMUserMap::iterator it = MMUsers.insert(pair<string,MMUser*>(imsi,(MMUser*)NULL)).first;
+		MMUserMap::iterator it = shard.mUsers.insert(pair<string,MMUser*>(imsi,(MMUser*)NULL)).first;
 		result = it->second;
 		if (result == NULL) {
 			result = it->second = new MMUser(imsi);
+			shard.mPaging.insert(result);		// Not attached yet.
 			LOG(DEBUG) << "inserting new MMUser "<<(void*)result;
 			what = "new ";
 		}
-		LOG(DEBUG) << "MMUsers["<<imsi<<"]="<<(void*)MMUsers[imsi];
 	} else {
-		MMUserMap::const_iterator it = MMUsers.find(imsi);
-		result = (it == MMUsers.end()) ? NULL : it->second;
+		MMUserMap::const_iterator it = shard.mUsers.find(imsi);
+		result = (it == shard.mUsers.end()) ? NULL : it->second;
 	}
 	LOG(DEBUG) <<what <<LOGVAR(result);
 	return result;
@@ -1167,7 +1287,10 @@ TMSI_t MMUser::mmuGetTmsi()
 {
 	if (! this->mmuDidTmsiCheck) {
 		this->mmuDidTmsiCheck = true;
-		if (uint32_t tmsi = gTMSITable.tmsiTabGetTMSI(mmuImsi,true)) { this->mmuTmsi = tmsi; }
+		if (uint32_t tmsi = gTMSITable.tmsiTabGetTMSI(mmuImsi,true)) {
+			this->mmuTmsi = tmsi;
+			gMMLayer.mmIndexTmsi(this,tmsi);
+		}
 	}
 	return this->mmuTmsi;
 }
@@ -1175,15 +1298,24 @@ TMSI_t MMUser::mmuGetTmsi()
 MMUser *MMLayer::mmFindByTmsi(uint32_t tmsi)
 {
 	devassert(gMMLock.lockcnt());		// Caller locked it.
-	//ScopedLock lock(gMMLock,__FILE__,__LINE__);
 	MMUser *result = NULL;
-	for (MMUserMap::iterator it = MMUsers.begin(); it != MMUsers.end(); ++it) {
-		MMUser *mmu = it->second;
+	{	MMTmsiShard &shard = mmTmsiShard(tmsi);
+		ScopedLock lock(shard.mLock,__FILE__,__LINE__);
+		std::map<uint32_t,MMUser*>::iterator it = shard.mUsers.find(tmsi);
+		if (it != shard.mUsers.end()) { result = it->second; }
+	}
+	if (result == NULL) {
+		// The MMUser we want may not have looked up its TMSI yet, so ask the TMSI table whose TMSI this is.
 		// (pat) The handset we want could be simultaneously doing an MM procedure that is establishing a TMSI,
 		// so we should check the tmsi table every single time this happens.
 		// However, we are currently doing an expensive sql lookup so only check once.
-		TMSI_t mmutmsi = mmu->mmuGetTmsi();
-		if (mmutmsi.valid() && mmutmsi.value() == tmsi) { result = mmu; break; }
+		string imsi = gTMSITable.tmsiTabGetIMSI(tmsi,NULL);
+		if (imsi.size()) {
+			if (MMUser *mmu = mmFindByImsi(imsi,false)) {
+				TMSI_t mmutmsi = mmu->mmuGetTmsi();
+				if (mmutmsi.valid() && mmutmsi.value() == tmsi) { result = mmu; }
+			}
+		}
 	}
 	LOG(DEBUG) << LOGVAR(result);
 	return result;
@@ -1202,44 +1334,84 @@ MMUser *MMLayer::mmFindByMobileId(L3MobileIdentity&mid)
 }
 
 // When called from the paging thread loop this function is responsible for noticing expired MMUsers and deleting them.
+// Only the unattached MMUsers are visited, one shard at a time, and gMMLock is taken only if some page expired.
+// MSs with only MT-SMS waiting are paged no faster than SDCCHs beyond Control.SMS.SDCCHReserve are free, so a bulk
+// SMS campaign cannot take every SDCCH away from calls and location updates.  The MT-SMS pages still awaiting a
+// response count against that budget, since each may seize an SDCCH at any moment.  The MSs left out are paged
+// in a later cycle, round robin, and their T3113 does not start until they are paged.
 void MMLayer::mmGetPages(NewPagingList_t &pages)
 {
 
 	assert(pages.size() == 0);	// Caller passes us a new list each time.
 
-	{
+	vector<string> expired;
+	NewPagingList_t smsPages;
+	unsigned outstanding = 0;
+	mmListPages(pages,smsPages,&expired,&outstanding);
+	if (smsPages.size()) {
+		int budget = (int)gBTS.SDCCHAvailable() - gConfig.getNum("Control.SMS.SDCCHReserve") - (int)outstanding;
+		unsigned count = budget <= 0 ? 0 : (unsigned)budget < smsPages.size() ? budget : smsPages.size();
+		ScopedLock lock(mmSmsPageLock,__FILE__,__LINE__);
+		unsigned start = mmSmsPageCursor % smsPages.size();
+		for (unsigned n = 0; n < count; n++) {
+			NewPagingEntry &pe = smsPages[(start + n) % smsPages.size()];
+			mmStartSmsPage(pe.mImsi);
+			pages.push_back(pe);
+		}
+		mmSmsPageCursor = start + count;
+		if (count < smsPages.size()) {
+			LOG(INFO) << "deferred MT-SMS pages for SDCCH reserve"<<LOGVAR(budget)<<LOGVAR(outstanding)<<LOGVAR2("deferred",smsPages.size()-count);
+		}
+	}
+	if (expired.size()) {
+		// Expired.  Get rid of them.
+		// (pat) The SIP error for no page should probably not be 480 Temporarily Unavailable,
+		// because that implies we know that the user is at the BTS, but if it did not answer the page, we do not.
+		// Paul at Null Team recommended 504.
+		// The MMUser may have been paged successfully or repaged since we looked, which mmuFree checks again.
 		ScopedLock lock(gMMLock,__FILE__,__LINE__);
-		LOG(DEBUG) <<"before "<<LOGVAR(MMUsers.size());
-		pages.reserve(MMUsers.size());
-		for (MMUserMap::iterator it = MMUsers.begin(); it != MMUsers.end(); ) {
-			MMUser *mmu = it->second;
-			MMUserMap::iterator thisone = it++;
-			LOG(DEBUG)<<LOGVAR(mmu);
-			if (mmu->mmuIsAttached()) { // Is it already attached to a radio channel?
-				LOG(DEBUG) << "MMUser already attached:"<<mmu->mmuImsi;
-				continue;
+		for (vector<string>::iterator it = expired.begin(); it != expired.end(); it++) {
+			if (MMUser *mmu = mmFindByImsi(*it,false)) {
+				mmu->mmuFree(TermCause::Local(L3Cause::No_Paging_Response),MMUser::FreeIfExpired);
 			}
-			if (mmu->mmuPageTimer.passed()) {
-				// Expired.  Get rid of it.
-				LOG(INFO) << "Page expired for imsi="<<mmu->mmuImsi;
-				// Erasing from a map invalidates the iterator, but not the iteration.
-				// (pat) The SIP error for no page should probably not be 480 Temporarily Unavailable,
-				// because that implies we know that the user is at the BTS, but if it did not answer the page, we do not.
-				// Paul at Null Team recommended 504.
-				// FIXME URGENTLY:  Dont do an mmFree within the gMMLock, although we need to make sure it does not disappear.
-				//mmu->mmuFree(&thisone,TermCause::Local(L3Cause::No_Paging_Response));
-				// (pat 10-10-2014) Stop passing the iterator, supersitiously.
-				mmu->mmuFree(NULL,TermCause::Local(L3Cause::No_Paging_Response));
+		}
+	}
+	if (pages.size()) LOG(DEBUG) <<LOGVAR(pages.size());
+}
+
+// Walk the unattached MMUsers and sort the ones being paged into the MSs waiting only for MT-SMS that have not
+// been paged yet and the rest.  The MT-SMS pages already sent are repaged with the rest and counted in smsOutstanding.
+// The IMSIs of the expired pages go in expired, or are skipped if it is NULL.
+void MMLayer::mmListPages(NewPagingList_t &pages, NewPagingList_t &smsPages, vector<string> *expired, unsigned *smsOutstanding)
+{
+	for (unsigned i = 0; i < cNumShards; i++) {
+		MMUserShard &shard = mShards[i];
+		ScopedLock lock(shard.mLock,__FILE__,__LINE__);
+		for (std::set<MMUser*>::iterator it = shard.mPaging.begin(); it != shard.mPaging.end(); ++it) {
+			MMUser *mmu = *it;
+			LOG(DEBUG)<<LOGVAR(mmu);
+			if (mmu->mmuPageExpired()) {
+				if (expired) {
+					LOG(INFO) << "Page expired for imsi="<<mmu->mmuImsi;
+					expired->push_back(mmu->mmuImsi);
+				}
 				continue;
 			}
-			// TODO: We could add a check for a "provisional IMSI" 
+			// An MMUser being created by mmAttachByImsi is briefly unattached with nothing to page for.
+			if (mmu->mmuIsEmpty()) { continue; }
+			// TODO: We could add a check for a "provisional IMSI"
 
 			NewPagingEntry tmp(mmu->mmuGetInitialChanType(), mmu->mmuImsi);
-			pages.push_back(tmp);
+			if (mmu->mmuSmsPageOutstanding()) {
+				if (smsOutstanding) { (*smsOutstanding)++; }
+				pages.push_back(tmp);
+			} else if (mmu->mmuIsSmsOnly()) {
+				smsPages.push_back(tmp);
+			} else {
+				pages.push_back(tmp);
+			}
 		}
-		LOG(DEBUG) <<"after "<<LOGVAR(MMUsers.size());
 	}
-	if (pages.size()) LOG(DEBUG) <<LOGVAR(pages.size());
 }
 
 // Not used.  This is only documentation how to do this now.
@@ -1260,15 +1432,21 @@ void MMLayer::mmGetPages(NewPagingList_t &pages)
 //}
 
 // For use by the CLI: create a copy of the paging list and print it.
+// This lists every MS being paged, including the MT-SMS pages deferred for the SDCCH reserve,
+// and leaves the paging thread's round robin and the expiry of pages alone.
 void MMLayer::printPages(ostream &os)
 {
-	// This does not need to lock anything.  The mmGetPages provides locked access to the MMUser list.
-	NewPagingList_t pages;
-	gMMLayer.mmGetPages(pages);
+	// This does not need to lock anything.  The mmListPages provides locked access to the MMUser list.
+	NewPagingList_t pages, smsPages;
+	mmListPages(pages,smsPages,NULL,NULL);
 	for (NewPagingList_t::iterator it = pages.begin(); it != pages.end(); ++it) {
 		NewPagingEntry &pe = *it;
 		os <<pe.text();
 	}
+	for (NewPagingList_t::iterator it = smsPages.begin(); it != smsPages.end(); ++it) {
+		NewPagingEntry &pe = *it;
+		os <<pe.text();
+	}
 }
 
 // Connect the channel with its MMUser based on the received page.
@@ -1306,12 +1484,34 @@ bool MMLayer::mmPageReceived(MMContext *mmchan, L3MobileIdentity &mobileId)
 void MMLayer::printMMUsers(std::ostream&os, bool onlyUnattached)
 {
 	ScopedLock lock(gMMLock,__FILE__,__LINE__);
-	for (MMUserMap::iterator it = MMUsers.begin(); it != MMUsers.end(); ++it) {
-		MMUser *mmu = it->second;
-		if (onlyUnattached && mmu->mmuIsAttached()) { continue; }
-		mmu->mmuText(os);
-		os << endl;
+	for (unsigned i = 0; i < cNumShards; i++) {
+		MMUserShard &shard = mShards[i];
+		ScopedLock slock(shard.mLock,__FILE__,__LINE__);
+		for (MMUserMap::iterator it = shard.mUsers.begin(); it != shard.mUsers.end(); ++it) {
+			MMUser *mmu = it->second;
+			if (onlyUnattached && mmu->mmuIsAttached()) { continue; }
+			mmu->mmuText(os);
+			os << endl;
+		}
+	}
+}
+
+// This is called for each incoming INVITE, so look in the shard first and take gMMLock only if the MS is on a channel.
+bool MMLayer::mmIsBusy(string &imsi)
+{
+	{	MMUserShard &shard = mmShard(imsi);
+		ScopedLock lock(shard.mLock,__FILE__,__LINE__);
+		MMUserMap::iterator it = shard.mUsers.find(imsi);
+		MMUser *mmu = (it == shard.mUsers.end()) ? NULL : it->second;
+		LOG(DEBUG) <<LOGVAR(imsi)<<LOGVAR(mmu);
+		if (!mmu) return false;
+		{	ScopedLock ulock(mmu->mmuLock,__FILE__,__LINE__);
+			if (mmu->mmuMTCq.size()) return true;	// Someone already waiting in the MTC queue.
+		}
+		if (!mmu->mmuContext) return false;
 	}
+	// The MMContext transactions are protected by gMMLock.
+	return mmFindVoiceTranByImsi(imsi) != NULL;
 }
 
 void MMLayer::printMMInfo(std::ostream&os)
@@ -1347,6 +1547,7 @@ void controlInit()
 {
 	LOG(DEBUG);
 	gTMSITable.tmsiTabOpen(gConfig.getStr("Control.Reporting.TMSITable").c_str());
+	gAuthVectors.avStart();
 	LOG(DEBUG);
 	gNewTransactionTable.ttInit();
 	LOG(DEBUG);
@@ -17,6 +17,7 @@
 #ifndef _L3MMLAYER_H
 #define _L3MMLAYER_H 1
 
+#include <set>
 #include <Logger.h>
 #include <Interthread.h>
 #include <Timeval.h>
@@ -67,6 +68,7 @@ class MMUser : public MemCheckMMUser /*: public RefCntBase*/ {
 	friend class MMContext;
 	mutable Mutex mmuLock;
 	Timeval mmuPageTimer;
+	Bool_z mmuSmsPaged;		// An MS waiting only for MT-SMS has been paged; until then mmuPageTimer is not running for it.
 	protected:
 	typedef PtrList<TranEntry> MMUQueue_t;
 	MMUQueue_t mmuMTCq;
@@ -83,7 +85,11 @@ class MMUser : public MemCheckMMUser /*: public RefCntBase*/ {
 	public: 	TMSI_t mmuGetTmsi();
 
 	protected:
-	void mmuFree(MMUserMap::iterator *it,TermCause cause /*= TermCauseUnknown*/);	// This is the destructor.  It is not public.  Can only delete from gMMLayer because we must lock the universe first.
+	enum FreeWhen { FreeAlways, FreeIfEmpty, FreeIfExpired };
+	bool mmuFree(TermCause cause, FreeWhen when = FreeAlways);	// This is the destructor.  It is not public.  Can only delete from gMMLayer because we must lock the universe first.
+	bool mmuPageExpired();
+	bool mmuSmsPageOutstanding() const;
+	void mmuStartSmsPage();
 
 	GSM::ChannelType mmuGetInitialChanType() const;
 
@@ -97,6 +103,7 @@ class MMUser : public MemCheckMMUser /*: public RefCntBase*/ {
 	//void mmuClose();		// TODO
 	bool mmuIsAttached() { return mmuContext != NULL; }	// Are we attached to a radio channel?
 	bool mmuIsEmpty();
+	bool mmuIsSmsOnly() const;	// Only MT-SMS are waiting, no calls.
 	void mmuCleanupDialogs();	// Let go of any dead dialogs
 	//void mmuCallFinished(L3LogicalChannel *chan,MMCause cause);
 	bool mmuServiceMTQueues();
@@ -127,6 +134,8 @@ class MMContext : public MemCheckMMContext /*: public RefCntBase*/ {
 	void mmcUnlink();
 	void mmcLink(MMUser *mmu);
 	time_t mmcOpenTime;
+	Timeval mmcLingerTimer;	// Hold the channel until this passes in case another MT-SMS arrives.
+	bool mmcLingering();
 
 	// These are the Transactions/Procedures that may be active simultaneously:
 	public:
@@ -164,6 +173,7 @@ class MMContext : public MemCheckMMContext /*: public RefCntBase*/ {
 	MMContext *tsDup();
 	void mmcPageReceived() const;
 	time_t mmcDuration() const { return time(NULL) - mmcOpenTime; }
+	unsigned mmPendingMTSMS();	// Number of MT-SMS queued behind the one running.
 
 	RefCntPointer<TranEntry> mmGetTran(unsigned ati) const;
 	void mmGetTranList( TranEntryVector &tranlist);
@@ -192,10 +202,23 @@ std::ostream& operator<<(std::ostream& os, const MMContext&mmc);
 std::ostream& operator<<(std::ostream& os, const MMContext*mmc);
 
 // Maps imsi to MMUser.  No imsi, no MMUser.
+// The map is split into shards by a hash of the IMSI so that lookups from different threads do not contend.
+struct MMUserShard {
+	Mutex mLock;
+	MMUserMap mUsers;
+	std::set<MMUser*> mPaging;		// The MMUsers in this shard not attached to a channel, which are the ones we page.
+};
+
+// Maps the TMSIs the MMUsers have looked up back to the MMUser, so a paging response by TMSI does not search every MMUser.
+struct MMTmsiShard {
+	Mutex mLock;
+	std::map<uint32_t,MMUser*> mUsers;
+};
 
 extern Mutex gMMLock;
 class MMLayer {
 	friend class MMUser;
+	friend class MMContext;
 	// Locking rules:
 	// The thread running the L3LogicalChannel service loop "owns" the MMContext on its channel,
 	// so it is allowed to manipulate it without locking this global Mutex.
@@ -208,10 +231,26 @@ class MMLayer {
 	// It is also used to create/delete MMContexts which is probably unnecessary.
 	// The MMUser::Mutex is used only to protect the queues inside MMUser,
 	// used to add/remove transactions to those queues.
+	// The MMUserShard lock protects the shard maps and the MMUser::mmuContext pointers of the MMUsers in it.
+	// An MMUser is deleted only with both gMMLock and its shard lock held, so holding either one keeps it alive.
+	// That lets the SIP side queue MT transactions, repage, and check for busy without gMMLock.
+	// The lock order is gMMLock, then the MMUserShard lock, then MMUser::mmuLock; the MMTmsiShard lock is taken last.
 	//Mutex gMMLock;
 	Signal mmPageSignal;						///< signal to wake the paging loop
-	MMUserMap MMUsers;
+	static const unsigned cNumShards = 16;
+	MMUserShard mShards[cNumShards];
+	MMTmsiShard mTmsiShards[cNumShards];
+	MMUserShard &mmShard(const string &imsi);
+	MMTmsiShard &mmTmsiShard(uint32_t tmsi) { return mTmsiShards[tmsi % cNumShards]; }
+	void mmSetContext(MMUser *mmu, MMContext *mmc);
+	void mmIndexTmsi(MMUser *mmu, uint32_t tmsi);
+	void mmUnindexTmsi(MMUser *mmu, uint32_t tmsi);
+	Mutex mmSmsPageLock;		// Protects mmSmsPageCursor.
+	unsigned mmSmsPageCursor;	// Where the next paging cycle starts among the MSs waiting only for MT-SMS.
+	void mmListPages(NewPagingList_t &pages, NewPagingList_t &smsPages, std::vector<std::string> *expired, unsigned *smsOutstanding);
+	void mmStartSmsPage(const string &imsi);
 	public:
+	MMLayer() : mmSmsPageCursor(0) {}
 	void mmGetPages(NewPagingList_t &pages);
 	void printPages(std::ostream &os);
 	bool mmPageReceived(MMContext *mmchan, L3MobileIdentity &mobileId);
@@ -234,16 +273,7 @@ class MMLayer {
 	string printMMInfo();
 
 	// Is the single MTC slot busy?
-	bool mmIsBusy(string &imsi) {
-		ScopedLock lock(gMMLock,__FILE__,__LINE__);
-		MMUser *mmu = mmFindByImsi(imsi,false);
-		LOG(DEBUG) <<LOGVAR(imsi)<<LOGVAR(mmu);
-		if (!mmu) return false;
-		if (mmu->mmuMTCq.size()) return true;	// Someone already waiting in the MTC queue.
-		if (!mmu->mmuContext) return false;
-		LOG(DEBUG) <<"mmc="<<mmu->mmuContext;
-		return mmu->mmuContext->tsGetVoiceTran() != NULL;
-	}
+	bool mmIsBusy(string &imsi);
 
 	RefCntPointer<TranEntry> mmFindVoiceTranByImsi(string &imsi) {
 		ScopedLock lock(gMMLock,__FILE__,__LINE__);
@@ -46,6 +46,7 @@
 #include <SIPExport.h>
 #include <Regexp.h>
 #include "RRLPServer.h"
+#include "AuthVectorCache.h"
 using namespace GSM;
 
 
@@ -630,6 +631,14 @@ MachineStatus LUStart::machineRunState(int state, const GSM::L3Message* l3msg, c
 			}
 		}
 
+		// If we already have a challenge for this MS we can skip the first REGISTER and challenge it right away.
+		string rand;
+		if (! ludata()->mSecondAttempt && ! ludata()->mPrefetchFailed && gAuthVectors.avGet(getImsi(),rand)) {
+			ludata()->mUsingPrefetchedChallenge = true;
+			ludata()->mRegistrationResult.regSetChallenge(rand);
+			return callMachStart(new LUAuthentication(tran()));
+		}
+
 		// The TranEntry already has the correct SipEngine.
 		// DCCH is available in tran()
 		string emptySRES;
@@ -694,6 +703,7 @@ MachineStatus LUAuthentication::machineRunState(int state, const GSM::L3Message*
 			Utils::stringToUint(rand, &uRAND, &lRAND);
 			// Sending authenticaion request moved to LUAuthentication::stateStart
 			timerStart(T3260,12000,TimerAbortChan);
+			ludata()->mChallenged = true;
 			channel()->l3sendm(GSM::L3AuthenticationRequest(0,GSM::L3RAND(uRAND,lRAND)));
 			return MachineStatusOK;
 		}
@@ -733,6 +743,22 @@ MachineStatus LUAuthentication::machineRunState(int state, const GSM::L3Message*
 			// on failure, by LUFinish::stateSendLUResponse(), which is called in other places too.
 			LOG(DEBUG) <<LOGVAR(ludata()->getTmsi()) <<LOGVAR(ludata()->getTmsiStatus()) <<LOGVAR(tran()->subscriberIMSI());
 			timerStop(TMMCancel);
+			if (ludata()->mUsingPrefetchedChallenge) {
+				ludata()->mUsingPrefetchedChallenge = false;
+				switch (ludata()->mRegistrationResult.mRegistrationStatus) {
+					case RegistrationChallenge:
+						// The Registrar no longer knew our challenge and sent a new one, so run that.
+						LOG(INFO) << "prefetched challenge replaced by Registrar for"<<LOGVAR2("imsi",getImsi());
+						return callMachStart(new LUAuthentication(tran()));
+					case RegistrationFail:
+						// The challenge may have gone stale at the Registrar, so give the MS a fresh one before rejecting it.
+						LOG(INFO) << "prefetched challenge failed, retrying with a new challenge for"<<LOGVAR2("imsi",getImsi());
+						ludata()->mPrefetchFailed = true;
+						return callMachStart(new LUStart(tran()),LUStart::stateHaveIds);
+					default:
+						break;
+				}
+			}
 			switch (ludata()->mRegistrationResult.mRegistrationStatus) {
 				case RegistrationUninitialized:
 				default:
@@ -932,6 +958,9 @@ MachineStatus LUFinish::stateSendLUResponse()
 	switch (ludata()->mRegistrationResult.mRegistrationStatus) {
 		case RegistrationSuccess:
 			authorization = AuthAuthorized;
+			// Get the challenge for the next location update now, while nobody is waiting for it.
+			// A Registrar that accepted the MS without a challenge would not issue one for a prefetch either.
+			if (ludata()->mChallenged) { gAuthVectors.avPrefetch(imsi); }
 			break;
 		case RegistrationError:
 			if (failOpen()) {
@@ -166,6 +166,12 @@ struct RegistrationResult {
 		Bool_z mSecondAttempt;
 		string mPrevRegisterAttemptImsi;
 		Bool_z mExpectingTmsiReallocationComplete;
+		// Set when the challenge came from gAuthVectors instead of a first REGISTER.  If the Registrar does not accept it
+		// we start over with a REGISTER, and mPrefetchFailed keeps us from using the cache again.
+		Bool_z mUsingPrefetchedChallenge;
+		Bool_z mPrefetchFailed;
+		// Set when the MS was sent an Authentication Request, so the Registrar challenges this IMSI and a prefetch is worth it.
+		Bool_z mChallenged;
 #if CACHE_AUTH
 		Bool_z mUsingCachedAuthentication;
 #endif
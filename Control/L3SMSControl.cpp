@@ -425,9 +425,12 @@ bool MTSMSMachine::createRPData(RPData &rp_data)
 		TLAddress tlcalling = TLAddress(tran()->calling().digits());
 		TLUserData tlmessage = TLUserData(tran()->mMessage.c_str());
 		PROCLOG(DEBUG)<<LOGVAR(tlcalling)<<LOGVAR(tlmessage);
+		TLDeliver deliver(tlcalling,tlmessage,0);
+		// 03.40 9.2.3.2: Tell the MS more messages are waiting so it expects them on this channel.
+		deliver.setMoreMessages(channel()->chanGetContext(true)->mmPendingMTSMS() > 0);
 		rp_data = RPData(this->mRpduRef,
 			RPAddress(gConfig.getStr("SMS.FakeSrcSMSC").c_str()),
-			TLDeliver(tlcalling,tlmessage,0));
+			deliver);
 	} else if (strncmp(contentType,"application/vnd.3gpp.sms",24)==0) {
 		BitVector2 RPDUbits(strlen(tran()->mMessage.c_str())*4);
 		if (!RPDUbits.unhex(tran()->mMessage.c_str())) {
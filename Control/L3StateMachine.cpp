@@ -708,7 +708,7 @@ static unsigned newUpdateCallTraffic(TranEntry *transaction, GSM::TCHFACCHLogica
 	// Flush FIFO to limit latency.
 	unsigned numFlushed = 0;
 	{
-		unsigned maxQ = gConfig.getNum("GSM.MaxSpeechLatency");
+		unsigned maxQ = gConfig.GSM.MaxSpeechLatency;
 		static Timeval testTimeStart;
 		while (TCH->queueSize()>maxQ) {
 			if (numFlushed == 0) testTimeStart.now();
@@ -725,7 +725,8 @@ static unsigned newUpdateCallTraffic(TranEntry *transaction, GSM::TCHFACCHLogica
 		activity += ulFrame->sizeBytes();
 		// Send on RTP.
 		LOG(DEBUG) <<TCH <<LOGVAR(*ulFrame);
-		transaction->txFrame(ulFrame,numFlushed);
+		// Step the RTP timestamp over the frames of an uplink gap that were not queued too.
+		transaction->txFrame(ulFrame,numFlushed + TCH->takeSkippedFrames());
 		delete ulFrame;
 	}
 
@@ -752,7 +753,7 @@ static bool checkemMessages(L3LogicalChannel *dcch, int delay)
 	LOG(DEBUG) <<LOGVAR(dcch) <<LOGVAR(delay);
 	// (pat) For l3Rewrite: there are two contending solutions for the uplink message path:
 	// They can be sent in a common queue to the global L3 message handler (similar to UMTS)
-	// or be handled by this dedicated channel thread called from DCCHDispatcher.
+	// or be handled by the DCCH dispatcher worker servicing this channel.
 	// This is the code for the latter.
 	// (pat) Can messages on FACCH be for transactions other than the current one?  Not sure, but
 	// be safe and handle the message with the generic L3 handler instead of dispatching it directly to this transaction.
@@ -821,8 +822,8 @@ static bool checkemMessages(L3LogicalChannel *dcch, int delay)
 }
 
 
-// Handle TCH traffic during a call.  This is called from the dedicated thread created for a combination I full rate TCH in GSMConfig.
-// It is called from DCCHDispatch.
+// Handle TCH traffic during a call.  This runs on a DCCH dispatcher worker for as long as the TCH is established.
+// It is called from L3DCCHService.
 // Prior to L3rewrite TCH traffic and messages were handled by callManagementLoop(), which called pollInCall(), updateGSMSignalling()
 static void l3CallTrafficLoop(L3LogicalChannel *dcch)
 {
@@ -952,80 +953,104 @@ static void l3CallTrafficLoop(L3LogicalChannel *dcch)
 // Note MS could send multiple simultaneous MO CMServiceRequests - one for CS and one for SMS.
 // FOR NOW:
 // Just have a primary transaction on the channel, which is known from the GSMState aka CallState.
-static void L3SDCCHLoop(L3LogicalChannel*dcch)
+// Service an SDCCH without waiting: handle whatever L3 messages, SIP messages and timers are pending.
+// Return false once the channel is no longer running.  Set more if there may be more to do right away.
+static bool L3SDCCHService(L3LogicalChannel*dcch, bool &more)
 {
 	assert(dcch->chtype() == SDCCHType);
-	while (dcch->chanRunning() && !gBTS.btsShutdown()) {
+	// Bound the work done per turn so one busy channel cannot hold a worker the other channels need.
+	for (unsigned turn = 0; turn < 8; turn++) {
+		if (! dcch->chanRunning() || gBTS.btsShutdown()) { return false; }
 		if (dcch->radioFailure()) {	// Checks expiry of T3109, set at 30s.
 			LOG(NOTICE) << "radio link failure, dropped call";
 			//gNewTransactionTable.ttLostChannel(dcch);
 			// (pat) 5-2014: Changed to RELEASE from HARDRELEASE - even though we can no longer hear the handset,
 			// it might still hear us so we have to deactivate SACCH and wait T3109.
 			dcch->chanRelease(L3_RELEASE_REQUEST,TermCause::Local(L3Cause::Radio_Interface_Failure)); 	// Kill off all the transactions associated with this channel.
-			return;
+			return false;
 		}
 
 		// Any L3 Messages from the MS side on this channel?
-		// Wait 100ms.  I made this number up out of thin air.
-		// Since an incoming L3 message will be returned instantly, this delay is the effective delay
-		// in handling SIP messages or timers, and could be much longer since none of those are precision timers.
-		if (checkemMessages(dcch,100)) { gResetWatchdog(); continue; }
+		// We do not wait here; the dispatcher calls us again when a frame or SIP message arrives,
+		// and every 100ms regardless, which is the effective resolution of the L3 timers.
+		if (! checkemMessages(dcch,0)) { return true; }
+		gResetWatchdog();
 	}
+	more = true;
+	return true;
 }
 
 // dcch may be SDCCH or FACCH.
-// This does not return until the channel is released.
-void L3DCCHLoop(L3LogicalChannel*dcch, L3Frame *frame)
+// This is called from the DCCH dispatcher whenever something may have happened on the channel.
+// It does whatever can be done without waiting and returns true if the channel should be serviced again right away.
+bool L3DCCHService(L3LogicalChannel*dcch)
 {
-	LOG(INFO) <<"DCCH LOOP OPEN "<<dcch;
+	bool open = dcch->mDcchOpen;
+	bool more = false;
 	try {
-		// We must not reset the channel state when opened because during a channel reassignment the new channel
-		// already has an attached MMContext.
-		assert(frame);
-		Primitive prim = frame->primitive();
-		delete frame;
-
-		dcch->chanSetState(L3LogicalChannel::chEstablished);
-		switch (prim) {
-			case L3_ESTABLISH_INDICATION:
-				break;
-			case HANDOVER_ACCESS:
+		if (! open) {
+			// Wait for a transaction to start.
+			L3Frame *frame = dcch->l2recv(0);
+			if (frame == NULL) { return false; }
+			Primitive prim = frame->primitive();
+			if (prim != L3_ESTABLISH_INDICATION && prim != HANDOVER_ACCESS) {
+				LOG(INFO) << "L3LogicalChannel: Ignored primitive:"<<prim;
+				delete frame;
+				return true;	// There may be more queued.
+			}
+			LOG(DEBUG) << *dcch << " received " << *frame;
+			delete frame;
+			gResetWatchdog();
+			LOG(INFO) <<"DCCH OPEN "<<dcch;
+
+			// We must not reset the channel state when opened because during a channel reassignment the new channel
+			// already has an attached MMContext.
+			dcch->chanSetState(L3LogicalChannel::chEstablished);
+			open = dcch->mDcchOpen = true;
+			if (prim == L3_ESTABLISH_INDICATION) { dcch->mChanTrace.ctcEstablish = timef(); }
+			if (prim == HANDOVER_ACCESS) {
 				ProcessHandoverAccess(dcch);
-				// If the handover fails, it sets the chState such that the loop below will return immediately,
-				// so we can just break here.
-				break;
-			default:
-				assert(0);	// Caller prevented anything else.
+				// If the handover fails, it sets the chState such that the service below will return immediately.
+			}
 		}
 
 		switch (dcch->chtype()) {
 		case SDCCHType:
-			L3SDCCHLoop(dcch);
+			open = L3SDCCHService(dcch,more);
 			break;
-		case FACCHType:
+		case FACCHType: {
+			// The traffic loop paces itself on RTP, so it keeps this worker until the channel is released.
+			DCCHBlocking blocking;
 			l3CallTrafficLoop(dcch);
+			open = false;
 			break;
+		}
 		default:
 			assert(0);
 		}
-		devassert(dcch->mChState != L3LogicalChannel::chIdle); // This would be a bug.
+		if (! open) { devassert(dcch->mChState != L3LogicalChannel::chIdle); } // This would be a bug.
 	} catch (exception &e) {
 		LOG(ERR) << "exception "<<e.what() << " " << typeid(&e).name();
+		open = false;
 	} catch (...) {
 		LOG(ERR) << "unrecognized exception, channel reset";
+		open = false;
 	}
-	WATCHINFO("DCCH LOOP EXIT " << dcch);
+	if (open) { return more; }
+
+	WATCHINFO("DCCH CLOSE " << dcch);
 
 	// Always reset, even though the MMContext is shared between L3LogicalChannels during channel reassignment;
 	// we now have a refcnt in the MMContext so this is bullet proof destruction.
 	dcch->L3LogicalChannelReset();
 	switch (dcch->mChState) {
-		case L3LogicalChannel::chRequestRelease:
+		case L3LogicalChannel::chRequestRelease: {
 			// The RELEASE primitive will block up to 30 seconds, so we NEVER EVER send it from anywhere but right here.
 			// To release the channel, set the channel state to chReleaseRequest and let it come here to release the channel.
-			// FIXME: Actually, LAPDm blocks in this forever until it gets the next ESTABLISH, so this is where the serviceloop really waits.
+			DCCHBlocking blocking;
 			dcch->l3sendp(L3_RELEASE_REQUEST);	// WARNING!  This must be the only place in L3 that sends this primitive.
 			break;
+		}
 		case L3LogicalChannel::chRequestHardRelease:
 			dcch->l3sendp(L3_HARDRELEASE_REQUEST);
 			break;
@@ -1034,7 +1059,9 @@ void L3DCCHLoop(L3LogicalChannel*dcch, L3Frame *frame)
 	LOG(DEBUG) <<"CLOSE "<<dcch << " dump all:" <<gMMLayer.printMMInfo();
 
 	dcch->chanSetState(L3LogicalChannel::chIdle);
-	LOG(DEBUG) << "DCCHLoop exiting "<<dcch;
+	dcch->mDcchOpen = false;
+	LOG(DEBUG) << "DCCH closed "<<dcch;
+	return true;	// The next ESTABLISH may already be waiting.
 }
 
 #if UNUSED_BUT_SAVE_FOR_UMTS	// but may be used for UTMS
@@ -1091,8 +1118,9 @@ CSL3StateMachine::CSL3StateMachine() : mCSL3Thread(NULL) {}
 
 void l3start()
 {
-	// We are not doing it this way in GSM.  Each channel has its own service loop.
+	// We are not doing it this way in GSM.  The dedicated channels are serviced by the DCCH dispatcher.
 	// if (l3rewrite()) { gCSL3StateMachine.csl3Start(); }
+	DCCHDispatchStart();
 }
 
 
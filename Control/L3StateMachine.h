@@ -55,7 +55,7 @@ namespace Control {
 using namespace GSM;
 class TranEntry;
 class MMContext;
-extern void L3DCCHLoop(L3LogicalChannel*dcch, L3Frame *frame);
+extern bool L3DCCHService(L3LogicalChannel*dcch);
 
 #if UNUSED_BUT_SAVE_FOR_UMTS
 typedef InterthreadQueue<GenericL3Msg> CSL3StateMachineFifo;
@@ -21,6 +21,11 @@
 #define LOG_GROUP LogGroup::Control		// Can set Log.Level.Control for debugging
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <strings.h>
+#include <deque>
 
 #include "ControlCommon.h"
 #include "L3TranEntry.h"
@@ -158,6 +163,7 @@ TranEntry::TranEntry(
 
 	mStartTime = time(NULL);
 	mConnectTime = 0;	// Means never connected.
+	mRtpTraced = false;
 	//mEndTime = 0;
 	//gNewTransactionTable.ttAdd(this);
 }
@@ -169,6 +175,10 @@ TranEntry *TranEntry::newMO(MMContext *wChan, const GSM::L3CMServiceType& wServi
 	//TranEntry *result = new TranEntry(proxy,unknownId,wChannel,wService,CCState::NullState);
 	TranEntry *result = new TranEntry(NULL,wService);	// No SipDialog yet for MO transactions.
 	LOG(DEBUG);
+	// The trace must exist before the transaction is attached to the channel, which picks up the channel milestones.
+	if (wService.type() == L3CMServiceType::MobileOriginatedCall || wService.type() == L3CMServiceType::EmergencyCall) {
+		gCallTrace.ctStart(result->tranID(),false);
+	}
 	wChan->mmConnectTran(result);
 	gNewTransactionTable.ttAdd(result);
 	return result;
@@ -176,7 +186,15 @@ TranEntry *TranEntry::newMO(MMContext *wChan, const GSM::L3CMServiceType& wServi
 
 void TranEntry::setDialog(SIP::SipDialog *dialog) { mDialog = dialog; dialog->setTranId(mID); }
 void TranEntry::txFrame(SIP::AudioFrame* frame, unsigned numFlushed) { getDialog()->txFrame(frame,numFlushed); }
-SIP::AudioFrame *TranEntry::rxFrame() { return getDialog()->rxFrame(); }	// Crashes if rtp not established.
+SIP::AudioFrame *TranEntry::rxFrame()
+{
+	SIP::AudioFrame *frame = getDialog()->rxFrame();	// Crashes if rtp not established.
+	if (frame && !mRtpTraced) {
+		mRtpTraced = true;
+		gCallTrace.ctMark(tranID(),ctFirstRtp);
+	}
+	return frame;
+}
 
 unsigned TranEntry::getRTPPort() const
 {
@@ -220,6 +238,7 @@ TranEntry *TranEntry::newMTC(
 	result->mSubscriber = msid;
 	result->mCalling = GSM::L3CallingPartyBCDNumber(wCallerId.c_str());
 	LOG(DEBUG) <<LOGVAR2("callerid",result->mCalling.digits());
+	if (wService.type() == L3CMServiceType::MobileTerminatedCall) { gCallTrace.ctStart(result->tranID(),true); }
 	gNewTransactionTable.ttAdd(result);
 	return result;
 }
@@ -301,6 +320,7 @@ TranEntry *TranEntry::newHandover(
 	// We are "BS2" in the handover ladder diagram.
 	// The message string was formed by the handoverString method.
 	result->getHandoverEntry(true)->initHandoverEntry(peer,wInboundHandoverReference,wHandoverOtherBSTransactionID,params);
+	gNewTransactionTable.ttIndexHandover(result);
 
 	return result;
 }
@@ -928,6 +948,7 @@ bool NewTransactionTable::ttRemove(TranEntryId key)
 	ScopedLock lock(mttLock,__FILE__,__LINE__);
 	NewTransactionMap::iterator itr = mTable.find(key);
 	if (itr==mTable.end()) return false;
+	ttUnindexHandover(itr->second);
 	mTable.erase(itr);
 	return true;
 }
@@ -1095,6 +1116,8 @@ void NewTransactionTable::ttAddMessage(TranEntryId tranid,SIP::DialogMessage *dm
 	TranEntry* tran = ttFindById(tranid);
 	if (tran) {
 		tran->mTranInbox.write(dmsg);
+		// The channel is immortal in GSM, so waking it is safe even if the transaction is moving to another one.
+		if (L3LogicalChannel *chan = tran->channel()) { dcchReady(chan); }
 	} else {
 		// This is ok - the SIP dialog and L3 transaction side are completely decoupled so it is quite
 		// possible that the transaction was deleted (for example, MS signal failure) while
@@ -1119,28 +1142,39 @@ void NewTransactionTable_ttAddMessage(TranEntryId tranid,SIP::DialogMessage *dms
 }
 
 
+// Index an inbound handover by the transaction ID it had on the other BTS.  Called once the HandoverEntry is set up.
+void NewTransactionTable::ttIndexHandover(TranEntry *tran)
+{
+	ScopedLock lock(mttLock,__FILE__,__LINE__);
+	mHandoverIndex.insert(std::pair<unsigned,TranEntryId>(tran->mHandover->mHandoverOtherBSTransactionID,tran->tranID()));
+}
+
+// Caller holds mttLock.
+void NewTransactionTable::ttUnindexHandover(TranEntry *tran)
+{
+	if (! tran->mHandover) { return; }
+	HandoverIndex::iterator it = mHandoverIndex.lower_bound(tran->mHandover->mHandoverOtherBSTransactionID);
+	while (it != mHandoverIndex.end() && it->first == tran->mHandover->mHandoverOtherBSTransactionID) {
+		if (it->second == tran->tranID()) {
+			mHandoverIndex.erase(it++);
+		} else {
+			it++;
+		}
+	}
+}
+
 TranEntry* NewTransactionTable::ttFindHandoverOther(const L3MobileIdentity& mobileID, unsigned otherBS1TranId)
 {
 	LOG(DEBUG) <<LOGVAR2("ID",mobileID) <<LOGVAR(otherBS1TranId);
 
-	// Yes, it's linear time.
-	// Since clearDeadEntries is also linear, do that here, too.
-	//clearDeadEntries();
-
-	// Brute force search.
+	// The transaction IDs of different peers may collide, so there may be several to check.
 	ScopedLock lock(mttLock,__FILE__,__LINE__);
-	for (NewTransactionMap::iterator itr = mTable.begin(); itr!=mTable.end(); ++itr) {
+	std::pair<HandoverIndex::iterator,HandoverIndex::iterator> range = mHandoverIndex.equal_range(otherBS1TranId);
+	for (HandoverIndex::iterator it = range.first; it != range.second; ++it) {
+		NewTransactionMap::iterator itr = mTable.find(it->second);
+		if (itr == mTable.end()) { continue; }
 		TranEntry *tran = itr->second;
-		LOG(DEBUG) << "comparing "<<tran<<LOGVAR2("HandoverOtherBSTransactionID",(tran->mHandover?tran->mHandover->mHandoverOtherBSTransactionID:-1));
 		if (tran->deadOrRemoved()) continue;
-		if (!tran->mHandover) {
-			LOG(DEBUG) "no match, no handover"<<tran;
-			continue;
-		}
-		if (tran->mHandover->mHandoverOtherBSTransactionID != otherBS1TranId) {
-			LOG(DEBUG) "no match "<<tran->mHandover->mHandoverOtherBSTransactionID<<"!="<<otherBS1TranId;
-			continue;
-		}
 		if (! mobileID.fmidMatch(&tran->subscriber())) {
 			LOG(DEBUG) "no match"<<LOGVAR(tran->subscriber()) <<LOGVAR(mobileID);
 			continue;
@@ -1221,7 +1255,7 @@ TranEntryId NewTransactionTable::findLongestCall()
 		if (itr->second->getGSMState() != CCState::Active) continue;
 		long runTime = itr->second->stateAge();
 		if (runTime > longTime) {
-			runTime = longTime;
+			longTime = runTime;
 			longCall = itr;
 		}
 	}
@@ -1229,44 +1263,113 @@ TranEntryId NewTransactionTable::findLongestCall()
 	return longCall->second->tranID();
 }
 
+// The RTP ports are handed out in even/odd pairs from RTP.Start up to RTP.Start+RTP.Range.
+// There is a bit in mFree for each pair that may be allocated, so finding a port does not look at the transactions.
+// A released pair is held in quarantine for RTP.Quarantine seconds before it is reused,
+// so late packets from the previous call do not land in the next one.
+class RTPPortAllocator {
+	Mutex mLock;
+	unsigned mBase, mPairs;
+	std::vector<uint32_t> mFree;	// Bitmap of the pairs that may be allocated.
+	std::vector<bool> mInUse;		// Pairs allocated and not yet released.  A pair neither free nor in use is in quarantine.
+	std::deque<std::pair<time_t,unsigned> > mQuarantine;	// Release time and pair, oldest first.
+	unsigned mNext;					// Where to start looking, so the pairs are used round robin.
+
+	void rpaSetFree(unsigned pair) { mFree[pair/32] |= 1u << (pair%32); }
+	void rpaClearFree(unsigned pair) { mFree[pair/32] &= ~(1u << (pair%32)); }
+	bool rpaFindFree(unsigned &pair) const;
+	void rpaConfigure();
+
+	public:
+	RTPPortAllocator() : mBase(0), mPairs(0), mNext(0) {}
+	unsigned rpaAllocate();
+	void rpaRelease(unsigned port);
+};
+static RTPPortAllocator gRTPPorts;
+
+// RTP.Start and RTP.Range are static so we only need to read them once.
+void RTPPortAllocator::rpaConfigure()
+{
+	mBase = gConfig.getNum("RTP.Start");
+	mPairs = max(1u,(unsigned)gConfig.getNum("RTP.Range")/2);
+	mFree.assign((mPairs+31)/32,0);
+	mInUse.assign(mPairs,false);
+	for (unsigned pair = 0; pair < mPairs; pair++) { rpaSetFree(pair); }
+	// Pick a random starting point.  (pat) Why?  Because there is a bug and we are trying to avoid it?
+	mNext = random() % mPairs;
+}
+
+// Find the first free pair at or after mNext, wrapping around.
+bool RTPPortAllocator::rpaFindFree(unsigned &pair) const
+{
+	unsigned words = mFree.size();
+	for (unsigned i = 0; i <= words; i++) {
+		unsigned word = (mNext/32 + i) % words;
+		uint32_t bits = mFree[word];
+		// The first word is looked at twice: first from mNext up, then at the end for the pairs before mNext.
+		if (i == 0) { bits &= ~0u << (mNext%32); }
+		if (bits) {
+			pair = word*32 + ffs(bits) - 1;
+			return true;
+		}
+	}
+	return false;
+}
+
+unsigned RTPPortAllocator::rpaAllocate()
+{
+	ScopedLock lock(mLock,__FILE__,__LINE__);
+	if (mPairs == 0) { rpaConfigure(); }
+	time_t now = time(NULL);
+	time_t quarantine = gConfig.getNum("RTP.Quarantine");
+	while (mQuarantine.size() && mQuarantine.front().first + quarantine <= now) {
+		unsigned pair = mQuarantine.front().second;
+		mQuarantine.pop_front();
+		if (! mInUse[pair]) { rpaSetFree(pair); }
+	}
+	unsigned pair;
+	if (! rpaFindFree(pair)) {
+		if (mQuarantine.size()) {
+			LOG(WARNING) << "RTP port pool exhausted, reusing a port still in quarantine";
+			pair = mQuarantine.front().second;
+			mQuarantine.pop_front();
+		} else {
+			// Every pair is in use.  The port we return is shared with another call, which is broken
+			// but better than failing the call setup.
+			LOG(ALERT) << "RTP port pool exhausted, increase RTP.Range" <<LOGVAR2("RTP.Range",2*mPairs);
+			pair = mNext;
+		}
+	}
+	rpaClearFree(pair);
+	mInUse[pair] = true;
+	mNext = (pair + 1) % mPairs;
+	return mBase + 2*pair;
+}
+
+void RTPPortAllocator::rpaRelease(unsigned port)
+{
+	ScopedLock lock(mLock,__FILE__,__LINE__);
+	if (port < mBase || port >= mBase + 2*mPairs || (port - mBase) % 2) { return; }	// Not one of ours.
+	unsigned pair = (port - mBase) / 2;
+	if (! mInUse[pair]) { return; }
+	mInUse[pair] = false;
+	mQuarantine.push_back(std::pair<time_t,unsigned>(time(NULL),pair));
+}
+
 /**
 	Return an even UDP port number for the RTP even/odd pair.
 */
 unsigned allocateRTPPorts()
 {
-	const unsigned base = gConfig.getNum("RTP.Start");
-	const unsigned range = gConfig.getNum("RTP.Range");
-	const unsigned top = base+range;
-	static Mutex lock;
-	// Pick a random starting point.  (pat) Why?  Because there is a bug and we are trying to avoid it?
-	static unsigned port = base + 2*(random()%(range/2));
-	unsigned retVal;
-	lock.lock();
-	//This is a little hacky as RTPAvail is O(n)
-	do {
-		retVal = port;
-		port += 2;
-		if (port>=top) port=base;
-	} while (!gNewTransactionTable.RTPAvailable(retVal));
-	lock.unlock();
-	return retVal;
+	return gRTPPorts.rpaAllocate();
 }
 
-/* linear, we should move the actual search into this structure */
-// (pat) Speed entirely irrelevant; this is done once per call.
-bool NewTransactionTable::RTPAvailable(unsigned rtpPort)
+/**
+	Return the pair starting at this port to the pool.
+*/
+void releaseRTPPorts(unsigned rtpPort)
 {
-	ScopedLock lock(mttLock,__FILE__,__LINE__);
-	//clearDeadEntries();
-	bool avail = true;
-	for (NewTransactionMap::iterator itr = mTable.begin(); itr!=mTable.end(); ++itr) {
-		if (itr->second->deadOrRemoved()) continue;
-		if (itr->second->getRTPPort() == rtpPort){
-			avail = false;
-			break;
-		}
-	}
-	return avail;
+	gRTPPorts.rpaRelease(rtpPort);
 }
 
 
@@ -1633,6 +1736,8 @@ void TranEntry::teRemove(TermCause cause)
 	// However to prevent a race we must do this after using the dialog, which we did above.
 	setGSMState(CCState::TranDeleted);	// (pat 10-10-2014) Now we use this to mark the TranEntry as deleted.
 	gNewTransactionTable.ttRemove(this->tranID());
+	// Finish the trace now rather than when the last reference goes away, which may be much later and on any thread.
+	gCallTrace.ctFinish(tranID());
 
 	while (currentProcedure()) {
 		delete this->tePopMachine();
@@ -1871,16 +1976,85 @@ void L3CDR::cdrWriteEntry(FILE *pf)
 	fprintf(pf,"%c,",(cdrCause.mtcInstigator == TermCause::SideLocal) ? 'L' : 'R');	// termination side
 	fprintf(pf,"%d",cdrCause.tcGetValue());	// termination cause
 	fprintf(pf,"\n");
-	fflush(pf);	// Write to disk in case OpenBTS crashes.
+	// The CdrService flushes after each batch.
+}
+
+void L3CDR::cdrWriteBinaryHeader(FILE *pf)
+{
+	fwrite("OBTSCDR1",1,8,pf);
+}
+
+static void cdrPutString(string &rec, const string &str)
+{
+	unsigned len = min((size_t)255,str.size());
+	rec.push_back((char)len);
+	rec.append(str,0,len);
+}
+
+static void cdrPutInt(string &rec, uint32_t val)
+{
+	rec.push_back((char)(val >> 24));
+	rec.push_back((char)(val >> 16));
+	rec.push_back((char)(val >> 8));
+	rec.push_back((char)val);
+}
+
+// The fields are the same and in the same order as cdrWriteEntry(); Control.CDR.Format describes the encoding.
+void L3CDR::cdrWriteBinary(FILE *pf)
+{
+	string rec;
+	rec.reserve(128);
+	rec.append(2,0);	// Length, filled in below.
+	cdrPutString(rec,cdrType);
+	cdrPutInt(rec,cdrTid);
+	cdrPutString(rec,cdrToImsi);
+	cdrPutString(rec,cdrFromImsi);
+	cdrPutString(rec,cdrToNumber);
+	cdrPutString(rec,cdrFromNumber);
+	cdrPutString(rec,cdrPeer);
+	cdrPutInt(rec,cdrConnectTime);
+	cdrPutInt(rec,cdrDuration);
+	cdrPutInt(rec,cdrMessageSize);
+	cdrPutString(rec,cdrToHandover);
+	cdrPutString(rec,cdrFromHandover);
+	rec.push_back((cdrCause.mtcInstigator == TermCause::SideLocal) ? 'L' : 'R');
+	cdrPutInt(rec,cdrCause.tcGetValue());
+	unsigned len = rec.size() - 2;
+	rec[0] = (char)(len >> 8);
+	rec[1] = (char)len;
+	fwrite(rec.data(),1,rec.size(),pf);
+}
+
+void CdrService::cdrAdd(L3CDR*cdrp)
+{
+	unsigned maxQueue = gConfig.getNum("Control.CDR.MaxQueue");
+	if (mCdrQueue.size() >= maxQueue) {
+		unsigned dropped;
+		{	ScopedLock lock(cdrLock);
+			dropped = ++cdrDropped;
+		}
+		gReports.incr("OpenBTS.CDR.Dropped");
+		// Dont flood the log while the writer is behind.
+		if (dropped % 1000 == 1) { LOG(WARNING) << "CDR queue full, dropping CDRs" <<LOGVAR(maxQueue) <<LOGVAR(dropped); }
+		delete cdrp;
+		return;
+	}
+	mCdrQueue.write(cdrp);
 }
 
-// Open a new file whenever the date changes.
+// Open a new file whenever the date changes, the file is too big or too old.
 void CdrService::cdrOpenFile()
 {
 	time_t now = time(NULL);
 	struct tm tm;
 	localtime_r(&now,&tm);
-	if (tm.tm_yday == cdrCurrentDay) {
+	bool rotate = false;
+	if (mpf) {
+		long maxSize = 1024 * gConfig.getNum("Control.CDR.MaxFileSize");
+		time_t interval = gConfig.getNum("Control.CDR.RotateInterval");
+		rotate = (maxSize && ftell(mpf) >= maxSize) || (interval && now - cdrFileOpened >= interval);
+	}
+	if (tm.tm_yday == cdrCurrentDay && !rotate) {
 		// We already tried to open the file.  Either we succeeded or not, but we wont try to open it on every transaction.
 		return;
 	}
@@ -1889,26 +2063,63 @@ void CdrService::cdrOpenFile()
 	if (0 == dirname.size()) { return; }	// Disabled if the Control.CDR.Dirname is empty.
 
 	cdrCurrentDay = tm.tm_yday;
+	cdrFileOpened = now;
+	cdrBinary = gConfig.getStr("Control.CDR.Format") == "BINARY";
 	string date = format("%04d-%02d-%02d", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday);
+	// The first file of the day keeps the old name; later files of the same day get the time too.
+	if (rotate) { date += format("_%02d%02d%02d",tm.tm_hour,tm.tm_min,tm.tm_sec); }
 
 	mkdir(dirname.c_str(),0777);	// Doesnt hurt to do this even if unnecessary.
 
 	string btsid = gConfig.getStr("SIP.Local.IP");	// Default bts id to the local IP address.
-	string filename = format("%s/OpenBTS_%s_%s.cdr",dirname,btsid,date);
+	string filename = format("%s/OpenBTS_%s_%s.%s",dirname,btsid,date,cdrBinary ? "cdrb" : "cdr");
 	mpf = fopen(filename.c_str(),"a");
+	if (!mpf) {
+		LOG(ERR) << "Cannot open CDR file "<<filename<<": "<<strerror(errno);
+		return;
+	}
+	// The batches are written with one fflush, so give stdio room for a whole batch.
+	setvbuf(mpf,NULL,_IOFBF,64*1024);
 	// Dont re-write the header if we are appending to an existing file.
-	if (mpf && 0 == ftell(mpf)) { L3CDR::cdrWriteHeader(mpf); }
+	if (0 == ftell(mpf)) {
+		if (cdrBinary) { L3CDR::cdrWriteBinaryHeader(mpf); } else { L3CDR::cdrWriteHeader(mpf); }
+	}
+}
+
+void CdrService::cdrWriteBatch(vector<L3CDR*> &batch)
+{
+	cdrOpenFile();	// We may have to open a new file if the date changed or the file is full.
+	if (!mpf) { return; }
+	for (vector<L3CDR*>::iterator it = batch.begin(); it != batch.end(); it++) {
+		if (cdrBinary) { (*it)->cdrWriteBinary(mpf); } else { (*it)->cdrWriteEntry(mpf); }
+	}
+	if (batch.size()) { fflush(mpf); }	// Get it out of our process in case OpenBTS crashes.
+	// Syncing is what costs, so only do that every so often.
+	time_t now = time(NULL);
+	if (now - cdrLastSync >= gConfig.getNum("Control.CDR.SyncInterval")) {
+		fsync(fileno(mpf));
+		cdrLastSync = now;
+	}
 }
 
 void*CdrService::cdrServiceLoop(void*arg)
 {
 	CdrService *self = static_cast<CdrService*>(arg);
+	const unsigned cMaxBatch = 256;
+	vector<L3CDR*> batch;
+	batch.reserve(cMaxBatch);
 	while (!gBTS.btsShutdown()) {
-		L3CDR *cdr = self->mCdrQueue.read();	// Blocking read.
-		if (!cdr) { continue; }	// paranoid, but maybe happens during shutdown.
-		self->cdrOpenFile();	// We may have to open a new file if the date changed.
-		if (self->mpf) { cdr->cdrWriteEntry(self->mpf); }
-		delete cdr;
+		// Wait for the first record, then take whatever else is already waiting.
+		// The timeout lets us sync and rotate the file even when no CDRs are arriving.
+		L3CDR *cdr = self->mCdrQueue.read(1000);
+		while (cdr) {
+			batch.push_back(cdr);
+			if (batch.size() >= cMaxBatch) { break; }
+			cdr = self->mCdrQueue.readNoBlock();
+		}
+		self->cdrWriteBatch(batch);
+		for (vector<L3CDR*>::iterator it = batch.begin(); it != batch.end(); it++) { delete *it; }
+		batch.clear();
 	}
 	return NULL;
 }
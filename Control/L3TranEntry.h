@@ -232,23 +232,33 @@ struct L3CDR {
 
 	static void cdrWriteHeader(FILE *pf);
 	void cdrWriteEntry(FILE *pf);
+	static void cdrWriteBinaryHeader(FILE *pf);
+	void cdrWriteBinary(FILE *pf);
 };
 
 // pat added 6-2014.
 // This is sent L3CDR records.  It writes them to a file.
+// The service thread takes the records off the queue in batches and flushes once per batch,
+// so a burst of CDRs costs one write and the transactions that made them never wait for the disk.
+// A new file is started each day, and optionally by size and age.  If the queue gets too long new CDRs are dropped.
 class CdrService {
 	Mutex cdrLock;
 	InterthreadQueue<L3CDR> mCdrQueue;
 	Thread cdrServiceThread;
 	FILE *mpf;
 	int cdrCurrentDay;
+	time_t cdrFileOpened;		// When mpf was opened, for Control.CDR.RotateInterval.
+	time_t cdrLastSync;
+	bool cdrBinary;				// The format of mpf.
 	Bool_z cdrServiceRunning;
+	unsigned cdrDropped;
+	void cdrWriteBatch(std::vector<L3CDR*> &batch);
 	public:
-	CdrService() : mpf(NULL), cdrCurrentDay(-1) {}
+	CdrService() : mpf(NULL), cdrCurrentDay(-1), cdrFileOpened(0), cdrLastSync(0), cdrBinary(false), cdrDropped(0) {}
 	void cdrServiceStart();
 	void cdrOpenFile();
 	static void *cdrServiceLoop(void*);
-	void cdrAdd(L3CDR*cdrp) { mCdrQueue.write(cdrp); }
+	void cdrAdd(L3CDR*cdrp);
 };
 extern CdrService gCdrService;
 
@@ -565,6 +575,7 @@ class TranEntry : public MemCheckTranEntry, public RefCntBase, public TranEntryP
 	public:
 	time_t mStartTime;		// transaction creation time.
 	time_t mConnectTime;	// When call is connected, or 0 if never.
+	bool mRtpTraced;		// The first downlink RTP frame has gone to the call trace.
 	L3CDR *createCDR(bool makeCMR, TermCause cause);
 };
 
@@ -593,6 +604,11 @@ class NewTransactionTable {
 	mutable Mutex mttLock;
 	unsigned mIDCounter;
 
+	// Inbound handovers by the transaction ID on the other BTS, for ttFindHandoverOther.
+	typedef std::multimap<unsigned,TranEntryId> HandoverIndex;
+	HandoverIndex mHandoverIndex;
+	void ttUnindexHandover(TranEntry *tran);
+
 	public:
 	/**
 		Initialize a transaction table.
@@ -641,12 +657,6 @@ class NewTransactionTable {
 	*/
 	TranEntryId findLongestCall();
 
-	/**
-		Return the availability of this particular RTP port
-		@return True if Port is available, False otherwise
-	*/
-	bool RTPAvailable(unsigned rtpPort);
-
 	/**
 		Fand an entry by its handover reference.
 		@param ref The 8-bit handover reference.
@@ -724,6 +734,7 @@ class NewTransactionTable {
 
 	/** Find by subscriber and handover other BS transaction ID. */
 	TranEntry* ttFindHandoverOther(const GSM::L3MobileIdentity& mobileID, unsigned transactionID);
+	void ttIndexHandover(TranEntry *tran);
 
 	/** Check for duplicated SMS delivery attempts. */
 	//bool duplicateMessage(const GSM::L3MobileIdentity& mobileID, const std::string& wMessage);
@@ -154,8 +154,58 @@ bool configSendTmsis()
 }
 
 
+// The columns kept in TmsiRecord, in the order used by the load query and the cached insert and update statements.
+static const char *cachedColumns =
+	"IMSI,TMSI,IMEI,CREATED,ACCESSED,A5_SUPPORT,POWER_CLASS,OLD_TMSI,OLD_MCC,OLD_MNC,OLD_LAC,"
+	"kc,ASSOCIATED_URI,ASSERTED_IDENTITY,WELCOME_SENT,AUTH,AUTH_EXPIRY,REJECT_CODE,TMSI_ASSIGNED";
+static const char *insertStatement =
+	"INSERT INTO TMSI_TABLE (IMSI,TMSI,IMEI,CREATED,ACCESSED,A5_SUPPORT,POWER_CLASS,OLD_TMSI,OLD_MCC,OLD_MNC,OLD_LAC,"
+	"kc,ASSOCIATED_URI,ASSERTED_IDENTITY,WELCOME_SENT,AUTH,AUTH_EXPIRY,REJECT_CODE,TMSI_ASSIGNED) "
+	"VALUES (?1,?2,?3,?4,?5,?6,?7,?8,?9,?10,?11,?12,?13,?14,?15,?16,?17,?18,?19)";
+// The update does not touch CREATED or the OLD_ fields, which never change after the insert.
+static const char *updateStatement =
+	"UPDATE TMSI_TABLE SET TMSI=?2,IMEI=?3,ACCESSED=?5,A5_SUPPORT=?6,POWER_CLASS=?7,"
+	"kc=?12,ASSOCIATED_URI=?13,ASSERTED_IDENTITY=?14,WELCOME_SENT=?15,AUTH=?16,AUTH_EXPIRY=?17,REJECT_CODE=?18,TMSI_ASSIGNED=?19 "
+	"WHERE IMSI=?1";
+static const char *deleteStatement = "DELETE FROM TMSI_TABLE WHERE IMSI=?1";
+
+static string columnText(sqlite3_stmt *stmt, int col)
+{
+	const char *text = (const char*)sqlite3_column_text(stmt,col);
+	return text ? string(text) : string("");
+}
+
+// Bind all the columns of the record in the cachedColumns order; the update statement skips the ones it does not use.
+static void bindRecord(sqlite3_stmt *stmt, const TmsiRecord &rec)
+{
+	sqlite3_reset(stmt);
+	sqlite3_clear_bindings(stmt);
+	sqlite3_bind_text(stmt,1,rec.imsi.c_str(),-1,SQLITE_TRANSIENT);
+	sqlite3_bind_int(stmt,2,tmsi2table(rec.tmsi));
+	sqlite3_bind_text(stmt,3,rec.imei.c_str(),-1,SQLITE_TRANSIENT);
+	sqlite3_bind_int64(stmt,4,rec.created);
+	sqlite3_bind_int64(stmt,5,rec.accessed);
+	sqlite3_bind_int(stmt,6,rec.a5support);
+	sqlite3_bind_int(stmt,7,rec.powerClass);
+	if (rec.haveOld) {
+		sqlite3_bind_int64(stmt,8,rec.oldTmsi);
+		sqlite3_bind_int(stmt,9,rec.oldMcc);
+		sqlite3_bind_int(stmt,10,rec.oldMnc);
+		sqlite3_bind_int(stmt,11,rec.oldLac);
+	}	// else they stay NULL.
+	sqlite3_bind_text(stmt,12,rec.kc.c_str(),-1,SQLITE_TRANSIENT);
+	sqlite3_bind_text(stmt,13,rec.associatedUri.c_str(),-1,SQLITE_TRANSIENT);
+	sqlite3_bind_text(stmt,14,rec.assertedIdentity.c_str(),-1,SQLITE_TRANSIENT);
+	sqlite3_bind_int(stmt,15,rec.welcomeSent);
+	sqlite3_bind_int(stmt,16,rec.auth);
+	sqlite3_bind_int(stmt,17,rec.authExpiry);
+	sqlite3_bind_int(stmt,18,rec.rejectCode);
+	sqlite3_bind_int(stmt,19,rec.tmsiAssigned);
+}
+
+
 // return true on success
-bool TMSITable::runQuery(const char *query, int checkChanges) const
+bool TMSITable::runSql(const char *query, int checkChanges) const
 {
 	int resultCode, changes=0;
 	LOG(DEBUG)<<LOGVAR(query)<<LOGVAR(checkChanges);
@@ -168,6 +218,20 @@ bool TMSITable::runQuery(const char *query, int checkChanges) const
 	return true;
 }
 
+// This is for the CLI.  The query may change anything, so write out what we have first and reload afterward.
+// All the shards stay locked from the flush to the reload, so a change made meanwhile is not lost in the reload;
+// it waits for the query instead.  The shard locks are recursive, so the flush and the reload can take them again.
+bool TMSITable::runQuery(const char *query, int checkChanges)
+{
+	ScopedLock lock(mFlushLock);
+	for (unsigned i = 0; i < cNumShards; i++) { mShards[i].mLock.lock(); }
+	tmsiTabFlushLocked();
+	bool result = runSql(query,checkChanges);
+	tmsiTabLoad();
+	for (unsigned i = cNumShards; i > 0; i--) { mShards[i-1].mLock.unlock(); }
+	return result;
+}
+
 // pat 9-2013: I am adding an extra table to hold attributes including a version number of the TMSI table file.
 // (pat) If the TMSI_TABLE version does not match expected, drop the TMSI_TABLE before returning, and the caller will recreate it.
 bool TMSITable::tmsiTabCheckVersion()
@@ -179,14 +243,14 @@ bool TMSITable::tmsiTabCheckVersion()
 	}
 
 	// Delete the existing tmsi table from the database, caller will recreate it.
-	runQuery("DROP TABLE IF EXISTS TMSI_TABLE");
+	runSql("DROP TABLE IF EXISTS TMSI_TABLE");
 
 	// Set the version attribute.
 	sqlite_set_attr(mTmsiDB,"VERSION",TmsiTableDefinition::tmsiTableVersion);
 	return false;
 }
 
-// Delete expired TMSITable entries.
+// Delete expired TMSITable entries.  This is done in the database before the table is loaded.
 void TMSITable::tmsiTabCleanup()
 {
 	// Delete old TMSIs.
@@ -195,7 +259,7 @@ void TMSITable::tmsiTabCleanup()
 	unsigned oldest_allowed = time(NULL) - (maxage * 60*60);
 	char query[102];
 	snprintf(query,100,"DELETE FROM TMSI_TABLE WHERE ACCESSED <= %u",oldest_allowed);
-	runQuery(query,false);
+	runSql(query,false);
 	int changes = sqlite3_changes(mTmsiDB);
 	if (changes) {
 		LOG(INFO) << "Deleted "<<changes<<" expired entries from TMSITable with age < Control.TMSITable.Maxage="<<maxage<<" hours";
@@ -204,44 +268,285 @@ void TMSITable::tmsiTabCleanup()
 
 void TMSITable::tmsiTabClearAuthCache()
 {
-	runQuery("UPDATE TMSI_TABLE SET AUTH_EXPIRY=0");
+	for (unsigned i = 0; i < cNumShards; i++) {
+		TmsiShard &shard = mShards[i];
+		ScopedLock lock(shard.mLock);
+		for (TmsiShard::RecordMap::iterator it = shard.mRecords.begin(); it != shard.mRecords.end(); it++) {
+			if (it->second->authExpiry) {
+				it->second->authExpiry = 0;
+				shard.mDirty.insert(it->first);
+			}
+		}
+	}
 }
 
 
 void TMSITable::tmsiTabClear()
 {
-	runQuery("DELETE FROM TMSI_TABLE WHERE 1");
+	ScopedLock lock(mFlushLock);
+	for (unsigned i = 0; i < cNumShards; i++) {
+		TmsiShard &shard = mShards[i];
+		ScopedLock lock(shard.mLock);
+		for (TmsiShard::RecordMap::iterator it = shard.mRecords.begin(); it != shard.mRecords.end(); it++) {
+			delete it->second;
+		}
+		shard.mRecords.clear();
+		shard.mDirty.clear();
+		shard.mDeleted.clear();
+	}
+	for (unsigned i = 0; i < cNumShards; i++) {
+		ScopedLock lock(mTmsiIndex[i].mLock);
+		mTmsiIndex[i].mImsiOf.clear();
+	}
+	runSql("DELETE FROM TMSI_TABLE WHERE 1");
 	//clearAuthFailures();
 	//authFailures.clear();
 }
 
+TmsiShard &TMSITable::imsiShard(const string &imsi) const
+{
+	// FNV-1a.  The low digits of the IMSI alone would do, but this does not care what the string looks like.
+	unsigned hash = 2166136261u;
+	for (string::const_iterator it = imsi.begin(); it != imsi.end(); it++) {
+		hash = (hash ^ (unsigned char)*it) * 16777619u;
+	}
+	return mShards[hash % cNumShards];
+}
+
+// The caller holds the shard lock.
+TmsiRecord *TMSITable::findRecord(TmsiShard &shard, const string &imsi) const
+{
+	TmsiShard::RecordMap::iterator it = shard.mRecords.find(imsi);
+	return it == shard.mRecords.end() ? NULL : it->second;
+}
+
+bool TMSITable::findImsi(uint32_t tmsi, string &imsi) const
+{
+	TmsiIndexShard &ishard = tmsiShard(tmsi);
+	ScopedLock lock(ishard.mLock);
+	map<uint32_t,string>::iterator it = ishard.mImsiOf.find(tmsi);
+	if (it == ishard.mImsiOf.end()) { return false; }
+	imsi = it->second;
+	return true;
+}
+
+void TMSITable::indexTmsi(uint32_t tmsi, const string &imsi)
+{
+	TmsiIndexShard &ishard = tmsiShard(tmsi);
+	ScopedLock lock(ishard.mLock);
+	ishard.mImsiOf[tmsi] = imsi;
+}
+
+void TMSITable::unindexTmsi(uint32_t tmsi)
+{
+	TmsiIndexShard &ishard = tmsiShard(tmsi);
+	ScopedLock lock(ishard.mLock);
+	ishard.mImsiOf.erase(tmsi);
+}
+
+// Replace the in-memory table with the contents of the database.
+// Called at startup and after a CLI query; the caller holds mFlushLock.
+void TMSITable::tmsiTabLoad()
+{
+	TmsiShard::RecordMap records[cNumShards];
+	map<uint32_t,string> index[cNumShards];
+	unsigned count = 0;
+
+	string query = format("SELECT %s FROM TMSI_TABLE",cachedColumns);
+	sqlite3_stmt *stmt;
+	if (sqlite3_prepare_statement(mTmsiDB,&stmt,query.c_str())) {
+		LOG(ALERT) << "cannot prepare statement for " << query;
+		return;
+	}
+	while (SQLITE_ROW == sqlite3_run_query(mTmsiDB,stmt)) {
+		TmsiRecord *rec = new TmsiRecord;
+		rec->imsi = columnText(stmt,0);
+		rec->tmsi = table2tmsi(sqlite3_column_int(stmt,1));
+		rec->imei = columnText(stmt,2);
+		rec->created = (unsigned)sqlite3_column_int64(stmt,3);
+		rec->accessed = (unsigned)sqlite3_column_int64(stmt,4);
+		rec->a5support = sqlite3_column_int(stmt,5);
+		rec->powerClass = sqlite3_column_int(stmt,6);
+		rec->haveOld = sqlite3_column_type(stmt,7) != SQLITE_NULL;
+		rec->oldTmsi = (unsigned)sqlite3_column_int64(stmt,7);
+		rec->oldMcc = sqlite3_column_int(stmt,8);
+		rec->oldMnc = sqlite3_column_int(stmt,9);
+		rec->oldLac = sqlite3_column_int(stmt,10);
+		rec->kc = columnText(stmt,11);
+		rec->associatedUri = columnText(stmt,12);
+		rec->assertedIdentity = columnText(stmt,13);
+		rec->welcomeSent = sqlite3_column_int(stmt,14);
+		rec->auth = (Authorization) sqlite3_column_int(stmt,15);
+		rec->authExpiry = sqlite3_column_int(stmt,16);
+		rec->rejectCode = sqlite3_column_int(stmt,17);
+		rec->tmsiAssigned = sqlite3_column_int(stmt,18);
+		rec->mInDB = true;
+		records[&imsiShard(rec->imsi) - mShards][rec->imsi] = rec;
+		index[rec->tmsi % cNumShards][rec->tmsi] = rec->imsi;
+		// The table was created with the fake tmsis above any valid one, so the highest tmsi is the highest fake.
+		if (rec->tmsi > sHighestFakeTmsi) { sHighestFakeTmsi = rec->tmsi; }
+		count++;
+	}
+	sqlite3_finalize(stmt);
+
+	for (unsigned i = 0; i < cNumShards; i++) {
+		TmsiShard &shard = mShards[i];
+		ScopedLock lock(shard.mLock);
+		for (TmsiShard::RecordMap::iterator it = shard.mRecords.begin(); it != shard.mRecords.end(); it++) {
+			delete it->second;
+		}
+		shard.mRecords.swap(records[i]);
+		for (TmsiShard::RecordMap::iterator it = shard.mRecords.begin(); it != shard.mRecords.end(); it++) {
+			it->second->mSerial = ++shard.mNextSerial;
+		}
+		shard.mDirty.clear();
+		shard.mDeleted.clear();
+	}
+	for (unsigned i = 0; i < cNumShards; i++) {
+		ScopedLock lock(mTmsiIndex[i].mLock);
+		mTmsiIndex[i].mImsiOf.swap(index[i]);
+	}
+	LOG(INFO) << "Loaded "<<count<<" TMSITable entries";
+}
+
 void TMSITable::tmsiTabInit()
 {
 	tmsiTabCleanup();
 
-	// Run through the tmsi table to find the highest number tmsi.
-	// We could let sqlite just automatically create them except for the initial case
+	// The load finds the highest tmsi.  We could let sqlite just automatically create them except for the initial case
 	// where we need to create the first fake tmsi.
 	sHighestFakeTmsi = MAX_VALID_TMSI;
-	if (1) {
-		// Not that it matters, since this is done only once, but because TMSI is a primary key this query is probably optimized.
-		sqlQuery qHighestTmsi(mTmsiDB,"TMSI_TABLE","max(TMSI)","");
-		if (qHighestTmsi.sqlSuccess()) {
-			unsigned highest_tmsi = qHighestTmsi.getResultInt(0);
-			LOG(DEBUG) << "Highest TMSI="<<highest_tmsi;
-			if (highest_tmsi > sHighestFakeTmsi) { sHighestFakeTmsi = highest_tmsi; }
-		} else {
-			// Possibly empty table.
+	ScopedLock lock(mFlushLock);
+	tmsiTabLoad();
+	LOG(DEBUG) << "Highest TMSI="<<sHighestFakeTmsi;
+}
+
+bool TMSITable::tmsiTabPrepare()
+{
+	if (sqlite3_prepare_statement(mTmsiDB,&mInsertStmt,insertStatement) ||
+		sqlite3_prepare_statement(mTmsiDB,&mUpdateStmt,updateStatement) ||
+		sqlite3_prepare_statement(mTmsiDB,&mDeleteStmt,deleteStatement)) {
+		LOG(ALERT) << "cannot prepare TMSITable statements: " << sqlite3_errmsg(mTmsiDB);
+		return false;
+	}
+	return true;
+}
+
+
+// Write everything that changed since the last flush to the TMSI_TABLE in one transaction.
+// Each shard is locked only long enough to copy out its changes, so no one waits on sqlite.
+// Rows are deleted first so an IMSI that was dropped and recreated, or a tmsi that moved to another IMSI, is reinserted cleanly.
+bool TMSITable::tmsiTabFlushLocked() const
+{
+	if (!mTmsiDB || !mInsertStmt || !mUpdateStmt || !mDeleteStmt) { return false; }
+	vector<string> deleted;
+	vector<TmsiRecord> changed;
+	for (unsigned i = 0; i < cNumShards; i++) {
+		TmsiShard &shard = mShards[i];
+		ScopedLock lock(shard.mLock);
+		deleted.insert(deleted.end(),shard.mDeleted.begin(),shard.mDeleted.end());
+		shard.mDeleted.clear();
+		for (set<string>::iterator it = shard.mDirty.begin(); it != shard.mDirty.end(); it++) {
+			if (TmsiRecord *rec = findRecord(shard,*it)) { changed.push_back(*rec); }
 		}
-	} else {
-		// old way, the brute-force approach.
-		sqlQuery qinit(mTmsiDB,"TMSI_TABLE","TMSI","");
-		while (qinit.sqlResultSize()) {
-			int rawtmsi = qinit.getResultInt(0);
-			if (rawtmsi > (int)sHighestFakeTmsi) { sHighestFakeTmsi = rawtmsi; }
-			if (! qinit.sqlStep()) break;
+		shard.mDirty.clear();
+	}
+	if (deleted.empty() && changed.empty()) { return true; }
+
+	if (!runSql("BEGIN TRANSACTION")) {
+		tmsiTabRequeue(deleted,changed);
+		return false;
+	}
+	// A failure of one row is logged and that row retried at the next flush; it does not hold up the others.
+	vector<string> failedDeletes;
+	vector<TmsiRecord> failedChanges;
+	vector<bool> written(changed.size(),false);
+	for (vector<string>::iterator it = deleted.begin(); it != deleted.end(); it++) {
+		sqlite3_reset(mDeleteStmt);
+		sqlite3_bind_text(mDeleteStmt,1,it->c_str(),-1,SQLITE_TRANSIENT);
+		int rc = sqlite3_run_query(mTmsiDB,mDeleteStmt);
+		if (rc != SQLITE_DONE) {
+			LOG(ERR) << "TMSI table delete failed for"<<LOGVAR2("imsi",*it)<<LOGVAR(rc)<<" error:"<<sqlite3_errmsg(mTmsiDB);
+			failedDeletes.push_back(*it);
+		}
+	}
+	for (unsigned i = 0; i < changed.size(); i++) {
+		TmsiRecord &rec = changed[i];
+		sqlite3_stmt *stmt = rec.mInDB ? mUpdateStmt : mInsertStmt;
+		bindRecord(stmt,rec);
+		int rc = sqlite3_run_query(mTmsiDB,stmt);
+		if (rc != SQLITE_DONE) {
+			// We dont write the record because it has Kc in it.
+			LOG(ERR) << "TMSI table "<<(rec.mInDB ? "update" : "insert")<<" failed for"<<LOGVAR2("imsi",rec.imsi)
+				<<LOGHEX2("tmsi",rec.tmsi)<<LOGVAR(rc)<<" error:"<<sqlite3_errmsg(mTmsiDB);
+			failedChanges.push_back(rec);
+		} else if (rec.mInDB && sqlite3_changes(mTmsiDB) == 0) {
+			// The row is gone, eg, deleted by a CLI query; insert it next time.
+			LOG(NOTICE) << "TMSI table row missing for"<<LOGVAR2("imsi",rec.imsi)<<", will insert it";
+			rec.mInDB = false;
+			failedChanges.push_back(rec);
+		} else {
+			written[i] = true;
 		}
 	}
+	sqlite3_reset(mDeleteStmt);
+	sqlite3_reset(mInsertStmt);
+	sqlite3_reset(mUpdateStmt);
+	if (!runSql("COMMIT")) {
+		runSql("ROLLBACK");
+		tmsiTabRequeue(deleted,changed);
+		return false;
+	}
+
+	// The inserted rows exist now, so later changes to the same records are updates.
+	// A record whose update found no row is inserted next time.
+	for (unsigned i = 0; i < changed.size(); i++) {
+		if (!written[i] || changed[i].mInDB) { continue; }
+		TmsiShard &shard = imsiShard(changed[i].imsi);
+		ScopedLock lock(shard.mLock);
+		TmsiRecord *rec = findRecord(shard,changed[i].imsi);
+		if (rec && rec->mSerial == changed[i].mSerial) { rec->mInDB = true; }
+	}
+	for (vector<TmsiRecord>::iterator it = failedChanges.begin(); it != failedChanges.end(); it++) {
+		TmsiShard &shard = imsiShard(it->imsi);
+		ScopedLock lock(shard.mLock);
+		TmsiRecord *rec = findRecord(shard,it->imsi);
+		if (rec && rec->mSerial == it->mSerial) { rec->mInDB = it->mInDB; }
+	}
+	if (failedDeletes.size() || failedChanges.size()) { tmsiTabRequeue(failedDeletes,failedChanges); }
+	LOG(DEBUG) << "TMSITable flushed"<<LOGVAR2("deleted",deleted.size())<<LOGVAR2("changed",changed.size())
+		<<LOGVAR2("failed",failedDeletes.size()+failedChanges.size());
+	return true;
+}
+
+// The transaction failed, so mark everything we took out of the shards to be written again next time.
+void TMSITable::tmsiTabRequeue(const vector<string> &deleted, const vector<TmsiRecord> &changed) const
+{
+	LOG(ERR) << "TMSI table write failed, will retry"<<LOGVAR2("deleted",deleted.size())<<LOGVAR2("changed",changed.size());
+	for (vector<string>::const_iterator it = deleted.begin(); it != deleted.end(); it++) {
+		TmsiShard &shard = imsiShard(*it);
+		ScopedLock lock(shard.mLock);
+		shard.mDeleted.insert(*it);
+	}
+	for (vector<TmsiRecord>::const_iterator it = changed.begin(); it != changed.end(); it++) {
+		TmsiShard &shard = imsiShard(it->imsi);
+		ScopedLock lock(shard.mLock);
+		if (findRecord(shard,it->imsi)) { shard.mDirty.insert(it->imsi); }
+	}
+}
+
+void TMSITable::tmsiTabFlush()
+{
+	ScopedLock lock(mFlushLock);
+	tmsiTabFlushLocked();
+}
+
+void TMSITable::writeBehindLoop()
+{
+	while (!mStopping) {
+		msleep(gConfig.getNum("Control.TMSITable.WriteBehind"));
+		tmsiTabFlush();
+	}
 }
 
 
@@ -289,28 +594,60 @@ int TMSITable::tmsiTabOpen(const char* wPath)
 	//        However, sqlite3_db_filename is not available in Ubuntu 12.04. Removing dependence for now.
 	LOG(DEBUG) << "TEST sqlite3_db_filename:"<< wPath;//sqlite3_db_filename(mTmsiDB,"main");
 	tmsiTabInit();
+	if (!tmsiTabPrepare()) {
+		LOG(EMERG) << "TMSITable changes will not be saved to " << wPath;
+	}
+	mWriteBehindThread.start((void*(*)(void*))writeBehindAdapter,this);
+	mWriteBehindStarted = true;
     return 0;
 }
 
 TMSITable::~TMSITable()
 {
-	if (mTmsiDB) sqlite3_close(mTmsiDB);
+	// Stop the write-behind first so it cannot use the database after it is closed.
+	if (mWriteBehindStarted) {
+		mStopping = true;
+		mWriteBehindThread.join();
+	}
+	ScopedLock lock(mFlushLock);
+	if (mTmsiDB) {
+		tmsiTabFlushLocked();
+		if (mInsertStmt) sqlite3_finalize(mInsertStmt);
+		if (mUpdateStmt) sqlite3_finalize(mUpdateStmt);
+		if (mDeleteStmt) sqlite3_finalize(mDeleteStmt);
+		mInsertStmt = mUpdateStmt = mDeleteStmt = NULL;
+		sqlite3_close(mTmsiDB);
+		mTmsiDB = NULL;
+	}
 }
 
 bool TMSITable::dropTmsi(uint32_t tmsi)
 {
-	char query[100];
 	LOG(DEBUG) << "Removing TMSITable entry for"<<LOGVAR(tmsi);
-	snprintf(query,100,"DELETE FROM TMSI_TABLE WHERE TMSI == %d",tmsi2table(tmsi));
-	return runQuery(query,1);
+	string imsi;
+	if (!findImsi(tmsi,imsi)) {
+		LOG(ERR) << "TMSI table has no entry for"<<LOGHEX(tmsi);
+		return false;
+	}
+	return dropImsi(imsi.c_str());
 }
 
 bool TMSITable::dropImsi(const char *imsi)
 {
-	char query[100];
 	LOG(DEBUG) << "Removing TMSITable entry for"<<LOGVAR(imsi);
-	snprintf(query,100,"DELETE FROM TMSI_TABLE WHERE IMSI == '%s'",imsi);
-	return runQuery(query,1);
+	TmsiShard &shard = imsiShard(imsi);
+	ScopedLock lock(shard.mLock);
+	TmsiRecord *rec = findRecord(shard,imsi);
+	if (!rec) {
+		LOG(ERR) << "TMSI table has no entry for"<<LOGVAR(imsi);
+		return false;
+	}
+	unindexTmsi(rec->tmsi);
+	shard.mRecords.erase(rec->imsi);
+	shard.mDirty.erase(rec->imsi);
+	shard.mDeleted.insert(rec->imsi);
+	delete rec;
+	return true;
 }
 
 
@@ -326,78 +663,31 @@ void TMSITable::tmsiTabSetAuthAndAssign(string imsi,int auth, int assigned)
 // This does nothing if the IMSI is not found in the table.
 void TMSITable::tmsiTabSetRejected(string imsi,int rejectCode)
 {
-	char query[100];
-	snprintf(query,100,"UPDATE TMSI_TABLE SET AUTH=0,REJECT_CODE=%d WHERE IMSI == '%s'",rejectCode,imsi.c_str());
-	runQuery(query,1);
-}
-
-struct TSqlString : public string {
-	char buf[100];
-	void appendf(const char *fmt,int val) { snprintf(buf,100,fmt,val); append(buf); }
-	void appendf(const char *fmt,const char *val) { snprintf(buf,100,fmt,val); append(buf); }
-	void appendf(const char *fmt,string val) { snprintf(buf,100,fmt,val.c_str()); append(buf); }
-	void appendf(const char *fmt,const char *a,string b) { snprintf(buf,100,fmt,a,b.c_str()); append(buf); }
-	void appendf(const char *fmt,const char *a,int b) { snprintf(buf,100,fmt,a,b); append(buf); }
-	//void addc(const char *name) { if (cnt++) append(","); append(name); }
-	//void addci(int ival) { if (cnt++) append(","); appendf("%d",ival); }
-	//void addcs(string sval) { if (cnt++) append(","); appendf("'%s'",sval.c_str()); }
-	TSqlString() { reserve(150); }
-};
-
-struct TSqlQuery : public TSqlString {
-	virtual void addc(const char *name,unsigned ival) = 0;
-	virtual void addc(const char *name,string sval) = 0;
-	virtual void finish() = 0;
-	void addStore(TmsiTableStore *store);
-};
-
-struct TSqlUpdate : public TSqlQuery {
-	Int_z cnt;		// Count of commas.
-	void addc(const char *name,string sval) {
-		if (cnt++) this->append(",");
-		this->appendf("%s='%s'",name,sval);
-	}
-	void addc(const char *name,unsigned ival) {
-		if (cnt++) this->append(",");
-		this->appendf("%s=%u",name,ival);
-	}
-	void finish() {}
-};
-
-struct TSqlInsert : public TSqlQuery {
-	TSqlString values;
-	Int_z cnt;		// Count of commas.
-	void addc(const char *name, string sval) {
-		if (cnt++) { this->append(","); values.append(","); }
-		this->append(name);
-		values.appendf("'%s'",sval);
+	TmsiShard &shard = imsiShard(imsi);
+	ScopedLock lock(shard.mLock);
+	if (TmsiRecord *rec = findRecord(shard,imsi)) {
+		rec->auth = AuthUnauthorized;
+		rec->rejectCode = rejectCode;
+		shard.mDirty.insert(imsi);
 	}
-	void addc(const char *name, unsigned ival) {
-		if (cnt++) { this->append(","); values.append(","); }
-		this->append(name);
-		values.appendf("%u",ival);
-	}
-	void finish() {
-		append(") VALUES (");
-		append(this->values);
-		append(")");
-	}
-};
+}
 
-// Flush anything that has changed out to the TMSI table in this SQL query.
-void TSqlQuery::addStore(TmsiTableStore *store)
+// Copy anything that has changed in the store into the record.  Return the number of fields changed.
+unsigned TMSITable::applyStore(TmsiRecord &rec, TmsiTableStore *store)
 {
-	if (store->imei_changed) { addc("IMEI",store->imei); store->imei_changed = false; }
-	if (store->auth_changed) { addc("AUTH",store->auth); store->auth_changed = false; }
-	if (store->authExpiry_changed) { addc("AUTH_EXPIRY",store->authExpiry); store->authExpiry_changed = false; }
-	if (store->rejectCode_changed) { addc("REJECT_CODE",store->rejectCode); store->rejectCode_changed = false; }
-	if (store->assigned_changed) { addc("TMSI_ASSIGNED",store->assigned); store->assigned_changed = false; }
-	if (store->a5support_changed) { addc("A5_SUPPORT",store->a5support); store->a5support_changed = false; }
-	if (store->powerClass_changed) { addc("POWER_CLASS",store->powerClass); store->powerClass_changed = false; }
-	if (store->kc_changed) { addc("kc",store->kc); store->kc_changed = false; }
-	if (store->associatedUri_changed) { addc("ASSOCIATED_URI",store->associatedUri); store->associatedUri_changed = false; }
-	if (store->assertedIdentity_changed) { addc("ASSERTED_IDENTITY",store->assertedIdentity); store->assertedIdentity_changed = false; }
-	if (store->welcomeSent_changed) { addc("WELCOME_SENT",store->welcomeSent); store->welcomeSent_changed = false; }
+	unsigned cnt = 0;
+	if (store->imei_changed) { rec.imei = store->imei; store->imei_changed = false; cnt++; }
+	if (store->auth_changed) { rec.auth = store->auth; store->auth_changed = false; cnt++; }
+	if (store->authExpiry_changed) { rec.authExpiry = store->authExpiry; store->authExpiry_changed = false; cnt++; }
+	if (store->rejectCode_changed) { rec.rejectCode = store->rejectCode; store->rejectCode_changed = false; cnt++; }
+	if (store->assigned_changed) { rec.tmsiAssigned = store->assigned; store->assigned_changed = false; cnt++; }
+	if (store->a5support_changed) { rec.a5support = store->a5support; store->a5support_changed = false; cnt++; }
+	if (store->powerClass_changed) { rec.powerClass = store->powerClass; store->powerClass_changed = false; cnt++; }
+	if (store->kc_changed) { rec.kc = store->kc; store->kc_changed = false; cnt++; }
+	if (store->associatedUri_changed) { rec.associatedUri = store->associatedUri; store->associatedUri_changed = false; cnt++; }
+	if (store->assertedIdentity_changed) { rec.assertedIdentity = store->assertedIdentity; store->assertedIdentity_changed = false; cnt++; }
+	if (store->welcomeSent_changed) { rec.welcomeSent = store->welcomeSent; store->welcomeSent_changed = false; cnt++; }
+	return cnt;
 }
 
 
@@ -410,18 +700,22 @@ unsigned TMSITable::allocateTmsi()
 	if (configTmsiTestMode()) {
 		// Deliberately over-write an existing entry to create a TMSI collision.
 		// Must use at least two phones - the second one will be assigned the same tmsi as the first.
-		sqlQuery q8(mTmsiDB,"TMSI_TABLE","TMSI","");	// Returns all the table rows one by one.
-		if (q8.sqlSuccess() == false) {
+		unsigned victim = 0;
+		for (unsigned i = 0; i < cNumShards && !victim; i++) {
+			ScopedLock lock(mTmsiIndex[i].mLock);
+			map<uint32_t,string> &imsiOf = mTmsiIndex[i].mImsiOf;
+			for (map<uint32_t,string>::iterator it = imsiOf.begin(); it != imsiOf.end(); it++) {
+				if (tmsiIsValid(tmsi2table(it->first))) { victim = it->first; break; }
+			}
+		}
+		if (victim == 0) {
 			WATCH("TMSI table is empty");
 		} else {
-			int rawtmsi = q8.getResultInt();
-			if (tmsiIsValid(rawtmsi)) {
-				unsigned tmsi = table2tmsi(rawtmsi);
-				WATCH("TMSI table test mode: created deliberate tmsi collision for"<<LOGVAR(tmsi));
-				// We must delete the existing entry or we will not be able to reassign it.
-				dropTmsi(tmsi);
-				return tmsi;
-			}
+			unsigned tmsi = victim;
+			WATCH("TMSI table test mode: created deliberate tmsi collision for"<<LOGVAR(tmsi));
+			// We must delete the existing entry or we will not be able to reassign it.
+			dropTmsi(tmsi);
+			return tmsi;
 		}
 	}
 
@@ -439,8 +733,8 @@ unsigned TMSITable::allocateTmsi()
 		if (tmsi < 1000) { tmsi += 1000; }
 		WATCH("testing"<<LOGVAR(tmsi)<<LOGVAR(seed));
 		if (tmsi == 0) continue;
-		sqlQuery q7(mTmsiDB,"TMSI_TABLE","TMSI","TMSI",tmsi2table(tmsi));
-		if (0 == q7.sqlSuccess()) { break; }
+		string unused;
+		if (! findImsi(tmsi,unused)) { break; }
 	} 
 	return tmsi;
 }
@@ -449,14 +743,17 @@ void TMSITable::tmsiTabUpdate(string imsi, TmsiTableStore *store)
 {
 	LOG(INFO) << "update entry for"<<LOGVAR(imsi) <<LOGVAR(store->auth_changed)<<LOGVAR(store->auth)<<LOGVAR(store->assigned_changed)<<LOGVAR(store->assigned);
 
-	ScopedLock lock(sTmsiMutex,__FILE__,__LINE__); // This lock should be redundant - sql serializes access, but it may prevent sql retry failures.
-	TSqlUpdate q1;
-	q1.append("UPDATE TMSI_TABLE SET ");
-	q1.addStore(store);
-	if (! q1.cnt) { return; }	// Nothing changed.
-	q1.addc("ACCESSED",(unsigned)time(NULL));
-	q1.appendf(" WHERE IMSI='%s'",imsi);	// You must include the quotes around IMSI
-	runQuery(q1.c_str(),true);
+	TmsiShard &shard = imsiShard(imsi);
+	ScopedLock lock(shard.mLock);
+	TmsiRecord *rec = findRecord(shard,imsi);
+	TmsiRecord unused;
+	if (! applyStore(rec ? *rec : unused,store)) { return; }	// Nothing changed.
+	if (!rec) {
+		LOG(ERR) << "TMSI table update failed, no entry for"<<LOGVAR(imsi);
+		return;
+	}
+	rec->accessed = (unsigned)time(NULL);
+	shard.mDirty.insert(imsi);
 }
 
 // Update or create a new entry in the TMSI table.
@@ -477,28 +774,13 @@ uint32_t TMSITable::tmsiTabCreateOrUpdate(
 	bool sendTmsis = configSendTmsis();
 	unsigned now = (unsigned)time(NULL);
 
-	ScopedLock lock(sTmsiMutex,__FILE__,__LINE__); // This lock should be redundant - sql serializes access, but it may prevent sql retry failures.
+	ScopedLock lock(sTmsiMutex,__FILE__,__LINE__); // Serializes tmsi allocation.
 
 	unsigned oldRawTmsi = tmsiTabGetTMSI(imsi,false);
 	bool isNewRecord = (oldRawTmsi == 0);
-
-	TSqlQuery *queryp;	// dufus language
-	TSqlInsert foo;
-	TSqlUpdate bar;
-	if (isNewRecord) {
-		// Create a new record.
-		queryp = &foo; queryp->reserve(200);
-		queryp->append("INSERT INTO TMSI_TABLE (");
-		queryp->addc("IMSI",imsi);
-		queryp->addc("CREATED",now);
-		queryp->addc("ACCESSED",now);
-	} else {
-		queryp = &bar; queryp->reserve(200);
-		// Update existing record.
-		queryp->append("UPDATE TMSI_TABLE SET ");
-	}
 	uint32_t tmsi = 0;
 
+	// The tmsi is chosen before taking the shard lock because allocateTmsi may drop another record.
 	if (sendTmsis) {
 		// We are handling several cases here.  If it is a new record we are allocating a new tmsi for the first time,
 		// or if it is an existing record that was created without an assigned tmsi, ie, it has a fake tmsi,
@@ -508,44 +790,44 @@ uint32_t TMSITable::tmsiTabCreateOrUpdate(
 		if (! tmsiIsValid(oldRawTmsi)) {
 			gReports.incr("OpenBTS.GSM.MM.TMSI.Assigned");
 			tmsi = allocateTmsi();
-			queryp->addc("TMSI",tmsi2table(tmsi));
 		} else {
 			tmsi = oldRawTmsi;
 		}
 	} else {
 		if (isNewRecord) {
-			// We are creating a new record.
-			// sqlite3 would auto-assign a unique TMSI higher than any other in
-			// the table, but we need to handle the initial case for the first fake tmsi.
+			// We are creating a new record; we need a unique fake tmsi for the primary key.
 			tmsi = ++sHighestFakeTmsi;
-			queryp->addc("TMSI",tmsi2table(tmsi));
 		}
 	}
-	queryp->addStore(store);
 
-	if (isNewRecord && lai) {
-		queryp->addc("OLD_MCC",lai->MCC());
-		queryp->addc("OLD_MNC",lai->MNC());
-		queryp->addc("OLD_LAC",lai->LAC());
-		queryp->addc("OLD_TMSI",oldTmsi);
-		queryp->finish();
-	} else {
-		queryp->append(format(" WHERE IMSI=='%s'",imsi));
+	TmsiShard &shard = imsiShard(imsi);
+	ScopedLock slock(shard.mLock);
+	TmsiRecord *rec = findRecord(shard,imsi);
+	if (!rec) {
+		// Create a new record.  It is also possible that someone dropped the entry since we looked.
+		if (tmsi == 0) { tmsi = ++sHighestFakeTmsi; }
+		rec = new TmsiRecord;
+		rec->imsi = imsi;
+		rec->created = rec->accessed = now;
+		rec->mSerial = ++shard.mNextSerial;
+		if (lai) {
+			rec->haveOld = true;
+			rec->oldMcc = lai->MCC();
+			rec->oldMnc = lai->MNC();
+			rec->oldLac = lai->LAC();
+			rec->oldTmsi = oldTmsi;
+		}
+		shard.mRecords[imsi] = rec;
+		isNewRecord = true;
 	}
-
-	if (!runQuery(queryp->c_str(),1)) {
-		LOG(ALERT) << "TMSI creation failed for"<<LOGVAR(imsi)<<" query:"<<*queryp;
-		return 0;
+	applyStore(*rec,store);
+	if (tmsi && tmsi != rec->tmsi) {
+		if (rec->tmsi) { unindexTmsi(rec->tmsi); }
+		rec->tmsi = tmsi;
+		indexTmsi(tmsi,imsi);
 	}
+	shard.mDirty.insert(imsi);
 	LOG(INFO) << (isNewRecord ? "new" : "updated") <<" entry for"<<LOGVAR(imsi)<<LOGHEX(tmsi);
-
-	if (sendTmsis) {	// double check to make sure the database entry made it.
-		unsigned tmsicheck;
-		if (!sqlite3_single_lookup(mTmsiDB,"TMSI_TABLE","IMSI",imsi.c_str(),"TMSI",tmsicheck) || table2tmsi(tmsicheck) != tmsi) {
-			LOG(ERR) << "TMSI database inconsistancy"<<LOGVAR(imsi)<<LOGVAR(tmsi)<<LOGVAR(tmsicheck);
-			return 0;
-		}
-	}
 	return tmsi;
 }
 
@@ -661,28 +943,24 @@ uint32_t TMSITable::assign(const string imsi, const GSM::L3LocationAreaIdentity
 
 
 
-// Update timestamp by TMSI.
-void TMSITable::tmsiTabTouchTmsi(unsigned TMSI) const
+// Update the timestamp.  The caller holds the shard lock.
+void TMSITable::tmsiTabTouch(TmsiShard &shard, TmsiRecord *rec) const
 {
-	char query[100];
-	snprintf(query,100,"UPDATE TMSI_TABLE SET ACCESSED = %u WHERE TMSI == %d", (unsigned)time(NULL),tmsi2table(TMSI));
-	runQuery(query);
-}
-
-// Update timestamp by IMSI.
-void TMSITable::tmsiTabTouchImsi(string IMSI) const
-{
-	char query[100];
-	snprintf(query,100,"UPDATE TMSI_TABLE SET ACCESSED = %u WHERE IMSI == '%s'", (unsigned)time(NULL),IMSI.c_str());
-	runQuery(query);
+	rec->accessed = (unsigned)time(NULL);
+	shard.mDirty.insert(rec->imsi);
 }
 
 void TMSITable::tmsiTabReallocationComplete(unsigned TMSI) const
 {
-	ScopedLock lock(sTmsiMutex,__FILE__,__LINE__); // This lock should be redundant - sql serializes access, but it may prevent sql retry failures.
-	char query[100];
-	snprintf(query,100,"UPDATE TMSI_TABLE SET TMSI_ASSIGNED = 1 WHERE TMSI == %d",tmsi2table(TMSI));
-	runQuery(query);
+	string imsi;
+	if (!findImsi(TMSI,imsi)) { return; }
+	TmsiShard &shard = imsiShard(imsi);
+	ScopedLock lock(shard.mLock);
+	TmsiRecord *rec = findRecord(shard,imsi);
+	if (rec && rec->tmsi == TMSI) {
+		rec->tmsiAssigned = 1;
+		shard.mDirty.insert(imsi);
+	}
 }
 
 
@@ -690,16 +968,18 @@ void TMSITable::tmsiTabReallocationComplete(unsigned TMSI) const
 bool TMSITable::tmsiTabGetStore(string imsi, TmsiTableStore *store) const
 {
 	store->store_valid = true;	// We have either updated the store or confirmed the imsi does not exist in the TMSI_TABLE.
-	sqlQuery q11(mTmsiDB,"TMSI_TABLE","AUTH,AUTH_EXPIRY,TMSI_ASSIGNED,REJECT_CODE,WELCOME_SENT", "IMSI",imsi.c_str());
-	if (!q11.sqlSuccess()) {
-		LOG(INFO) << "No TMSI_TABLE table entry for"<<LOGVAR(imsi) <<LOGVAR2("query",q11.mQueryString);
+	TmsiShard &shard = imsiShard(imsi);
+	ScopedLock lock(shard.mLock);
+	TmsiRecord *rec = findRecord(shard,imsi);
+	if (!rec) {
+		LOG(INFO) << "No TMSI_TABLE table entry for"<<LOGVAR(imsi);
 		return false;
 	}
-	store->auth = (Authorization) q11.getResultInt(0);			//store->auth_valid = true;
-	store->authExpiry = q11.getResultInt(1);	//store->authExpiry_valid = true;
-	store->assigned = q11.getResultInt(2);		//store->assigned_valid = true;
-	store->rejectCode = q11.getResultInt(3);	//store->rejectCode_valid = true;
-	store->welcomeSent = q11.getResultInt(4);	//store->welcomeSent_valid = true;
+	store->auth = rec->auth;
+	store->authExpiry = rec->authExpiry;
+	store->assigned = rec->tmsiAssigned;
+	store->rejectCode = rec->rejectCode;
+	store->welcomeSent = rec->welcomeSent;
 	LOG(DEBUG) <<LOGVAR2("auth",store->auth)<<LOGVAR2("authExpiry",store->authExpiry)
 		<<LOGVAR2("assigned",store->assigned)<<LOGVAR2("rejectCode",store->rejectCode)<<LOGVAR2("welcomSent",store->welcomeSent);
 	return true;
@@ -709,45 +989,48 @@ bool TMSITable::tmsiTabGetStore(string imsi, TmsiTableStore *store) const
 string TMSITable::tmsiTabGetIMSI(unsigned tmsi, unsigned *pAuthorizationResult) const
 {
 	string imsi;
-	if (pAuthorizationResult) tmsiTabTouchTmsi(tmsi);
-	sqlQuery q4(mTmsiDB,"TMSI_TABLE","IMSI,AUTH", "TMSI",tmsi2table(tmsi));
-	if (!q4.sqlSuccess()) {
-		if (pAuthorizationResult) { *pAuthorizationResult = 0; }
-	} else {
-		imsi = q4.getResultText(0);
-		int auth = q4.getResultInt(1);
-		if (pAuthorizationResult) { *pAuthorizationResult = auth; }
-		LOG(DEBUG) <<LOGVAR(tmsi) <<LOGVAR(imsi) <<LOGVAR(auth);
+	unsigned auth = 0;
+	if (findImsi(tmsi,imsi)) {
+		TmsiShard &shard = imsiShard(imsi);
+		ScopedLock lock(shard.mLock);
+		TmsiRecord *rec = findRecord(shard,imsi);
+		if (rec && rec->tmsi == tmsi) {
+			auth = rec->auth;
+			if (pAuthorizationResult) { tmsiTabTouch(shard,rec); }
+			LOG(DEBUG) <<LOGVAR(tmsi) <<LOGVAR(imsi) <<LOGVAR(auth);
+		} else {
+			imsi.clear();	// The entry changed since we looked in the index.
+		}
 	}
+	if (pAuthorizationResult) { *pAuthorizationResult = auth; }
 	return imsi;
 }
 
 unsigned TMSITable::tmsiTabCheckAuthorization(string imsi) const
 {
-	tmsiTabTouchImsi(imsi);
-	unsigned auth = 0;
-	if (! sqlite3_single_lookup(mTmsiDB,"TMSI_TABLE","IMSI",imsi.c_str(),"AUTH",auth)) {
-		return 0;	// If IMSI not found, unauthorized.
-	}
-	return auth;
+	TmsiShard &shard = imsiShard(imsi);
+	ScopedLock lock(shard.mLock);
+	TmsiRecord *rec = findRecord(shard,imsi);
+	if (!rec) { return 0; }	// If IMSI not found, unauthorized.
+	tmsiTabTouch(shard,rec);
+	return rec->auth;
 }
 
 // If onlyIfKnown only return the TMSI if the handset has received and acknowleged it.
 // Note that if onlyIfKnown is false, this may return invalid TMSIs; the caller must check validity.
 unsigned TMSITable::tmsiTabGetTMSI(const string imsi, bool onlyIfKnown) const
 {
-	ScopedLock lock(sTmsiMutex,__FILE__,__LINE__); // This lock should be redundant - sql serializes access, but it may prevent sql retry failures.
-	sqlQuery q3(mTmsiDB,"TMSI_TABLE","TMSI,TMSI_ASSIGNED", "IMSI",imsi.c_str());
-	if (! q3.sqlSuccess()) {
+	TmsiShard &shard = imsiShard(imsi);
+	ScopedLock lock(shard.mLock);
+	TmsiRecord *rec = findRecord(shard,imsi);
+	if (!rec) {
 		LOG(DEBUG) << "not found"<<LOGVAR(imsi);
 		return 0;
-	} else {
-		LOG(DEBUG) << "found"<<LOGVAR(imsi)<<LOGVAR(onlyIfKnown)<<LOGVAR(q3.getResultInt(0))<<LOGVAR(q3.getResultInt(1));
-		int rawtmsi = q3.getResultInt(0);	// the returned tmsi.
-		int tmsiAssigned = q3.getResultInt(1);	// true if the tmsi has been sent to the handset in a tmsi assignment.
-		if (onlyIfKnown && tmsiAssigned == 0) { return 0; }
-		return table2tmsi(rawtmsi);		// the returned tmsi.
 	}
+	LOG(DEBUG) << "found"<<LOGVAR(imsi)<<LOGVAR(onlyIfKnown)<<LOGHEX2("tmsi",rec->tmsi)<<LOGVAR2("assigned",rec->tmsiAssigned);
+	// tmsiAssigned is true if the tmsi has been sent to the handset in a tmsi assignment.
+	if (onlyIfKnown && rec->tmsiAssigned == 0) { return 0; }
+	return rec->tmsi;
 }
 
 
@@ -795,6 +1078,9 @@ vector< vector<string> > TMSITable::tmsiTabView(int verbosity, bool rawFlag, uns
 	vector<string> headers = stringSplit(vh1,header1.c_str());
 	view.push_back(headers);
 
+	// The view is read from the database, so first write out anything not there yet.
+	ScopedLock lock(mFlushLock);
+	tmsiTabFlushLocked();
 	string columns = replaceAll(header1," ",",");
 	sqlQuery query(mTmsiDB,"TMSI_TABLE",columns.c_str(),"ORDER BY ACCESSED DESC");	// descending
 	unsigned nrows = 1;
@@ -908,13 +1194,16 @@ void TMSITable::setIMEI(string IMSI, string IMEI)
 
 bool TMSITable::classmark(const char* IMSI, const GSM::L3MobileStationClassmark2& classmark)
 {
-	int A5Bits = classmark.getA5Bits();
-	char query[100];
-	snprintf(query,100,
-		"UPDATE TMSI_TABLE SET A5_SUPPORT=%u,ACCESSED=%u,POWER_CLASS=%u "
-		" WHERE IMSI=\"%s\"",
-		A5Bits,(unsigned)time(NULL),classmark.powerClass(),IMSI);
-	runQuery(query,1);
+	TmsiShard &shard = imsiShard(IMSI);
+	ScopedLock lock(shard.mLock);
+	TmsiRecord *rec = findRecord(shard,IMSI);
+	if (!rec) {
+		LOG(ERR) << "TMSI table has no entry for"<<LOGVAR(IMSI);
+		return true;
+	}
+	rec->a5support = classmark.getA5Bits();
+	rec->powerClass = classmark.powerClass();
+	tmsiTabTouch(shard,rec);
 	return true;
 }
 
@@ -930,9 +1219,13 @@ unsigned getPreferredA5Algorithm(unsigned A5Bits)
 
 int TMSITable::tmsiTabGetPreferredA5Algorithm(const char* IMSI)
 {
-	sqlQuery query(mTmsiDB,"TMSI_TABLE","A5_SUPPORT", "IMSI",IMSI);
-	if (!query.sqlSuccess()) return 0;
-	int cm = query.getResultInt(0);
+	TmsiShard &shard = imsiShard(IMSI);
+	int cm;
+	{	ScopedLock lock(shard.mLock);
+		TmsiRecord *rec = findRecord(shard,IMSI);
+		if (!rec) return 0;
+		cm = rec->a5support;
+	}
 #if 0
 	char query[200];
 	snprintf(query,200, "SELECT A5_SUPPORT from TMSI_TABLE WHERE IMSI=\"%s\"", IMSI);
@@ -994,20 +1287,23 @@ void TMSITable::putKc(const char* imsi, string Kc, string pAssociatedUri, string
 
 string TMSITable::getKc(const char* IMSI) const
 {
-	string Kcs;
-	if (!sqlite_single_lookup( mTmsiDB, "TMSI_TABLE", "IMSI", IMSI, "kc", Kcs)) {
-		LOG(ERR) << "sqlite3_single_lookup failed to find kc for " << IMSI;
+	TmsiShard &shard = imsiShard(IMSI);
+	ScopedLock lock(shard.mLock);
+	TmsiRecord *rec = findRecord(shard,IMSI);
+	if (!rec) {
+		LOG(ERR) << "TMSI table has no entry to find kc for " << IMSI;
 		return "";
 	}
-	return Kcs;
+	return rec->kc;
 }
 
 void TMSITable::getSipIdentities(string imsi, string &pAssociatedUri,string &pAssertedIdentity) const
 {
-	sqlQuery query(mTmsiDB, "TMSI_TABLE", "ASSOCIATED_URI,ASSERTED_IDENTITY", "IMSI", imsi.c_str());
-	if (query.sqlResultSize() == 2) {
-		pAssociatedUri = query.getResultText(0);
-		pAssertedIdentity = query.getResultText(1);
+	TmsiShard &shard = imsiShard(imsi);
+	ScopedLock lock(shard.mLock);
+	if (TmsiRecord *rec = findRecord(shard,imsi)) {
+		pAssociatedUri = rec->associatedUri;
+		pAssertedIdentity = rec->assertedIdentity;
 	}
 	LOG(DEBUG) <<LOGVAR(imsi) <<LOGVAR(pAssociatedUri) <<LOGVAR(pAssertedIdentity);
 }
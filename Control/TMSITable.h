@@ -20,6 +20,8 @@
 #define TMSITABLE_H
 
 #include <map>
+#include <set>
+#include <string>
 #include <vector>
 
 #include <Timeval.h>
@@ -28,6 +30,7 @@
 
 
 struct sqlite3;
+struct sqlite3_stmt;
 
 namespace GSM {
 class L3LocationAreaIdentity;
@@ -40,7 +43,6 @@ namespace Control {
 using namespace std;
 class MMSharedData;
 class TMSITable;
-class TSqlQuery;
 
 enum Authorization {
 	AuthUnauthorized,
@@ -51,7 +53,6 @@ enum Authorization {
 
 class TmsiTableStore {
 	friend class TMSITable;
-	friend class TSqlQuery;
 
 	Bool_z store_valid;	// Set when we have either updated the store or confirmed the imsi does not exist in the TMSI_TABLE.
 	string imei;                Bool_z imei_changed;
@@ -98,13 +99,84 @@ class TmsiTableStore {
 	string getImei() { return imei; }
 };
 
+// The in-memory copy of one TMSI_TABLE row.
+// RRLP_STATUS, DEG_LAT, DEG_LONG and PTMSI_ASSIGNED are not used by anything so they are not cached;
+// the write-behind never writes them, so whatever is in the database for them is preserved.
+struct TmsiRecord {
+	string imsi;
+	uint32_t tmsi;				// May be a fake tmsi, see tmsiIsValid.
+	string imei;
+	unsigned created, accessed;
+	int a5support, powerClass;
+	bool haveOld;				// The OLD_ fields are known.  They are only written when the row is inserted.
+	unsigned oldTmsi;
+	int oldMcc, oldMnc, oldLac;
+	string kc, associatedUri, assertedIdentity;
+	int welcomeSent;
+	Authorization auth;
+	int authExpiry, rejectCode, tmsiAssigned;
+
+	unsigned mSerial;			// Distinguishes this record from a later one for the same IMSI.
+	bool mInDB;					// The row exists in the TMSI_TABLE, so the write-behind updates it instead of inserting.
+
+	TmsiRecord() : tmsi(0), created(0), accessed(0), a5support(0), powerClass(0), haveOld(false), oldTmsi(0),
+		oldMcc(0), oldMnc(0), oldLac(0), welcomeSent(0), auth(AuthUnauthorized), authExpiry(0), rejectCode(0),
+		tmsiAssigned(0), mSerial(0), mInDB(false) {}
+};
+
+// One shard of the records, selected by a hash of the IMSI.
+struct TmsiShard {
+	typedef map<string,TmsiRecord*> RecordMap;
+	Mutex mLock;
+	RecordMap mRecords;
+	set<string> mDirty;			// IMSIs of records changed since the last flush.
+	set<string> mDeleted;		// IMSIs whose rows must be deleted from the TMSI_TABLE.
+	unsigned mNextSerial;
+	TmsiShard() : mNextSerial(0) {}
+};
+
+// One shard of the TMSI to IMSI index, selected by the TMSI.
+struct TmsiIndexShard {
+	Mutex mLock;
+	map<uint32_t,string> mImsiOf;
+};
+
+// The TMSI table is kept in memory, which is the primary copy; all lookups and updates are done there
+// and a write-behind thread flushes the changes to the sqlite TMSI_TABLE in one transaction every
+// Control.TMSITable.WriteBehind milliseconds, so location updates never wait for sqlite.
+// If you must hold two locks, take the TmsiShard lock before the TmsiIndexShard lock.
 class TMSITable {
 
 	private:
 
+	static const unsigned cNumShards = 16;
+
 	sqlite3 *mTmsiDB;			///< database connection
+	sqlite3_stmt *mInsertStmt, *mUpdateStmt, *mDeleteStmt;	///< cached statements for the write-behind
+	mutable Mutex mFlushLock;	///< Serializes flushes and every other direct use of the database.
+	mutable TmsiShard mShards[cNumShards];
+	mutable TmsiIndexShard mTmsiIndex[cNumShards];
+	Thread mWriteBehindThread;
+	bool mWriteBehindStarted;
+	volatile bool mStopping;	///< Tells the write-behind thread to exit.
+
 	void tmsiTabCleanup();
 	void tmsiTabInit();
+	void tmsiTabLoad();
+	bool tmsiTabPrepare();
+	bool tmsiTabFlushLocked() const;
+	void tmsiTabRequeue(const vector<string> &deleted, const vector<TmsiRecord> &changed) const;
+	void writeBehindLoop();
+	static void *writeBehindAdapter(TMSITable *table) { table->writeBehindLoop(); return NULL; }
+
+	TmsiShard &imsiShard(const string &imsi) const;
+	TmsiIndexShard &tmsiShard(uint32_t tmsi) const { return mTmsiIndex[tmsi % cNumShards]; }
+	TmsiRecord *findRecord(TmsiShard &shard, const string &imsi) const;
+	bool findImsi(uint32_t tmsi, string &imsi) const;
+	void indexTmsi(uint32_t tmsi, const string &imsi);
+	void unindexTmsi(uint32_t tmsi);
+	unsigned applyStore(TmsiRecord &rec, TmsiTableStore *store);
+	bool runSql(const char *query, int checkChanges=0) const;
 
 
 	public:
@@ -117,7 +189,7 @@ class TMSITable {
 	std::string mTablePath;			///< The path used to create the table.
 	int tmsiTabOpen(const char* wPath);
 
-	TMSITable() : mTmsiDB(0) {}
+	TMSITable() : mTmsiDB(0), mInsertStmt(0), mUpdateStmt(0), mDeleteStmt(0), mWriteBehindStarted(false), mStopping(false) {}
 	~TMSITable();
 
 	/**
@@ -140,9 +212,9 @@ class TMSITable {
 
 	/**
 		Find an IMSI in the table.
-		This is a log-time operation.
+		This is a log-time lookup in memory.
 		@param TMSI The TMSI to find.
-		@return Pointer to IMSI to be freed by the caller, or NULL.
+		@return The IMSI, or an empty string.
 	*/
 	bool tmsiTabGetStore(string imsi, TmsiTableStore *store) const;
 	std::string tmsiTabGetIMSI(unsigned TMSI, unsigned *pAuthorizationResult) const;
@@ -150,7 +222,7 @@ class TMSITable {
 
 	/**
 		Find a TMSI in the table.
-		This is a linear-time operation.
+		This is a log-time lookup in memory.
 		@param IMSI The IMSI to mach.
 		@return A TMSI value or zero on failure.
 	*/
@@ -166,6 +238,9 @@ class TMSITable {
 	// Clear the authorization cache.
 	void tmsiTabClearAuthCache();
 
+	/** Write all pending changes to the database now. */
+	void tmsiTabFlush();
+
 	/** Set the IMEI. */
 	//void setIMEI(string IMSI, string IMEI);
 
@@ -191,13 +266,13 @@ class TMSITable {
 
 	void getSipIdentities(string imsi, string &pAssociatedUri,string &pAssertedIdentity) const;
 
-	bool runQuery(const char *query,int checkChanges=0) const;
+	/** Run an arbitrary query on the database, then reload the in-memory table from it. */
+	bool runQuery(const char *query,int checkChanges=0);
 	private:
 	bool tmsiTabCheckVersion();
 
-	/** Update the "accessed" time on a record. */
-	void tmsiTabTouchTmsi(unsigned TMSI) const;
-	void tmsiTabTouchImsi(string IMSI) const;
+	/** Update the "accessed" time on a record; the caller holds the shard lock. */
+	void tmsiTabTouch(TmsiShard &shard, TmsiRecord *rec) const;
 };
 
 
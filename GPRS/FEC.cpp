@@ -103,6 +103,7 @@ void PDCHL1FEC::mchStart() {
 void PDCHL1FEC::mchStop() {
 	getRadio()->setSlot(TN(),Transceiver::I);
 	mchOldFec->setGPRS(false,NULL);
+	gBTS.chanReleased(mchLogChan);
 }
 
 PDCHL1FEC::PDCHL1FEC(TCHFACCHLogicalChannel *wlogchan) :
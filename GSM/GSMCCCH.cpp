@@ -24,6 +24,9 @@
 #include <L3TranEntry.h>	// For NewTransactionTable.
 #include <MAC.h>
 #include <math.h>
+#include <deque>
+#include <queue>
+#include <algorithm>
 
 using namespace Control;
 using namespace GPRS;
@@ -115,11 +118,127 @@ class IterableQueue {
 	}
 };
 
+// GSM 05.02 clause 7 table 5 of 9: the first frame of CCCH blocks B0..B8 within the 51-multiframe.
+// A combined (C-V) beacon has only B0..B2.
+static const unsigned sCcchBlockFN[9] = { 6, 12, 16, 22, 26, 32, 36, 42, 46 };
+
+// Pages are queued by CCCH_GROUP and PAGING_GROUP, GSM 05.02 6.5.2, so each page is sent only in
+// the paging blocks its MS listens to in DRX mode.  The first BS_AG_BLKS_RES CCCH blocks of each
+// 51-multiframe are reserved for AGCH; the rest are paging blocks, and paging group
+// (mf * mBlocksPerMF + block) is paging block 'block' in 51-multiframes where (FN div 51) mod BS_PA_MFRMS == mf.
+// A GPRS MS still in its non-DRX period, before mDrxBegin, listens to every paging block, so its pages
+// go out in the next paging block of any group.
 class PagingQ {
+	typedef std::deque<NewPagingEntry*> PageList;
+	Mutex mLock;
+	unsigned mBS_CC_CHANS;		///< number of CCCH timeslots
+	unsigned mBS_PA_MFRMS;		///< 51-multiframes per paging cycle
+	unsigned mAgBlocks;			///< CCCH blocks reserved for AGCH, BS_AG_BLKS_RES
+	unsigned mBlocksPerMF;		///< paging blocks per 51-multiframe on each CCCH
+	unsigned mN;				///< paging groups per CCCH, N in GSM 05.02 6.5.2
+	std::vector<PageList> mQ;	///< indexed by ccchGroup*mN + pagingGroup
+	PageList mNonDrx;			///< GPRS pages for MS in non-DRX mode
+	unsigned mLoad;
+
+	// Caller holds mLock.  gControlChannelDescription is static config, created in gsmInit.
+	void pqInit() {
+		if (mN) { return; }
+		assert(gControlChannelDescription);
+		mBS_CC_CHANS = countBeaconTimeslots(gControlChannelDescription->mCCCH_CONF);
+		mBS_PA_MFRMS = gControlChannelDescription->mBS_PA_MFRMS;
+		unsigned ccchBlocks = gControlChannelDescription->isCCCHCombined() ? 3 : 9;
+		mAgBlocks = gControlChannelDescription->mBS_AG_BLKS_RES;
+		if (mAgBlocks >= ccchBlocks) {
+			// The MS would find no paging blocks at all; keep one so pages are still sent somewhere.
+			LOG(ALERT) << "GSM.CCCH.BS_AG_BLKS_RES=" << mAgBlocks << " leaves no paging blocks in " << ccchBlocks
+				<< " CCCH blocks, using " << ccchBlocks-1 << " for paging";
+			mAgBlocks = ccchBlocks - 1;
+		}
+		mBlocksPerMF = ccchBlocks - mAgBlocks;
+		mN = mBlocksPerMF * mBS_PA_MFRMS;
+		mQ.resize(mBS_CC_CHANS * mN);
+	}
+
+	// Caller holds mLock.
+	bool inNonDrx(const NewPagingEntry *npe) {
+		return npe->mGprsClient && gBTS.time() < Time(npe->mDrxBegin);
+	}
+
+	PageList &queueFor(unsigned ccchGroup, unsigned pagingGroup) {
+		assert(ccchGroup < mBS_CC_CHANS && pagingGroup < mN);
+		return mQ[ccchGroup*mN + pagingGroup];
+	}
+
 	public:
-	InterthreadQueue<NewPagingEntry> mPageQ;
-	void addPage(NewPagingEntry *npe) { mPageQ.write(npe); }
-	unsigned getPagingLoad() { return mPageQ.size(); }
+	PagingQ() : mBS_CC_CHANS(0), mBS_PA_MFRMS(0), mAgBlocks(0), mBlocksPerMF(0), mN(0), mLoad(0) {}
+
+	/** Map the frame number of a paging block and its index within the 51-multiframe to the paging group it serves. */
+	unsigned pagingGroup(int32_t FN, unsigned blockIndex) {
+		ScopedLock lock(mLock);
+		pqInit();
+		return ((FN / 51) % mBS_PA_MFRMS) * mBlocksPerMF + blockIndex;
+	}
+
+	/** Fill in the reverse index of frame number to paging block index for one CCCH, -1 if not a paging block. */
+	void pagingBlocks(int revPCH[51]) {
+		ScopedLock lock(mLock);
+		pqInit();
+		for (int i = 0; i < 51; i++) { revPCH[i] = -1; }
+		for (unsigned b = 0; b < mBlocksPerMF; b++) { revPCH[sCcchBlockFN[mAgBlocks+b]] = b; }
+	}
+
+	void addPage(NewPagingEntry *npe) {
+		ScopedLock lock(mLock);
+		pqInit();
+		mLoad++;
+		if (inNonDrx(npe)) {
+			mNonDrx.push_back(npe);
+			return;
+		}
+		unsigned imsiMod = npe->getImsiMod1000() % (mBS_CC_CHANS * mN);
+		queueFor(imsiMod / mN, imsiMod % mN).push_back(npe);
+	}
+
+	/** Remove the pages for the next paging block of this group: up to 4 GSM pages, or a single GPRS message. */
+	bool getPages(unsigned ccchGroup, unsigned pagingGroup, std::vector<NewPagingEntry*> &pages) {
+		ScopedLock lock(mLock);
+		pqInit();
+		// A GPRS page for an MS in non-DRX mode goes in the first paging block, whatever the group.
+		// Once its DRX period has begun it moves to its own group like any other page.
+		while (mNonDrx.size()) {
+			NewPagingEntry *npe = mNonDrx.front();
+			mNonDrx.pop_front();
+			if (inNonDrx(npe)) {
+				pages.push_back(npe);
+				mLoad--;
+				return true;
+			}
+			unsigned imsiMod = npe->getImsiMod1000() % (mBS_CC_CHANS * mN);
+			queueFor(imsiMod / mN, imsiMod % mN).push_back(npe);
+		}
+		PageList &q = queueFor(ccchGroup,pagingGroup);
+		while (q.size() && pages.size() < 4) {
+			NewPagingEntry *npe = q.front();
+			if (npe->mGprsClient && pages.size()) { break; }
+			pages.push_back(npe);
+			q.pop_front();
+			mLoad--;
+			if (npe->mGprsClient) { break; }
+		}
+		return pages.size();
+	}
+
+	/** Return pages to the front of their queue, in order, for the next paging block of the group. */
+	void putBack(unsigned ccchGroup, unsigned pagingGroup, const std::vector<NewPagingEntry*> &pages) {
+		ScopedLock lock(mLock);
+		PageList &q = queueFor(ccchGroup,pagingGroup);
+		for (std::vector<NewPagingEntry*>::const_reverse_iterator it = pages.rbegin(); it != pages.rend(); it++) {
+			(inNonDrx(*it) ? mNonDrx : q).push_front(*it);
+			mLoad++;
+		}
+	}
+
+	unsigned getPagingLoad() { ScopedLock lock(mLock); return mLoad; }
 } gPagingQ;
 
 // Global linkage:
@@ -134,19 +253,30 @@ struct RachCompareAdapter {
 	// (pat) This is used when a RachInfo is placed in a priority_queue.
 	// Return true if rach1 should appear before rach2 in the priority_queue,
 	// meaning that rach2 will be serviced before rach1, since the stupid C++ priority_queue pops from the END of the queue.
-	bool operator()(const RachInfo *rach1, const RachInfo *rach2) {
-		assert(!rach1->mChan == !rach2->mChan);	// In any given queue, all raches have mChan, or none.
-		if (rach1->mChan) {
-			return rach1->mReadyTime > rach2->mReadyTime;
-		} else {
-			return rach1->mWhen > rach2->mWhen;
-		}
+	bool operator()(const RachInfo *rach1, const RachInfo *rach2) const {
+		if (rach1->mPriority != rach2->mPriority) { return rach1->mPriority > rach2->mPriority; }
+		return rach1->mWhen > rach2->mWhen;
 	}
 };
 
 
-// This queue holds RACHes of all types waiting to be serviced.
-InterthreadQueue<RachInfo> gRachq;
+// Calculate maximum number of frames of delay.
+static void computeMaxAge()
+{
+	bool isCCCHCombined = gControlChannelDescription->isCCCHCombined();
+	// See GSM 04.08 3.3.1.1.2 for the logic here.
+	unsigned txInteger = gConfig.getNum("GSM.RACH.TxInteger");
+	assert(txInteger <= 15);
+	// RACH slot definition: we see in GSM 5.02 clause 7 table 3 of 9 that a RACH can appear on timeslots 0,2,4, or 6, and in table 5 of 9 we
+	// see that for a non-combined CCCH-CONF any of the 51 frames can be used, and for combined CCCH-CONF the available (51*4=204 slots/51-multiframe)
+	// frames are: B4, B5, B14, B15 ... B36, B45, B46 (27*4=108 slots/51-multiframe.)
+	// GSM 4.08 11.1.1, And I quote: "The minimum value of this timer is equal to the time taken by T+2S slots of the mobile station's
+	// RACH. S and T are defined in sub-clause 3.3.1.2. The maximum value of this timer is 5 seconds."
+	int stval = GSM::RACHSpreadSlots[txInteger] + 2*(isCCCHCombined ? GSM::RACHWaitSParamCombined[txInteger] : GSM::RACHWaitSParam[txInteger]);
+	// Subtract some frames from the maxAge to make sure we still have time left to send it; the amount should be 4 frames
+	// plus some time for the MS to receive and decode it plus the slack induced by the OpenBTS tranceiver interface, which we do not know.
+	sMaxAge = min(stval, (int)(5 * 51 * 4.2)) - 6;
+}
 
 
 // The result is 3-state (LCH, !LCH and deleteMe==true, !LCH && deleteMe==false.)
@@ -212,19 +342,152 @@ static L2LogicalChannel *preallocateChForRach(RachInfo *rach, bool *deleteMe)
 	return LCH;
 }
 
-void enqueueRach(RachInfo *rip)
-{
-	// TODO: Phones next to the base station will include the operator's.
-	// We should service them first, even if they are just LUR.
+// The RACH stage sits between the RACH decoder and the CCCH service loops.
+// During a RACH storm, typically a flood of location updates when a neighbor cell goes down, allocating a channel
+// for each RACH on the decoder thread as it arrives hands the channels out first-come-first-served, and a burst
+// decoded twice or repeated with the same random reference gets a channel of its own.
+// Instead the stage collects the RACHes that arrive during one CCCH block, drops the duplicates,
+// and preallocates in order of establishment cause, so an emergency call or a page response is not
+// stuck behind a queue of LURs.  The CCCH service loops pull from the ready queue in the same order.
+class RachStage {
+	InterthreadQueue<RachInfo> mIncoming;	///< Raw RACHes from AccessGrantResponder.
+	Mutex mLock;							///< Protects mReady.
+	std::priority_queue<RachInfo*,std::vector<RachInfo*>,RachCompareAdapter> mReady;	///< Preallocated, waiting for an AGCH block.
+	struct RecentRach {
+		unsigned mRA; Time mWhen; int mTA;
+		RecentRach(const RachInfo *rach) : mRA(rach->mRA), mWhen(rach->mWhen), mTA(rach->initialTA()) {}
+	};
+	std::deque<RecentRach> mRecent;			///< Recently accepted RACHes for duplicate detection; only the stage thread touches it.
+	Thread mThread;
+	volatile bool mRunning;
+
+	// Forget the accepted RACHes that are too old to match anything in a batch whose oldest RACH arrived at oldest.
+	// The batches are taken in priority order, so mRecent is not in time order and every entry has to be checked.
+	void pruneRecent(int window, Time oldest) {
+		std::deque<RecentRach> keep;
+		for (std::deque<RecentRach>::const_iterator it = mRecent.begin(); it != mRecent.end(); it++) {
+			if ((oldest - it->mWhen) <= window) { keep.push_back(*it); }
+		}
+		mRecent.swap(keep);
+	}
+
+	bool isDuplicate(const RachInfo *rach, int window) {
+		if (window <= 0) { return false; }
+		for (std::deque<RecentRach>::const_iterator it = mRecent.begin(); it != mRecent.end(); it++) {
+			int age = rach->mWhen - it->mWhen;
+			int taDiff = it->mTA - rach->initialTA();
+			if (age >= -window && age <= window && it->mRA == rach->mRA && taDiff >= -1 && taDiff <= 1) { return true; }
+		}
+		mRecent.push_back(RecentRach(rach));
+		return false;
+	}
+
+	// RachCompareAdapter orders for the priority_queue, ie, backwards; sort wants it the other way round.
+	struct Inverse {
+		bool operator()(const RachInfo *rach1, const RachInfo *rach2) const { return RachCompareAdapter()(rach2,rach1); }
+	};
+
+	// Move one batch of RACHes from the incoming queue to the ready queue.
+	void processBatch(RachInfo *first) {
+		std::vector<RachInfo*> batch;
+		batch.push_back(first);
+		// If others are already waiting there is contention, so give the rest of this block's RACHes a chance
+		// to arrive and order them.  An AGCH block is 4 frames, so this costs no more than one CCCH opportunity.
+		// A lone RACH is preallocated at once.
+		if (mIncoming.size() || readySize()) { gBTS.clock().wait(gBTS.time() + 4); }
+		while (RachInfo *rach = mIncoming.readNoBlock()) { batch.push_back(rach); }
+
+		int window = gConfig.GSM.RACH.DuplicateWindow;
+		Time oldest = first->mWhen;
+		for (std::vector<RachInfo*>::iterator it = batch.begin(); it != batch.end(); it++) {
+			if ((*it)->mWhen < oldest) { oldest = (*it)->mWhen; }
+		}
+		pruneRecent(window,oldest);
+		std::sort(batch.begin(),batch.end(),Inverse());
+
+		for (std::vector<RachInfo*>::iterator it = batch.begin(); it != batch.end(); it++) {
+			RachInfo *rach = *it;
+			if (isDuplicate(rach,window)) {
+				LOG(INFO) << "dropping duplicate RACH " << *rach;
+				delete rach;
+				continue;
+			}
+			bool deleteMe = false;
+			preallocateChForRach(rach,&deleteMe);
+			if (deleteMe) {
+				delete rach;
+				continue;
+			}
+			ScopedLock lock(mLock);
+			mReady.push(rach);
+		}
+		if (batch.size() > 1) { LOG(DEBUG) << "RACH batch" <<LOGVAR2("size",batch.size()); }
+	}
+
+	public:
+	RachStage() : mRunning(false) {}
+
+	void rachStageServiceLoop() {
+		while (! gBTS.btsShutdown()) {
+			RachInfo *first = mIncoming.read();	// Blocks.
+			processBatch(first);
+		}
+	}
+
+	void start();
+
+	void add(RachInfo *rip) { mIncoming.write(rip); }
+
+	// Return the most urgent RACH ready for assignment, or NULL.
+	RachInfo *getReady() {
+		ScopedLock lock(mLock);
+		if (mReady.empty()) { return NULL; }
+		RachInfo *rach = mReady.top();
+		mReady.pop();
+		return rach;
+	}
 
-	bool deleteMe = false;
-	preallocateChForRach(rip,&deleteMe);
-	if (deleteMe) {
-		delete rip;
-		return;
+	// Return the next ready RACH only if it also has a preallocated channel, so the caller can pair it in an extended assignment.
+	RachInfo *getReadyDedicated() {
+		ScopedLock lock(mLock);
+		if (mReady.empty() || mReady.top()->mChan == NULL) { return NULL; }
+		RachInfo *rach = mReady.top();
+		mReady.pop();
+		return rach;
 	}
 
-	gRachq.write(rip);
+	size_t readySize() {
+		ScopedLock lock(mLock);
+		return mReady.size();
+	}
+
+	size_t size() {
+		ScopedLock lock(mLock);
+		return mReady.size() + mIncoming.size();
+	}
+} gRachStage;
+
+static void *RachStageServiceLoopAdapter(RachStage *stage)
+{
+	stage->rachStageServiceLoop();
+	return NULL;
+}
+
+void RachStage::start()
+{
+	if (mRunning) { return; }
+	mRunning = true;
+	// The CCCH service loops compute this too, but they may not be running yet.
+	computeMaxAge();
+	mThread.start((void*(*)(void*))RachStageServiceLoopAdapter,this);
+}
+
+void RachStageStart() { gRachStage.start(); }
+
+
+void enqueueRach(RachInfo *rip)
+{
+	gRachStage.add(rip);
 }
 
 // This queue holds ImmediateAssignments sent from GPRS waiting be serviced.
@@ -241,7 +504,7 @@ IterableQueue<NewPagingEntry*> gGprsCcchMessageQ;
 int getAGCHLoad()
 {
 	int result = 0;
-		result += gRachq.size();
+		result += gRachStage.size();
 	return result + gGprsCcchMessageQ.getSize();
 }
 
@@ -265,9 +528,20 @@ int getAGCHPending() { return 0; }
 
 
 // Return true if the CCCH frame was used.
+// Note the RACH and Immediate Assignment times on the channel for the call setup trace.
+// This is done before the assignment is queued so the ESTABLISH can not beat it.
+static void traceImmediateAssignment(L2LogicalChannel *LCH, const RachInfo *rach)
+{
+	CallTraceChannel &trace = LCH->mChanTrace;
+	trace.ctcRachFN = rach->mWhen.FN();
+	trace.ctcRach = gBTS.clock().systime(rach->mWhen);
+	trace.ctcImmAssign = timef();
+	trace.ctcEstablish = 0;
+}
+
 bool CCCHLogicalChannel::processRaches()
 {
-	while (RachInfo *rach = gRachq.readNoBlock())
+	while (RachInfo *rach = gRachStage.getReady())
 	{
 		Time now = gBTS.time();
 		int age = now - rach->mWhen;	// The result is number of frames and could be negative.
@@ -353,6 +627,35 @@ bool CCCHLogicalChannel::processRaches()
 
 		// TODO: Update T3101.
 
+		// If another handset is also waiting for a dedicated channel, assign both in this block.
+		if (gConfig.GSM.CCCH.ImmediateAssignmentExtended) {
+			while (RachInfo *rach2 = gRachStage.getReadyDedicated()) {
+				if (now - rach2->mWhen > sMaxAge) {
+					LOG(WARNING) << "ignoring RACH burst with age " << (now - rach2->mWhen);
+					rach2->mChan->l2sendp(L3_HARDRELEASE_REQUEST);
+					delete rach2;
+					continue;
+				}
+				int initialTA2 = rach2->initialTA();
+				gReports.incr("OpenBTS.GSM.RR.RACH.TA.Accepted",(int)(initialTA2));
+				L3ImmediateAssignmentExtended assign2(
+					L3RequestReference(rach->mRA,rach->mWhen),
+					LCH->channelDescription(),
+					L3TimingAdvance(initialTA),
+					L3RequestReference(rach2->mRA,rach2->mWhen),
+					rach2->mChan->channelDescription(),
+					L3TimingAdvance(initialTA2)
+				);
+				LOG(INFO) << "sending " << assign2;
+				traceImmediateAssignment(LCH,rach);
+				traceImmediateAssignment(rach2->mChan,rach2);
+				L2LogicalChannelBase::l2sendm(assign2,L3_UNIT_DATA);
+				delete rach;
+				delete rach2;
+				return true;	// We used this CCCH.
+			}
+		}
+
 		L3ImmediateAssignment assign(
 			L3RequestReference(rach->mRA,rach->mWhen),
 			LCH->channelDescription(),
@@ -376,6 +679,7 @@ bool CCCHLogicalChannel::processRaches()
 			LOG(INFO) << "sending L3ImmediateAssignment " << LCH->descriptiveString() <<LOGVAR(msecsDelay) <<" " <<assign;
 		}
 
+		traceImmediateAssignment(LCH,rach);
 		L2LogicalChannelBase::l2sendm(assign,L3_UNIT_DATA);
 		delete rach;
 		return true;	// We used this CCCH.
@@ -384,32 +688,83 @@ bool CCCHLogicalChannel::processRaches()
 }
 
 
-// Simplified version for public release
-bool CCCHLogicalChannel::processPages()
+// Send the pages waiting for this paging group, packing as many as fit into one message, GSM 04.08 9.1.22-9.1.24:
+// Type 3 carries four TMSIs, Type 2 two TMSIs plus one mobile ID of any type, Type 1 two mobile IDs of any type.
+bool CCCHLogicalChannel::processPages(unsigned pagingGroup)
 {
-	while (NewPagingEntry *npe1 = gPagingQ.mPageQ.readNoBlock()) {
+	std::vector<NewPagingEntry*> pages;
+	if (! gPagingQ.getPages(mCcchGroup,pagingGroup,pages)) { return false; }	// CCCH unused.
+
+	std::vector<NewPagingEntry*> sent, unsent;
+	if (pages[0]->mGprsClient) {	// Is it a GPRS page?
+		NewPagingEntry *npe1 = pages[0];
 		LOG(DEBUG)<<LOGVAR(npe1);
-		if (npe1->mGprsClient) {	// Is it a GPRS page?
-			// Add 51 to the frame time because the message because the MS may be on the other 51-multiframe.
-			Time future(mCcchNextWriteTime + 52);
-			if (! sendGprsCcchMessage(npe1,future)) {
-				delete npe1;	// In the incredibly unlikely event that the above failed, just give up.
-				continue;
+		// Add 51 to the frame time because the message because the MS may be on the other 51-multiframe.
+		Time future(mCcchNextWriteTime + 52);
+		if (! sendGprsCcchMessage(npe1,future)) {
+			delete npe1;	// In the incredibly unlikely event that the above failed, just give up.
+			return false;
+		}
+		sent.push_back(npe1);
+	} else {
+		L3MobileIdentity ids[4];
+		std::vector<unsigned> byTmsi, other;
+		for (unsigned i = 0; i < pages.size(); i++) {
+			LOG(DEBUG)<<LOGVAR(pages[i]);
+			ids[i] = pages[i]->getMobileId();
+			(ids[i].isTMSI() ? byTmsi : other).push_back(i);
+		}
+		std::vector<unsigned> use;	// Indices into pages of the ones going in this message.
+		if (byTmsi.size() == 4) {
+			uint32_t tmsis[4];
+			ChannelType types[4];
+			for (unsigned i = 0; i < 4; i++) {
+				tmsis[i] = ids[i].TMSI();
+				types[i] = pages[i]->getGsmChanType();
+				use.push_back(i);
 			}
+			L3PagingRequestType3 page3(tmsis,types);
+			L2LogicalChannelBase::l2sendm(page3,L3_UNIT_DATA);
+		} else if (byTmsi.size() >= 2) {
+			unsigned t1 = byTmsi[0], t2 = byTmsi[1];
+			L3PagingRequestType2 page2(ids[t1].TMSI(),pages[t1]->getGsmChanType(),ids[t2].TMSI(),pages[t2]->getGsmChanType());
+			use.push_back(t1);
+			use.push_back(t2);
+			if (byTmsi.size() > 2 || other.size()) {
+				unsigned t3 = byTmsi.size() > 2 ? byTmsi[2] : other[0];
+				page2.mobileID3(ids[t3],pages[t3]->getGsmChanType());
+				use.push_back(t3);
+			}
+			L2LogicalChannelBase::l2sendm(page2,L3_UNIT_DATA);
+		} else if (pages.size() >= 2) {
+			L3PagingRequestType1 page1(ids[0],pages[0]->getGsmChanType(),ids[1],pages[1]->getGsmChanType());
+			use.push_back(0);
+			use.push_back(1);
+			L2LogicalChannelBase::l2sendm(page1,L3_UNIT_DATA);
 		} else {
-			const L3MobileIdentity& id1 = npe1->getMobileId();
-			ChannelType type1 = npe1->getGsmChanType();
-			L3PagingRequestType1 page1(id1,type1);
+			L3PagingRequestType1 page1(ids[0],pages[0]->getGsmChanType());
+			use.push_back(0);
 			L2LogicalChannelBase::l2sendm(page1,L3_UNIT_DATA);
 		}
-		if (++npe1->mSendCount < 2) {	// Send each page twice.
-			gPagingQ.mPageQ.write_front(npe1);	// Put it back for resend in the next multiframe.
+		for (unsigned i = 0; i < pages.size(); i++) {
+			if (std::find(use.begin(),use.end(),i) != use.end()) {
+				sent.push_back(pages[i]);
+			} else {
+				unsent.push_back(pages[i]);
+			}
+		}
+	}
+
+	// Pages that did not fit go first next time, then the ones we just sent get their second transmission.
+	for (std::vector<NewPagingEntry*>::iterator it = sent.begin(); it != sent.end(); it++) {
+		if (++(*it)->mSendCount < 2) {	// Send each page twice.
+			unsent.push_back(*it);
 		} else {
-			delete npe1;
+			delete *it;
 		}
-		return true;
 	}
-	return false;	// CCCH unused.
+	if (unsent.size()) { gPagingQ.putBack(mCcchGroup,pagingGroup,unsent); }
+	return true;
 }
 
 
@@ -425,9 +780,9 @@ bool CCCHLogicalChannel::ccchServiceQueue()
 
 	// Is this CCCH used for pages?  We determine this by looking at the frame number within the 51-multiframe.
 	int paging_block_index = mRevPCH[mCcchNextWriteTime.FN() % 51];
-
-
-	if (paging_block_index >= 0 && processPages()) { return true; }
+	if (paging_block_index >= 0) {
+		if (processPages(gPagingQ.pagingGroup(mCcchNextWriteTime.FN(),paging_block_index))) { return true; }
+	}
 
 	// We did not use this CCCH for a page, so lets look for something else to send.
 	if (processRaches()) {
@@ -475,26 +830,11 @@ void CCCHLogicalChannel::ccchServiceLoop()
 	static const L3PagingRequestType1 filler;
 	static const L3Frame idleFrame(filler,L3_UNIT_DATA);
 
-	bool isCCCHCombined = gControlChannelDescription->isCCCHCombined();
 	// TODO: Send idle frame to transceiver.
 
-	// Calculate maximum number of frames of delay.
-	// See GSM 04.08 3.3.1.1.2 for the logic here.
-	static const unsigned txInteger = gConfig.getNum("GSM.RACH.TxInteger");
-	assert(txInteger <= 15);
-	// RACH slot definition: we see in GSM 5.02 clause 7 table 3 of 9 that a RACH can appear on timeslots 0,2,4, or 6, and in table 5 of 9 we
-	// see that for a non-combined CCCH-CONF any of the 51 frames can be used, and for combined CCCH-CONF the available (51*4=204 slots/51-multiframe)
-	// frames are: B4, B5, B14, B15 ... B36, B45, B46 (27*4=108 slots/51-multiframe.)
-	// GSM 4.08 11.1.1, And I quote: "The minimum value of this timer is equal to the time taken by T+2S slots of the mobile station's
-	// RACH. S and T are defined in sub-clause 3.3.1.2. The maximum value of this timer is 5 seconds."
-	static const int stval = GSM::RACHSpreadSlots[txInteger] + 2*(isCCCHCombined ? GSM::RACHWaitSParamCombined[txInteger] : GSM::RACHWaitSParam[txInteger]);
-	// Subtract some frames from the maxAge to make sure we still have time left to send it; the amount should be 4 frames
-	// plus some time for the MS to receive and decode it plus the slack induced by the OpenBTS tranceiver interface, which we do not know.
-	sMaxAge = min(stval, (int)(5 * 51 * 4.2)) - 6;
-
-	for (int i = 0; i < 51; i++) { mRevPCH[i] = -1; }	// -1 means not used for paging.
+	computeMaxAge();
 
-		mRevPCH[16] = 0;
+	gPagingQ.pagingBlocks(mRevPCH);	// -1 means not used for paging.
 
 	int cnt = 0;
 	while (! gBTS.btsShutdown()) {
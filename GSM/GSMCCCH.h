@@ -64,7 +64,7 @@ class CCCHLogicalChannel : public NDCCHLogicalChannel
 	Thread mServiceThread;	///< a thread for the service loop
 	GSM::Time mCcchNextWriteTime;	///< Indicates frame currently being serviced.
 
-	int mRevPCH[51]; // Reverse index of frame number to paging block number, B0 .. B8.
+	int mRevPCH[51]; // Reverse index of frame number to paging block index among the paging blocks of the 51-multiframe.
 
 	public:
 
@@ -76,8 +76,7 @@ class CCCHLogicalChannel : public NDCCHLogicalChannel
 	void sendReject(RachInfo *rach, int priority);
 	void sendRawReject(RachInfo *rach, int delaysecs);	// Testing routine.
 	bool processRaches();
-	bool processPages(
-		);
+	bool processPages(unsigned pagingGroup);
 	bool sendGprsCcchMessage(Control::NewPagingEntry *gprsMsg, GSM::Time &frameTime);
 
 	ChannelType chtype() const { return CCCHType; }
@@ -91,6 +90,7 @@ extern int getPCHLoad();
 extern int getAGCHPending();
 extern unsigned getT3122();
 extern void enqueueRach(RachInfo *rip);
+extern void RachStageStart();
 
 }; // namespace
 #endif // GSMCCCH_H
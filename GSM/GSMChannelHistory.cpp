@@ -23,15 +23,20 @@
 #include "NeighborTable.h"
 #include "GSMChannelHistory.h"
 #include "GSML1FEC.h"
+#include "GSMMeasurementEngine.h"
 
 namespace GSM {
 
 // Return the averaged RXLEV from the serving BTS as reported by the handset.
+// This is averaged over the last GSM.Handover.RXLEV_DL.History reports by the measurement engine.
 int ChannelHistory::getAvgRxlev()
 {
-	ScopedLock lock(mSCellLock);
-	FrameNum now = gBTS.time().FN();
-	return round(ComputeTrend(mSCellData,now,&SCellPoint::getFrameNum,&SCellPoint::getRxlev,gConfig.GSM.Handover.RXLEV_DL.History));
+	return round(gMeasurementEngine.meAvgServingRxlev(mMeasSlot));
+}
+
+float ChannelHistory::getAvgRxqual()
+{
+	return gMeasurementEngine.meAvgServingRxqual(mMeasSlot);
 }
 
 
@@ -71,7 +76,8 @@ void NeighborHistory::nhAddPoint(NCellPoint &npt, FrameNum now)
 {
 	ScopedLock lock(nhLock);
 	nhList.push_front(npt);		// This makes a copy of npt.
-	int maxlen = gConfig.GSM.Handover.History.Max;
+	// nhGetAvgRxlev only looks at the newest RXLEV_DL.History points, so keep no more than that.
+	int maxlen = gConfig.GSM.Handover.RXLEV_DL.History;
 	while ((int)nhList.size() > maxlen) { nhList.pop_back(); }
 	// Throw away points that are too old.
 	int maxage = (1+maxlen) * 2*52;		// Each report requires 2 * 52-multiframes, 480ms.
@@ -82,22 +88,6 @@ void NeighborHistory::nhAddPoint(NCellPoint &npt, FrameNum now)
 	}
 }
 
-void ChannelHistory::chAddPoint(SCellPoint &spt, FrameNum now)
-{
-	LOG(DEBUG) << LOGVAR(spt.scpFrame) << LOGVAR(now);
-	ScopedLock lock(mSCellLock);
-	mSCellData.push_front(spt);
-	int maxlen = gConfig.GSM.Handover.History.Max;
-	while ((int)mSCellData.size() > maxlen) { mSCellData.pop_back(); }
-	// Throw away points that are too old.
-	int maxage = (1+maxlen) * 2*52;		// Each report requires 2 * 52-multiframes, 480ms.
-	while (mSCellData.size()) {
-		SCellPoint &bk = mSCellData.back();
-		if (FNDelta(now,bk.scpFrame) > maxage) { mSCellData.pop_back(); continue; }
-		break;
-	}
-}
-
 // Find the neighbor with the highest RXLEV.
 // If none, the mValid in the result will be false.
 Control::BestNeighbor ChannelHistory::neighborFindBest(Control::NeighborPenalty penalty)
@@ -169,17 +159,11 @@ bool ChannelHistory::neighborAddMeasurements(SACCHLogicalChannel* SACCH,const L3
 
 	this->mReportTimestamp++;
 
-	{	SCellPoint spt;
-		spt.scpFrame = sampleTime.FN();
-		// These are reported by the handset.
-		spt.scpValid = measurements->isServingCellValid();
-		if (spt.scpValid) {
-			spt.scpRxlev = measurements->RXLEV_FULL_SERVING_CELL_dBm();
-			spt.scpRxqual  = measurements->RXQUAL_FULL_SERVING_CELL();
-		} else {
-			spt.scpRxlev = -1000;	// Impossible value.
-			spt.scpRxqual  = 8;		// Impossible value.
-		}
+	// Save the serving cell measurements reported by the handset.
+	if (measurements->isServingCellValid()) {
+		gMeasurementEngine.meAddReport(mMeasSlot,true,measurements->RXLEV_FULL_SERVING_CELL_dBm(),measurements->RXQUAL_FULL_SERVING_CELL());
+	} else {
+		gMeasurementEngine.meAddReport(mMeasSlot,false,0,0);
 	}
 
 	// Save the RXLEV for the neighbors.
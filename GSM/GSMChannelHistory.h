@@ -108,24 +108,6 @@ class NeighborHistory {
 	void nhText(string &result,bool full);
 };
 
-// Serving Cell Data Point
-struct SCellPoint {
-	// Max age: 32 reports, each SACCH frame requiring 2 * 52-multiframes each, approximately 16 seconds, plus slop.
-	//const int cMaxAgeFrames = 32 * 2 * 52 + (2*52-1);
-
-	// The measurement report scales rxlev; this is post scaled, ie, actual db.
-	FrameNum scpFrame;		// When the report was received in GSM frame numbers.
-
-	bool scpValid;			// Measurements from MS were valid in this report.
-	int scpRxlev;			// serving cell RXLEV reported by MS.  Value is negative in dB.
-	int scpRxqual;			// value is 0-7.  GSM5.08 8.2.24:  0 is good, 7 is BER > 12.8%
-	public:
-	FrameNum getFrameNum() { return scpFrame; }
-	int getRxlev(bool &valid) { valid=scpValid; return scpRxlev; }
-
-};
-typedef std::deque<SCellPoint> SCellPointList;
-
 // GSM 5.08 A3.1 specifies BSS processing of measurement reports and recommended. operator control parameters.
 // We are required to save 32 samples.
 
@@ -144,15 +126,15 @@ class ChannelHistory {
 	typedef std::map<unsigned,NeighborHistory> NeighborMap;
 	NeighborMap mNeighborData;
 
-	// The most recent point is on the front of the vector.
-	SCellPointList mSCellData;
-	mutable Mutex mSCellLock;
-
-	void chAddPoint(SCellPoint &spt,FrameNum now);
+	// The serving cell reports are kept by the measurement engine, in our slot.
+	int mMeasSlot;
 
 	//int cNumReports;	// Neighbor must appear in 2 of last cNumReports measurement reports.
 	Int_z mReportTimestamp;	// Incremented each time a report arrives.
 	public:
+	ChannelHistory() : mMeasSlot(-1) {}
+	void setMeasSlot(int slot) { mMeasSlot = slot; }
+
 	unsigned makeKey(unsigned arfcn, unsigned BSIC) { return (arfcn<<6) + BSIC; }
 	void crackKey(unsigned key, unsigned *arfcn, unsigned *BSIC) { *BSIC = key & 0x3f; *arfcn = key>>6; }
 
@@ -166,6 +148,7 @@ class ChannelHistory {
 
 	// Routines to return the accumulated data.
 	int getAvgRxlev();	// Doesnt hurt to round the return to an int.
+	float getAvgRxqual();
 };
 
 };
@@ -19,6 +19,7 @@
 
 #include <OpenBTSConfig.h>
 #include <math.h>
+#include <errno.h>
 #include "GSMCommon.h"
 
 using namespace GSM;
@@ -220,36 +221,64 @@ ostream& GSM::operator<<(ostream& os, const Time& t)
 
 
 
+int64_t Clock::monotonicNs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return 1000000000LL*ts.tv_sec + ts.tv_nsec;
+}
+
+
 void Clock::clockSet(const Time& when)
 {
-	ScopedLock lock(mLock);
-	mBaseTime = Timeval(0);
+	int64_t nowNs = monotonicNs();
+	Timeval now;
+	__sync_fetch_and_add(&mSeq,1);		// odd: readers retry.  Also a full barrier.
+	mBaseTime = now;
+	mBaseNs = nowNs;
 	mBaseFN = when.FN();
+	__sync_fetch_and_add(&mSeq,1);		// even again
 	isValid = true;
 }
 
 
+void Clock::readBase(int32_t &baseFN, Timeval &baseTime, int64_t &baseNs) const
+{
+	while (1) {
+		unsigned seq = mSeq;
+		__sync_synchronize();
+		baseFN = mBaseFN;
+		baseTime = mBaseTime;
+		baseNs = mBaseNs;
+		__sync_synchronize();
+		if (!(seq & 1) && seq == mSeq) { return; }
+	}
+}
+
+
 int32_t Clock::FN() const
 {
-	ScopedLock lock(mLock);
-	Timeval now;
-	int32_t deltaSec = now.sec() - mBaseTime.sec();
-	int32_t deltaUSec = now.usec() - mBaseTime.usec();
-	int64_t elapsedUSec = 1000000LL*deltaSec + deltaUSec;
-	int64_t elapsedFrames = elapsedUSec / gFrameMicroseconds;
-	int32_t currentFN = (mBaseFN + elapsedFrames) % gHyperframe;
+	int32_t baseFN;
+	Timeval baseTime;
+	int64_t baseNs;
+	readBase(baseFN,baseTime,baseNs);
+	int64_t elapsedFrames = (monotonicNs() - baseNs) / (1000LL*gFrameMicroseconds);
+	int32_t currentFN = (baseFN + elapsedFrames) % gHyperframe;
 	return currentFN;
 }
 
 double Clock::systime(const GSM::Time& when) const
 {
-	ScopedLock lock(mLock);
+	int32_t baseFN;
+	Timeval baseTime;
+	int64_t baseNs;
+	readBase(baseFN,baseTime,baseNs);
 	const double slotMicroseconds = (48.0 / 13e6) * 156.25;
 	const double frameMicroseconds = slotMicroseconds * 8.0;
-	int32_t elapsedFrames = when.FN() - mBaseFN;
+	int32_t elapsedFrames = when.FN() - baseFN;
 	if (elapsedFrames<0) elapsedFrames += gHyperframe;
 	double elapsedUSec = elapsedFrames * frameMicroseconds + when.TN() * slotMicroseconds;
-	double baseSeconds = mBaseTime.sec() + mBaseTime.usec()*1e-6;
+	double baseSeconds = baseTime.sec() + baseTime.usec()*1e-6;
 	double st = baseSeconds + 1e-6*elapsedUSec;
 	return st;
 }
@@ -265,13 +294,25 @@ Timeval Clock::systime2(const GSM::Time& when) const
 
 void Clock::wait(const Time& when) const
 {
-	int32_t now = FN();
+	int32_t baseFN;
+	Timeval baseTime;
+	int64_t baseNs;
+	readBase(baseFN,baseTime,baseNs);
+	const int64_t frameNs = 1000LL*gFrameMicroseconds;
+	int64_t elapsedFrames = (monotonicNs() - baseNs) / frameNs;
+	int32_t now = (baseFN + elapsedFrames) % gHyperframe;
 	int32_t target = when.FN();
 	int32_t delta = FNDelta(target,now);
 	if (delta<1) return;
 	static const int32_t maxSleep = 51*26;
 	if (delta>maxSleep) delta=maxSleep;
-	sleepFrames(delta);
+	// Sleep to the absolute start of the target frame so that the time spent getting here,
+	// or a clockSet() in the meantime, does not add up across calls the way a relative sleep would.
+	int64_t deadlineNs = baseNs + (elapsedFrames+delta)*frameNs;
+	struct timespec deadline;
+	deadline.tv_sec = deadlineNs / 1000000000LL;
+	deadline.tv_nsec = deadlineNs % 1000000000LL;
+	while (clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,&deadline,NULL) == EINTR) {}
 }
 
 
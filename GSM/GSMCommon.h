@@ -25,6 +25,7 @@
 #include "Defines.h"
 #include <stdlib.h>
 #include <sys/time.h>
+#include <time.h>
 #include <ostream>
 #include <vector>
 
@@ -516,18 +517,28 @@ class Clock {
 
 	private:
 
+	// FN() is called by every encoder and service loop every frame, so readers take no lock.
+	// The base values are published under a sequence lock: clockSet() makes mSeq odd while
+	// it writes them and readers retry if mSeq was odd or changed while they read.
 	Bool_z isValid;
-	mutable Mutex mLock;
+	volatile unsigned mSeq;
 	int32_t mBaseFN;
-	Timeval mBaseTime;	// Defaults to now.
+	Timeval mBaseTime;	// Defaults to now.  Wall clock, used only by systime().
+	int64_t mBaseNs;	// CLOCK_MONOTONIC at mBaseTime, used for FN() and wait().
+
+	/** Read mBaseFN, mBaseTime and mBaseNs consistently. */
+	void readBase(int32_t &baseFN, Timeval &baseTime, int64_t &baseNs) const;
 
 	public:
 
 	Clock(const Time& when = Time(0))
-		:mBaseFN(when.FN())
+		:mSeq(0),mBaseFN(when.FN()),mBaseNs(monotonicNs())
 	{}
 
-	/** Set the clock to a value. */
+	/** Current CLOCK_MONOTONIC time in nanoseconds. */
+	static int64_t monotonicNs();
+
+	/** Set the clock to a value.  Only the thread handling the transceiver CLOCK indication calls this. */
 	void clockSet(const Time&);
 	bool isClockValid() { return isValid; }	// Dont need a semaphore for POD.
 
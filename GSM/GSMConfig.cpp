@@ -20,6 +20,7 @@
 #include "GSMTransfer.h"
 #include "GSMLogicalChannel.h"
 #include "GSMCCCH.h"
+#include "GSMMeasurementEngine.h"
 #include "GPRSExport.h"
 #include <ControlCommon.h>
 #include <Logger.h>
@@ -110,8 +111,11 @@ void GSMConfig::gsmStart()
 		GPRS::gprsStart();
 	}
 	gPowerManager.pmStart();
+	// All the SACCH exist by now.
+	gMeasurementEngine.meStart();
 	// Do not call this until the paging channels are installed.
 	PagerStart();
+	RachStageStart();
 
 	Control::l3start();	// (pat) For the L3 rewrite: start the L3 state machine dispatcher.
 }
@@ -152,6 +156,8 @@ void GSMConfig::regenerateBeacon()
 
 	// SI1
 	L3SystemInformationType1 *SI1 = new L3SystemInformationType1;
+	// The MS needs the Cell Allocation to decode the Mobile Allocation of a hopping channel.
+	if (gTRX.hopping()) SI1->cellChannelDescription(cellChannelDescription());
 	if (mSI1) delete mSI1;
 	mSI1 = SI1;
 	LOG(INFO) << *SI1;
@@ -247,137 +253,264 @@ size_t GSMConfig::AGCHLoad() { return getAGCHLoad(); }
 size_t GSMConfig::PCHLoad() { return getPCHLoad(); }
 
 
-template <class ChanType> ChanType* getChan(vector<ChanType*>& chanList, bool forGprs)
+int64_t ChanFreeList::nowMsecs()
 {
-	const unsigned sz = chanList.size();
-	LOG(DEBUG) << "sz=" << sz;
-	if (sz==0) return NULL;
+	Timeval now;
+	return 1000LL*now.sec() + now.usec()/1000;
+}
+
+void ChanFreeList::freeInsert(unsigned ix)
+{
+	if (mFree[mCN[ix]].insert(ix).second) { mNumFree++; }
+}
+
+void ChanFreeList::freeErase(unsigned ix)
+{
+	if (mFree[mCN[ix]].erase(ix)) { mNumFree--; }
+}
+
+void ChanFreeList::recycleAt(unsigned ix, long msecs)
+{
+	if (msecs < 0) { return; }	// Nothing to wait for; the channel comes back through chanReleased().
+	mRecycle.push(RecycleEntry(nowMsecs() + msecs, ix));
+}
+
+void ChanFreeList::add(L2LogicalChannel *chan)
+{
+	unsigned ix = mChans.size();
+	unsigned CN = chan->CN();
+	mChans.push_back(chan);
+	mIndex[chan] = ix;
+	mCN.push_back(CN);
+	if (mFree.size() <= CN) { mFree.resize(CN+1); mTotal.resize(CN+1); }
+	mTotal[CN]++;
+	recycleAt(ix,0);	// Checked on the first allocation.
+}
+
+bool ChanFreeList::chanReleased(L2LogicalChannel *chan)
+{
+	std::map<L2LogicalChannel*,unsigned>::const_iterator it = mIndex.find(chan);
+	if (it == mIndex.end()) { return false; }
+	ScopedLock lock(mReleasedLock);
+	mReleased.push_back(it->second);
+	return true;
+}
+
+void ChanFreeList::allocated(L2LogicalChannel *chan)
+{
+	std::map<L2LogicalChannel*,unsigned>::const_iterator it = mIndex.find(chan);
+	if (it == mIndex.end()) { return; }
+	freeErase(it->second);
+	recycleAt(it->second,chan->recycleWait());
+}
+
+// Move the channels that are due from mRecycle to mFree.
+void ChanFreeList::update()
+{
+	{
+		ScopedLock lock(mReleasedLock);
+		for (unsigned i = 0; i < mReleased.size(); i++) { recycleAt(mReleased[i],0); }
+		mReleased.clear();
+	}
+	int64_t now = nowMsecs();
+	while (mRecycle.size() && mRecycle.top().first <= now) {
+		unsigned ix = mRecycle.top().second;
+		mRecycle.pop();
+		L2LogicalChannel *chan = mChans[ix];
+		if (chan->inUseByGPRS()) { continue; }	// It comes back via chanReleased() when GPRS lets go.
+		long wait = chan->recycleWait();
+		if (wait == 0) {
+			freeInsert(ix);
+		} else if (wait > 0) {
+			mRecycle.push(RecycleEntry(now + wait, ix));
+		}
+	}
+}
+
+void ChanFreeList::rescan()
+{
+	for (unsigned ix = 0; ix < mChans.size(); ix++) {
+		if (!mChans[ix]->inUseByGPRS() && mChans[ix]->recyclable()) { freeInsert(ix); }
+	}
+	mNextRescan.future(1000);
+}
+
+// Return the pool index of the free channel to use, or -1.
+int ChanFreeList::choose(bool forGprs)
+{
+	if (mNumFree == 0) { return -1; }
 	// (pat) Dont randomize for GPRS!  GPRS requires that channels are returned
 	// in order for the initial channels allocated on C0.
-	// We shouldnt randomize at all because we want RR TCH to come from the
-	// front of the list and GPRS from the back.
-	unsigned pos = 0;
-	const char *configRandomize = "GSM.Channels.Randomize";
-	if (gConfig.defines(configRandomize)) {
-		if (forGprs) {
-			// If the parameter is 'required', the gConfig.remove fails, but dont print a zillion messages.
-			static bool once = true;
-			if (once) {
-				LOG(ALERT) << "Config parameter '" << configRandomize << "' is incompatible with GPRS, removed";
-				once = false;
+	if (gConfig.GSM.Channels.Randomize && forGprs) {
+		// If the parameter is 'required', the gConfig.remove fails, but dont print a zillion messages.
+		static bool once = true;
+		if (once) {
+			LOG(ALERT) << "Config parameter 'GSM.Channels.Randomize' is incompatible with GPRS, removed";
+			once = false;
+		}
+		gConfig.remove("GSM.Channels.Randomize");
+	}
+	int best = -1;
+	if (gConfig.GSM.Channels.Randomize && !forGprs) {
+		// The first free channel at or after a random point in the pool, as the old linear search did.
+		unsigned pos = random() % mChans.size();
+		for (unsigned CN = 0; CN < mFree.size(); CN++) {
+			std::set<unsigned>::const_iterator it = mFree[CN].lower_bound(pos);
+			if (it == mFree[CN].end()) { it = mFree[CN].begin(); }
+			if (it == mFree[CN].end()) { continue; }
+			// Distance from pos, wrapping around the pool.
+			if (best < 0 || (*it + mChans.size() - pos) % mChans.size() < (best + mChans.size() - pos) % mChans.size()) { best = *it; }
+		}
+		return best;
+	}
+	switch (forGprs ? 0 : gConfig.GSM.Channels.Placement) {
+	default:
+	case 0:		// pack: lowest pool index, which fills C0 first.
+		for (unsigned CN = 0; CN < mFree.size(); CN++) {
+			if (mFree[CN].size() && (best < 0 || (int)*mFree[CN].begin() < best)) { best = *mFree[CN].begin(); }
+		}
+		return best;
+	case 1: {	// spread: the ARFCN with the fewest channels of this type in use.
+		int bestBusy = 0;
+		for (unsigned CN = 0; CN < mFree.size(); CN++) {
+			if (mFree[CN].empty()) { continue; }
+			int busy = mTotal[CN] - mFree[CN].size();
+			if (best < 0 || busy < bestBusy) { best = *mFree[CN].begin(); bestBusy = busy; }
+		}
+		return best;
+	}
+	case 2: {	// quality: the free channel whose last occupant saw the lowest uplink FER.
+		// The FER is from the decoder statistics, which are kept until the channel is opened again.
+		float bestFER = 0;
+		for (unsigned CN = 0; CN < mFree.size(); CN++) {
+			for (std::set<unsigned>::const_iterator it = mFree[CN].begin(); it != mFree[CN].end(); it++) {
+				float fer = mChans[*it]->FER();
+				if (best < 0 || fer < bestFER) { best = *it; bestFER = fer; }
 			}
-			gConfig.remove(configRandomize);
-		} else {
-			pos = random() % sz;
 		}
+		return best;
 	}
-	for (unsigned i=0; i<sz; i++, pos = (pos+1)%sz) {
-		LOG(DEBUG) << "pos=" << pos << " " << i << "/" << sz;
-		ChanType *chan = chanList[pos];
-		if (! chan->inUseByGPRS() && chan->recyclable()) return chan;
+	}
+}
+
+L2LogicalChannel *ChanFreeList::allocate(bool forGprs)
+{
+	update();
+	if (mNumFree == 0 && mNextRescan.passed()) { rescan(); }
+	int ix;
+	while ((ix = choose(forGprs)) >= 0) {
+		freeErase(ix);
+		L2LogicalChannel *chan = mChans[ix];
+		// Double check; something other than the allocator may have taken it.
+		if (chan->inUseByGPRS() || !chan->recyclable()) {
+			recycleAt(ix,chan->recycleWait());
+			continue;
+		}
+		return chan;
 	}
 	return NULL;
 }
 
-// Are the two channels adjacent?
-template <class ChanType>
-bool testAdjacent(ChanType *ch1, ChanType *ch2)
+// Are pool entries ix1 and ix1+1 on consecutive timeslots of the same ARFCN?
+bool ChanFreeList::adjacent(unsigned ix1) const
 {
-	return (ch1->CN() == ch2->CN() && ch1->TN() == ch2->TN()-1);
+	unsigned ix2 = ix1 + 1;
+	return ix2 < mChans.size() && mCN[ix1] == mCN[ix2] && mChans[ix1]->TN()+1 == mChans[ix2]->TN();
 }
 
-// (pat) Return the goodness of this possible match of gprs channels.
-// Higher numbers are gooder.
-template <class ChanType>
-int testGoodness(vector<ChanType*>& chanList, int lo, int hi)
+// The goodness of the group of n channels starting at pool index lo; higher is better.
+// The best group is adjacent to other gprs channels, the next best to an empty channel.
+int ChanFreeList::groupGoodness(unsigned lo, unsigned n) const
 {
 	int goodness = 0;
-	if (lo > 0) {
-		ChanType *ch1 = chanList[lo-1];	// ch1 is below to ch lo.
-		if (testAdjacent(ch1,chanList[lo])) {
-			// The best match is adjacent to other gprs channels.
-			if (ch1->inUseByGPRS()) { goodness += 2; }
-			// The next best is an empty adjacent channel.
-			else if (ch1->recyclable()) { goodness += 1; }
-		}
+	if (lo > 0 && adjacent(lo-1)) {
+		L2LogicalChannel *below = mChans[lo-1];
+		if (below->inUseByGPRS()) { goodness += 2; }
+		else if (below->recyclable()) { goodness += 1; }
 	}
-	if (hi < (int)chanList.size()-1) {
-		ChanType *ch2 = chanList[hi+1];	// ch2 is above ch hi
-		if (testAdjacent(ch2,chanList[hi])) {
-			if (ch2->inUseByGPRS()) { goodness += 2; }
-			else if (ch2->recyclable()) { goodness += 1; }
-		}
+	unsigned hi = lo + n - 1;
+	if (adjacent(hi)) {
+		L2LogicalChannel *above = mChans[hi+1];
+		if (above->inUseByGPRS()) { goodness += 2; }
+		else if (above->recyclable()) { goodness += 1; }
 	}
 	return goodness;
 }
 
 // (pat) 6-20-2012: To increase the likelihood that GPRS channels will be adjacent,
-// GSM RR channels will be allocated from the front of the channel list
-// and GPRS from the end.
-// This function allocates a group of channels for gprs.
-// Look for the largest group of adjacent channels <= groupSize.
-// Give preference to channels that are adjacent to channels already
-// allocated for gprs, or to empty channels.
-// Give second preference to groups near the end of the channel list.
-// Return the allocated channels in the array pointed to by results and
-// return number of channels found.
-template <class ChanType>
-static unsigned getChanGroup(vector<ChanType*>& chanList, ChanType **results)
+// GSM RR channels will be allocated from the front of the channel list and GPRS from the end.
+// Look for the largest group of adjacent free channels <= groupSize.
+// Give preference to groups adjacent to channels already allocated for gprs, or to empty channels,
+// and second preference to groups near the end of the channel list.
+// Only the free lists are walked, from the end, and each run of consecutive free indices is a candidate.
+unsigned ChanFreeList::allocateGroup(unsigned groupSize, L2LogicalChannel **results)
 {
-	const unsigned sz = chanList.size();
-	if (sz==0) return 0;
-
-	const bool backwards = true;	// Currently we always search backwards.
-	// To search forwards, dont forget to invert besti,bestn below
-	ChanType *prevFreeCh = NULL;	// unneeded initialization
-	int curN = 0;					// current number of adjacent free channels.
-	int bestI=0, bestN=0;			// best match
-	int bestGoodness = 0;			// goodness of best match
-	for (unsigned i=0; i<sz; i++) {
-		ChanType *chan = chanList[backwards ? sz-i-1 : i];
-		if (chan->inUseByGPRS()) { continue; }
-		if (! chan->recyclable()) { continue; }
-		if (bestN == 0) {
-			bestI = i;
-			curN = bestN = 1;
-			bestGoodness = testGoodness(chanList,bestI,bestN);
-		} else {
-			if (testAdjacent<ChanType>(chan,prevFreeCh)) {
-				curN++; 	// chan is adjacent to prevCh.
-				int curGoodness = testGoodness(chanList,i,curN);
-				if (curN > bestN || (curN == bestN && curGoodness > bestGoodness)) {
-					// Best so far, so remember it.
-					bestN = curN;
-					bestI = i;
-					bestGoodness = curGoodness;
-					// optional early termination test
-					//if (bestN >= groupSize && bestIsAdjacent) { goto finished; }
-				}
-			} else {
-				curN = 0;
+	update();
+	if (mNumFree == 0 && mNextRescan.passed()) { rescan(); }
+	std::vector<unsigned> stale;
+	int bestLo = -1;
+	unsigned bestN = 0;
+	int bestGoodness = 0;
+	for (int CN = (int)mFree.size()-1; CN >= 0; CN--) {
+		unsigned runN = 0;		// Length of the run of free channels starting at ix.
+		for (std::set<unsigned>::const_reverse_iterator it = mFree[CN].rbegin(); it != mFree[CN].rend(); it++) {
+			unsigned ix = *it;
+			// Double check; something other than the allocator may have taken it.
+			if (mChans[ix]->inUseByGPRS() || !mChans[ix]->recyclable()) {
+				stale.push_back(ix);
+				runN = 0;
+				continue;
+			}
+			std::set<unsigned>::const_reverse_iterator prev = it;
+			runN = (runN && *--prev == ix+1 && adjacent(ix)) ? runN+1 : 1;
+			unsigned n = std::min(runN,groupSize);
+			int goodness = groupGoodness(ix,n);
+			if (n > bestN || (n == bestN && goodness > bestGoodness)) {
+				bestLo = ix;
+				bestN = n;
+				bestGoodness = goodness;
 			}
 		}
-		prevFreeCh = chan;
 	}
-	int firstIx = sz-bestI-1; // only works if backwards==true
-	for (int j = 0; j < bestN; j++) {
-		results[j] = chanList[firstIx+j];
+	for (unsigned i = 0; i < stale.size(); i++) {
+		freeErase(stale[i]);
+		recycleAt(stale[i],mChans[stale[i]]->recycleWait());
+	}
+	for (unsigned j = 0; j < bestN; j++) {
+		results[j] = mChans[bestLo+j];
+		freeErase(bestLo+j);
 	}
 	return bestN;
 }
 
+void GSMConfig::addSDCCH(SDCCHLogicalChannel *wSDCCH)
+{
+	mSDCCHPool.push_back(wSDCCH);
+	mSDCCHFree.add(wSDCCH);
+}
+
+void GSMConfig::addTCH(TCHFACCHLogicalChannel *wTCH)
+{
+	mTCHPool.push_back(wTCH);
+	mTCHFree.add(wTCH);
+}
+
+void GSMConfig::chanReleased(L2LogicalChannel *chan)
+{
+	if (! mSDCCHFree.chanReleased(chan)) { mTCHFree.chanReleased(chan); }
+}
+
 // Allocate a group of channels for gprs.
-// See comments at getChanGroup.
+// See comments at ChanFreeList::allocateGroup.
 int GSMConfig::getTCHGroup(int groupSize,TCHFACCHLogicalChannel **results)
 {
 	ScopedLock lock(mLock);
-	int nfound = getChanGroup<TCHFACCHLogicalChannel>(mTCHPool,results);
-	// limit to channels actually requested
-	if (groupSize < nfound) {
-		nfound = groupSize;
-	}
+	L2LogicalChannel *chans[8];		// A group is on consecutive timeslots of one ARFCN.
+	int nfound = mTCHFree.allocateGroup(min(groupSize,8),chans);
 	for (int i = 0; i < nfound; i++) {
+		results[i] = static_cast<TCHFACCHLogicalChannel*>(chans[i]);
 		results[i]->lcGetL1()->setGPRS(true,NULL);
+		mTCHFree.allocated(results[i]);
 	}
 	return nfound;
 }
@@ -389,8 +522,11 @@ int GSMConfig::getTCHGroup(int groupSize,TCHFACCHLogicalChannel **results)
 SDCCHLogicalChannel *GSMConfig::getSDCCH()
 {
 	ScopedLock lock(mLock);
-	SDCCHLogicalChannel *chan = getChan<SDCCHLogicalChannel>(mSDCCHPool,0);
-	if (chan) chan->lcinit();
+	SDCCHLogicalChannel *chan = static_cast<SDCCHLogicalChannel*>(mSDCCHFree.allocate(false));
+	if (chan) {
+		chan->lcinit();
+		mSDCCHFree.allocated(chan);	// Comes back on T3101 expiry if the MS never shows up.
+	}
 	LOG(DEBUG) <<chan;
 	return chan;
 }
@@ -414,13 +550,16 @@ TCHFACCHLogicalChannel *GSMConfig::getTCH(
 	//	}
 	//	LOG(WARNING)<<"getTCH list:"<<buf;
 	//}
-	TCHFACCHLogicalChannel *chan = getChan<TCHFACCHLogicalChannel>(mTCHPool,forGPRS);
+	TCHFACCHLogicalChannel *chan = static_cast<TCHFACCHLogicalChannel*>(mTCHFree.allocate(forGPRS));
 	// (pat) We have to open it or set gprs mode before returning to avoid a race.
 	if (chan) {
 		// The channels are searched in order from low to high, so if the first channel
 		// found is not on CN0, we have failed.
 		//LOG(DEBUG)<<"getTCH returns"<<LOGVAR2("chan->CN",chan->CN());
-		if (onlyCN0 && chan->CN()) { return NULL; }
+		if (onlyCN0 && chan->CN()) {
+			mTCHFree.chanReleased(chan);	// Not taken after all.
+			return NULL;
+		}
 		if (forGPRS) {
 			// (pat) Reserves channel for GPRS, but does not start delivering bursts yet.
 			chan->lcGetL1()->setGPRS(true,NULL);
@@ -428,6 +567,7 @@ TCHFACCHLogicalChannel *GSMConfig::getTCH(
 		}
 		gReports.incr("OpenBTS.GSM.RR.ChannelAssignment");
 		chan->lcinit();
+		mTCHFree.allocated(chan);	// Comes back on T3101 expiry if the MS never shows up.
 	} else {
 		//LOG(DEBUG)<<"getTCH returns NULL";
 	}
@@ -515,6 +655,25 @@ unsigned GSMConfig::TCHTotal() const
 }
 
 
+L3CellChannelDescription GSMConfig::cellChannelDescription() const
+{
+	std::vector<unsigned> arfcns;
+	for (unsigned i=0; i<gTRX.numARFCNs(); i++) { arfcns.push_back(gTRX.ARFCN(i)->ARFCN()); }
+	hoppingSortARFCNs(arfcns);
+	L3CellChannelDescription result;
+	result.ARFCNs(arfcns);
+	return result;
+}
+
+
+L3MobileAllocation GSMConfig::mobileAllocation() const
+{
+	std::vector<unsigned> hopping = gTRX.hoppingARFCNs();
+	if (hopping.empty()) return L3MobileAllocation();
+	return L3MobileAllocation(cellChannelDescription().ARFCNs(),hopping);
+}
+
+
 void GSMConfig::createCombination0(TransceiverManager& TRX, unsigned TN)
 {
 	// This channel is a dummy burst generator.
@@ -534,8 +693,7 @@ void GSMConfig::createCombinationI(TransceiverManager& TRX, unsigned CN, unsigne
 	radio->setSlot(TN,1);	// (pat) 1 => Transciever.h enum ChannelCombination = I
 	TCHFACCHLogicalChannel* chan = new TCHFACCHLogicalChannel(CN,TN,gTCHF_T[TN]);
 	chan->downstream(radio);
-	Thread* thread = new Thread;
-	thread->start((void*(*)(void*))Control::DCCHDispatcher,dynamic_cast<L3LogicalChannel*>(chan));
+	Control::dcchRegister(dynamic_cast<L3LogicalChannel*>(chan));
 	chan->lcinit();
 	if (CN == 0 && !testStart) chan->lcstart();	// Everything on C0 must broadcast continually.
 	gBTS.addTCH(chan);
@@ -571,7 +729,6 @@ class BeaconC5 : public Beacon {
 	RACHL1FEC *RACH;
 	CCCHLogicalChannel *CCCH;
 	SDCCHLogicalChannel *C0T0SDCCH[4];
-	Thread C0T0SDCCHControlThread[4];
 
 	public:
 	BeaconC5(ARFCNManager *radio)
@@ -603,7 +760,7 @@ class BeaconC5 : public Beacon {
 		for (int i=0; i<4; i++) {
 			if (SMSCB && (i==2)) continue;
 			C0T0SDCCH[i]->downstream(radio);
-			C0T0SDCCHControlThread[i].start((void*(*)(void*))Control::DCCHDispatcher,dynamic_cast<L3LogicalChannel*>(C0T0SDCCH[i]));
+			Control::dcchRegister(dynamic_cast<L3LogicalChannel*>(C0T0SDCCH[i]));
 			C0T0SDCCH[i]->lcinit();
 			C0T0SDCCH[i]->lcstart();	// Everything on channel 0 needs to broadcast constantly.
 			gBTS.addSDCCH(C0T0SDCCH[i]);
@@ -632,8 +789,7 @@ void GSMConfig::createCombinationVII(TransceiverManager& TRX, unsigned CN, unsig
 	for (int i=0; i<8; i++) {
 		SDCCHLogicalChannel* chan = new SDCCHLogicalChannel(CN,TN,gSDCCH8[i]);
 		chan->downstream(radio);
-		Thread* thread = new Thread;
-		thread->start((void*(*)(void*))Control::DCCHDispatcher,dynamic_cast<L3LogicalChannel*>(chan));
+		Control::dcchRegister(dynamic_cast<L3LogicalChannel*>(chan));
 		chan->lcinit();
 		if (CN == 0 && !testStart) chan->lcstart();	// Everything on C0 must broadcast continually.
 		gBTS.addSDCCH(chan);
@@ -23,6 +23,9 @@
 
 #include "Defines.h"
 #include <vector>
+#include <set>
+#include <map>
+#include <queue>
 #include <Interthread.h>
 #include <PowerManager.h>
 #include "GSMRadioResource.h"
@@ -55,6 +58,54 @@ struct TimeSlot {
 	TimeSlot(int wCN,int wTN) : mCN(wCN), mTN(wTN) {}
 };
 
+
+/**
+	Allocation bookkeeping for one allocatable channel pool, so that allocating does not scan the pool.
+	mFree holds the channels believed free, per ARFCN and ordered by pool index, so 'pack' placement
+	still allocates RR channels from the front of the pool as the old linear search did.
+	A channel that is released, or allocated and may time out unused on T3101, is put on mRecycle,
+	keyed by the time it may next be recyclable; allocation moves the due ones onto mFree.
+	Channels freed by a path we do not hear about are found by an occasional rescan when mFree runs dry.
+	All methods except add() and chanReleased() are called with GSMConfig::mLock held.
+*/
+class ChanFreeList {
+	typedef std::pair<int64_t,unsigned> RecycleEntry;	///< (msecs, pool index)
+	std::vector<L2LogicalChannel*> mChans;			///< the pool, in the order it was created
+	std::map<L2LogicalChannel*,unsigned> mIndex;	///< pool index of each channel; written only during init
+	std::vector<unsigned> mCN;						///< CN of each pool entry
+	std::vector<std::set<unsigned> > mFree;			///< indices of free channels, indexed by CN
+	std::vector<unsigned> mTotal;					///< pool entries on each CN
+	unsigned mNumFree;
+	std::priority_queue<RecycleEntry,std::vector<RecycleEntry>,std::greater<RecycleEntry> > mRecycle;
+	Timeval mNextRescan;
+	Mutex mReleasedLock;
+	std::vector<unsigned> mReleased;				///< from chanReleased(), protected by mReleasedLock
+
+	static int64_t nowMsecs();
+	void freeInsert(unsigned ix);
+	void freeErase(unsigned ix);
+	void recycleAt(unsigned ix, long msecs);
+	void update();
+	void rescan();
+	int choose(bool forGprs);
+	bool adjacent(unsigned ix1) const;
+	int groupGoodness(unsigned lo, unsigned n) const;
+
+	public:
+	ChanFreeList() : mNumFree(0) {}
+
+	/** Add a channel to the pool, during initialization only. */
+	void add(L2LogicalChannel *chan);
+	/** Remove and return a free channel according to GSM.Channels.Placement, or NULL. */
+	L2LogicalChannel *allocate(bool forGprs);
+	/** Remove up to groupSize free channels on consecutive timeslots for GPRS, return how many. */
+	unsigned allocateGroup(unsigned groupSize, L2LogicalChannel **results);
+	/** Note that a channel was taken, by allocate() or otherwise, so we know when it may come back. */
+	void allocated(L2LogicalChannel *chan);
+	/** Note that a channel was released.  Thread safe; returns false if the channel is not in this pool. */
+	bool chanReleased(L2LogicalChannel *chan);
+};
+
 /**
 	This object carries the top-level GSM air interface configuration.
 	It serves as a central clearinghouse to get access to everything else in the GSM code.
@@ -80,6 +131,8 @@ class GSMConfig {
 	//@{
 	SDCCHList mSDCCHPool;
 	TCHList mTCHPool;
+	ChanFreeList mSDCCHFree;
+	ChanFreeList mTCHFree;
 	//@}
 
 	/**@name BSIC. */
@@ -192,6 +245,14 @@ class GSMConfig {
 	*/
 	void regenerateSI5();
 
+	/**@name Frequency hopping, see TransceiverManager::startHopping. */
+	//@{
+	/** The Cell Allocation, all our ARFCNs; sent in SI1 and with hopping assignments. */
+	L3CellChannelDescription cellChannelDescription() const;
+	/** The Mobile Allocation of the hopping channels, empty if nothing hops. */
+	L3MobileAllocation mobileAllocation() const;
+	//@}
+
 	/**
 		Hold off on channel allocations; don't answer RACH.
 		@param val true to hold, false to clear hold
@@ -234,7 +295,7 @@ class GSMConfig {
 	/**@name Manage SDCCH Pool. */
 	//@{
 	/** The add method is not mutex protected and should only be used during initialization. */
-	void addSDCCH(SDCCHLogicalChannel *wSDCCH) { mSDCCHPool.push_back(wSDCCH); }
+	void addSDCCH(SDCCHLogicalChannel *wSDCCH);
 	/** Return a pointer to a usable channel. */
 	SDCCHLogicalChannel *getSDCCH();
 	/** Return true if an SDCCH is available, but do not allocate it. */
@@ -250,7 +311,7 @@ class GSMConfig {
 	/**@name Manage TCH pool. */
 	//@{
 	/** The add method is not mutex protected and should only be used during initialization. */
-	void addTCH(TCHFACCHLogicalChannel *wTCH) { mTCHPool.push_back(wTCH); }
+	void addTCH(TCHFACCHLogicalChannel *wTCH);
 	/** Return a pointer to a usable channel. */
 	TCHFACCHLogicalChannel *getTCH(bool forGPRS=false, bool onlyCN0=false);
 	int getTCHGroup(int groupSize,TCHFACCHLogicalChannel **results);
@@ -264,6 +325,9 @@ class GSMConfig {
 	const TCHList& TCHPool() const { return mTCHPool; }
 	//@}
 
+	/** Called when an SDCCH or TCH is released so the allocator can reuse it once recyclable.  Thread safe. */
+	void chanReleased(L2LogicalChannel *chan);
+
 	/**@name Methods to create channel combinations. */
 	//@{
 	/** Combination 0 is a idle slot, as opposed to a non-transmitting one. */
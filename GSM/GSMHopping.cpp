@@ -0,0 +1,74 @@
+/*
+* Copyright 2014 Range Networks, Inc.
+*
+* This software is distributed under multiple licenses;
+* see the COPYING file in the main directory for licensing
+* information for this specific distribution.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+*/
+
+#include "GSMHopping.h"
+#include <algorithm>
+
+namespace GSM {
+
+// The pseudo random table RNTABLE of GSM 05.02 6.2.3.
+static const unsigned char sRNTable[114] = {
+	48,  98,  63,   1,  36,  95,  78, 102,  94,  73,
+	 0,  64,  25,  81,  76,  59, 124,  23, 104, 100,
+	101, 47, 118,  85,  18,  56,  96,  86,  54,   2,
+	80,  34, 127,  13,   6,  89,  57, 103,  12,  74,
+	55, 111,  75,  38, 109,  71, 112,  29,  11,  88,
+	87,  19,   3,  68, 110,  26,  33,  31,   8,  45,
+	82,  58,  40, 107,  32,   5, 106,  92,  62,  67,
+	77, 108, 122,  37,  60,  66, 121,  42,  51, 126,
+	117, 114,  4,  90,  43,  52,  53, 113, 120,  72,
+	16,  49,   7,  79, 119,  61,  22,  84,   9,  97,
+	91,  15,  21,  24,  46,  39,  93, 105,  65,  70,
+	125, 99,  17, 123
+};
+
+
+unsigned hoppingMAI(unsigned FN, unsigned N, unsigned MAIO, unsigned HSN)
+{
+	if (N <= 1) { return 0; }
+	if (HSN == 0) { return (FN + MAIO) % N; }
+
+	unsigned T1R = (FN / (26*51)) % 64;
+	unsigned T2 = FN % 26;
+	unsigned T3 = FN % 51;
+
+	// NBIN is the number of bits needed to represent N.
+	unsigned NBIN = 0;
+	while ((1u << NBIN) <= N) { NBIN++; }
+	unsigned mask = (1u << NBIN) - 1;
+
+	unsigned M = T2 + sRNTable[(HSN ^ T1R) + T3];
+	unsigned Mp = M & mask;
+	unsigned Tp = T3 & mask;
+	unsigned S = (Mp < N) ? Mp : (Mp + Tp) % N;
+	return (S + MAIO) % N;
+}
+
+
+static bool caOrder(unsigned a, unsigned b)
+{
+	if (a == 0) { return false; }
+	if (b == 0) { return true; }
+	return a < b;
+}
+
+
+void hoppingSortARFCNs(std::vector<unsigned> &ARFCNs)
+{
+	std::sort(ARFCNs.begin(),ARFCNs.end(),caOrder);
+}
+
+};	// namespace GSM
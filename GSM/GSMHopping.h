@@ -0,0 +1,41 @@
+/*
+* Copyright 2014 Range Networks, Inc.
+*
+* This software is distributed under multiple licenses;
+* see the COPYING file in the main directory for licensing
+* information for this specific distribution.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+*/
+
+#ifndef _GSMHOPPING_H_
+#define _GSMHOPPING_H_ 1
+
+#include <vector>
+
+// This file has no dependencies on the rest of OpenBTS so the sequences can be checked by HoppingTest.
+
+namespace GSM {
+
+/**
+	The hopping sequence generation of GSM 05.02 6.2.3.
+	Return the Mobile Allocation Index, 0..N-1, used in frame FN by a channel with the given MAIO and HSN
+	hopping over a mobile allocation of N frequencies.  HSN 0 is cyclic hopping.
+	Channels with the same HSN and different MAIOs never use the same frequency in the same frame.
+*/
+unsigned hoppingMAI(unsigned FN, unsigned N, unsigned MAIO, unsigned HSN);
+
+/**
+	Sort an ARFCN list into the order that the Cell Channel Description and Mobile Allocation
+	elements number it in, GSM 04.08 10.5.2.21: increasing ARFCN, except that ARFCN 0 goes last.
+*/
+void hoppingSortARFCNs(std::vector<unsigned> &ARFCNs);
+
+};	// namespace GSM
+#endif
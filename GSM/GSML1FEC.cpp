@@ -29,6 +29,7 @@
 #include "GSMTDMA.h"
 #include "GSMTAPDump.h"
 #include "GSMLogicalChannel.h"
+#include "GSMMeasurementEngine.h"
 #include <ControlCommon.h>
 #include <OpenBTSConfig.h>
 #include <TRXManager.h>
@@ -59,8 +60,7 @@ using namespace SIP;	// For AudioFrame
 const float cInitialPower = 33; 
 
 
-// The actual phone settings change every 4 bursts, so average over at least 4.
-static const unsigned cAveragePeriodTiming = 8; // How many we measurement reports over which we average timing, minus 1.
+// The timing is averaged in GSMMeasurementEngine.cpp.
 //static const unsigned cAveragePeriodRSSI = 8; // How many measurement reports over which we average RSSI, minus 1.
 //static const unsigned cAveragePeriodSNR = 8; // How many frames over which we average SNR, minus 1.
 static const unsigned cFERMemory = 208; // How many we frames we average FER, minus 1.  For reporting.
@@ -213,6 +213,7 @@ L1Encoder::L1Encoder(unsigned wCN, unsigned wTN, const TDMAMapping& wMapping, L1
 	mPrevWriteTime(gBTS.time().FN(),wTN),
 	mNextWriteTime(gBTS.time().FN(),wTN),
 	mRunning(false),
+	mTxAtten(0),
 	mEncrypted(ENCRYPT_NO),
 	mEncryptionAlgorithm(0)
 {
@@ -270,6 +271,7 @@ void L1Encoder::encInit()
 	// then clear the encryption flag here, when the channel gets reused.
 	mEncrypted = ENCRYPT_NO;
 	mEncryptionAlgorithm = 0;
+	mTxAtten = 0;	// Every call starts at full power.
 	// (pat) On very first initialization, start sending the dummy bursts;
 	// this allows us to get rid of the dopey 'starting' of all the channels when the BTS is turned on.
 	if (mCN == 0 && !mEncEverActive) { sendDummyFill(); }
@@ -351,6 +353,12 @@ void L1Encoder::waitToSend() const
 }
 
 
+bool L1Encoder::sendWouldBlock() const
+{
+	return gBTS.time() < mPrevWriteTime;
+}
+
+
 void L1Encoder::sendDummyFill()
 {
 	// Send the L1 idle filling pattern, if any.
@@ -446,6 +454,8 @@ void DecoderStats::decoderStatsInit()
 	mStatTotalFrames = 0;
 	mStatStolenFrames = 0;
 	mStatBadFrames = 0;
+	mStatCombineTries = 0;
+	mStatCombineRecovered = 0;
 }
 
 ostream& operator<<(std::ostream& os, const L1Decoder *decp)
@@ -523,7 +533,7 @@ void DecoderStats::countSNR(const RxBurst &burst)
 {
 	// setting to 0 disables:
 	mLastSNR = burst.getNormalSNR();
-	if (int SNRAveragePeriod = gConfig.getNum("GSM.Radio.SNRAveragePeriod")) {
+	if (int SNRAveragePeriod = gConfig.GSM.Radio.SNRAveragePeriod) {
 		int count = min((int)mSNRCount,SNRAveragePeriod);
 		mAveSNR = (mLastSNR  + count * mAveSNR) / (count+1);
 		mSNRCount++;
@@ -572,7 +582,7 @@ void L1Decoder::countBadFrame(unsigned nframes)	// Number of bursts to count.
 
 void SACCHL1Decoder::countBadFrame(unsigned nframes)
 {
-	RSSIBumpDown(gConfig.getNum("Control.SACCHTimeout.BumpDown"));
+	RSSIBumpDown(gConfig.Control.SACCHTimeout.BumpDown);
 	L1Decoder::countBadFrame(nframes);
 }
 
@@ -715,7 +725,8 @@ XCCHL1Decoder::XCCHL1Decoder(
 		unsigned wTN,
 		const TDMAMapping& wMapping,
 		L1FEC *wParent)
-	:L1Decoder(wCN,wTN,wMapping,wParent)
+	:L1Decoder(wCN,wTN,wMapping,wParent),
+	mChaseC(456),mChaseFresh(456),mChaseFN(-1)
 {
 }
 
@@ -789,6 +800,11 @@ void XCCHL1Decoder::writeLowSideRx(const RxBurst& inBurst)
 			} else {
 				countBadFrame(1);
 			}
+		} else if (chaseDecode(mReadTime.FN())) {
+			countGoodFrame(1);
+			countBER(mVCoder.getBEC(),mC.size());
+			mD.LSB8MSB();
+			handleGoodFrame();
 		} else {
 			countBadFrame(1);
 		}
@@ -796,6 +812,48 @@ void XCCHL1Decoder::writeLowSideRx(const RxBurst& inBurst)
 }
 
 
+// Combine two soft bits, each the probability of a 1, by adding their log likelihood ratios.
+static float combineSoftBits(float p1, float p2)
+{
+	// Keep away from 0 and 1 so the logs stay finite; a hard decision from one copy
+	// should still be overruled by two confident copies saying otherwise.
+	static const float lim = 0.001F;
+	p1 = max(lim,min(1.0F-lim,p1));
+	p2 = max(lim,min(1.0F-lim,p2));
+	float llr = logf(p1/(1.0F-p1)) + logf(p2/(1.0F-p2));
+	return 1.0F / (1.0F + expf(-llr));
+}
+
+
+bool XCCHL1Decoder::chaseDecode(int32_t FN)
+{
+	if (!gConfig.GSM.Radio.ChaseCombining) { return false; }
+	// Ciphering start is detected by a parity failure, so dont mix blocks across it.
+	if (mEncrypted == ENCRYPT_MAYBE) { chaseClear(); return false; }
+
+	bool haveOld = mChaseFN >= 0 && FNDelta(FN,mChaseFN) > 0 && FNDelta(FN,mChaseFN) <= (int32_t) (2*mMapping.repeatLength());
+	mC.copyTo(mChaseFresh);
+	if (haveOld) {
+		mDecoderStats.mStatCombineTries++;
+		for (unsigned k=0; k<mC.size(); k++) {
+			mC[k] = combineSoftBits(mChaseFresh[k],mChaseC[k]);
+		}
+		if (decode()) {
+			mDecoderStats.mStatCombineRecovered++;
+			OBJLOG(INFO) << "recovered block by soft combining with block from FN " << mChaseFN
+				<<LOGVAR2("tries",mDecoderStats.mStatCombineTries) <<LOGVAR2("recovered",mDecoderStats.mStatCombineRecovered);
+			chaseClear();
+			return true;
+		}
+		mChaseFresh.copyTo(mC);
+	}
+	// Keep only the latest failure; it is the one most likely to be repeated next.
+	mChaseFresh.copyTo(mChaseC);
+	mChaseFN = FN;
+	return false;
+}
+
+
 void XCCHL1Decoder::saveMi()
 {
 	for (int i = 0; i < 4; i++) {
@@ -927,7 +985,7 @@ bool SharedL1Decoder::decode()
 	unsigned syndrome = mBlockCoder.syndrome(mDP);
 	OBJLOG(DEBUG) <<"XCCHL1Decoder syndrome=" << hex << syndrome << dec;
 	// Simulate high FER for testing?
-	if (random()%100 < gConfig.getNum("Test.GSM.SimulatedFER.Uplink")) {
+	if (random()%100 < gConfig.Test.GSM.SimulatedFER.Uplink) {
 		OBJLOG(NOTICE) << "XCCHL1Decoder simulating dropped uplink frame at " << mReadTime;
 		return false;
 	}
@@ -949,7 +1007,7 @@ void XCCHL1Decoder::handleGoodFrame()
 		// stop T3101 and tell L2 we're alive down here.
 		if (mT3101.active()) {
 			mT3101.reset();
-			// This does not block; goes to a InterthreadQueue L2LAPdm::mL1In
+			// This does not block; goes onto L2LAPDm::mL1In for the LAPDm engine
 			if (mUpstream!=NULL) mUpstream->writeLowSide(L2Frame(ESTABLISH));
 		}
 	}
@@ -961,13 +1019,13 @@ void XCCHL1Decoder::handleGoodFrame()
 
 	if (mUpstream) {
 		// Are we fuzzing ourselves?
-		if (random()%100 < gConfig.getNum("Test.GSM.UplinkFuzzingRate")) {
+		if (random()%100 < gConfig.Test.GSM.UplinkFuzzingRate) {
 			size_t i = random() % mD.size();
 			mD[i] = 1 - mD[i];
 			OBJLOG(NOTICE) << "XCCHL1Decoder fuzzing input frame, flipped bit " << i;
 		}
 		// Send all bits to GSMTAP
-		if (gConfig.getBool("Control.GSMTAP.GSM")) {
+		if (gConfig.Control.GSMTAP.GSM) {
 			// FIXME -- This repeatLengh>51 is a bit of a hack.
 			gWriteGSMTAP(ARFCN(),TN(),mReadTime.FN(),typeAndOffset(),mMapping.repeatLength()>51,true,mD);
 		}
@@ -981,16 +1039,13 @@ void XCCHL1Decoder::handleGoodFrame()
 }
 
 // Get the physical parameters of the burst.
+// The averaging of RSSI and timing error is updated once per reporting period by the measurement engine.
 void MSPhysReportInfo::processPhysInfo(const RxBurst &inBurst)
 {
 	// RSSI is dB wrt full scale.
-	unsigned count = min((int)mReportCount,(int)gConfig.getNum("GSM.Radio.RSSIAveragePeriod"));
-	mRSSI = (inBurst.RSSI()  + count * mRSSI) / (count+1);
-
 	// Timing error is a float in symbol intervals.
 	// (pat) It is the timing error of the received bursts which means it is relative to the Timing Advance currently in use.
-	count = min(mReportCount,cAveragePeriodTiming);
-	mTimingError = (inBurst.timingError()  + count * mTimingError) / (count+1);
+	gMeasurementEngine.meAddBurst(mMeasSlot,inBurst.time().FN(),inBurst.RSSI(),inBurst.timingError());
 
 	// Timestamp
 	mTimestamp = gBTS.clock().systime(inBurst.time());
@@ -1002,6 +1057,16 @@ void MSPhysReportInfo::processPhysInfo(const RxBurst &inBurst)
 }
 
 
+void MSPhysReportInfo::RSSIBumpDown(float dB)
+{
+	if (mMeasSlot >= 0) {
+		gMeasurementEngine.meBumpDown(mMeasSlot,dB);
+	} else {
+		mRSSI -= dB;
+	}
+}
+
+
 bool SACCHL1Decoder::processBurst(const RxBurst& inBurst)
 {
 	// TODO -- One quick test of burst validity is to look at the tail bits.
@@ -1116,7 +1181,7 @@ void XCCHL1Encoder::sendFrame(const L2Frame& frame)
 
 	// Send to GSMTAP
 	frame.copyToSegment(mU,headerOffset());
-	if (gConfig.getBool("Control.GSMTAP.GSM")) {
+	if (gConfig.Control.GSMTAP.GSM) {
 		gWriteGSMTAP(ARFCN(),TN(),mNextWriteTime.FN(),typeAndOffset(),mMapping.repeatLength()>51,false,mU);
 	}
 
@@ -1183,7 +1248,7 @@ void L1Encoder::transmit(BitVector2 *mI, BitVector2 *mE, const int *qbits)
 
 	// add noise
 	// the noise insertion happens below, merged in with the ciphering
-	int p = gConfig.getFloat("GSM.Cipher.CCHBER") * (float)0xFFFFFF;
+	int p = gConfig.GSM.Cipher.CCHBER * (float)0xFFFFFF;
 
 	for (int qi=0,B=0; B<4; B++) {
 		mBurst.time(mNextWriteTime);
@@ -1237,6 +1302,7 @@ void L1Encoder::transmit(BitVector2 *mI, BitVector2 *mE, const int *qbits)
 		mBurst.Hu(qbits[qi++]);
 		// Send it to the radio.
 		OBJLOG(DEBUG) << "transmit mBurst=" << mBurst;
+		mBurst.atten(burstAtten());
 		mDownstream->writeHighSideTx(mBurst,"Shared");
 		rollForward();
 	}
@@ -1400,7 +1466,10 @@ TCHFACCHL1Decoder::TCHFACCHL1Decoder(
 	unsigned wTN,
 	const TDMAMapping& wMapping,
 	L1FEC *wParent)
-	:XCCHL1Decoder(wCN,wTN, wMapping, wParent)
+	:XCCHL1Decoder(wCN,wTN, wMapping, wParent),
+	mRxBursts(0),
+	mLastFN(-1),
+	mSkippedFrames(0)
 {
 	for (int i=0; i<8; i++) {
 		mE[i] = SoftVector(114);
@@ -1411,6 +1480,15 @@ TCHFACCHL1Decoder::TCHFACCHL1Decoder(
 	}
 }
 
+void TCHFACCHL1Decoder::decInit()
+{
+	for (unsigned B = 0; B < 8; B++) { mI[B].fill(0.5F); }
+	mRxBursts = 0;
+	mLastFN = -1;
+	mSkippedFrames = 0;
+	XCCHL1Decoder::decInit();
+}
+
 ViterbiBase *newViterbi(AMRMode mode)
 {
 	switch (mode) {
@@ -1435,6 +1513,7 @@ void TCHFRL1Decoder::setAmrMode(AMRMode wMode)
 	mPrevGoodFrame.resize(kd);
 	mPrevGoodFrame.zero();	// When switching modes the contents of this are garbage, so zero.
 	mNumBadFrames = 0;
+	mPrevGoodSID = false;
 	setViterbi(wMode);
 	if (wMode == TCH_FS) {
 		assert(kd == 260);
@@ -1549,6 +1628,9 @@ bool TCHFACCHL1Decoder::processBurst( const RxBurst& inBurst)
 	assert(B>=0);
 	OBJLOG(DEBUG) << "TCHFACCHL1Decoder B=" << B << " " << inBurst;
 
+	// Finish any block whose last burst never arrived.
+	fillMissingBursts(inBurst.time().FN());
+
 	// Pull the data fields (e-bits) out of the burst and put them into i[B][].
 	// GSM 05.03 3.1.4
 	inBurst.data1().copyToSegment(mI[B],0);
@@ -1558,11 +1640,65 @@ bool TCHFACCHL1Decoder::processBurst( const RxBurst& inBurst)
 	mFN[B] = inBurst.time().FN();
 	stealBitsL[B] = inBurst.Hl();
 	stealBitsU[B] = inBurst.Hu();
+	mRxBursts |= 1 << B;
 
 	// Every 4th frame is the start of a new block.
 	// So if this isn't a "4th" frame, return now.
 	if (B%4!=3) return false;
 
+	decodeBlock(B);
+	return true;	// note: result not used by this class.
+}
+
+
+// Uplink DTX: the transceiver does not pass up the bursts in which it found nothing, so a block whose
+// last burst is missing would never be finished, and its bursts would be counted again in the next block.
+// Treat each frame of this channel between the last burst and this one as an erased burst,
+// and finish the last cMaxFillBlocks blocks that ended in the gap, so the speech path gets comfort noise or a bad frame.
+// The blocks before those are not queued all at once behind the late burst; they are counted in mSkippedFrames
+// and the RTP timestamp steps over them instead.
+void TCHFACCHL1Decoder::fillMissingBursts(int FN)
+{
+	int last = mLastFN;
+	if (last >= 0) {
+		int gap = FNDelta(FN,last);
+		if (gap <= 0) { return; }		// A late or repeated burst.
+		if (gap > (int)TDMAMapping::mMaxRepeatLength) {
+			// Longer than any speech pause, so the MS was gone.  Start over with an empty buffer.
+			for (unsigned B = 0; B < 8; B++) { mI[B].fill(0.5F); }
+			mRxBursts = 0;
+		} else {
+			int blocks = 0;
+			for (int i = 1; i < gap; i++) {
+				int rev = mMapping.reverseMapping((last + i) % gHyperframe);
+				if (rev >= 0 && rev % 4 == 3) { blocks++; }
+			}
+			for (int i = 1; i < gap; i++) {
+				int fn = (last + i) % gHyperframe;
+				int rev = mMapping.reverseMapping(fn);
+				if (rev < 0) { continue; }		// The SACCH or idle frame.
+				int B = rev % 8;
+				mI[B].fill(0.5F);
+				mFN[B] = fn;
+				stealBitsL[B] = stealBitsU[B] = 0;
+				mRxBursts &= ~(1 << B);
+				if (B%4!=3) { continue; }
+				if (blocks-- > cMaxFillBlocks) {
+					mRxBursts &= (B == 3) ? 0x0f : 0xf0;	// As decodeBlock would.
+					__sync_fetch_and_add(&mSkippedFrames,1);
+				} else {
+					decodeBlock(B);
+				}
+			}
+		}
+	}
+	mLastFN = FN;
+}
+
+
+// Decode the block that ends with burst B, which is 3 or 7.
+void TCHFACCHL1Decoder::decodeBlock(int B)
+{
 	if (mEncrypted == ENCRYPT_MAYBE) {
 		saveMi();
 	}
@@ -1577,6 +1713,18 @@ bool TCHFACCHL1Decoder::processBurst( const RxBurst& inBurst)
 	if (B==3) deinterleaveTCH(4);
 	else deinterleaveTCH(0);
 
+	// Uplink DTX, GSM 06.31.  In a speech pause the MS sends only a SID frame each SACCH multiframe,
+	// and the transceiver drops the bursts in which it finds nothing.  A block with half of its bursts
+	// or fewer cannot be decoded, so do not spend the Viterbi decoder on it, and send comfort noise.
+	unsigned received = 0;
+	for (unsigned i = 0; i < 8; i++) { if (mRxBursts & (1<<i)) received++; }
+	mRxBursts &= (B == 3) ? 0x0f : 0xf0;	// Keep the half that the next block shares.
+	if (received <= 4 && gConfig.GSM.DTX.Uplink) {
+		OBJLOG(DEBUG) <<"TCHFACCHL1Decoder DTX idle block" <<LOGVAR(received);
+		decodeTCHIdle();
+		return;
+	}
+
 	// See if this was the end of a stolen frame, GSM 05.03 4.2.5.
 	// (pat) There are 8 bits to determine if the frame is stolen.  If they are all set one
 	// way or the other, that is a pretty good indication the frame is stolen or not, but
@@ -1590,7 +1738,7 @@ bool TCHFACCHL1Decoder::processBurst( const RxBurst& inBurst)
 		stolenbits = stealBitsU[0] + stealBitsU[1] + stealBitsU[2] + stealBitsU[3] +
 			stealBitsL[4] + stealBitsL[5] + stealBitsL[6] + stealBitsL[7];
 	}
-	OBJLOG(DEBUG) <<"TCHFACCHL1Decoder Hl=" << inBurst.Hl() << " Hu=" << inBurst.Hu();
+	OBJLOG(DEBUG) <<"TCHFACCHL1Decoder Hl=" << stealBitsL[B] << " Hu=" << stealBitsU[B];
 	bool okFACCH = false;
 	if (stolenbits) {	// If any of the 8 stolen bits are set, try decoding as FACCH.
 		okFACCH = decode();	// Calls SharedL1Decoder::decode() to decode mC into mU
@@ -1617,6 +1765,12 @@ bool TCHFACCHL1Decoder::processBurst( const RxBurst& inBurst)
 			}
 		}
 
+		// A block whose stealing flags are nearly all set is FACCH even if it failed parity,
+		// so it is worth combining with the previous failed FACCH block.
+		if (!okFACCH && stolenbits > 5) {
+			okFACCH = chaseDecode(mFN[B]);
+		}
+
 		if (okFACCH) {	// This frame was stolen for sure.
 			OBJLOG(DEBUG) <<"TCHFACCHL1Decoder good FACCH frame";
 			//countGoodFrame();
@@ -1649,8 +1803,6 @@ bool TCHFACCHL1Decoder::processBurst( const RxBurst& inBurst)
 		//mT3109.set();
 	}
 	else countBadFrame(4);
-
-	return true;	// note: result not used by this class.
 }
 
 
@@ -1719,49 +1871,43 @@ void TCHFACCHL1Decoder::addToSpeechQ(AudioFrame *newFrame)  { mSpeechQ.write(new
 
 
 // (pat) See GSM 6.12 5.2 and 5.03 table 2 (in section 5.4)
-// I did not get this to work in that I did not see any silence frames.
-static bool isSIDFrame(BitVector &frame)
-{
-	// A SID frame is marked by all zeros in particular positions in the RPE pulse data.
-	// If all the above bits are 0, it is a SID frame.
-	const char *frameMarker[4] = {
-		// There are 13 RPE pulses per frame.
-		// In the first three sub-frames, two bits of each RPE pulse are considered.
-		// I dont know which direction the bits go within each variable.
-		"00x00x00x00x00x00x00x00x00x00x00x00x00x",
-		"00x00x00x00x00x00x00x00x00x00x00x00x00x",
-		"00x00x00x00x00x00x00x00x00x00x00x00x00x",
-		// In the fourth sub-frame bit one is included only for the first 4 RPE pulses (numbers 64-67 inclusive)
-		"00x00x00x00x0xx0xx0xx0xx0xx0xx0xx0xx0xx" };
-		//"x00x00x00x00x00x00x00x00x00x00x00x00x00",
-		//"x00x00x00x00x00x00x00x00x00x00x00x00x00",
-		//"x00x00x00x00x00x00x00x00x00x00x00x00x00",
-		//"x00x00x00x00xx0xx0xx0xx0xx0xx0xx0xx0xx0"
-
-	if (0) {
-		// Print out the SID bits
-		char buf[200], *bp = buf;
-		for (unsigned f = 0; f < 4; f++) {		// For each voice sub-frame
-			const char *fp = frame.begin() + 36 + 17 + f * 56; 	// RPE params start at bit 17.
-			const char *zb = frameMarker[f];
-			for (; *zb; zb++) {
-				if (*zb == '0') *bp++ = '0' + *fp++;
+// A SID frame is marked by the SID code word, 95 bits that are all zero, in particular positions in the RPE pulse data.
+// There are 13 RPE pulses per sub-frame.
+// In the first three sub-frames, two bits of each RPE pulse are considered.
+// In the fourth sub-frame bit one is included only for the first 4 RPE pulses (numbers 64-67 inclusive)
+static const char *sSIDCodeWord[4] = {
+	"00x00x00x00x00x00x00x00x00x00x00x00x00x",
+	"00x00x00x00x00x00x00x00x00x00x00x00x00x",
+	"00x00x00x00x00x00x00x00x00x00x00x00x00x",
+	"00x00x00x00x0xx0xx0xx0xx0xx0xx0xx0xx0xx" };
+
+enum SIDClass { SIDNone, SIDInvalid, SIDValid };
+
+// GSM 06.31: a frame is a valid SID frame if at most one bit of the SID code word is 1, an invalid SID frame
+// (one damaged on the way) if fewer than 16 are, and otherwise speech.
+static SIDClass classifySID(BitVector &frame)
+{
+	unsigned ones = 0;
+	for (unsigned f = 0; f < 4; f++) {		// For each voice sub-frame
+		const char *fp = frame.begin() + 36 + 17 + f * 56; 	// RPE params start at bit 17.
+		for (const char *zb = sSIDCodeWord[f]; *zb; zb++, fp++) {
+			if (*zb != 'x' && *fp) {
+				if (++ones >= 16) { return SIDNone; }
 			}
 		}
-		*bp = 0;
-		printf("SID=%s\n",buf);
 	}
+	return ones <= 1 ? SIDValid : SIDInvalid;
+}
 
-	for (unsigned f = 0; f < 4; f++) {		// For each voice sub-frame
-		const char *fp = frame.begin() + 36 + 17 + f * 56; 	// RPE params start at bit 17.
-		const char *zb = frameMarker[f];
-		for (; *zb; zb++, fp++) {
-			if (*zb != 'x') {
-				if (*fp != 0) { return false; }	// Not a SID frame.
-			}
+// Zero the SID code word, so an invalid SID frame goes upstream as a valid one.
+static void clearSIDCodeWord(BitVector &frame)
+{
+	for (unsigned f = 0; f < 4; f++) {
+		char *fp = frame.begin() + 36 + 17 + f * 56;
+		for (const char *zb = sSIDCodeWord[f]; *zb; zb++, fp++) {
+			if (*zb != 'x') { *fp = 0; }
 		}
 	}
-	return true;	// All the non-X bits were 0 so it is a SID frame.
 }
 
 // GSM Full Rate Speech Frame GSM 6.10 1.7
@@ -1853,7 +1999,7 @@ bool TCHFRL1Decoder::decodeTCH_GSM(bool stolen,const SoftVector *wC)
 	// GSM 05.02 3.1.2, but backwards
 
 	// Simulate high FER for testing?
-	if (random()%100 < gConfig.getNum("Test.GSM.SimulatedFER.Uplink")) {
+	if (random()%100 < gConfig.Test.GSM.SimulatedFER.Uplink) {
 		OBJLOG(DEBUG) << "simulating dropped uplink vocoder frame at " << mReadTime;
 		stolen = true;
 	}
@@ -1915,6 +2061,10 @@ bool TCHFRL1Decoder::decodeTCH_GSM(bool stolen,const SoftVector *wC)
 			mGsmPrevGoodFrame.clone(mGsmVFrame);
 #endif
 			mTCHD.unmap(g610BitOrder,260,mPrevGoodFrame);	// Put the completed decoded data in mPrevGoodFrame.
+			// With uplink DTX a good frame may be a SID frame, which the network turns into comfort noise.
+			SIDClass sid = gConfig.GSM.DTX.Uplink ? classifySID(mPrevGoodFrame) : SIDNone;
+			if (sid == SIDInvalid) { clearSIDCodeWord(mPrevGoodFrame); }
+			mPrevGoodSID = sid != SIDNone;
 			newFrame->append(mPrevGoodFrame);				// And copy it into the RTP audio frame.
 			mNumBadFrames = 0;
 		}
@@ -1938,9 +2088,8 @@ bool TCHFRL1Decoder::decodeTCH_GSM(bool stolen,const SoftVector *wC)
 		// Annex 2 is Subjective relevance of speech coder bits.
 		// Get xmax of the final sub-frame.
 		// (pat) We only modify voice frames, not silence frames.
-		// 1-2014 We dont get SID frames because we dont yet support DTX as specified in the beacon in L3CellOptionsBCCH,
-		// so this code is zeroed out until we do...
-		if (1 || !isSIDFrame(mPrevGoodFrame)) {
+		// In a DTX speech pause the last good frame is a SID frame, and repeating it keeps the comfort noise going, GSM 06.31.
+		if (!mPrevGoodSID) {
 			mNumBadFrames++;
 			if (mNumBadFrames >= 32) {
 				createSilenceFrame(mPrevGoodFrame);
@@ -1967,8 +2116,6 @@ bool TCHFRL1Decoder::decodeTCH_GSM(bool stolen,const SoftVector *wC)
 					}
 				}
 			}
-		} else {
-			printf("found SID frame\n"); fflush(stdout);
 		}
 		newFrame->append(mPrevGoodFrame);
 	} else {
@@ -2075,10 +2222,21 @@ bool TCHFRL1Decoder::decodeTCH_AFS(bool stolen, const SoftVector *wC)
 	return good;
 }
 
+void TCHFRL1Decoder::decodeTCHIdle()
+{
+	if (mAMRMode == TCH_FS) {
+		// The bad frame processing repeats the last SID frame, or mutes if there was none.
+		decodeTCH_GSM(true,NULL);
+	} else {
+		// We do not decode AMR SID frames, so let the network generate the comfort noise.
+		addToSpeechQ(new AudioFrameRtp(mAMRMode,AudioFrameRtp::AmrNoData));
+	}
+}
+
 bool TCHFRL1Decoder::decodeTCH(bool stolen, const SoftVector *wC)	// result goes to sendTCHUp()
 {
 	// Simulate high FER for testing?
-	if (random()%100 < gConfig.getNum("Test.GSM.SimulatedFER.Uplink")) {
+	if (random()%100 < gConfig.Test.GSM.SimulatedFER.Uplink) {
 		OBJLOG(DEBUG) << "simulating dropped uplink vocoder frame at " << mReadTime;
 		stolen = true;
 	}
@@ -2141,7 +2299,8 @@ TCHFACCHL1Encoder::TCHFACCHL1Encoder(
 	const TDMAMapping& wMapping,
 	L1FEC *wParent)
 	:XCCHL1Encoder(wCN, wTN, wMapping, wParent), 
-	mPreviousFACCH(true),mOffset(0)
+	mPreviousFACCH(true),mOffset(0),
+	mDTXPause(false),mPrevBlockSent(true)
 {
 	for(int k = 0; k<8; k++) {
 		mI[k].resize(114);
@@ -2169,10 +2328,21 @@ void TCHFACCHL1Encoder::encInit()
 	// But it's gone now.
 	XCCHL1Encoder::encInit();
 	mPreviousFACCH = true;
+	mDTXPause = false;
+	mPrevBlockSent = true;
+	resetComfortNoise();
+}
+
+
+// GSM 05.08 8.3: the TCH/F frames, modulo 104, that carry the SID frame in a speech pause, by timeslot pair.
+bool TCHFACCHL1Encoder::isSIDBlock(const Time &when) const
+{
+	static const int sidStart[4] = { 52, 0, 26, 78 };
+	return when.FN() % 104 == sidStart[TN()/2];
 }
 
 
-void TCHFRL1Encoder::encodeTCH_GSM(const AudioFrame* aFrame)
+TCHFrameKind TCHFRL1Encoder::encodeTCH_GSM(const AudioFrame* aFrame)
 {
 	assert(mTCHRaw.size() == 260 && mTCHD.size() == 260);
 	// GSM 05.03 3.1.2
@@ -2181,6 +2351,46 @@ void TCHFRL1Encoder::encodeTCH_GSM(const AudioFrame* aFrame)
 	// The incoming ByteVector is an RTP payload type 3 (GSM), which uses the standard 4 bit RTP header.
 	AudioFrameRtp rtpFrame(TCH_FS,aFrame);
 	rtpFrame.getPayload(&mTCHRaw);		// Get the RTP frame payload into a BitVector2.
+
+	// The network may send SID frames itself, in which case they are passed through.
+	// Otherwise remember the comfort noise parameters of the speech in case we have to make SID frames.
+	SIDClass sid = classifySID(mTCHRaw);
+	if (sid == SIDInvalid) { clearSIDCodeWord(mTCHRaw); }
+	if (sid == SIDNone) {
+		GSMFRSpeechFrame sf(mTCHRaw);
+		unsigned char *params = mCNParams[mCNCount++ % cCNFrames];
+		for (unsigned n = 1; n <= 8; n++) { params[n-1] = sf.getLAR(n); }
+		for (unsigned f = 0; f < 4; f++) { params[8+f] = sf.getBlockAmplitude(f); }
+	}
+	encodeTCH_GSMRaw();
+	return sid == SIDNone ? TCHSpeech : TCHSID;
+}
+
+void TCHFRL1Encoder::encodeSID()
+{
+	// GSM 06.12 5.2: the SID frame carries the LARs and block amplitudes averaged over the last 4 speech frames,
+	// and the SID code word.  The other parameters are not used by the comfort noise generator, so they are 0 too.
+	// We average the coded values.
+	mTCHRaw.zero();
+	GSMFRSpeechFrame sf(mTCHRaw);
+	unsigned n = mCNCount < cCNFrames ? mCNCount : cCNFrames;
+	if (n == 0) {
+		// No speech yet, so use the GSM 06.11 silence frame.
+		createSilenceFrame(mTCHRaw);
+		clearSIDCodeWord(mTCHRaw);
+	} else {
+		for (unsigned p = 0; p < 12; p++) {
+			unsigned sum = 0;
+			for (unsigned i = 0; i < n; i++) { sum += mCNParams[i][p]; }
+			unsigned avg = (sum + n/2) / n;
+			if (p < 8) { sf.setLAR(p+1,avg); } else { sf.setBlockAmplitude(p-8,avg); }
+		}
+	}
+	encodeTCH_GSMRaw();
+}
+
+void TCHFRL1Encoder::encodeTCH_GSMRaw()
+{
 	mTCHRaw.map(g610BitOrder,260,mTCHD);
 
 	// Reorder bits by importance.
@@ -2212,7 +2422,7 @@ void TCHFRL1Encoder::encodeTCH_GSM(const AudioFrame* aFrame)
 	// and ready for the interleaver.
 }
 
-void TCHFRL1Encoder::encodeTCH_AFS(const AudioFrame* aFrame)
+TCHFrameKind TCHFRL1Encoder::encodeTCH_AFS(const AudioFrame* aFrame)
 {
 	// We dont support SID frames.
 	// GSM 05.02 3.9
@@ -2223,6 +2433,9 @@ void TCHFRL1Encoder::encodeTCH_AFS(const AudioFrame* aFrame)
 	//mAmrVFrame.payload().map(mAMRBitOrder, mKd, mTCHD);
 
 	AudioFrameRtp rtpFrame(mAMRMode,aFrame);
+	// A SID or NO_DATA frame from the network does not fit the speech payload, so there is nothing to send.
+	unsigned frameType = rtpFrame.amrFrameType();
+	if (frameType == AudioFrameRtp::AmrSid || frameType == AudioFrameRtp::AmrNoData) { return TCHNoData; }
 	rtpFrame.getPayload(&mTCHRaw);
 	mTCHRaw.map(mAMRBitOrder, mTCHD.size(), mTCHD);
 
@@ -2253,12 +2466,13 @@ void TCHFRL1Encoder::encodeTCH_AFS(const AudioFrame* aFrame)
 	// Puncturing brought the frame size to 448 bits, regardless of mode.
 	// TCH_AFS interleaver (3.9.4.5) is same as TCH/FS (3.1.3).
 	// TCH_AFS mapper (3.9.4.6) is same as TCH/FS (3.1.4).
+	return TCHSpeech;
 }
 
-void TCHFRL1Encoder::encodeTCH(const AudioFrame* aFrame)
+TCHFrameKind TCHFRL1Encoder::encodeTCH(const AudioFrame* aFrame)
 {
 	// (pat) Slight weirdness to avoid modifying existing GSM_FR code.
-	if (mAMRMode == TCH_FS) { encodeTCH_GSM(aFrame); } else { encodeTCH_AFS(aFrame); }
+	return (mAMRMode == TCH_FS) ? encodeTCH_GSM(aFrame) : encodeTCH_AFS(aFrame);
 }
 
 
@@ -2266,7 +2480,7 @@ void TCHFACCHL1Encoder::sendFrame( const L2Frame& frame )
 {
 	OBJLOG(DEBUG) << "TCHFACCHL1Encoder " << frame;
 	// Simulate high FER for testing.
-	if (random()%100 < gConfig.getNum("Test.GSM.SimulatedFER.Downlink")) {
+	if (random()%100 < gConfig.Test.GSM.SimulatedFER.Downlink) {
 		OBJLOG(NOTICE) << "simulating dropped downlink frame at " << mNextWriteTime;
 		return;
 	}
@@ -2301,11 +2515,15 @@ void TCHFACCHL1Encoder::dispatch()
 	
 	// flag to control stealing bits
 	bool currentFACCH = false; 
+	// false to suppress the block in a downlink DTX speech pause
+	bool sendBlock = true;
+	// We do not send AMR SID frames, so AMR channels transmit continuously.
+	bool dtx = gConfig.GSM.DTX.Downlink && getAmrMode() == TCH_FS;
 	
 	// Speech latency control.
 	// Since Asterisk is local, latency should be small.
 	OBJLOG(DEBUG) <<"TCHFACCHL1Encoder speechQ.size=" << mSpeechQ.size();
-	int maxQ = gConfig.getNum("GSM.MaxSpeechLatency");
+	int maxQ = gConfig.GSM.MaxSpeechLatency;
 	while ((int)mSpeechQ.size() > maxQ) delete mSpeechQ.read();
 
 	// Send, by priority: (1) FACCH, (2) TCH, (3) filler.
@@ -2313,7 +2531,7 @@ void TCHFACCHL1Encoder::dispatch()
 		OBJLOG(DEBUG) <<"TCHFACCHL1Encoder FACCH " << *fFrame;
 		currentFACCH = true;
 		// Send to GSMTAP
-		if (gConfig.getBool("Control.GSMTAP.GSM")) {
+		if (gConfig.Control.GSMTAP.GSM) {
 			gWriteGSMTAP(ARFCN(),TN(),mNextWriteTime.FN(),typeAndOffset(),mMapping.repeatLength()>51,false,*fFrame);
 		}
 		// Copy the L2 frame into u[] for processing.
@@ -2326,40 +2544,69 @@ void TCHFACCHL1Encoder::dispatch()
 		delete fFrame;
 		// Flush the vocoder FIFO to limit latency.
 		while (mSpeechQ.size()>0) delete mSpeechQ.read();
-	} else if (AudioFrame *tFrame = mSpeechQ.readNoBlock()) {
-		OBJLOG(DEBUG) <<"TCHFACCHL1Encoder TCH " << *tFrame;
-		// Encode the speech frame into c[] as per GSM 05.03 3.1.2.
-		encodeTCH(tFrame);
-		delete tFrame;
-		OBJLOG(DEBUG) <<"TCHFACCHL1Encoder TCH c[]=" << mC;
 	} else {
-		// We have no ready data but must send SOMETHING.
-		if (!mPreviousFACCH) {
-			// This filler pattern was captured from a Nokia 3310, BTW.
-			static const BitVector2 fillerC("110100001000111100000000111001111101011100111101001111000000000000110111101111111110100110101010101010101010101010101010101010101010010000110000000000000000000000000000000000000000001101001111000000000000000000000000000000000000000000000000111010011010101010101010101010101010101010101010101001000011000000000000000000110100111100000000111001111101101000001100001101001111000000000000000000011001100000000000000000000000000000000000000000000000000000000001");
-			fillerC.copyTo(mC);
-		} else {
-			// FIXME -- This could be a lot more efficient.
-			currentFACCH = true;
-			L2Frame frame(L2IdleFrame());
-			frame.LSB8MSB();
-			frame.copyTo(mU);
-			encode41();
+		TCHFrameKind kind = TCHNoData;
+		if (AudioFrame *tFrame = mSpeechQ.readNoBlock()) {
+			OBJLOG(DEBUG) <<"TCHFACCHL1Encoder TCH " << *tFrame;
+			// Encode the speech frame into c[] as per GSM 05.03 3.1.2.
+			kind = encodeTCH(tFrame);
+			delete tFrame;
+			OBJLOG(DEBUG) <<"TCHFACCHL1Encoder TCH c[]=" << mC;
+		}
+		if (kind == TCHSpeech) {
+			mDTXPause = false;
+		} else if (dtx) {
+			// A speech pause.  GSM 06.31: send a SID frame at the start of the pause and then only in
+			// the SID position of each SACCH multiframe; the other blocks are not sent.
+			bool first = !mDTXPause;
+			mDTXPause = true;
+			if (first || isSIDBlock(mNextWriteTime)) {
+				if (kind != TCHSID) { encodeSID(); }
+				OBJLOG(DEBUG) <<"TCHFACCHL1Encoder DTX SID" <<LOGVAR(first);
+			} else {
+				sendBlock = false;
+			}
+		} else if (kind == TCHNoData) {
+			// We have no ready data but must send SOMETHING.
+			if (!mPreviousFACCH) {
+				// This filler pattern was captured from a Nokia 3310, BTW.
+				static const BitVector2 fillerC("110100001000111100000000111001111101011100111101001111000000000000110111101111111110100110101010101010101010101010101010101010101010010000110000000000000000000000000000000000000000001101001111000000000000000000000000000000000000000000000000111010011010101010101010101010101010101010101010101001000011000000000000000000110100111100000000111001111101101000001100001101001111000000000000000000011001100000000000000000000000000000000000000000000000000000000001");
+				fillerC.copyTo(mC);
+			} else {
+				// FIXME -- This could be a lot more efficient.
+				currentFACCH = true;
+				L2Frame frame(L2IdleFrame());
+				frame.LSB8MSB();
+				frame.copyTo(mU);
+				encode41();
+			}
+			OBJLOG(DEBUG) <<"TCHFACCHL1Encoder filler FACCH=" << currentFACCH << " c[]=" << mC;
 		}
-		OBJLOG(DEBUG) <<"TCHFACCHL1Encoder filler FACCH=" << currentFACCH << " c[]=" << mC;
 	}
 
 	// Interleave c[] to i[].
-	interleave31(mOffset);
+	if (sendBlock) { interleave31(mOffset); }
+
+	// The bursts carry half of this block and half of the previous one, so they are needed if either was sent.
+	// Otherwise C0 must keep transmitting, so it gets dummy bursts, and other carriers switch off.
+	bool sendBursts = sendBlock || mPrevBlockSent;
+	mPrevBlockSent = sendBlock;
 
 	// randomly toggle bits in control channel bursts
 	// the toggle happens below, merged in with the ciphering
-	int p = currentFACCH ? gConfig.getFloat("GSM.Cipher.CCHBER") * (float)0xFFFFFF : 0;
+	int p = currentFACCH ? gConfig.GSM.Cipher.CCHBER * (float)0xFFFFFF : 0;
 
 	// "mapping on a burst"
 	// Map c[] into outgoing normal bursts, marking stealing flags as needed.
 	// GMS 05.03 3.1.4.
 	for (int B=0; B<4; B++) {
+		if (!sendBursts) {
+			TxBurst idleBurst(mFillerBurst,mNextWriteTime);
+			idleBurst.atten(mCN == 0 ? 0 : TxBurst::cAttenOff);
+			mDownstream->writeHighSideTx(idleBurst,"DTX");
+			rollForward();
+			continue;
+		}
 		// set TDMA position
 		mBurst.time(mNextWriteTime);
 		// encrypt x
@@ -2410,6 +2657,7 @@ void TCHFACCHL1Encoder::dispatch()
 		mBurst.Hl(mPreviousFACCH);
 		// send
 		OBJLOG(DEBUG) <<"TCHFACCHEncoder sending burst=" << mBurst;
+		mBurst.atten(burstAtten());
 		mDownstream->writeHighSideTx(mBurst,"FACCH");	
 		rollForward();
 	}	
@@ -2452,7 +2700,7 @@ void MSPhysReportInfo::sacchInit1()
 {
 	mActualMSTiming = 0.0F;
 	// (pat) 6-2013: Bug fix: RSSI must be inited each time SACCH is opened, and to RSSITarget, not to 0.
-	mRSSI = gConfig.getNum("GSM.Radio.RSSITarget");
+	mRSSI = gConfig.GSM.Radio.RSSITarget;
 	// The RACH was sent at full power, but full power probably depends on the MS power class.  We just use a constant.
 	mActualMSPower = cInitialPower;
 	mReportCount = 0;
@@ -2483,6 +2731,7 @@ void SACCHL1Decoder::decInit()
 	// (pat) But what is the max power?  Does it depend on the MS class?
 	// Measured values should be set after opening with setPhy.
 	sacchInit1();
+	gMeasurementEngine.meReset(mMeasSlot);
 	XCCHL1Decoder::decInit();		// (pat) maps to L1Decoder::decInit()
 }
 
@@ -2526,8 +2775,8 @@ void MSPhysReportInfo::setPhy(const SACCHL1Decoder& other)
 
 static float boundMSPower(float orderedMSPower)
 {
-	float maxPower = gConfig.getNum("GSM.MS.Power.Max");
-	float minPower = gConfig.getNum("GSM.MS.Power.Min");
+	float maxPower = gConfig.GSM.MS.Power.Max;
+	float minPower = gConfig.GSM.MS.Power.Min;
 	if (orderedMSPower>maxPower) orderedMSPower=maxPower;
 	else if (orderedMSPower<minPower) orderedMSPower=minPower;
 	return orderedMSPower;
@@ -2541,7 +2790,7 @@ void SACCHL1Encoder::setMSPower(float orderedPower)
 void SACCHL1Encoder::setMSTiming(float orderedTiming)
 {
 	mOrderedMSTiming = orderedTiming;
-	float maxTiming = gConfig.getNum("GSM.MS.TA.Max");
+	float maxTiming = gConfig.GSM.MS.TA.Max;
 	if (mOrderedMSTiming<0.0F) mOrderedMSTiming=0.0F;
 	else if (mOrderedMSTiming>maxTiming) mOrderedMSTiming=maxTiming;
 }
@@ -2558,7 +2807,7 @@ void SACCHL1Encoder::initPhy(float wRSSI, float wTimingError)
 	// Arbitrarily goose the initial power up a little (10) by adjusting RSSITarget, just to make sure we get an ok initialization,
 	// in case the RSSI measured power was inaccurate, or there is noise in the channel.
 	//float RSSI = sib.getRSSI();
-	float RSSITarget = gConfig.getNum("GSM.Radio.RSSITarget") + 10;
+	float RSSITarget = gConfig.GSM.Radio.RSSITarget + 10;
 	float deltaP = wRSSI - RSSITarget;
 	//float actualPower = sib.actualMSPower();	// This is just set to cInitialPower.
 	//setMSPower(actualPower - deltaP);
@@ -2632,58 +2881,9 @@ void SACCHL1Encoder::sendFrame(const L2Frame& frame)
 	OBJLOG(BLATHER) << "SACCHL1Encoder " << frame;
 
 	// Physical header, GSM 04.04 6, 7.1
-	// Power and timing control, GSM 05.08 4, GSM 05.10 5, 6.
-
-	SACCHL1Decoder &sib = *SACCHSibling();
-
-	if (sib.isValid()) {
-		// Power.  GSM 05.08 4.
-		// Power expressed in dBm, RSSI in dB wrt max.
-		float RSSI = sib.getRSSI();
-		float RSSITarget = gConfig.getNum("GSM.Radio.RSSITarget");
-		// (pat) RSSI and RSSITarget are both negative, so deltaP is positive if power is too high.
-		float deltaP = RSSI - RSSITarget;
-		// SNRTarget == 0 disables:
-		if (float SNRTarget = gConfig.getNum("GSM.Radio.SNRTarget")) {
-			float SNR = sib.getAveSNR();
-			if (deltaP > 0 && SNR < SNRTarget) {	// If RSSITarget is met but SNR looks bad...
-				// How do we decide what the target power should be from SNR?  And I dont want to call log().
-				// We only change upward based on SNR - we rely on RSSITarget to keep the power down.
-				deltaP = SNR - SNRTarget;	// So how about something simple like this?  eg: SNR == 10 is ok, SNR==6 would be bad, so add 4dB?  
-			}
-		}
-		float actualPower = sib.actualMSPower();
-		int configPowerDamping = gConfig.getNum("GSM.MS.Power.Damping");
-		// Use the power damping algorithm.
-		float targetMSPower = actualPower - deltaP;
-		float powerDamping = configPowerDamping*0.01F;
-		if (configPowerDamping < 90 && deltaP < 4) {
-			// (pat 2-2014) Adjust the power in the upward direction faster than in the downward direction
-			// if we are in danger of losing the signal.
-			// This is intended to lessen signal degradation from, eg, just turning your head.
-			// But this may not be worth the effort.  If the signal has dropped much lower than this
-			// we will already have lost communication with the MS so we will never get here,
-			// instead RSSIBumpDown will be used, although that could indirectly induce this greater jump here.
-			powerDamping /= 2;	// This should probably be log response.
-		}
-		// (pat) Now, how fast does RSSI as seen in OpenBTS respond to changes ordered in the MS by mOrderedPower?
-		// Do we need the damping factor to take that into account, or should we instead wait a bit after ordering
-		// a power change before ordering another?  I guess we rely on the powerDamping factor to handle it.
-		setMSPower(powerDamping*mOrderedMSPower + (1.0F-powerDamping)*targetMSPower);
-		OBJLOG(DEBUG) <<"SACCHL1Encoder RSSI=" << RSSI << " target=" << RSSITarget
-			<< " deltaP=" << deltaP << " actual=" << actualPower << " order=" << mOrderedMSPower;
-		// Timing.  GSM 05.10 5, 6.
-		// Time expressed in symbol periods.
-		float timingError = sib.timingError();
-		float actualTiming = sib.actualMSTiming();
-		float targetMSTiming = actualTiming + timingError;
-		float TADamping = gConfig.getNum("GSM.MS.TA.Damping")*0.01F;
-		setMSTiming(TADamping*mOrderedMSTiming + (1.0F-TADamping)*targetMSTiming);
-		OBJLOG(DEBUG) << "SACCHL1Encoder timingError=" << timingError
-			<< " actualTA=" << actualTiming << " orderedTA=" << mOrderedMSTiming
-			<< " targetTA=" << targetMSTiming;
+	// Power and timing control, GSM 05.08 4, GSM 05.10 5, 6, is done by the measurement engine once per
+	// reporting period; here we just send the current orders.
 
-	}
 	// Write physical header into mU and then call base class.
 
 	// SACCH physical header, GSM 04.04 6.1, 7.1.
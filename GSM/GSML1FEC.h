@@ -132,6 +132,7 @@ class L1Encoder {
 	mutable Mutex mWriteTimeLock;
 
 	volatile bool mRunning;			///< true while the service loop is running
+	volatile int mTxAtten;			///< downlink power reduction ordered by power control, dB
 	Bool_z mEncActive;				///< true between open() and close()
 	Bool_z mEncEverActive;			// true if the encoder has ever been active.
 	//@}
@@ -181,6 +182,14 @@ class L1Encoder {
 	//@}
 	//@}
 
+	/**@name Downlink power control, set by the measurement engine and cleared by encInit. */
+	//@{
+	void setTxAtten(int dB) { mTxAtten = dB; }
+	int txAtten() const { return mTxAtten; }
+	/** The reduction to apply to the next burst.  GSM 05.08 7.1: the BCCH carrier is always sent at full power. */
+	unsigned burstAtten() const { return (mCN == 0 || mTxAtten < 0) ? 0 : mTxAtten; }
+	//@}
+
 	/** Close the channel after blocking for flush.  */
 	virtual void close();
 
@@ -232,6 +241,8 @@ class L1Encoder {
 
 	/** Block until the BTS clock catches up to mPrevWriteTime.  */
 	void waitToSend() const;
+	/** True if waitToSend would block now. */
+	bool sendWouldBlock() const;
 
 	/**
 		Send the dummy filling pattern, if any.
@@ -264,6 +275,8 @@ struct DecoderStats {
 	int mStatTotalFrames;
 	int mStatStolenFrames;
 	int mStatBadFrames;
+	int mStatCombineTries;		// Failed blocks re-decoded by soft combining with an earlier failed block.
+	int mStatCombineRecovered;	// Those that then passed parity.
 	void decoderStatsInit();
 	void countSNR(const RxBurst &burst);
 };
@@ -412,6 +425,7 @@ class L1Decoder {
 
 	/**@name Components of the channel description. */
 	//@{
+	unsigned CN() const { return mCN; }
 	unsigned TN() const { return mTN; }
 	unsigned ARFCN() const;                 ///< this comes from mUpstream
 	TypeAndOffset typeAndOffset() const;    ///< this comes from mMapping
@@ -642,6 +656,9 @@ class L1FEC {
 	unsigned ARFCN() const	// Absolute Radio Frequence Channel Number.
 		{ assert(mEncoder); return mEncoder->ARFCN(); }
 
+	void setTxAtten(int dB)	// Downlink power reduction for the current call.
+		{ assert(mEncoder); mEncoder->setTxAtten(dB); }
+
 	float FER() const		// Frame Error Rate
 		{ assert(mDecoder); return mDecoder->FER(); }
 
@@ -842,6 +859,30 @@ class XCCHL1Decoder :
 
 	protected:
 
+	/**@name Chase combining of repeated blocks, GSM.Radio.ChaseCombining. */
+	// LAPDm retransmits an unacknowledged I-frame unchanged and the MS repeats SACCH blocks
+	// when asked to, so a block that failed parity is frequently followed shortly by another copy.
+	// We keep the soft c[] of the last failed block; when the next block also fails we add the
+	// log-likelihood ratios of the two and decode again.  The 40 bit fire code makes a false
+	// positive on two different messages as unlikely as on noise.
+	//@{
+	SoftVector mChaseC;				///< c[] of the most recent block that failed parity
+	SoftVector mChaseFresh;			///< scratch copy of the current c[]
+	int32_t mChaseFN;				///< frame number of mChaseC, -1 if empty
+	/**
+		Called after mC, the block ending at FN, failed to decode.  Try again with mC combined with the saved block.
+		On success mU/mD hold the result, on failure mC is unchanged and is saved for next time.
+		@return true if the combined block passed parity.
+	*/
+	bool chaseDecode(int32_t FN);
+	void chaseClear() { mChaseFN = -1; }
+	//@}
+
+	public:
+	/** Extend decInit() to forget any block saved for combining. */
+	void decInit() { chaseClear(); L1Decoder::decInit(); }
+	protected:
+
 	/** Offset to the start of the L2 header. */
 	virtual unsigned headerOffset() const { return 0; }
 
@@ -886,17 +927,18 @@ class SDCCHL1Decoder : public XCCHL1Decoder {
 // and the measurement reports are up in Layer 2.
 class MSPhysReportInfo {
 	public:	// dont know why we bother
-	unsigned mReportCount;			// Number of measurement reports received so far (not including the initial RACH); used for averaging RSSI and others.
+	volatile unsigned mReportCount;	// Number of SACCH bursts received so far (not including the initial RACH); counted as they arrive so isValid() does not wait for the engine.
 	volatile float mRSSI;			///< most recent RSSI, dB wrt full scale (Received Signal Strength derived from our measurement of the received burst).
 	volatile float mTimingError;		///< Timing error history in symbols (derived from our measurement of the received burst).
 	volatile double mTimestamp;		///< system time of most recent received burst, including the initial RACH burst.
 	volatile int mActualMSPower;		///< actual MS tx power in dBm (that the MS reported to us)
 	volatile int mActualMSTiming;		///< actual MS tx timing advance in symbols (that the MS reported to us)
+	int mMeasSlot;						///< Our slot in gMeasurementEngine, or -1.
 	void sacchInit1();
 	void sacchInit2(float wRSSI, float wTimingError, double wTimestamp);
 	public:
 	// constructor is irrelevant, should call sacchInit via open() before each use, but be tidy.
-	MSPhysReportInfo() { sacchInit1(); }	// Unused init
+	MSPhysReportInfo() : mMeasSlot(-1) { sacchInit1(); }	// Unused init
 
 	bool isValid() const { return mReportCount > 0; }
 	int actualMSPower() const { return mActualMSPower; }
@@ -913,8 +955,9 @@ class MSPhysReportInfo {
 		return mRSSI + gConfig.GSM.MS.Power.Max - mActualMSPower;
 	}
 	
-	/** Artificially push down RSSI to induce the handset to push more power. */
-	void RSSIBumpDown(float dB) { mRSSI -= dB; }
+	/** Artificially push down RSSI to induce the handset to push more power.
+		With a measurement engine slot the engine applies it, since the engine owns the RSSI average. */
+	void RSSIBumpDown(float dB);
 
 	/** Timestamp of most recent received burst. */
 	// (pat) Since BTS started, in seconds, with uSec resolution.
@@ -1040,6 +1083,13 @@ class XCCHL1Encoder :
 // upstream flow:
 //		speechQ
 
+/** What a downlink vocoder frame turned out to be. */
+enum TCHFrameKind {
+	TCHSpeech,		///< Speech, encoded into c[].
+	TCHSID,			///< A TCH_FS SID frame, encoded into c[].
+	TCHNoData		///< Nothing to send, eg an AMR SID or NO_DATA frame; c[] is untouched.
+};
+
 class TCHFRL1Encoder : virtual public SharedL1Encoder
 {
 	// Shared AMR and GSM_FR variables:
@@ -1064,21 +1114,35 @@ class TCHFRL1Encoder : virtual public SharedL1Encoder
 	const unsigned *mPuncture;
 	unsigned mPunctureLth;
 
-	void encodeTCH_AFS(const SIP::AudioFrame* vFrame);
-	void encodeTCH_GSM(const SIP::AudioFrame* vFrame);
+	// Comfort noise parameters of the last few downlink TCH_FS speech frames, for SID frames.  GSM 06.12 5.
+	static const unsigned cCNFrames = 4;
+	unsigned char mCNParams[cCNFrames][12];	///< LAR 1-8 then xmax of each sub-frame, as coded
+	unsigned mCNCount;						///< Number of speech frames recorded so far.
+
+	TCHFrameKind encodeTCH_AFS(const SIP::AudioFrame* vFrame);
+	TCHFrameKind encodeTCH_GSM(const SIP::AudioFrame* vFrame);
+	void encodeTCH_GSMRaw();
 	void setViterbi(AMRMode wMode) {
 		if (mViterbi) { delete mViterbi; }
 		mViterbi = newViterbi(wMode);
 	}
 	public:
 	unsigned getTCHPayloadSize() { return GSM::gAMRKd[mAMRMode]; }	// decoded payload size.
+	AMRMode getAmrMode() const { return mAMRMode; }
 	void setAmrMode(AMRMode wMode);
-	/** Encode a full speed AMR vocoder frame into c[]. */
-	void encodeTCH(const SIP::AudioFrame* aFrame);	// Not that the const does any good.
+	/**
+		Encode a full speed AMR vocoder frame into c[] and say what it was.
+		Nothing is encoded for TCHNoData, which includes AMR SID frames since we do not send them in-band.
+	*/
+	TCHFrameKind encodeTCH(const SIP::AudioFrame* aFrame);	// Not that the const does any good.
+	/** Encode a TCH_FS SID frame with comfort noise from the recent speech frames into c[].  GSM 06.12 5.2. */
+	void encodeSID();
+	/** Forget the comfort noise parameters of the last call. */
+	void resetComfortNoise() { mCNCount = 0; }
 
 	// (pat) Irritating and pointless but harmless double-initialization of Parity and BitVector2s.  Stupid language.
 	// (pat) Assume TCH_FS until someone changes the mode to something else.
-	TCHFRL1Encoder() : mViterbi(0), mTCHParity(0,0,0) { setAmrMode(TCH_FS); }
+	TCHFRL1Encoder() : mViterbi(0), mTCHParity(0,0,0), mCNCount(0) { setAmrMode(TCH_FS); }
 	//string debugId() const { static string id; return id.size() ? id : (id=format("TCHFRL1Encoder %s ",descriptiveString())); }
 };
 
@@ -1098,6 +1162,13 @@ class TCHFACCHL1Encoder :
 
 	BitVector2 mFillerC;				///< copy of previous c[] for filling dead time
 
+	/**@name Downlink DTX, GSM 06.31. */
+	//@{
+	bool mDTXPause;			///< true during a speech pause
+	bool mPrevBlockSent;	///< false if the previous block was suppressed, so its half of the bursts is free
+	bool isSIDBlock(const Time &when) const;
+	//@}
+
 	AudioFrameFIFO mSpeechQ;		///< input queue for speech frames
 
 	L2FrameFIFO mL2Q;				///< input queue for L2 FACCH frames
@@ -1151,6 +1222,7 @@ class TCHFRL1Decoder : virtual public SharedL1Decoder
 	Parity mTCHParity;
 	BitVector2 mPrevGoodFrame;	///< current and previous good frame
 	unsigned mNumBadFrames;		// Number of bad frames in a row.
+	bool mPrevGoodSID;			///< The last good TCH_FS frame was a SID frame, so the MS is in a DTX speech pause.
 
 	BitVector2 mTCHU;					///< u[] (uncoded) in the spec
 	BitVector2 mTCHD;					///< d[] (data) in the spec
@@ -1183,6 +1255,8 @@ class TCHFRL1Decoder : virtual public SharedL1Decoder
 		Return true if there's a good frame.
 	*/
 	bool decodeTCH(bool stolen, const SoftVector *wC);	// result goes to mSpeechQ
+	/** Send comfort noise upstream for a block the MS did not transmit because of uplink DTX. */
+	void decodeTCHIdle();
 	void setAmrMode(AMRMode wMode);
 
 	// (pat) Irritating and pointless but harmless double-initialization of Parity and BitVector2s.  Stupid language.
@@ -1213,6 +1287,13 @@ class TCHFACCHL1Decoder :
 	SoftVector mI[8];	///< deinterleaving history, 8 blocks instead of 4
 	AudioFrameFIFO mSpeechQ;					///< output queue for speech frames
 	unsigned stealBitsU[8], stealBitsL[8];	// (pat 1-16-2014) These are single bits; the upper and lower stealing bits found in incoming bursts.
+	unsigned mRxBursts;		///< Bit B is set if burst B of the deinterleaving buffer was received; used for uplink DTX.
+	int mLastFN;			///< FN of the last burst received, or -1 since the channel opened.
+	volatile unsigned mSkippedFrames;	///< speech frames of a long gap that were not queued, for the RTP timestamps
+	static const int cMaxFillBlocks = 2;	///< blocks of a gap that fillMissingBursts decodes
+
+	void fillMissingBursts(int FN);
+	void decodeBlock(int B);
 
 	public:
 	TCHFACCHL1Decoder(unsigned wCN, unsigned wTN, 
@@ -1221,6 +1302,9 @@ class TCHFACCHL1Decoder :
 
 	ChannelType channelType() const { return FACCHType; }
 
+	/** Extend decInit() to start a new channel with an empty deinterleaving buffer. */
+	void decInit();
+
 	/** TCH/FACCH has a special-case writeLowSide. */
 	void writeLowSideRx(const RxBurst& inBurst);
 
@@ -1251,6 +1335,8 @@ class TCHFACCHL1Decoder :
 
 	/** Return count of internally-queued traffic frames. */
 	unsigned queueSize() const { return mSpeechQ.size(); }
+	/** Return and clear the count of speech frames skipped in uplink gaps since the last call. */
+	unsigned takeSkippedFrames() { return __sync_lock_test_and_set(&mSkippedFrames,0); }
 	const char* descriptiveString() const { return L1Decoder::descriptiveString(); }
 	//string debugId() const { static string id; return id.size() ? id : (id=format("TCHFACCHL1Decoder %s ",descriptiveString())); }
 
@@ -1438,6 +1524,8 @@ class SACCHL1Encoder : public XCCHL1Encoder {
 	//void orderedMSTiming(int timing) { mOrderedMSTiming = timing; }
 	void setMSPower(float orderedMSPower);
 	void setMSTiming(float orderedTiming);
+	float orderedMSPower() const { return mOrderedMSPower; }
+	float orderedMSTiming() const { return mOrderedMSTiming; }
 
 	void setPhy(const SACCHL1Encoder&);
 	void initPhy(float RSSI, float timingError);
@@ -1582,6 +1670,9 @@ public:
 	unsigned queueSize() const
 		{ assert(mTCHDecoder); return mTCHDecoder->queueSize(); }
 
+	unsigned takeSkippedFrames()
+		{ assert(mTCHDecoder); return mTCHDecoder->takeSkippedFrames(); }
+
 	//string debugId() const { static string id; return id.size() ? id : (id=format("TCHFACCHL1FEC %s ",descriptiveString())); }
 };
 
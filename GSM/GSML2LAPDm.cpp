@@ -42,6 +42,9 @@ implementation, although no code is copied directly.
 #include <Logger.h>
 #include <GSML3RRMessages.h>
 #include <L3StateMachine.h>
+#include <GSMConfig.h>
+#include <deque>
+#include <vector>
 
 using namespace std;
 using namespace GSM;
@@ -49,6 +52,254 @@ using namespace GSM;
 //#define NDEBUG
 
 
+// An uplink frame on its way from L1 to LAPDm.  These are recycled through a free list, so after startup
+// moving a frame from L1 to L2 costs one copy of the bits into a pooled buffer and no allocation.
+struct GSM::LAPDmInFrame {
+	L2Frame mFrame;
+	LAPDmInFrame *mNext;
+};
+
+
+/**
+	All the LAPDm instances, SAP0 and SAP3 on every SDCCH, FACCH and SACCH, share this engine instead of
+	each having its own upstream thread.  An instance is queued to the worker pool when L1 hands it a frame
+	or when its T200 expires.  T200 is kept in a hierarchical timer wheel driven by the TDMA frame clock,
+	so there is no per-instance polling at all.  Each instance is serviced by at most one worker at a time.
+	A worker can block in writeL1 waiting for its L1 encoder to catch up to the clock, for up to one block
+	period of that channel; while it does the engine starts another worker if too few would be left,
+	the same as the DCCH dispatcher does for Layer 3.  Workers beyond GSM.LAPDm.Workers exit after
+	cWorkerIdleMsecs without work.
+*/
+class GSM::LAPDmEngine {
+	enum EngineState { esIdle, esQueued, esRunning, esRunningAgain };
+	static const unsigned cWorkerIdleMsecs = 60000;
+
+	struct Worker {
+		LAPDmEngine *mEngine;
+		Thread mThread;
+		Worker(LAPDmEngine *wEngine) : mEngine(wEngine) {}
+	};
+
+	Mutex mLock;
+	Signal mWork;
+	std::deque<L2LAPDm*> mRunQ;
+	unsigned mMinFree;			///< Configured number of workers that should be free to run.
+	unsigned mWorkers;			///< Number of worker threads started.
+	unsigned mBlocked;			///< Number of workers blocked in writeL1.
+	bool mStarted;
+	Thread mTickThread;
+	std::vector<Worker*> mRetired;	///< Workers that have exited, joined by the tick thread.
+
+	/**@name The T200 timer wheel, in TDMA frames.  Level 0 covers the next 256 frames (1.2s) a frame per slot,
+		level 1 the next 64*256 frames (75s) 256 frames per slot.  Entries are never removed early; a stale
+		entry just wakes the instance, which then finds T200 not expired.  The frame ticks can run ahead of
+		wall time, eg, catching up after a stall, so an instance woken by the wheel before T200 has expired
+		schedules itself again for the time remaining. */
+	//@{
+	struct WheelEntry {
+		L2LAPDm *mLapdm;
+		unsigned long long mWhen;
+		WheelEntry(L2LAPDm *wLapdm, unsigned long long wWhen) : mLapdm(wLapdm), mWhen(wWhen) {}
+	};
+	Mutex mWheelLock;
+	unsigned long long mTicks;	///< Frames since the engine started.
+	std::vector<WheelEntry> mLevel0[256];
+	std::vector<WheelEntry> mLevel1[64];
+	//@}
+
+	/**@name Free list of uplink frames. */
+	//@{
+	Mutex mPoolLock;
+	LAPDmInFrame *mFreeFrames;
+	//@}
+
+	// Caller holds mLock.
+	void makeReady(L2LAPDm *lapdm) {
+		switch (lapdm->mEngineState) {
+			case esIdle:
+				lapdm->mEngineState = esQueued;
+				mRunQ.push_back(lapdm);
+				mWork.signal();
+				break;
+			case esRunning:
+				lapdm->mEngineState = esRunningAgain;
+				break;
+			default:	// Already queued or marked.
+				break;
+		}
+	}
+
+	// Caller holds mLock.
+	void startWorker() {
+		mWorkers++;
+		Worker *worker = new Worker(this);
+		// Try a 32K stack for 32 bit machines, same as the old per-instance threads.
+		worker->mThread.start2((void*(*)(void*))workerLoopAdapter,worker,8000*sizeof(void*));
+	}
+
+	void reapWorkers() {
+		std::vector<Worker*> retired;
+		{	ScopedLock lock(mLock);
+			retired.swap(mRetired);
+		}
+		for (std::vector<Worker*>::iterator it = retired.begin(); it != retired.end(); it++) {
+			(*it)->mThread.join();
+			delete *it;
+		}
+	}
+
+	// Caller holds mWheelLock.
+	void insert(const WheelEntry &entry) {
+		unsigned long long delta = entry.mWhen - mTicks;
+		if (delta < 256) {
+			mLevel0[entry.mWhen & 255].push_back(entry);
+		} else {
+			mLevel1[(entry.mWhen >> 8) & 63].push_back(entry);
+		}
+	}
+
+	void tick() {
+		std::vector<WheelEntry> due;
+		{
+			ScopedLock lock(mWheelLock);
+			mTicks++;
+			if ((mTicks & 255) == 0) {
+				// Cascade the next level 1 slot into level 0.
+				std::vector<WheelEntry> &slot1 = mLevel1[(mTicks >> 8) & 63];
+				std::vector<WheelEntry> later;
+				for (std::vector<WheelEntry>::iterator it = slot1.begin(); it != slot1.end(); it++) {
+					if (it->mWhen - mTicks < 256) { mLevel0[it->mWhen & 255].push_back(*it); }
+					else { later.push_back(*it); }	// Not possible with T200 values, but be safe.
+				}
+				slot1.swap(later);
+			}
+			due.swap(mLevel0[mTicks & 255]);
+		}
+		if (due.empty()) { return; }
+		ScopedLock lock(mLock);
+		for (std::vector<WheelEntry>::iterator it = due.begin(); it != due.end(); it++) {
+			it->mLapdm->mT200Wake = true;
+			makeReady(it->mLapdm);
+		}
+	}
+
+	void workerLoop(Worker *self);
+	void tickLoop();
+	static void *workerLoopAdapter(Worker *worker) { worker->mEngine->workerLoop(worker); return NULL; }
+	static void *tickLoopAdapter(LAPDmEngine *engine) { engine->tickLoop(); return NULL; }
+
+	public:
+	LAPDmEngine() : mMinFree(0), mWorkers(0), mBlocked(0), mStarted(false), mTicks(0), mFreeFrames(NULL) {}
+
+	void start() {
+		ScopedLock lock(mLock);
+		if (mStarted) { return; }
+		mStarted = true;
+		mMinFree = gConfig.getNum("GSM.LAPDm.Workers");
+		while (mWorkers < mMinFree) { startWorker(); }
+		mTickThread.start((void*(*)(void*))tickLoopAdapter,this);
+	}
+
+	void ready(L2LAPDm *lapdm) {
+		ScopedLock lock(mLock);
+		makeReady(lapdm);
+	}
+
+	void scheduleT200(L2LAPDm *lapdm, unsigned msecs) {
+		// Round up, and one more because the current frame is partly gone.
+		unsigned frames = (msecs * 1000 + gFrameMicroseconds - 1) / gFrameMicroseconds + 1;
+		ScopedLock lock(mWheelLock);
+		insert(WheelEntry(lapdm,mTicks + frames));
+	}
+
+	bool blockingBegin();
+	void blockingEnd() { ScopedLock lock(mLock); assert(mBlocked); mBlocked--; }
+
+	LAPDmInFrame *allocFrame(const L2Frame &frame) {
+		LAPDmInFrame *result;
+		{
+			ScopedLock lock(mPoolLock);
+			result = mFreeFrames;
+			if (result) { mFreeFrames = result->mNext; }
+		}
+		if (result == NULL) { result = new LAPDmInFrame; }
+		frame.copyTo(result->mFrame);
+		result->mFrame.primitive(frame.primitive());
+		result->mNext = NULL;
+		return result;
+	}
+
+	void freeFrames(LAPDmInFrame *list) {
+		if (list == NULL) { return; }
+		LAPDmInFrame *last = list;
+		while (last->mNext) { last = last->mNext; }
+		ScopedLock lock(mPoolLock);
+		last->mNext = mFreeFrames;
+		mFreeFrames = list;
+	}
+};
+
+static GSM::LAPDmEngine gLAPDmEngine;
+
+// Set in the engine worker threads so writeL1 can tell whether it is blocking one.
+static __thread bool sIsLAPDmWorker = false;
+
+bool GSM::LAPDmEngine::blockingBegin()
+{
+	ScopedLock lock(mLock);
+	mBlocked++;
+	if (mWorkers - mBlocked < mMinFree) { startWorker(); }
+	return true;
+}
+
+void GSM::LAPDmEngine::workerLoop(Worker *self)
+{
+	sIsLAPDmWorker = true;
+	Timeval idleLimit(cWorkerIdleMsecs);
+	mLock.lock();
+	while (! gBTS.btsShutdown()) {
+		if (mRunQ.empty()) {
+			if (idleLimit.passed() && mWorkers - mBlocked > mMinFree) {
+				mWorkers--;
+				mRetired.push_back(self);
+				break;
+			}
+			mWork.wait(mLock,cWorkerIdleMsecs);
+			continue;
+		}
+		L2LAPDm *lapdm = mRunQ.front();
+		mRunQ.pop_front();
+		lapdm->mEngineState = esRunning;
+		bool t200Wake = lapdm->mT200Wake;
+		lapdm->mT200Wake = false;
+		mLock.unlock();
+
+		lapdm->lapService(t200Wake);
+		idleLimit.future(cWorkerIdleMsecs);
+
+		mLock.lock();
+		if (lapdm->mEngineState == esRunningAgain) {
+			lapdm->mEngineState = esQueued;
+			mRunQ.push_back(lapdm);
+		} else {
+			lapdm->mEngineState = esIdle;
+		}
+	}
+	mLock.unlock();
+}
+
+void GSM::LAPDmEngine::tickLoop()
+{
+	Time next = gBTS.time();
+	while (! gBTS.btsShutdown()) {
+		next = next + 1;
+		gBTS.clock().wait(next);
+		tick();
+		if ((next.FN() & 255) == 0) { reapWorkers(); }
+	}
+}
+
+
 ostream& GSM::operator<<(ostream& os, LAPDState state)
 {
 	switch (state) {
@@ -67,6 +318,9 @@ ostream& GSM::operator<<(ostream& os, LAPDState state)
 
 L2LAPDm::L2LAPDm(unsigned wC, SAPI_t wSAPI)
 	:mRunning(false),
+	mL1In(NULL),
+	mEngineState(0),
+	mT200Wake(false),
 	mC(wC),mR(1-wC),mSAPI(wSAPI),
 	mMaster(NULL),
 	mState(LAPDStateUnused),
@@ -96,8 +350,20 @@ void L2LAPDm::writeL1(const L2Frame& frame)
 	// It is tempting not to lock this, but if we don't,
 	// the ::open operation can result in contention in L1.
 	ScopedLock lock(mL1Lock);
+	// This may block for up to a block period of the channel; don't let that starve the other LAPDm instances.
+	// Most writes are paced by the encoder and do not wait, and those need no replacement worker.
+	bool blocking = sIsLAPDmWorker && mL2Downstream->l1WriteWouldBlock() && gLAPDmEngine.blockingBegin();
 	//mL2Downstream->sapWriteHighSide(frame);	// (pat) This blocks in L1Encoder::transmit until the time has passed.
 	mL2Downstream->writeToL1(frame);	// (pat) This blocks in L1Encoder::transmit until the start time has passed.
+	if (blocking) { gLAPDmEngine.blockingEnd(); }
+}
+
+
+void L2LAPDm::startT200()
+{
+	// Caller should hold mLock.
+	mT200.set(T200());
+	gLAPDmEngine.scheduleT200(this,T200());
 }
 
 
@@ -137,7 +403,7 @@ void L2LAPDm::writeL1Ack(const L2Frame& frame)
 	frame.copyTo(mSentFrame);
 	mSentFrame.primitive(frame.primitive());
 	writeL1(frame);
-	mT200.set(T200());
+	startT200();
 }
 
 
@@ -148,6 +414,7 @@ void L2LAPDm::waitForAck()
 	// Caller should hold mLock.
 	//OBJLOG(DEBUG) <<"L2LAPDm::waitForAck state=" << mState << " VS=" << mVS << " VA=" << mVA;
 	OBJLOG(DEBUG) <<"L2LAPDm::waitForAck ";		// OBJLOG prints the entire LAPDm object now.
+	Control::DCCHBlocking blocking(false);	// Tell the DCCH dispatcher if we actually wait.
 	while (true) {
 		if (mState==LinkReleased) break;
 		if ((mState==ContentionResolution) && (mVS==mVA)) break;
@@ -155,6 +422,7 @@ void L2LAPDm::waitForAck()
 		// HACK -- We should not need a timeout here.
 		// (pat) When we send a RELEASE the calling thread blocks FOREVER so this timeout
 		// is needed to prevent the channel from hanging.  It will be gone for 30 secs.
+		blocking.begin();
 		mAckSignal.wait(mLock,N200()*T200ms);
 		//OBJLOG(DEBUG) <<"L2LAPDm::waitForAck state=" << mState << " VS=" << mVS << " VA=" << mVA;
 		OBJLOG(DEBUG) <<"L2LAPDm::waitForAck ";
@@ -306,7 +574,7 @@ void L2LAPDm::retransmissionProcedure()
 	OBJLOG(DEBUG);//<< "VS=" << mVS << " VA=" << mVA << " RC=" << mRC;
 	mRC++;
 	writeL1(mSentFrame);
-	mT200.set(T200());
+	startT200();
 	mAckSignal.signal();
 }
 
@@ -326,12 +594,11 @@ void L2LAPDm::l2dlOpen(std::string wDescriptiveString)
 			// since N201 may not be defined yet.
 			mMaxIPayloadBits = 8*N201(L2Control::IFormat);
 			mRunning = true;
-			// Try a 32K stack for 32 bit machines.
-			mUpstreamThread.start2((void *(*)(void*))LAPDmServiceLoopAdapter,this, 8000*sizeof(void*));
+			gLAPDmEngine.start();
 		}
 		OBJLOG(DEBUG);
 		//mL3Out.clear();
-		mL1In.clear();
+		gLAPDmEngine.freeFrames(__sync_lock_test_and_set(&mL1In,(LAPDmInFrame*)NULL));
 		clearCounters();
 		mState = LinkReleased;
 		mAckSignal.signal();
@@ -342,13 +609,6 @@ void L2LAPDm::l2dlOpen(std::string wDescriptiveString)
 	OBJLOG(DEBUG);
 }
 
-void *GSM::LAPDmServiceLoopAdapter(L2LAPDm *lapdm)
-{
-	lapdm->lapServiceLoop();
-	return NULL;
-}
-
-
 void L2LAPDm::normalRelease()
 {
 	LOG(DEBUG) <<this;
@@ -363,7 +623,7 @@ void L2LAPDm::normalRelease()
 	clearCounters();
 	mEstablishmentInProgress=false;
 	mState=AwaitingRelease;
-	mT200.set(T200());	// HACK?
+	startT200();	// HACK?
 	// Send DISC and wait for UA.
 	// Don't return until released.
 	sendUFrameDISC();
@@ -437,51 +697,44 @@ void L2LAPDm::l2dlWriteHighSide(const L3Frame& frame)
 void L2LAPDm::l2dlWriteLowSide(const L2Frame& frame)
 {
 	OBJLOG(DEBUG) << frame;
-	mL1In.write(new L2Frame(frame));
+	// Push onto the lock-free incoming stack; lapService reverses it back into arrival order.
+	LAPDmInFrame *in = gLAPDmEngine.allocFrame(frame);
+	LAPDmInFrame *head;
+	do {
+		head = mL1In;
+		in->mNext = head;
+	} while (! __sync_bool_compare_and_swap(&mL1In,head,in));
+	gLAPDmEngine.ready(this);
 }
 
 
 
-void L2LAPDm::lapServiceLoop()
+void L2LAPDm::lapService(bool t200Wake)
 {
-	mLock.lock();
-	while (mRunning) {
-		// Block for up to T200 expiration, then check T200.
-		// Allow other threads to modify state while blocked.
-		// Add 2 ms to prevent race condition due to roundoff error.
-		unsigned timeout = mT200.remaining() + 2;
-		// If SAP0 is released, other SAPs need to release also.
-
-		// (pat 6-2014) This seems to be a bug fix to compensate for improper initialization,
-		// and it depended on the mMaster only being set on the host channel,
-		// since if you set it on sacch it will keep anything from ever going through since sap0 is always in idle (LinkReleased) state.
-		// if (mMaster) {
-		//	if (mMaster->mState==LinkReleased) {
-		//		OBJLOG(DEBUG) << "master release";
-		//		mState=LinkReleased;
-		//	}
-		// }
-
-		if (!mT200.active()) {
-			if (mState==LinkReleased) timeout=3600000;
-			else timeout = T200();	// currently 3.6sec  (pat) Looks like .9 secs on TCH,SDCCH and 4*.9 on SACCH.  Why?
-			// (pat) FIXME: T3111 must be longer that this, right?
-		}
-		OBJLOG(DEBUG) << "read blocking up to " << timeout << " ms ";//, state=" << mState;
-		mLock.unlock();
-		// FIXME -- If the link is released, there should be no timeout at all.
-		L2Frame* frame = mL1In.read(timeout);
-		LOG(DEBUG);
-		mLock.lock();
-		if (frame!=NULL) {
-			//OBJLOG(DEBUG) << "state=" << mState << " received " << *frame;
-			OBJLOG(DEBUG) << " received " << *frame;
-			receiveFrame(*frame);
-			delete frame;
-		}
-		if (mT200.expired()) T200Expiration();
+	// Take everything L1 has delivered so far in one swap.
+	LAPDmInFrame *list = __sync_lock_test_and_set(&mL1In,(LAPDmInFrame*)NULL);
+	LAPDmInFrame *fifo = NULL;
+	while (list) {
+		LAPDmInFrame *next = list->mNext;
+		list->mNext = fifo;
+		fifo = list;
+		list = next;
+	}
+
+	ScopedLock lock(mLock);
+	if (!mRunning) { gLAPDmEngine.freeFrames(fifo); return; }
+	for (LAPDmInFrame *in = fifo; in; in = in->mNext) {
+		OBJLOG(DEBUG) << " received " << in->mFrame;
+		receiveFrame(in->mFrame);
+	}
+	gLAPDmEngine.freeFrames(fifo);
+	// T200 wakes us through the engine timer wheel; the wakeup may be stale if T200 was since reset or restarted,
+	// or early if the frame ticks ran ahead of the wall clock, in which case wait out the rest.
+	if (mT200.expired()) {
+		T200Expiration();
+	} else if (t200Wake && mT200.active()) {
+		gLAPDmEngine.scheduleT200(this,mT200.remaining());
 	}
-	mLock.unlock();
 }
 	
 
@@ -780,7 +1033,7 @@ void L2LAPDm::receiveUFrameDM(const L2Frame& frame)
 		// Confusing b/c Sect. 5.4.2.2 suggests (not requires) sending an MDL_ERROR_INDICATION
 		// But nothing about releasing the link, so don't do it!
 		//releaseLink(true,MDL_ERROR_INDICATION);
-	        mT200.set(T200());
+	        startT200();
                 writeL3(new L3Frame(mSAPI,L3_RELEASE_INDICATION));
 		//releaseLink(true,L3_RELEASE_INDICATION);
 		return;
@@ -1167,7 +1420,7 @@ void L2LAPDm::text(std::ostream&os) const
 	if (mState != LAPDStateUnused) {
 		os  <<LOGVARM(mC)<<LOGVARM(mR)<<LOGVARM(mVS)<<LOGVARM(mVA)<<LOGVARM(mVR)
 			<<LOGVARM(mRC)<<LOGVARM(mEstablishmentInProgress)
-			<<LOGVARM(mL1In.size());	//<<LOGVARM(mL3Out.size());
+			<<LOGVAR2("mL1In.pending",(mL1In!=NULL));	//<<LOGVARM(mL3Out.size());
 		if (mMaster) {
 			os <<LOGVAR2("master.State",mMaster->mState);
 		}
@@ -34,6 +34,8 @@ namespace GSM {
 // Forward refs.
 class L2SAPMux;
 class L2LogicalChannelBase;
+struct LAPDmInFrame;
+class LAPDmEngine;
 
 /**@name L2 Processing Errors */
 //@{
@@ -187,13 +189,16 @@ class L2LAPDm : public L2DL {
 
 
 	private:
+	friend class LAPDmEngine;
 
-	Thread mUpstreamThread;		///< a thread for upstream traffic and T200 timeouts
-	bool mRunning;				///< true once the service loop starts
+	bool mRunning;				///< true once opened
 	protected:
 	//L3FrameFIFO mL3Out;			///< we connect L2->L3 through a FIFO
 	private:
-	L2FrameFIFO mL1In;			///< we connect L1->L2 through a FIFO
+	/** We connect L1->L2 through a lock-free stack of pooled frames, pushed by L1 and taken whole by the LAPDm engine. */
+	LAPDmInFrame *volatile mL1In;
+	int mEngineState;			///< LAPDmEngine dispatch state, protected by the engine lock.
+	bool mT200Wake;				///< Queued by the T200 timer wheel, protected by the engine lock.
 
 	unsigned mC;			///< the "C" bit for commands, 1 for BTS, 0 for MS
 							// (pat) C is ALWAYS 1 and R 0 for us, so why is it an argument to the constructor?  For testing?
@@ -291,6 +296,9 @@ class L2LAPDm : public L2DL {
 	/** Block until we receive any pending ack. */
 	void waitForAck();
 
+	/** Start T200 and schedule the engine to look at it when it expires. */
+	void startT200();
+
 	/** Send an L2Frame on the L2->L1 interface. */
 	void writeL1(const L2Frame&);
 	/** Send an L3Frame upstream on the L2->L3 interface. */
@@ -410,11 +418,10 @@ class L2LAPDm : public L2DL {
 	bool stuckChannel(const L2Frame&);
 
 	/**
-		The upstream service loop handles incoming L2 frames from L1 and T200 timeouts.
+		Handle the incoming L2 frames from L1 and T200 expiration; called from the LAPDm engine.
+		@param t200Wake True if the T200 timer wheel queued this instance.
 	*/
-	void lapServiceLoop();
-
-	friend void *LAPDmServiceLoopAdapter(L2LAPDm*);
+	void lapService(bool t200Wake);
 
 	public:
 	LAPDState getLapdmState() const { return mState; }
@@ -427,8 +434,6 @@ std::ostream& operator<<(std::ostream&, L2LAPDm&);
 std::ostream& operator<<(std::ostream&, L2LAPDm*);	// such a great language
 
 
-/** C-style adapter for LAPDm serice loop. */
-void *LAPDmServiceLoopAdapter(L2LAPDm*);
 
 
 
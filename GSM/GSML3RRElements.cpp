@@ -35,16 +35,6 @@ namespace GSM {
 L3ControlChannelDescription *gControlChannelDescription = NULL;
 
 
-void L3CellOptionsBCCH::writeV(L3Frame& dest, size_t &wp) const
-{
-	dest.writeField(wp,0,1);
-	dest.writeField(wp,mPWRC,1);
-	dest.writeField(wp,mDTX,2);
-	dest.writeField(wp,mRADIO_LINK_TIMEOUT,4);
-}
-
-
-
 void L3CellOptionsBCCH::text(ostream& os) const
 {
 	os << "PWRC=" << mPWRC;
@@ -54,16 +44,6 @@ void L3CellOptionsBCCH::text(ostream& os) const
 
 
 
-void L3CellOptionsSACCH::writeV(L3Frame& dest, size_t &wp) const
-{
-	dest.writeField(wp,(mDTX>>2)&0x01,1);
-	dest.writeField(wp,mPWRC,1);
-	dest.writeField(wp,mDTX&0x03,2);
-	dest.writeField(wp,mRADIO_LINK_TIMEOUT,4);
-}
-
-
-
 void L3CellOptionsSACCH::text(ostream& os) const
 {
 	os << "PWRC=" << mPWRC;
@@ -73,18 +53,6 @@ void L3CellOptionsSACCH::text(ostream& os) const
 
 
 
-void L3CellSelectionParameters::writeV(L3Frame& dest, size_t &wp) const
-{
-	dest.writeField(wp,mCELL_RESELECT_HYSTERESIS,3);
-	dest.writeField(wp,mMS_TXPWR_MAX_CCH,5);
-	dest.writeField(wp,mACS,1);
-	dest.writeField(wp,mNECI,1);
-	dest.writeField(wp,mRXLEV_ACCESS_MIN,6);
-}
-
-
-
-
 void L3CellSelectionParameters::text(ostream& os) const
 {
 	os << "CELL-RESELECT-HYSTERESIS=" << mCELL_RESELECT_HYSTERESIS;
@@ -291,17 +259,6 @@ void L3NCCPermitted::text(ostream& os) const
 
 
 
-void L3RACHControlParameters::writeV(L3Frame& dest, size_t &wp) const
-{
-	// GMS 04.08 10.5.2.29
-	dest.writeField(wp, mMaxRetrans, 2);
-	dest.writeField(wp, mTxInteger, 4);
-	dest.writeField(wp, mCellBarAccess, 1);
-	dest.writeField(wp, mRE, 1);
-	dest.writeField(wp, mAC, 16);
-}
-
-
 void L3RACHControlParameters::text(ostream& os) const
 {
 	os << "maxRetrans=" << mMaxRetrans;
@@ -361,16 +318,23 @@ void L3ChannelDescription::writeV( L3Frame &dest, size_t &wp ) const
 // 		 	7      6      5      4      3     2      1      0
 //	  [         TSC       ][ H=0 ][ SPARE(0,0)][ ARFCN[9:8] ]  Octet 3
 //	  [                ARFCN[7:0]                           ]  Octet 4 H=0
+//	  [         TSC       ][ H=1 ][  MAIO[5:2]              ]  Octet 3
+//	  [ MAIO[1:0]  ][        HSN[5:0]                       ]  Octet 4 H=1
 //
 
-	// HACK -- Hard code for non-hopping.
 	// (pat) Same format used for Packet Channel Description 10.5.2.25a
-	assert(mHFlag==0);
 	dest.writeField(wp,mTypeAndOffset,5);
 	dest.writeField(wp,mTN,3);
 	dest.writeField(wp,mTSC,3);
-	dest.writeField(wp,0,3);				// H=0 + 2 spares
-	dest.writeField(wp,mARFCN,10);
+	if (mHFlag) {
+		// The frequencies are in the Mobile Allocation sent with the channel description.
+		dest.writeField(wp,1,1);
+		dest.writeField(wp,mMAIO,6);
+		dest.writeField(wp,mHSN,6);
+	} else {
+		dest.writeField(wp,0,3);				// H=0 + 2 spares
+		dest.writeField(wp,mARFCN,10);
+	}
 }
 
 
@@ -398,24 +362,37 @@ void L3ChannelDescription::text(std::ostream& os) const
 	os << " TN=" << mTN;
 	os << " TSC=" << mTSC;
 	os << " ARFCN=" << mARFCN;	
+	if (mHFlag) { os << " MAIO=" << mMAIO << " HSN=" << mHSN; }
 }
 
 
-void L3RequestReference::writeV( L3Frame &dest, size_t &wp ) const 
+
+L3MobileAllocation::L3MobileAllocation(const std::vector<unsigned>& wCellAllocation, const std::vector<unsigned>& wARFCNs)
+	:L3ProtocolElement()
 {
+	// One bit per Cell Allocation entry; the last octet carries the first entry in its LSB.
+	for (unsigned i=0; i<wCellAllocation.size(); i++) {
+		bool used = false;
+		for (unsigned j=0; j<wARFCNs.size(); j++) {
+			if (wARFCNs[j]==wCellAllocation[i]) { used = true; break; }
+		}
+		mBitmap.push_back(used);
+	}
+}
 
 
-	// Note: fields are written MSB first, then bytes are reversed later in the encoder.
-	// 					Request Reference Format.
-	// 		 	7      6      5      4      3     2      1      0
-	//	  [      			RequestReference [7:0]   			]  Octet 2
-	//	  [			T1[4:0]                 ][   T3[5:3]        ]  Octet 3
-	//	  [       T3[2:0]     ][            T2[4:0]             ]  Octet 4
+void L3MobileAllocation::writeV(L3Frame& dest, size_t &wp) const
+{
+	// GSM 04.08 10.5.2.21: MA C(8*NF) first, down to MA C001.
+	for (unsigned i=8*lengthV(); i>0; i--) {
+		dest.writeField(wp,(i<=mBitmap.size()) ? mBitmap[i-1] : 0,1);
+	}
+}
+
 
-	dest.writeField(wp, mRA, 8);
-	dest.writeField(wp, mT1p, 5);
-	dest.writeField(wp, mT3, 6);
-	dest.writeField(wp, mT2, 5);
+void L3MobileAllocation::text(std::ostream& os) const
+{
+	for (unsigned i=0; i<mBitmap.size(); i++) { os << (mBitmap[i] ? '1' : '0'); }
 }
 
 
@@ -433,12 +410,6 @@ void L3RequestReference::text(ostream& os) const
 
 
 
-void L3TimingAdvance::writeV( L3Frame &dest, size_t &wp ) const
-{
-	dest.writeField(wp, 0x00, 2);
-	dest.writeField(wp, mTimingAdvance, 6);
-}
-
 void L3TimingAdvance::text(ostream& os) const
 {
     os << mTimingAdvance;
@@ -464,19 +435,6 @@ void L3RRCauseElement::text(ostream& os) const
 
 
 
-void L3PowerCommand::writeV( L3Frame &dest, size_t &wp )const
-{
-	dest.writeField(wp, 0, 3);
-	dest.writeField(wp, mCommand, 5);
-}
-
-void L3PowerCommand::parseV(const L3Frame &src, size_t &rp)
-{
-	// Just put the whole thing in mCommand so we can see it.
-	mCommand = src.readField(rp,8);
-}
-
-
 void L3PowerCommand::text(ostream& os) const
 {
 	os << mCommand;
@@ -637,27 +595,6 @@ void L3APDUData::text(ostream& os) const
 }
 
 
-void L3MeasurementResults::parseV(const L3Frame& frame, size_t &rp)
-{
-	// GSM 04.08 10.5.2.20
-	mBA_USED = frame.readField(rp,1);
-	mDTX_USED = frame.readField(rp,1);
-	mRXLEV_FULL_SERVING_CELL = frame.readField(rp,6);
-	rp++;	// spare
-	mMEAS_VALID = frame.readField(rp,1);
-	mRXLEV_SUB_SERVING_CELL = frame.readField(rp,6);
-	rp++;	// spare
-	mRXQUAL_FULL_SERVING_CELL = frame.readField(rp,3);
-	mRXQUAL_SUB_SERVING_CELL = frame.readField(rp,3);
-	mNO_NCELL = frame.readField(rp,3);
-	for (unsigned i=0; i<6; i++) {
-		mRXLEV_NCELL[i] = frame.readField(rp,6);
-		mBCCH_FREQ_NCELL[i] = frame.readField(rp,5);
-		mBSIC_NCELL[i] = frame.readField(rp,6);
-	}
-}
-
-
 void L3MeasurementResults::text(ostream& os) const
 {
 	// GSM 04.08 10.5.2.20
@@ -857,12 +794,6 @@ void L3SI3RestOctets::text(ostream& os) const
 
 
 
-void L3HandoverReference::writeV(L3Frame& frame, size_t& wp) const
-{
-	frame.writeField(wp,mValue,8);
-}
-
-
 size_t L3CipheringModeSetting::lengthV() const
 {
 	return 0;
@@ -924,24 +855,6 @@ void L3SynchronizationIndication::text(ostream& os) const
 }
 
 
-void L3CellDescription::writeV(L3Frame& frame, size_t &wp) const
-{
-	frame.writeField(wp, mARFCN>>8, 2);
-	frame.writeField(wp, mNCC, 3);
-	frame.writeField(wp, mBCC, 3);
-	frame.writeField(wp, mARFCN & 0x0ff, 8);
-}
-
-void L3CellDescription::parseV(const L3Frame&src, size_t&rp)
-{
-	unsigned arfcnHighBits = src.readField(rp,2);
-	mNCC = src.readField(rp,3);
-	mBCC = src.readField(rp,3);
-	mARFCN = src.readField(rp,8) + (arfcnHighBits<<8);
-}
-
-
-
 void L3CellDescription::text(std::ostream& os) const
 {
 	os << " ARFCN=" << mARFCN;	
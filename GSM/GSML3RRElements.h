@@ -25,6 +25,8 @@
 #include "L3Enums.h"
 #include "GSML3Message.h"
 #include "GSML3GPRSElements.h"
+#include "GSML3Schema.h"
+#include "GSML3RRFields.h"
 #include <OpenBTSConfig.h>
 
 
@@ -44,21 +46,30 @@ class L3CellOptionsBCCH : public L3ProtocolElement {
 	// ie 15 steps of 4 SACCH blocks each, which translated is about 2 second granularity.
 	unsigned mRADIO_LINK_TIMEOUT;	///< timeout to declare dead phy link
 
+	typedef L3Fields<
+		L3Spare<1>,
+		L3Field<L3CellOptionsBCCH,unsigned,&L3CellOptionsBCCH::mPWRC,1>,
+		L3Field<L3CellOptionsBCCH,unsigned,&L3CellOptionsBCCH::mDTX,2>,
+		L3Field<L3CellOptionsBCCH,unsigned,&L3CellOptionsBCCH::mRADIO_LINK_TIMEOUT,4>
+	> Schema;
+	L3_SCHEMA_LENGTH_CHECK(Schema,1);
+
 	public:
 
-	/** Sets defaults for no use of DTX or downlink power control. */
+	/** Sets defaults for no downlink power control and uplink DTX from GSM.DTX.Uplink. */
 	L3CellOptionsBCCH()
 		:L3ProtocolElement()
 	{
 		// Values dictated by the current implementation are hard-coded.
 		mPWRC=0;
-		mDTX=2;
 		// Configuarable values.
+		// DTX: 0 means the MS may use uplink DTX, 2 means it shall not.
+		mDTX = gConfig.getBool("GSM.DTX.Uplink") ? 0 : 2;
 		mRADIO_LINK_TIMEOUT= gConfig.getNum("GSM.CellOptions.RADIO-LINK-TIMEOUT");
 	}
 
-	size_t lengthV() const { return 1; }
-	void writeV(L3Frame& dest, size_t &wp) const;
+	size_t lengthV() const { return Schema::bits/8; }
+	void writeV(L3Frame& dest, size_t &wp) const { Schema::write(*this,dest,wp); }
 	void parseV(const L3Frame&, size_t&) { assert(0); }
 	void parseV(const L3Frame&, size_t& , size_t) { assert(0); }
 	void text(std::ostream&) const;
@@ -68,29 +79,24 @@ class L3CellOptionsBCCH : public L3ProtocolElement {
 
 
 /** Cell Options (SACCH), GSM 04.08 10.5.2.3a */
-class L3CellOptionsSACCH : public L3ProtocolElement {
-
-	private:
-
-	unsigned mPWRC;					///< 1 -> downlink power control may be used
-	unsigned mDTX;					///< discontinuous transmission state
-	unsigned mRADIO_LINK_TIMEOUT;	///< timeout to declare dead phy link  See comments at L3CellOptionsBCCH
+class L3CellOptionsSACCH : public L3ProtocolElement, protected L3CellOptionsSACCHFields {
 
 	public:
 
-	/** Sets defaults for no use of DTX or downlink power control. */
+	/** Sets defaults for no downlink power control and uplink DTX from GSM.DTX.Uplink. */
 	L3CellOptionsSACCH()
 		:L3ProtocolElement()
 	{
 		// Values dictated by the current implementation are hard-coded.
 		mPWRC=0;
-		mDTX=2;
 		// Configuarable values.
+		// DTX: 0 means the MS may use uplink DTX on TCH/F and not on TCH/H, 2 means it shall not use it on either.
+		mDTX = gConfig.getBool("GSM.DTX.Uplink") ? 0 : 2;
 		mRADIO_LINK_TIMEOUT=gConfig.getNum("GSM.CellOptions.RADIO-LINK-TIMEOUT");
 	}
 
-	size_t lengthV() const { return 1; }
-	void writeV(L3Frame& dest, size_t &wp) const;
+	size_t lengthV() const { return Schema::bits/8; }
+	void writeV(L3Frame& dest, size_t &wp) const { Schema::write(static_cast<const L3CellOptionsSACCHFields&>(*this),dest,wp); }
 	void parseV(const L3Frame&, size_t&) { assert(0); }
 	void parseV(const L3Frame&, size_t& , size_t) { assert(0); }
 	void text(std::ostream&) const;
@@ -112,6 +118,15 @@ class L3CellSelectionParameters : public L3ProtocolElement {
 	unsigned mMS_TXPWR_MAX_CCH;
 	unsigned mRXLEV_ACCESS_MIN;
 
+	typedef L3Fields<
+		L3Field<L3CellSelectionParameters,unsigned,&L3CellSelectionParameters::mCELL_RESELECT_HYSTERESIS,3>,
+		L3Field<L3CellSelectionParameters,unsigned,&L3CellSelectionParameters::mMS_TXPWR_MAX_CCH,5>,
+		L3Field<L3CellSelectionParameters,unsigned,&L3CellSelectionParameters::mACS,1>,
+		L3Field<L3CellSelectionParameters,unsigned,&L3CellSelectionParameters::mNECI,1>,
+		L3Field<L3CellSelectionParameters,unsigned,&L3CellSelectionParameters::mRXLEV_ACCESS_MIN,6>
+	> Schema;
+	L3_SCHEMA_LENGTH_CHECK(Schema,2);
+
 	public:
 
 	/** Sets defaults to reduce gratuitous handovers. */
@@ -127,8 +142,8 @@ class L3CellSelectionParameters : public L3ProtocolElement {
 		mCELL_RESELECT_HYSTERESIS=gConfig.getNum("GSM.CellSelection.CELL-RESELECT-HYSTERESIS");
 	}
 
-	size_t lengthV() const { return 2; }
-	void writeV(L3Frame& dest, size_t &wp) const;
+	size_t lengthV() const { return Schema::bits/8; }
+	void writeV(L3Frame& dest, size_t &wp) const { Schema::write(*this,dest,wp); }
 	void parseV(const L3Frame&, size_t&) { assert(0); }
 	void parseV(const L3Frame&, size_t& , size_t) { assert(0); }
 	void text(std::ostream&) const;
@@ -327,20 +342,7 @@ class L3NCCPermitted : public L3ProtocolElement {
 
 
 /** RACH Control Parameters GSM 04.08 10.5.2.29 */
-class L3RACHControlParameters : public L3ProtocolElement {
-
-	private:
-
-	unsigned mMaxRetrans;		///< code for 1-7 RACH retransmission attempts
-	// 44.018 Table 10.5.2.29.1: coding of MaxRetransmissions:
-	//	0 => Maximum 1 retransmission.
-	//	1 => Maximum 2 retransmission.
-	//	2 => Maximum 4 retransmission.
-	//	3 => Maximum 7 retransmission.
-	unsigned mTxInteger;		///< code for 3-50 slots to spread transmission
-	unsigned mCellBarAccess;	///< if true, phones cannot camp
-	unsigned mRE;				///< if true, call reestablishment is not allowed
-	uint16_t mAC;				///< mask of barring flags for the 16 access classes
+class L3RACHControlParameters : public L3ProtocolElement, protected L3RACHControlParametersFields {
 
 	public:
 
@@ -357,8 +359,8 @@ class L3RACHControlParameters : public L3ProtocolElement {
 		mAC = gConfig.getNum("GSM.RACH.AC");
 	}
 
-	size_t lengthV() const { return 3; }
-	void writeV(L3Frame& dest, size_t &wp) const;
+	size_t lengthV() const { return Schema::bits/8; }
+	void writeV(L3Frame& dest, size_t &wp) const { Schema::write(static_cast<const L3RACHControlParametersFields&>(*this),dest,wp); }
 	void parseV(const L3Frame&, size_t&) { assert(0); }
 	void parseV(const L3Frame&, size_t& , size_t) { assert(0); }
 	void text(std::ostream&) const;
@@ -485,6 +487,12 @@ public:
 	unsigned TN() const { return mTN; }
 	unsigned TSC() const{ return mTSC; }
 	unsigned ARFCN() const { return mARFCN; }
+
+	/** Make this a hopping channel description.  The ARFCN is kept for logging only. */
+	void hopping(unsigned wMAIO, unsigned wHSN) { mHFlag = 1; mMAIO = wMAIO; mHSN = wHSN; }
+	bool hopping() const { return mHFlag; }
+	unsigned MAIO() const { return mMAIO; }
+	unsigned HSN() const { return mHSN; }
 };
 
 /** GSM 44.018 10.5.2.5a */
@@ -503,6 +511,36 @@ class L3ChannelDescription2 : public L3ChannelDescription {
 };
 
 
+/**
+	Mobile Allocation, GSM 04.08 10.5.2.21.
+	The frequencies a hopping channel hops over, as a bitmap over the Cell Allocation,
+	which is the Cell Channel Description of SI1 or of the same message.
+	Empty for a non-hopping channel.
+*/
+class L3MobileAllocation : public L3ProtocolElement {
+
+	std::vector<bool> mBitmap;		///< one entry per Cell Allocation ARFCN, in hoppingSortARFCNs order
+
+	public:
+
+	L3MobileAllocation() {}
+
+	/**
+		@param wCellAllocation The Cell Allocation, sorted by hoppingSortARFCNs.
+		@param wARFCNs The hopping frequencies; all must be in the Cell Allocation.
+	*/
+	L3MobileAllocation(const std::vector<unsigned>& wCellAllocation, const std::vector<unsigned>& wARFCNs);
+
+	bool empty() const { return mBitmap.empty(); }
+
+	size_t lengthV() const { return (mBitmap.size()+7)/8; }
+	void writeV(L3Frame& dest, size_t &wp) const;
+	void parseV(const L3Frame&, size_t&) { assert(0); }
+	void parseV(const L3Frame&, size_t& , size_t) { assert(0); }
+	void text(std::ostream&) const;
+};
+
+
 
 
 
@@ -526,6 +564,14 @@ class L3RequestReference : public L3ProtocolElement
 	unsigned mT3;
 	//@}
 
+	typedef L3Fields<
+		L3Field<L3RequestReference,unsigned,&L3RequestReference::mRA,8>,
+		L3Field<L3RequestReference,unsigned,&L3RequestReference::mT1p,5>,
+		L3Field<L3RequestReference,unsigned,&L3RequestReference::mT3,6>,
+		L3Field<L3RequestReference,unsigned,&L3RequestReference::mT2,5>
+	> Schema;
+	L3_SCHEMA_LENGTH_CHECK(Schema,3);
+
 public:
 
 	L3RequestReference() {}
@@ -535,8 +581,8 @@ public:
 		mT1p(when.T1()%32),mT2(when.T2()),mT3(when.T3())
 	{}
 
-	size_t lengthV() const { return 3; }
-	void writeV(L3Frame &, size_t &wp ) const;
+	size_t lengthV() const { return Schema::bits/8; }
+	void writeV(L3Frame &dest, size_t &wp ) const { Schema::write(*this,dest,wp); }
 	void parseV( const L3Frame&, size_t&) { assert(0); }
 	void parseV(const L3Frame&, size_t& , size_t) { assert(0); }
 	void text(std::ostream&) const;
@@ -553,6 +599,12 @@ class L3TimingAdvance : public L3ProtocolElement
 //    [    spare(0,0)     ][      TimingAdvance [5:0]              ]  Octet 1
 
 	unsigned mTimingAdvance;
+
+	typedef L3Fields<
+		L3Spare<2>,
+		L3Field<L3TimingAdvance,unsigned,&L3TimingAdvance::mTimingAdvance,6>
+	> Schema;
+	L3_SCHEMA_LENGTH_CHECK(Schema,1);
 	
 public:
 
@@ -561,8 +613,8 @@ public:
 		mTimingAdvance(wTimingAdvance)
 	{}
 	
-	size_t lengthV() const { return 1; }
-	void writeV(L3Frame&, size_t &wp) const;
+	size_t lengthV() const { return Schema::bits/8; }
+	void writeV(L3Frame& dest, size_t &wp) const { Schema::write(*this,dest,wp); }
 	void parseV(const L3Frame&, size_t&) { assert(0); }
 	void parseV(const L3Frame&, size_t& , size_t) { assert(0); }
 	void text(std::ostream&) const;
@@ -605,6 +657,12 @@ class L3PowerCommand : public L3ProtocolElement
 {
 	unsigned mCommand;
 
+	typedef L3Fields<
+		L3Spare<3>,
+		L3Field<L3PowerCommand,unsigned,&L3PowerCommand::mCommand,5>
+	> Schema;
+	L3_SCHEMA_LENGTH_CHECK(Schema,1);
+
 public:
 
 	L3PowerCommand(unsigned wCommand=0)
@@ -612,9 +670,10 @@ public:
 		mCommand(wCommand)
 	{}
 
-	size_t lengthV() const { return 1; }
-	void writeV( L3Frame &dest, size_t &wp ) const;
-	void parseV( const L3Frame&, size_t&);
+	size_t lengthV() const { return Schema::bits/8; }
+	void writeV( L3Frame &dest, size_t &wp ) const { Schema::write(*this,dest,wp); }
+	/** Unlike writeV this keeps the whole octet, including the EPC bits we do not send, so we can see it. */
+	void parseV( const L3Frame &src, size_t &rp) { mCommand = src.readField(rp,8); }
 	void parseV(const L3Frame&, size_t& , size_t) { assert(0); }
 	void text(std::ostream&) const;
 
@@ -817,45 +876,18 @@ class L3APDUData : public L3ProtocolElement {
 
 /** GSM 04.08 10.5.2.20 */
 // (pat) Also see 5.08
-class L3MeasurementResults : public L3ProtocolElement {
-
-	private:
-
-	bool mBA_USED;
-	bool mDTX_USED;
-	bool mMEAS_VALID;		///< 0 for valid, 1 for non-valid  NOTE!!
-	// (pat) 5.08 8.1.4 defines RXLEV values.  MS measures RMS signal level in the range -110dB to -48dB.
-	// RXLEV 0 = < -110 dBm + SCALE
-	// RXLEV 1 = < -109 dBm + SCALE
-	// ...
-	// RXLEV 63 = > -48 dBm + SCALE
-	// The SCALE is used for Enhanced Measurement Report and is inconsequential for normal report.
-	// The MS always reports the 6 best cells from among the candidates in the BA list sent by the BTS.
-	unsigned mRXLEV_FULL_SERVING_CELL;
-	unsigned mRXLEV_SUB_SERVING_CELL;
-	unsigned mRXQUAL_FULL_SERVING_CELL;
-	unsigned mRXQUAL_SUB_SERVING_CELL;
-
-	unsigned mNO_NCELL;
-	unsigned mRXLEV_NCELL[6];
-	unsigned mBCCH_FREQ_NCELL[6];
-	unsigned mBSIC_NCELL[6];
+class L3MeasurementResults : public L3ProtocolElement, protected L3MeasurementResultsFields {
 
 	public:
 
 	L3MeasurementResults()
 		:L3ProtocolElement(),
-		mMEAS_VALID(true),			// true means invalid.
-		mRXLEV_FULL_SERVING_CELL(0),
-		mRXLEV_SUB_SERVING_CELL(0),
-		mRXQUAL_FULL_SERVING_CELL(0),
-		mRXQUAL_SUB_SERVING_CELL(0),
-		mNO_NCELL(0)
+		L3MeasurementResultsFields()
 	{ }
 
-	size_t lengthV() const { return 16; }
-	void writeV(L3Frame&, size_t&) const { assert(0); }
-	void parseV(const L3Frame&, size_t&);
+	size_t lengthV() const { return Schema::bits/8; }
+	void writeV(L3Frame& dest, size_t &wp) const { Schema::write(static_cast<const L3MeasurementResultsFields&>(*this),dest,wp); }
+	void parseV(const L3Frame& src, size_t &rp) { Schema::read(static_cast<L3MeasurementResultsFields&>(*this),src,rp); }
 	void parseV(const L3Frame&, size_t& , size_t) { assert(0); }
 	void text(std::ostream& os) const;
 	string text() const;
@@ -908,27 +940,20 @@ class L3MeasurementResults : public L3ProtocolElement {
 
 
 /** GSM 04.08 10.5.2.2 */
-class L3CellDescription : public L3ProtocolElement {
-
-	protected:
-
-	unsigned mARFCN;
-	unsigned mNCC;
-	unsigned mBCC;
+class L3CellDescription : public L3ProtocolElement, protected L3CellDescriptionFields {
 
 	public:
 
 	L3CellDescription( unsigned wARFCN, unsigned wNCC, unsigned wBCC)
 		:L3ProtocolElement(),
-		mARFCN(wARFCN),
-		mNCC(wNCC),mBCC(wBCC)
+		L3CellDescriptionFields(wARFCN,wNCC,wBCC)
 	{ }
 
 	L3CellDescription() { }
 
-	size_t lengthV() const { return 2; }
-	void writeV(L3Frame&, size_t&) const;
-	void parseV(const L3Frame&, size_t&);
+	size_t lengthV() const { return Schema::bits/8; }
+	void writeV(L3Frame& dest, size_t &wp) const { Schema::write(static_cast<const L3CellDescriptionFields&>(*this),dest,wp); }
+	void parseV(const L3Frame& src, size_t &rp) { Schema::read(static_cast<L3CellDescriptionFields&>(*this),src,rp); }
 	void parseV(const L3Frame&, size_t& , size_t) { assert(0); }
 	void text(std::ostream&) const;
 };
@@ -941,6 +966,10 @@ class L3HandoverReference : public L3ProtocolElement
 
 	unsigned mValue;	// Range 0 to 255
 
+	typedef L3Fields<
+		L3Field<L3HandoverReference,unsigned,&L3HandoverReference::mValue,8>
+	> Schema;
+	L3_SCHEMA_LENGTH_CHECK(Schema,1);
 
 	public:
 
@@ -951,10 +980,10 @@ class L3HandoverReference : public L3ProtocolElement
 
 	L3HandoverReference() { }
 
-	size_t lengthV() const { return 1; }
-	void writeV(L3Frame &, size_t &wp ) const;
+	size_t lengthV() const { return Schema::bits/8; }
+	void writeV(L3Frame &dest, size_t &wp ) const { Schema::write(*this,dest,wp); }
 	void parseV( const L3Frame&, size_t&, size_t) { abort(); }
-	void parseV(const L3Frame&src, size_t&rp) { mValue = src.readField(rp,8); }
+	void parseV(const L3Frame &src, size_t &rp) { Schema::read(*this,src,rp); }
 	void text(std::ostream&) const;
 
 	unsigned value() const { return mValue; }
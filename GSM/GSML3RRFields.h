@@ -0,0 +1,147 @@
+/*
+* Copyright 2014 Range Networks, Inc.
+*
+* This software is distributed under multiple licenses;
+* see the COPYING file in the main directory for licensing
+* information for this specific distribution.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*/
+
+// The data members and Schema of RR IEs whose codecs are checked by L3SchemaTest.
+// The IE classes in GSML3RRElements.h inherit these, so the test exercises the same
+// layout and codec as parseV and writeV without linking the rest of the BTS.
+
+#ifndef GSML3RRFIELDS_H
+#define GSML3RRFIELDS_H
+
+#include "GSML3Schema.h"
+
+namespace GSM {
+
+/** The fields of the Cell Options (SACCH), GSM 04.08 10.5.2.3a */
+struct L3CellOptionsSACCHFields {
+	unsigned mPWRC;					///< 1 -> downlink power control may be used
+	unsigned mDTX;					///< discontinuous transmission state
+	unsigned mRADIO_LINK_TIMEOUT;	///< timeout to declare dead phy link  See comments at L3CellOptionsBCCH
+
+	// The DTX field is split, with its high bit ahead of PWRC.
+	typedef L3Fields<
+		L3FieldPart<L3CellOptionsSACCHFields,unsigned,&L3CellOptionsSACCHFields::mDTX,2,1>,
+		L3Field<L3CellOptionsSACCHFields,unsigned,&L3CellOptionsSACCHFields::mPWRC,1>,
+		L3FieldPart<L3CellOptionsSACCHFields,unsigned,&L3CellOptionsSACCHFields::mDTX,0,2>,
+		L3Field<L3CellOptionsSACCHFields,unsigned,&L3CellOptionsSACCHFields::mRADIO_LINK_TIMEOUT,4>
+	> Schema;
+	L3_SCHEMA_LENGTH_CHECK(Schema,1);
+};
+
+
+/** The fields of the Cell Description, GSM 04.08 10.5.2.2 */
+struct L3CellDescriptionFields {
+	unsigned mARFCN;
+	unsigned mNCC;
+	unsigned mBCC;
+
+	// The ARFCN is split, with its 2 high bits ahead of the BSIC.
+	typedef L3Fields<
+		L3FieldPart<L3CellDescriptionFields,unsigned,&L3CellDescriptionFields::mARFCN,8,2>,
+		L3Field<L3CellDescriptionFields,unsigned,&L3CellDescriptionFields::mNCC,3>,
+		L3Field<L3CellDescriptionFields,unsigned,&L3CellDescriptionFields::mBCC,3>,
+		L3FieldPart<L3CellDescriptionFields,unsigned,&L3CellDescriptionFields::mARFCN,0,8>
+	> Schema;
+	L3_SCHEMA_LENGTH_CHECK(Schema,2);
+
+	L3CellDescriptionFields(unsigned wARFCN=0, unsigned wNCC=0, unsigned wBCC=0)
+		:mARFCN(wARFCN),mNCC(wNCC),mBCC(wBCC)
+	{ }
+};
+
+
+/** The fields of the RACH Control Parameters, GSM 04.08 10.5.2.29 */
+struct L3RACHControlParametersFields {
+	unsigned mMaxRetrans;		///< code for 1-7 RACH retransmission attempts
+	// 44.018 Table 10.5.2.29.1: coding of MaxRetransmissions:
+	//	0 => Maximum 1 retransmission.
+	//	1 => Maximum 2 retransmission.
+	//	2 => Maximum 4 retransmission.
+	//	3 => Maximum 7 retransmission.
+	unsigned mTxInteger;		///< code for 3-50 slots to spread transmission
+	unsigned mCellBarAccess;	///< if true, phones cannot camp
+	unsigned mRE;				///< if true, call reestablishment is not allowed
+	uint16_t mAC;				///< mask of barring flags for the 16 access classes
+
+	// GMS 04.08 10.5.2.29
+	typedef L3Fields<
+		L3Field<L3RACHControlParametersFields,unsigned,&L3RACHControlParametersFields::mMaxRetrans,2>,
+		L3Field<L3RACHControlParametersFields,unsigned,&L3RACHControlParametersFields::mTxInteger,4>,
+		L3Field<L3RACHControlParametersFields,unsigned,&L3RACHControlParametersFields::mCellBarAccess,1>,
+		L3Field<L3RACHControlParametersFields,unsigned,&L3RACHControlParametersFields::mRE,1>,
+		L3Field<L3RACHControlParametersFields,uint16_t,&L3RACHControlParametersFields::mAC,16>
+	> Schema;
+	L3_SCHEMA_LENGTH_CHECK(Schema,3);
+};
+
+
+/** The fields of the Measurement Results, GSM 04.08 10.5.2.20 */
+struct L3MeasurementResultsFields {
+	bool mBA_USED;
+	bool mDTX_USED;
+	bool mMEAS_VALID;		///< 0 for valid, 1 for non-valid  NOTE!!
+	// (pat) 5.08 8.1.4 defines RXLEV values.  MS measures RMS signal level in the range -110dB to -48dB.
+	// RXLEV 0 = < -110 dBm + SCALE
+	// RXLEV 1 = < -109 dBm + SCALE
+	// ...
+	// RXLEV 63 = > -48 dBm + SCALE
+	// The SCALE is used for Enhanced Measurement Report and is inconsequential for normal report.
+	// The MS always reports the 6 best cells from among the candidates in the BA list sent by the BTS.
+	unsigned mRXLEV_FULL_SERVING_CELL;
+	unsigned mRXLEV_SUB_SERVING_CELL;
+	unsigned mRXQUAL_FULL_SERVING_CELL;
+	unsigned mRXQUAL_SUB_SERVING_CELL;
+
+	unsigned mNO_NCELL;
+	unsigned mRXLEV_NCELL[6];
+	unsigned mBCCH_FREQ_NCELL[6];
+	unsigned mBSIC_NCELL[6];
+
+	template <unsigned I> struct NCell {
+		typedef L3Fields<
+			L3ArrayField<L3MeasurementResultsFields,unsigned,6,&L3MeasurementResultsFields::mRXLEV_NCELL,I,6>,
+			L3ArrayField<L3MeasurementResultsFields,unsigned,6,&L3MeasurementResultsFields::mBCCH_FREQ_NCELL,I,5>,
+			L3ArrayField<L3MeasurementResultsFields,unsigned,6,&L3MeasurementResultsFields::mBSIC_NCELL,I,6>
+		> type;
+	};
+	// GSM 04.08 10.5.2.20
+	typedef L3Fields<
+		L3Field<L3MeasurementResultsFields,bool,&L3MeasurementResultsFields::mBA_USED,1>,
+		L3Field<L3MeasurementResultsFields,bool,&L3MeasurementResultsFields::mDTX_USED,1>,
+		L3Field<L3MeasurementResultsFields,unsigned,&L3MeasurementResultsFields::mRXLEV_FULL_SERVING_CELL,6>,
+		L3Spare<1>,
+		L3Field<L3MeasurementResultsFields,bool,&L3MeasurementResultsFields::mMEAS_VALID,1>,
+		L3Field<L3MeasurementResultsFields,unsigned,&L3MeasurementResultsFields::mRXLEV_SUB_SERVING_CELL,6>,
+		L3Spare<1>,
+		L3Field<L3MeasurementResultsFields,unsigned,&L3MeasurementResultsFields::mRXQUAL_FULL_SERVING_CELL,3>,
+		L3Field<L3MeasurementResultsFields,unsigned,&L3MeasurementResultsFields::mRXQUAL_SUB_SERVING_CELL,3>,
+		L3Field<L3MeasurementResultsFields,unsigned,&L3MeasurementResultsFields::mNO_NCELL,3>,
+		L3Repeat<NCell,6>
+	> Schema;
+	L3_SCHEMA_LENGTH_CHECK(Schema,16);
+
+	L3MeasurementResultsFields()
+		:mMEAS_VALID(true),			// true means invalid.
+		mRXLEV_FULL_SERVING_CELL(0),
+		mRXLEV_SUB_SERVING_CELL(0),
+		mRXQUAL_FULL_SERVING_CELL(0),
+		mRXQUAL_SUB_SERVING_CELL(0),
+		mNO_NCELL(0)
+	{ }
+};
+
+};	// namespace GSM
+
+#endif
@@ -90,6 +90,10 @@ const char *L3RRMessage::name(MessageType mt)
 			return "Paging Response"; 
 		case L3RRMessage::PagingRequestType1: 
 			return "Paging Request Type 1"; 
+		case L3RRMessage::PagingRequestType2:
+			return "Paging Request Type 2";
+		case L3RRMessage::PagingRequestType3:
+			return "Paging Request Type 3";
 		case L3RRMessage::MeasurementReport: 
 			return "Measurement Report"; 
 		case L3RRMessage::AssignmentComplete: 
@@ -98,6 +102,8 @@ const char *L3RRMessage::name(MessageType mt)
 			return "Immediate Assignment"; 
 		case L3RRMessage::ImmediateAssignmentReject: 
 			return "Immediate Assignment Reject"; 
+		case L3RRMessage::ImmediateAssignmentExtended:
+			return "Immediate Assignment Extended";
 		case L3RRMessage::AssignmentCommand: 
 			return "Assignment Command"; 
 		case L3RRMessage::AssignmentFailure: 
@@ -256,6 +262,88 @@ void L3PagingRequestType1::text(ostream& os) const
 }
 
 
+
+size_t L3PagingRequestType2::l2BodyLength() const
+{
+	size_t sum = 1+4+4;
+	if (mMobileID3.type()!=NoIDType) sum += mMobileID3.lengthTLV();
+	return sum;
+}
+
+
+void L3PagingRequestType2::writeBody(L3Frame& dest, size_t &wp) const
+{
+	// See GSM 04.08 9.1.23.
+	// Page Mode Page Mode M V 1/2 10.5.2.26
+	// Channels Needed for Mobiles 1 and 2 M V 1/2 10.5.2.8
+	// Mobile Identity 1 TMSI/P-TMSI M V 4 10.5.2.42
+	// Mobile Identity 2 TMSI/P-TMSI M V 4 10.5.2.42
+	// 0x17 Mobile Identity 3 O TLV 3-10 10.5.1.4
+	// P2 Rest Octets M V 1-11 10.5.2.24
+	dest.writeField(wp,channelNeededCode(mChannelsNeeded[1]),2);
+	dest.writeField(wp,channelNeededCode(mChannelsNeeded[0]),2);
+	// "normal paging", GSM 04.08 Table 10.5.63
+	dest.writeField(wp,0x0,4);
+	dest.writeField(wp,mTMSIs[0],32);
+	dest.writeField(wp,mTMSIs[1],32);
+	if (mMobileID3.type()!=NoIDType) {
+		mMobileID3.writeTLV(0x17,dest,wp);
+		// P2 Rest Octets, GSM 04.08 10.5.2.24: channel needed for mobile 3.
+		dest.writeH(wp);
+		dest.writeField(wp,channelNeededCode(mChannelsNeeded[2]),2);
+	} else {
+		dest.writeL(wp);
+	}
+	while (wp & 7) { dest.writeL(wp); }
+}
+
+
+void L3PagingRequestType2::text(ostream& os) const
+{
+	L3RRMessage::text(os);
+	os << " mobileIDs=(";
+	for (unsigned i=0; i<2; i++) {
+		os << "(TMSI=" << hex << "0x" << mTMSIs[i] << dec << "," << mChannelsNeeded[i] << ") ";
+	}
+	if (mMobileID3.type()!=NoIDType) {
+		os << "(" << mMobileID3 << "," << mChannelsNeeded[2] << ") ";
+	}
+	os << ")";
+}
+
+
+void L3PagingRequestType3::writeBody(L3Frame& dest, size_t &wp) const
+{
+	// See GSM 04.08 9.1.24.
+	// Page Mode Page Mode M V 1/2 10.5.2.26
+	// Channels Needed for Mobiles 1 and 2 M V 1/2 10.5.2.8
+	// Mobile Identity 1..4 TMSI/P-TMSI M V 4 each 10.5.2.42
+	// P3 Rest Octets M V 3 10.5.2.25
+	dest.writeField(wp,channelNeededCode(mChannelsNeeded[1]),2);
+	dest.writeField(wp,channelNeededCode(mChannelsNeeded[0]),2);
+	// "normal paging", GSM 04.08 Table 10.5.63
+	dest.writeField(wp,0x0,4);
+	for (unsigned i=0; i<4; i++) { dest.writeField(wp,mTMSIs[i],32); }
+	// P3 Rest Octets, GSM 04.08 10.5.2.25: channels needed for mobiles 3 and 4.
+	size_t wpstart = wp;
+	dest.writeH(wp);
+	dest.writeField(wp,channelNeededCode(mChannelsNeeded[2]),2);
+	dest.writeField(wp,channelNeededCode(mChannelsNeeded[3]),2);
+	while (wp - wpstart < 8*restOctetsLength()) { dest.writeL(wp); }
+}
+
+
+void L3PagingRequestType3::text(ostream& os) const
+{
+	L3RRMessage::text(os);
+	os << " mobileIDs=(";
+	for (unsigned i=0; i<4; i++) {
+		os << "(TMSI=" << hex << "0x" << mTMSIs[i] << dec << "," << mChannelsNeeded[i] << ") ";
+	}
+	os << ")";
+}
+
+
 size_t L3PagingResponse::l2BodyLength() const
 {
 	return 1 + mClassmark.lengthLV() + mMobileID.lengthLV();
@@ -531,6 +619,26 @@ void L3SystemInformationType6::text(ostream& os) const
 	os << " NCCPermitted=(" << mNCCPermitted << ")";
 }
 
+// The Mobile Allocation that goes with a channel description, empty if the channel does not hop.
+static L3MobileAllocation mobileAllocationFor(const L3ChannelDescription& desc)
+{
+	return desc.hopping() ? gBTS.mobileAllocation() : L3MobileAllocation();
+}
+
+
+size_t L3ImmediateAssignment::l2BodyLength() const
+{
+	// 1/2: page mode
+	// 1/2: Dedicated mode or TBF
+	// 3: channel description or packet channel description 
+	// 3: request reference
+	// 1: timing advance
+	// 1-9: Mobile Allocation, just the length byte if the channel does not hop.
+	// 0-3: starting time if present.
+	return 8 + mobileAllocationFor(mChannelDescription).lengthLV() + (mStartTimePresent ? 3 : 0);
+}
+
+
 void L3ImmediateAssignment::writeStartTime(L3Frame& dest, size_t &wp) const
 {
 	// The names T1, T2, T3 are defined in GSM 4.08 table 10.5.2.39 (same as 10.5.79)
@@ -571,9 +679,8 @@ void L3ImmediateAssignment::writeBody( L3Frame &dest, size_t &wp ) const
 	mChannelDescription.writeV(dest, wp);	// From L3ChannelDescription
 	mRequestReference.writeV(dest, wp);
 	mTimingAdvance.writeV(dest, wp);
-	// No mobile allocation in non-hopping systems.
-	// A zero-length LV.  Just write L=0.  (pat) LV, etc. defined in GSM04.07 sec 11.2.1.1
-	dest.writeField(wp,0,8);
+	// The mobile allocation is a zero-length LV for a non-hopping channel.  (pat) LV, etc. defined in GSM04.07 sec 11.2.1.1
+	mobileAllocationFor(mChannelDescription).writeLV(dest,wp);
 	if (mStartTimePresent) {
 		dest.writeField(wp,0x7c,8);	// The type of the TLV.
 		writeStartTime(dest,wp);
@@ -600,6 +707,59 @@ void L3ImmediateAssignment::text(ostream& os) const
 }
 
 
+size_t L3ImmediateAssignmentExtended::l2BodyLength() const
+{
+	// 1/2: page mode, 1/2: spare
+	// 3+3+1: channel description, request reference and timing advance 1
+	// 3+3+1: channel description, request reference and timing advance 2
+	// 1-9: Mobile Allocation, just the length byte unless a channel hops
+	return 15 + mobileAllocationFor(mChannelDescription1.hopping() ? mChannelDescription1 : mChannelDescription2).lengthLV();
+}
+
+
+void L3ImmediateAssignmentExtended::writeBody( L3Frame &dest, size_t &wp ) const
+{
+	size_t wpstart = wp;
+	/*
+	- Page Mode 10.5.2.26 M V 1/2
+	- Spare Half Octet 10.5.1.8 M V 1/2
+	- Channel Description 1 10.5.2.5 M V 3
+	- Request Reference 1 10.5.2.30 M V 3
+	- Timing Advance 1 10.5.2.40 M V 1
+	- Channel Description 2 10.5.2.5 M V 3
+	- Request Reference 2 10.5.2.30 M V 3
+	- Timing Advance 2 10.5.2.40 M V 1
+	- Mobile Allocation 10.5.2.21 M LV 1-5
+	(ignoring optional elements)
+	*/
+	// reverse order of 1/2-octet fields
+	dest.writeField(wp,0,4);	// spare
+	mPageMode.writeV(dest, wp);
+	mChannelDescription1.writeV(dest, wp);
+	mRequestReference1.writeV(dest, wp);
+	mTimingAdvance1.writeV(dest, wp);
+	mChannelDescription2.writeV(dest, wp);
+	mRequestReference2.writeV(dest, wp);
+	mTimingAdvance2.writeV(dest, wp);
+	// One mobile allocation serves both channels; a zero-length LV if neither hops.
+	mobileAllocationFor(mChannelDescription1.hopping() ? mChannelDescription1 : mChannelDescription2).writeLV(dest,wp);
+	assert(wp-wpstart == fullBodyLength() * 8);
+}
+
+
+void L3ImmediateAssignmentExtended::text(ostream& os) const
+{
+	L3RRMessage::text(os);
+	os << "PageMode=("<<mPageMode<<")";
+	os << " ChannelDescription1=("<<mChannelDescription1<<")";
+	os << " RequestReference1=("<<mRequestReference1<<")";
+	os << " TimingAdvance1="<<mTimingAdvance1;
+	os << " ChannelDescription2=("<<mChannelDescription2<<")";
+	os << " RequestReference2=("<<mRequestReference2<<")";
+	os << " TimingAdvance2="<<mTimingAdvance2;
+}
+
+
 void L3ChannelRequest::text(ostream& os) const
 {
 	L3RRMessage::text(os);
@@ -625,7 +785,10 @@ void L3AssignmentCommand::writeBody( L3Frame &dest, size_t &wp ) const
 {
 	mChannelDescription.writeV(dest, wp);
 	mPowerCommand.writeV(dest, wp);
+	// A hopping channel carries our Cell Allocation and its Mobile Allocation.
+	if (mChannelDescription.hopping()) gBTS.cellChannelDescription().writeTV(0x62,dest,wp);
 	if (mHaveMode1) mMode1.writeTV(0x63,dest,wp); 
+	if (mChannelDescription.hopping()) gBTS.mobileAllocation().writeTLV(0x72,dest,wp);
 	if (isAMR()) mMultiRate.writeTLV(3,dest,wp);
 }
 
@@ -633,6 +796,7 @@ size_t L3AssignmentCommand::l2BodyLength() const
 {
 	size_t len = mChannelDescription.lengthV();
 	len += mPowerCommand.lengthV();
+	if (mChannelDescription.hopping()) len += gBTS.cellChannelDescription().lengthTV() + gBTS.mobileAllocation().lengthTLV();
 	if (mHaveMode1) len += mMode1.lengthTV();
 	if (isAMR()) len += mMultiRate.lengthTLV();
 	return len;
@@ -889,6 +1053,9 @@ size_t L3HandoverCommand::l2BodyLength() const
 		mHandoverReference.lengthV() +
 		mPowerCommandAccessType.lengthV() +
 		mSynchronizationIndication.lengthV();
+	if (mChannelDescriptionAfter.hopping()) {
+		sum += gBTS.cellChannelDescription().lengthTV() + gBTS.mobileAllocation().lengthTLV();
+	}
 	return sum;
 }
 
@@ -899,6 +1066,12 @@ void L3HandoverCommand::writeBody(L3Frame& frame, size_t& wp) const
 	mHandoverReference.writeV(frame,wp);
 	mPowerCommandAccessType.writeV(frame,wp);
 	mSynchronizationIndication.writeV(frame,wp);
+	// The handset does not know the Cell Allocation of the new cell, so send it along with the Mobile Allocation.
+	// This message is built by the target BTS, so these are its own.
+	if (mChannelDescriptionAfter.hopping()) {
+		gBTS.cellChannelDescription().writeTV(0x62,frame,wp);
+		gBTS.mobileAllocation().writeTLV(0x72,frame,wp);
+	}
 }
 
 void L3HandoverCommand::parseBody(const L3Frame& frame, size_t& rp)
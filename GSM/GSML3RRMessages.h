@@ -235,6 +235,69 @@ class L3PagingRequestType1 : public L3RRMessageNRO {
 
 
 
+/** Paging Request Type 2, GSM 04.08 9.1.23: two TMSIs and an optional third mobile ID of any type. */
+class L3PagingRequestType2 : public L3RRMessageRO {
+
+	private:
+
+	uint32_t mTMSIs[2];
+	L3MobileIdentity mMobileID3;		///< NoIDType if not present
+	ChannelType mChannelsNeeded[3];
+
+	public:
+
+	L3PagingRequestType2(uint32_t wTMSI1, ChannelType wType1, uint32_t wTMSI2, ChannelType wType2)
+		:L3RRMessageRO()
+	{
+		mTMSIs[0]=wTMSI1;
+		mChannelsNeeded[0]=wType1;
+		mTMSIs[1]=wTMSI2;
+		mChannelsNeeded[1]=wType2;
+		mChannelsNeeded[2]=AnyDCCHType;
+	}
+
+	/** Add the optional third mobile ID. */
+	void mobileID3(const L3MobileIdentity& wId3, ChannelType wType3)
+		{ mMobileID3 = wId3; mChannelsNeeded[2] = wType3; }
+
+	int MTI() const { return PagingRequestType2; }
+
+	size_t l2BodyLength() const;
+	size_t restOctetsLength() const { return 1; }
+	void writeBody(L3Frame& dest, size_t& wp) const;
+	void text(std::ostream&) const;
+};
+
+
+/** Paging Request Type 3, GSM 04.08 9.1.24: four TMSIs. */
+class L3PagingRequestType3 : public L3RRMessageRO {
+
+	private:
+
+	uint32_t mTMSIs[4];
+	ChannelType mChannelsNeeded[4];
+
+	public:
+
+	L3PagingRequestType3(const uint32_t wTMSIs[4], const ChannelType wTypes[4])
+		:L3RRMessageRO()
+	{
+		for (unsigned i=0; i<4; i++) {
+			mTMSIs[i]=wTMSIs[i];
+			mChannelsNeeded[i]=wTypes[i];
+		}
+	}
+
+	int MTI() const { return PagingRequestType3; }
+
+	size_t l2BodyLength() const { return 1+4*4; }
+	size_t restOctetsLength() const { return 3; }
+	void writeBody(L3Frame& dest, size_t& wp) const;
+	void text(std::ostream&) const;
+};
+
+
+
 
 /** Paging Response, GSM 04.08 9.1.25 */
 class L3PagingResponse : public L3RRMessageNRO {
@@ -610,17 +673,7 @@ public:
 
 
 	int MTI() const { return (int)ImmediateAssignment; }
-	size_t l2BodyLength() const {
-		// 1/2: page mode
-		// 1/2: Dedicated mode or TBF
-		// 3: channel description or packet channel description 
-		// 3: request reference
-		// 1: timing advance
-		// 1-9: Mobile Allocation (not implemented, so just 1 byte)
-		// 0-3: starting time if present.
-		// = 9 total bytes.
-		return 9 + (mStartTimePresent ? 3 : 0);
-	}
+	size_t l2BodyLength() const;
 
 	// (pat) Return the PacketAssignment part of the message for the client to fill in.
 	// I did it this way to cause the least change to the preexisting L3ImmediateAssignment class.
@@ -642,6 +695,48 @@ public:
 
 
 
+/** Immediate Assignment Extended, GSM 04.08 9.1.19: dedicated channels for two MSs in one message. */
+class L3ImmediateAssignmentExtended : public L3RRMessageNRO
+{
+
+private:
+
+	L3PageMode mPageMode;
+	L3ChannelDescription mChannelDescription1;
+	L3RequestReference mRequestReference1;
+	L3TimingAdvance mTimingAdvance1;
+	L3ChannelDescription mChannelDescription2;
+	L3RequestReference mRequestReference2;
+	L3TimingAdvance mTimingAdvance2;
+
+public:
+
+	L3ImmediateAssignmentExtended(
+				const L3RequestReference& wRequestReference1,
+				const L3ChannelDescription& wChannelDescription1,
+				const L3TimingAdvance& wTimingAdvance1,
+				const L3RequestReference& wRequestReference2,
+				const L3ChannelDescription& wChannelDescription2,
+				const L3TimingAdvance& wTimingAdvance2)
+		:L3RRMessageNRO(),
+		mPageMode(0),
+		mChannelDescription1(wChannelDescription1),
+		mRequestReference1(wRequestReference1),
+		mTimingAdvance1(wTimingAdvance1),
+		mChannelDescription2(wChannelDescription2),
+		mRequestReference2(wRequestReference2),
+		mTimingAdvance2(wTimingAdvance2)
+	{}
+
+	int MTI() const { return (int)ImmediateAssignmentExtended; }
+	size_t l2BodyLength() const;
+
+	void writeBody(L3Frame &dest, size_t &wp) const;
+	void text(std::ostream&) const;
+};
+
+
+
 /** Immediate Assignment Reject, GSM 04.08 9.1.20 */
 class L3ImmediateAssignmentReject : public L3RRMessageNRO {
 
@@ -920,7 +1015,7 @@ class L3MeasurementReport : public L3RRMessageNRO {
 	void parseBody(const L3Frame&, size_t&);
 	void text(std::ostream&) const;
 
-	const L3MeasurementResults results() const { return mResults; }
+	const L3MeasurementResults &results() const { return mResults; }
 
 };
 
@@ -0,0 +1,135 @@
+/*
+* Copyright 2014 Range Networks, Inc.
+*
+* This software is distributed under multiple licenses;
+* see the COPYING file in the main directory for licensing
+* information for this specific distribution.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*/
+
+#ifndef GSML3SCHEMA_H
+#define GSML3SCHEMA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace GSM {
+
+/**@name Declarative codecs for fixed-layout information elements.
+
+	A fixed-layout IE is described once as a list of its fields in transmission order,
+	and the reader and writer are generated from that list, so the two cannot disagree
+	about widths or offsets and the length is a compile-time constant, Schema::bits.
+	For example, the Cell Selection Parameters of GSM 04.08 10.5.2.4:
+
+		typedef L3Fields<
+			L3Field<L3CellSelectionParameters,unsigned,&L3CellSelectionParameters::mCELL_RESELECT_HYSTERESIS,3>,
+			L3Field<L3CellSelectionParameters,unsigned,&L3CellSelectionParameters::mMS_TXPWR_MAX_CCH,5>,
+			...
+		> Schema;
+
+	Schema::read(obj,frame,rp) and Schema::write(obj,frame,wp) then expand inline into
+	the same readField/writeField calls a hand-written parseV or writeV would make,
+	with no loops or virtual calls.  The Frame can be anything with BitVector's readField and writeField.
+*/
+//@{
+
+/** An empty field, used to fill out the unused slots of L3Fields. */
+struct L3NoField {
+	enum { bits = 0 };
+	template <class Obj, class Frame> static void read(Obj&, const Frame&, size_t&) {}
+	template <class Obj, class Frame> static void write(const Obj&, Frame&, size_t&) {}
+};
+
+/** A Width bit field held in the data member Member of Obj. */
+template <class Obj, class T, T Obj::*Member, unsigned Width>
+struct L3Field {
+	enum { bits = Width };
+	template <class Frame> static void read(Obj &obj, const Frame &src, size_t &rp)
+		{ obj.*Member = (T) src.readField(rp,Width); }
+	template <class Frame> static void write(const Obj &obj, Frame &dest, size_t &wp)
+		{ dest.writeField(wp,(uint64_t)(obj.*Member),Width); }
+};
+
+/** A Width bit field held in element Index of the array member Member of Obj. */
+template <class Obj, class T, unsigned N, T (Obj::*Member)[N], unsigned Index, unsigned Width>
+struct L3ArrayField {
+	enum { bits = Width };
+	template <class Frame> static void read(Obj &obj, const Frame &src, size_t &rp)
+		{ (obj.*Member)[Index] = (T) src.readField(rp,Width); }
+	template <class Frame> static void write(const Obj &obj, Frame &dest, size_t &wp)
+		{ dest.writeField(wp,(uint64_t)(obj.*Member)[Index],Width); }
+};
+
+/** Width bits of the data member Member of Obj starting at bit Shift, for a value split across the IE.
+	The parts of a member must cover all of its bits that are in use. */
+template <class Obj, class T, T Obj::*Member, unsigned Shift, unsigned Width>
+struct L3FieldPart {
+	enum { bits = Width };
+	template <class Frame> static void read(Obj &obj, const Frame &src, size_t &rp)
+	{
+		T mask = (T) (((1u << Width) - 1) << Shift);
+		obj.*Member = (T) ((obj.*Member & ~mask) | ((T) src.readField(rp,Width) << Shift));
+	}
+	template <class Frame> static void write(const Obj &obj, Frame &dest, size_t &wp)
+		{ dest.writeField(wp,(uint64_t)((obj.*Member >> Shift) & ((1u << Width) - 1)),Width); }
+};
+
+/** Spare bits, skipped on read and written as 0. */
+template <unsigned Width>
+struct L3Spare {
+	enum { bits = Width };
+	template <class Obj, class Frame> static void read(Obj&, const Frame&, size_t &rp) { rp += Width; }
+	template <class Obj, class Frame> static void write(const Obj&, Frame &dest, size_t &wp) { dest.writeField(wp,0,Width); }
+};
+
+/** Group<0>::type through Group<Count-1>::type in order, for IEs that repeat a group of fields. */
+template <template <unsigned> class Group, unsigned Count>
+struct L3Repeat {
+	typedef typename Group<Count-1>::type Last;
+	enum { bits = L3Repeat<Group,Count-1>::bits + Last::bits };
+	template <class Obj, class Frame> static void read(Obj &obj, const Frame &src, size_t &rp)
+		{ L3Repeat<Group,Count-1>::read(obj,src,rp); Last::read(obj,src,rp); }
+	template <class Obj, class Frame> static void write(const Obj &obj, Frame &dest, size_t &wp)
+		{ L3Repeat<Group,Count-1>::write(obj,dest,wp); Last::write(obj,dest,wp); }
+};
+
+template <template <unsigned> class Group>
+struct L3Repeat<Group,0> : public L3NoField {};
+
+/** A sequence of up to 12 fields.  An L3Fields may itself be one of the fields of another. */
+template <class F1, class F2 = L3NoField, class F3 = L3NoField, class F4 = L3NoField,
+	class F5 = L3NoField, class F6 = L3NoField, class F7 = L3NoField, class F8 = L3NoField,
+	class F9 = L3NoField, class F10 = L3NoField, class F11 = L3NoField, class F12 = L3NoField>
+struct L3Fields {
+	enum { bits = F1::bits + F2::bits + F3::bits + F4::bits + F5::bits + F6::bits
+		+ F7::bits + F8::bits + F9::bits + F10::bits + F11::bits + F12::bits };
+	template <class Obj, class Frame> static void read(Obj &obj, const Frame &src, size_t &rp)
+	{
+		F1::read(obj,src,rp); F2::read(obj,src,rp); F3::read(obj,src,rp); F4::read(obj,src,rp);
+		F5::read(obj,src,rp); F6::read(obj,src,rp); F7::read(obj,src,rp); F8::read(obj,src,rp);
+		F9::read(obj,src,rp); F10::read(obj,src,rp); F11::read(obj,src,rp); F12::read(obj,src,rp);
+	}
+	template <class Obj, class Frame> static void write(const Obj &obj, Frame &dest, size_t &wp)
+	{
+		F1::write(obj,dest,wp); F2::write(obj,dest,wp); F3::write(obj,dest,wp); F4::write(obj,dest,wp);
+		F5::write(obj,dest,wp); F6::write(obj,dest,wp); F7::write(obj,dest,wp); F8::write(obj,dest,wp);
+		F9::write(obj,dest,wp); F10::write(obj,dest,wp); F11::write(obj,dest,wp); F12::write(obj,dest,wp);
+	}
+};
+
+/** Fails to compile unless the Schema is exactly Octets long.  Use it in the class that declares the Schema. */
+#define L3_SCHEMA_LENGTH_CHECK(Schema,Octets) \
+	typedef char Schema##LengthCheck[((Schema::bits) == 8*(Octets)) ? 1 : -1]
+
+//@}
+
+};	// namespace GSM
+
+#endif
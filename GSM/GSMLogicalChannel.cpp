@@ -80,8 +80,10 @@
 #include "GSMSMSCBL3Messages.h"
 #include "GSMLogicalChannel.h"
 #include "GSMConfig.h"
+#include "GSMMeasurementEngine.h"
 
 #include <ControlTransfer.h>
+#include <ControlCommon.h>
 #include <L3Handover.h>
 #include "GPRSExport.h"
 #include <Globals.h>
@@ -369,6 +371,7 @@ void L2LogicalChannel::writeToL3(L3Frame*frame)
 			assert(0);
 	}
 	mL3Out.write(frame);
+	Control::dcchReady(this);
 }
 
 
@@ -464,6 +467,18 @@ bool L2LogicalChannel::recyclable()
 	return (mT3101.expired() || mT3109.expired() || mT3111.expired()) && mL1->encoder()->l1IsIdle() && getSACCH()->mL1->encoder()->l1IsIdle();
 }
 
+long L2LogicalChannel::recycleWait()
+{
+	if (recyclable()) { return 0; }
+	// A timer has expired but the encoders are still flushing, which does not take long.
+	if (mT3101.expired() || mT3109.expired() || mT3111.expired()) { return 100; }
+	long wait = -1;
+	if (mT3101.active()) { wait = mT3101.remaining(); }
+	if (mT3109.active() && (wait < 0 || mT3109.remaining() < wait)) { wait = mT3109.remaining(); }
+	if (mT3111.active() && (wait < 0 || mT3111.remaining() < wait)) { wait = mT3111.remaining(); }
+	return wait < 0 ? -1 : max(wait,1L);
+}
+
 // We know this channel is now unused.  Finish deactivating it and mark it for reuse.
 // The SACCH was already deactivated.  Just close the main channel and become recyclable.
 void L2LogicalChannel::immediateRelease()
@@ -485,6 +500,7 @@ void L2LogicalChannel::immediateRelease()
 #endif
 	getSACCH()->l2stop(); // Done already in the T3109 or T3111 expiry cases.
 	this->l2stop();
+	gBTS.chanReleased(this);
 }
 
 // Service the main SDCCH or TCH/FACCH L2LogicalChannel.
@@ -599,7 +615,7 @@ void L2LogicalChannel::writeLowSide(const L2Frame& frame)
 	if (mT3101.active()) {
 		mT3101.reset();
 		// Inform L3 that we are alive down here.
-		// This does not block; goes to a InterthreadQueue L2LAPdm::mL1In
+		// This does not block; goes onto L2LAPDm::mL1In for the LAPDm engine
 		sapWriteFromL1(L2Frame(PH_CONNECT));
 	}
 	switch (frame.primitive()) {
@@ -666,12 +682,14 @@ L3ChannelDescription L2LogicalChannelBase::channelDescription() const
 	if (mL1==NULL) return L3ChannelDescription(TDMA_MISC,0,0,0);
 
 	// In normal cases, we get this information from L1.
-	return L3ChannelDescription(
+	L3ChannelDescription desc(
 		mL1->typeAndOffset(),
 		mL1->TN(),
 		mL1->TSC(),
 		mL1->ARFCN()
 	);
+	if (gTRX.hops(mL1->CN(),mL1->TN())) desc.hopping(gTRX.MAIO(mL1->CN()),gTRX.HSN());
+	return desc;
 }
 
 ChannelHistory *L2LogicalChannel::getChannelHistory()
@@ -723,6 +741,9 @@ SACCHLogicalChannel::SACCHLogicalChannel(
 	L2LAPDm *sap3 = new SACCHL2(1,SAPI3);
 	sapInit(sap0,sap3);
 	connect(mL1);
+	int slot = gMeasurementEngine.meRegister(mSACCHL1,wHost ? wHost->lcGetL1() : NULL);
+	mSACCHL1->decoder()->mMeasSlot = slot;
+	setMeasSlot(slot);
 	//assert(mSACCH==NULL);
 #if USE_SEMAPHORE
 	int sval, semstat= sem_getvalue(&mOpenSignal,&sval);
@@ -755,43 +776,28 @@ void SACCHLogicalChannel::sacchInit()
 	LOG(DEBUG);
 }
 
-static L3Message* parseSACCHMessage(const L3Frame *l3frame)
-{
-	if (!l3frame) return NULL;
-	LOG(DEBUG) << *l3frame;
-	Primitive prim = l3frame->primitive();
-	if ((prim!=L3_DATA) && (prim!=L3_UNIT_DATA)) {
-		LOG(INFO) << "non-data primitive " << prim;
-		return NULL;
-	}
-	L3Message* message = parseL3(*l3frame);
-	if (!message) {
-		LOG(WARNING) << "SACCH received unparsable L3 frame " << *l3frame;
-		WATCHF("SACCH received unparsable L3 frame PD=%d MTI=%d",l3frame->PD(),l3frame->MTI());
-	}
-	return message;
-}
-
+// Measurement reports arrive every 480ms on every active channel, so they are decoded straight from the frame
+// into mMeasurementResults rather than through parseL3, which would allocate an L3MeasurementReport for each one.
 bool SACCHLogicalChannel::processMeasurementReport(L3Frame *rrFrame)
 {
 	if (! (rrFrame->isData() && rrFrame->PD() == L3RadioResourcePD && rrFrame->MTI() == L3RRMessage::MeasurementReport)) { return false; }
 
-	// Neither of these 'ifs' should fail, but be safe.
-	if (const L3Message* rrMessage = parseSACCHMessage(rrFrame)) {
-		if (const L3MeasurementReport* measurement = dynamic_cast<typeof(measurement)>(rrMessage)) {
-			OBJLOG(INFO) << "SACCH measurement report " <<this <<" "<< mMeasurementResults;
-			mMeasurementResults = measurement->results();
-			//if (mMeasurementResults.MEAS_VALID() == 0) {
-			//	addSelfRxLev(mMeasurementResults.RXLEV_SUB_SERVING_CELL_dBm());
-			//}
-			// Add the measurement results to the sql table (pat - no longer used)
-			// Note that the typeAndOffset of a SACCH match the host channel.
-			gPhysStatus.setPhysical(this, mMeasurementResults);
-			// Check for handover requirement.
-			// (pat) TODO: This may block while waiting for a reply from a Peer BTS.
-			Control::HandoverDetermination(&mMeasurementResults,this);
-		}
-		delete rrMessage;
+	size_t rp = 16;		// Skip the L3 header, as L3Message::parse does.
+	if (rrFrame->size() < rp + 8*mMeasurementResults.lengthV()) {
+		LOG(WARNING) << "SACCH received unparsable L3 frame " << *rrFrame;
+		WATCHF("SACCH received unparsable L3 frame PD=%d MTI=%d",rrFrame->PD(),rrFrame->MTI());
+	} else {
+		mMeasurementResults.parseV(*rrFrame,rp);
+		OBJLOG(INFO) << "SACCH measurement report " <<this <<" "<< mMeasurementResults;
+		//if (mMeasurementResults.MEAS_VALID() == 0) {
+		//	addSelfRxLev(mMeasurementResults.RXLEV_SUB_SERVING_CELL_dBm());
+		//}
+		// Add the measurement results to the sql table (pat - no longer used)
+		// Note that the typeAndOffset of a SACCH match the host channel.
+		gPhysStatus.setPhysical(this, mMeasurementResults);
+		// Check for handover requirement.
+		// (pat) TODO: This may block while waiting for a reply from a Peer BTS.
+		Control::HandoverDetermination(&mMeasurementResults,this);
 	}
 	delete rrFrame;
 	return true;
@@ -98,6 +98,8 @@ public:
 
 	// Pat 5-27-2012: Let the LogicalChannel know the next scheduled write time.
 	GSM::Time getNextWriteTime() { return mL1->encoder()->getNextWriteTime(); }
+	/** True if a write now would wait for the encoder to catch up to the clock. */
+	bool l1WriteWouldBlock() const { return mL1->encoder()->sendWouldBlock(); }
 
 	/**@name L3 interfaces */
 	//@{
@@ -329,6 +331,8 @@ class L2LogicalChannel: public L2SAPMux, public Control::L3LogicalChannel
 
 	/** Return true if the channel is safely abandoned (closed or orphaned). */
 	bool recyclable();
+	/** Return 0 if recyclable(), else msecs until it might be, or -1 if that waits on a release not yet started. */
+	long recycleWait();
 
 
 	// Frame comes down from L2LAPDm writeL1.
@@ -599,6 +603,10 @@ class TCHFACCHLogicalChannel : public L2LogicalChannel {
 	unsigned queueSize() const
 		{ devassert(mTCHL1); return mTCHL1->queueSize(); }
 
+	/** Speech frames the uplink skipped in a gap, to be covered by the RTP timestamp. */
+	unsigned takeSkippedFrames()
+		{ devassert(mTCHL1); return mTCHL1->takeSkippedFrames(); }
+
 	// (pat) 3-28: Moved this higher in the hierarchy so we can use it on SDCCH as well.
 	//bool radioFailure() const
 	//	{ devassert(mTCHL1); return mTCHL1->radioFailure(); }
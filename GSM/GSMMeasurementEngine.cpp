@@ -0,0 +1,280 @@
+/*
+* Copyright 2014 Range Networks, Inc.
+*
+* This software is distributed under multiple licenses;
+* see the COPYING file in the main directory for licensing
+* information for this specific distribution.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+*/
+
+#define LOG_GROUP LogGroup::GSM		// Can set Log.Level.GSM for debugging
+
+#include "GSMMeasurementEngine.h"
+#include "GSML1FEC.h"
+#include "GSMConfig.h"
+#include <OpenBTSConfig.h>
+#include <Logger.h>
+
+using namespace std;
+
+namespace GSM {
+
+MeasurementEngine gMeasurementEngine;
+const unsigned MeasurementEngine::cHistoryDepth;
+const short MeasurementEngine::cInvalidRxlev;
+
+// How many bursts over which we average timing, minus 1.
+static const unsigned cAveragePeriodTiming = 8;
+
+
+int MeasurementEngine::meRegister(SACCHL1FEC *sacch, L1FEC *host)
+{
+	ScopedLock lock(mLock);
+	if (mStarted) {
+		LOG(ALERT) << "SACCH created after the measurement engine started, power control disabled for it";
+		return -1;
+	}
+	mSacch.push_back(sacch);
+	mHost.push_back(host);
+	return mSacch.size() - 1;
+}
+
+
+void MeasurementEngine::meStart()
+{
+	{	ScopedLock lock(mLock);
+		if (mStarted) { return; }
+		mNumSlots = mSacch.size();
+		for (unsigned b = 0; b < 2; b++) {
+			mBurstRSSI[b].assign(mNumSlots,0.0F);
+			mBurstTimingError[b].assign(mNumSlots,0.0F);
+			mBurstCount[b].assign(mNumSlots,0);
+		}
+		mBurstsFolded.assign(mNumSlots,0);
+		mBumpDown.assign(mNumSlots,0.0F);
+		mServRxlev.assign(mNumSlots * cHistoryDepth,cInvalidRxlev);
+		mServRxqual.assign(mNumSlots * cHistoryDepth,0);
+		mServHead.assign(mNumSlots,0);
+		mPeriodRSSI.assign(mNumSlots,0.0F);
+		mPeriodBursts.assign(mNumSlots,0);
+		mAvgServRxlev.assign(mNumSlots,0.0F);
+		mAvgServRxqual.assign(mNumSlots,0.0F);
+		mReportsUsed.assign(mNumSlots,0);
+		mULLoop.assign(mNumSlots,PowerControlLoop());
+		mDLLoop.assign(mNumSlots,PowerControlLoop());
+		mDLReduction.assign(mNumSlots,0);
+		mStarted = true;
+	}
+	LOG(INFO) << "measurement engine started with " << mNumSlots << " SACCH";
+	mThread.start((void*(*)(void*))serviceLoopAdapter,this);
+}
+
+
+void MeasurementEngine::meReset(int slot)
+{
+	if (!mStarted || slot < 0) { return; }
+	for (unsigned b = 0; b < 2; b++) {
+		mBurstRSSI[b][slot] = 0;
+		mBurstTimingError[b][slot] = 0;
+		mBurstCount[b][slot] = 0;
+	}
+	ScopedLock lock(mLock);
+	mBurstsFolded[slot] = 0;
+	mBumpDown[slot] = 0;
+	mServHead[slot] = 0;
+	mReportsUsed[slot] = 0;
+	mAvgServRxlev[slot] = 0;
+	mAvgServRxqual[slot] = 0;
+	mPeriodBursts[slot] = 0;
+	mULLoop[slot].pclReset();
+	mDLLoop[slot].pclReset();
+	mDLReduction[slot] = 0;		// The encoders clear their own copy in encInit.
+}
+
+
+void MeasurementEngine::meBumpDown(int slot, float dB)
+{
+	if (!mStarted || slot < 0) { return; }
+	ScopedLock lock(mLock);
+	mBumpDown[slot] += dB;
+}
+
+
+void MeasurementEngine::meAddReport(int slot, bool valid, int rxlev, int rxqual)
+{
+	if (!mStarted || slot < 0) { return; }
+	ScopedLock lock(mLock);
+	unsigned pos = slot * cHistoryDepth + (mServHead[slot] % cHistoryDepth);
+	mServRxlev[pos] = valid ? rxlev : cInvalidRxlev;
+	mServRxqual[pos] = valid ? rxqual : 0;
+	mServHead[slot]++;
+}
+
+
+static void loadPowerControlParams(PowerControlParams &params, float target)
+{
+	params.mAlgorithm = (PowerControlParams::Algorithm) gConfig.GSM.PowerControl.Algorithm;
+	params.mAverageWindow = gConfig.GSM.PowerControl.AverageWindow;
+	params.mTarget = target;
+	params.mHysteresis = gConfig.GSM.PowerControl.Hysteresis;
+	params.mRxqualBad = gConfig.GSM.PowerControl.RxqualBad;
+	params.mRxqualGood = gConfig.GSM.PowerControl.RxqualGood;
+	params.mVoteP = gConfig.GSM.PowerControl.VoteP;
+	// With more votes needed than counted power would never change; the config cross check warns about it.
+	params.mVoteN = min((unsigned)gConfig.GSM.PowerControl.VoteN,params.mVoteP);
+	params.mIncreaseStep = gConfig.GSM.PowerControl.IncreaseStep;
+	params.mReduceStep = gConfig.GSM.PowerControl.ReduceStep;
+	params.mInterval = gConfig.GSM.PowerControl.Interval;
+}
+
+
+// Process the measurements from the reporting period whose bursts were accumulated in bank b.
+// Each step is a separate pass over all the slots.
+void MeasurementEngine::processPeriod(unsigned b)
+{
+	// Read the configuration once for the whole period.
+	const unsigned rssiPeriod = gConfig.GSM.Radio.RSSIAveragePeriod;
+	const float RSSITarget = gConfig.GSM.Radio.RSSITarget;
+	const float SNRTarget = gConfig.GSM.Radio.SNRTarget;
+	const int configPowerDamping = gConfig.GSM.MS.Power.Damping;
+	const int maxPower = gConfig.GSM.MS.Power.Max;
+	const int minPower = gConfig.GSM.MS.Power.Min;
+	const float TADamping = gConfig.GSM.MS.TA.Damping*0.01F;
+	const int maxReduction = gConfig.GSM.PowerControl.DL.MaxReduction;
+	PowerControlParams ulParams, dlParams;
+	loadPowerControlParams(ulParams,RSSITarget);
+	loadPowerControlParams(dlParams,gConfig.GSM.PowerControl.DL.Target);
+	const unsigned history = min((unsigned)gConfig.GSM.Handover.RXLEV_DL.History,cHistoryDepth);
+
+	float *rssiSum = &mBurstRSSI[b][0];
+	float *timingSum = &mBurstTimingError[b][0];
+	unsigned *count = &mBurstCount[b][0];
+
+	// Fold the bursts of the period into the averaged RSSI and timing error of each MS.
+	// This is the running average that used to be updated on every burst, applied to k bursts at once.
+	// The decoder RSSI is written only here, so a bump down from L1 is applied here too.
+	{	ScopedLock lock(mLock);
+		for (unsigned s = 0; s < mNumSlots; s++) {
+			SACCHL1Decoder *dec = mSacch[s]->decoder();
+			unsigned k = mPeriodBursts[s] = count[s];
+			if (k) {
+				mPeriodRSSI[s] = rssiSum[s] / k;
+				unsigned n = min(mBurstsFolded[s],rssiPeriod);
+				dec->mRSSI = (rssiSum[s] + n * dec->mRSSI) / (n+k);
+				n = min(mBurstsFolded[s],cAveragePeriodTiming);
+				dec->mTimingError = (timingSum[s] + n * dec->mTimingError) / (n+k);
+				mBurstsFolded[s] += k;
+				rssiSum[s] = 0;
+				timingSum[s] = 0;
+				count[s] = 0;
+			}
+			if (mBumpDown[s]) {
+				dec->mRSSI -= mBumpDown[s];
+				mBumpDown[s] = 0;
+			}
+		}
+	}
+
+	// Serving cell averages over the most recent reports, for handover.
+	{	ScopedLock lock(mLock);
+		for (unsigned s = 0; s < mNumSlots; s++) {
+			unsigned have = min(mServHead[s],cHistoryDepth);
+			unsigned use = min(have,history);
+			const short *rxlev = &mServRxlev[s * cHistoryDepth];
+			const unsigned char *rxqual = &mServRxqual[s * cHistoryDepth];
+			int sumRxlev = 0, sumRxqual = 0, npoints = 0;
+			for (unsigned i = 1; i <= use; i++) {
+				unsigned pos = (mServHead[s] - i) % cHistoryDepth;
+				if (rxlev[pos] == cInvalidRxlev) { continue; }
+				sumRxlev += rxlev[pos];
+				sumRxqual += rxqual[pos];
+				npoints++;
+			}
+			// With no valid reports leave the averages alone; 0 dB never looks worse than a neighbor.
+			// For handover add back our downlink power reduction, so it compares the cells at full power.
+			if (npoints) {
+				mAvgServRxlev[s] = (float) sumRxlev / npoints + mDLReduction[s];
+				mAvgServRxqual[s] = (float) sumRxqual / npoints;
+			}
+		}
+	}
+
+	// Closed loop MS power and timing control.  GSM 05.08 4, GSM 05.10 5, 6.
+	for (unsigned s = 0; s < mNumSlots; s++) {
+		SACCHL1Decoder *dec = mSacch[s]->decoder();
+		if (!dec->isValid() || !dec->decActive()) { continue; }
+		SACCHL1Encoder *enc = mSacch[s]->encoder();
+
+		// Power expressed in dBm, RSSI in dB wrt max.
+		if (ulParams.mAlgorithm == PowerControlParams::RSSITarget) {
+			enc->setMSPower(rssiTargetMSPower(enc->orderedMSPower(),dec->actualMSPower(),dec->getRSSI(),RSSITarget,
+				dec->getAveSNR(),SNRTarget,configPowerDamping));
+		} else if (mPeriodBursts[s]) {
+			int ordered = (int) (enc->orderedMSPower() + 0.5F);
+			int rxqual = berToRxqual(dec->getDecoderStats().mAveBER);
+			int change = mULLoop[s].pclStep(ulParams,mPeriodRSSI[s],rxqual,maxPower - ordered,ordered - minPower);
+			if (change) { enc->setMSPower(ordered + change); }
+		}
+		// setMSPower and setMSTiming apply the configured limits.
+
+		// Time expressed in symbol periods.
+		float targetMSTiming = dec->actualMSTiming() + dec->timingError();
+		enc->setMSTiming(TADamping*enc->orderedMSTiming() + (1.0F-TADamping)*targetMSTiming);
+
+		LOG(DEBUG) << enc->descriptiveString() <<LOGVAR2("RSSI",dec->getRSSI()) <<LOGVAR(RSSITarget)
+			<<LOGVAR2("actualPower",dec->actualMSPower()) <<LOGVAR2("orderedPower",enc->orderedMSPower())
+			<<LOGVAR2("timingError",dec->timingError()) <<LOGVAR2("orderedTA",enc->orderedMSTiming());
+	}
+
+	// Downlink power control from the measurement reports, on both the SACCH and its host channel.
+	// There is one report per period, so the loop runs only when a new one has arrived.
+	if (maxReduction > 0) {
+		ScopedLock lock(mLock);
+		for (unsigned s = 0; s < mNumSlots; s++) {
+			if (mServHead[s] == mReportsUsed[s]) { continue; }
+			mReportsUsed[s] = mServHead[s];
+			unsigned pos = s * cHistoryDepth + (mServHead[s] - 1) % cHistoryDepth;
+			if (mServRxlev[pos] == cInvalidRxlev) { continue; }
+			int reduction = mDLReduction[s];
+			int change = mDLLoop[s].pclStep(dlParams,mServRxlev[pos],mServRxqual[pos],reduction,maxReduction - reduction);
+			if (change == 0) { continue; }
+			mDLReduction[s] = reduction - change;
+			mSacch[s]->setTxAtten(mDLReduction[s]);
+			if (mHost[s]) { mHost[s]->setTxAtten(mDLReduction[s]); }
+			LOG(DEBUG) << mSacch[s]->descriptiveString() <<LOGVAR2("rxlev",mServRxlev[pos]) <<LOGVAR2("rxqual",(int)mServRxqual[pos])
+				<<LOGVAR2("reduction",mDLReduction[s]);
+		}
+	} else {
+		ScopedLock lock(mLock);
+		for (unsigned s = 0; s < mNumSlots; s++) {
+			if (mDLReduction[s]) {
+				mDLReduction[s] = 0;
+				mSacch[s]->setTxAtten(0);
+				if (mHost[s]) { mHost[s]->setTxAtten(0); }
+			}
+		}
+	}
+}
+
+
+void MeasurementEngine::serviceLoop()
+{
+	// Run 52 frames into each reporting period, which gives L1 time to finish with the bursts
+	// of the previous period and leaves us the rest of this one before L1 starts on that bank again.
+	int fn = gBTS.time().FN();
+	Time next((fn - fn % 104 + 104 + 52) % gHyperframe);
+	while (!gBTS.btsShutdown()) {
+		gBTS.clock().wait(next);
+		processPeriod(bank(next.FN() + gHyperframe - 104));
+		next = next + 104;
+	}
+}
+
+};	// namespace GSM
@@ -0,0 +1,131 @@
+/*
+* Copyright 2014 Range Networks, Inc.
+*
+* This software is distributed under multiple licenses;
+* see the COPYING file in the main directory for licensing
+* information for this specific distribution.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+*/
+
+#ifndef _GSMMEASUREMENTENGINE_H_
+#define _GSMMEASUREMENTENGINE_H_ 1
+
+#include <vector>
+#include <Threads.h>
+#include "GSMCommon.h"
+#include "GSMPowerControl.h"
+
+namespace GSM {
+class SACCHL1FEC;
+class L1FEC;
+
+/**
+	The SACCH measurement engine.
+	Every SACCH is given a slot at startup.  The uplink burst measurements from L1 and the serving cell
+	measurements from the MS measurement reports are stored by slot in columnar arrays, and once per
+	SACCH reporting period (104 frames, 480ms) the engine runs over all the slots at once to update the
+	averaged RSSI and timing error, the serving cell RXLEV/RXQUAL averages used for handover, the
+	MS power and timing advance orders that SACCHL1Encoder sends in the SACCH physical header,
+	and the downlink power reduction of the channel.  The power control algorithms are in GSMPowerControl.
+	The configuration is read once per period instead of once per burst or report.
+*/
+class MeasurementEngine {
+	public:
+	/** Depth of the serving cell report history, the max value of GSM.Handover.RXLEV_DL.History. */
+	static const unsigned cHistoryDepth = 32;
+
+	private:
+	Mutex mLock;				///< Protects registration and the report history columns.
+	volatile bool mStarted;
+	Thread mThread;
+
+	std::vector<SACCHL1FEC*> mSacch;		///< The SACCH of each slot.
+	std::vector<L1FEC*> mHost;				///< The SDCCH or TCH that the SACCH belongs to.
+	unsigned mNumSlots;						///< Fixed when the engine starts.
+
+	/**@name Uplink burst accumulators, written by the L1 decoder threads without locking.
+		There are two banks, selected by the parity of the reporting period of the burst,
+		so the engine can drain the last period while L1 fills the current one. */
+	//@{
+	std::vector<float> mBurstRSSI[2];
+	std::vector<float> mBurstTimingError[2];
+	std::vector<unsigned> mBurstCount[2];
+	//@}
+
+	std::vector<unsigned> mBurstsFolded;	///< Bursts folded into the decoder RSSI and timing averages since the SACCH opened.
+	std::vector<float> mBumpDown;			///< RSSI reduction requested by L1 since the last period, dB; protected by mLock.
+
+	/**@name Serving cell report history, a ring of cHistoryDepth entries per slot. */
+	//@{
+	std::vector<short> mServRxlev;			///< dB, negative; cInvalidRxlev if the MS said the measurement was not valid.
+	std::vector<unsigned char> mServRxqual;
+	std::vector<unsigned> mServHead;		///< Number of reports added; the next entry is at mServHead % cHistoryDepth.
+	//@}
+
+	/**@name Statistics computed each period. */
+	//@{
+	std::vector<float> mPeriodRSSI;			///< Mean uplink RSSI of the bursts in the last period.
+	std::vector<unsigned> mPeriodBursts;	///< Number of bursts in the last period, 0 if none.
+	std::vector<float> mAvgServRxlev;
+	std::vector<float> mAvgServRxqual;
+	std::vector<unsigned> mReportsUsed;		///< mServHead when the downlink loop last ran.
+	//@}
+
+	/**@name Power control state. */
+	//@{
+	std::vector<PowerControlLoop> mULLoop;
+	std::vector<PowerControlLoop> mDLLoop;
+	std::vector<int> mDLReduction;			///< Downlink power reduction, dB.
+	//@}
+
+	static const short cInvalidRxlev = -1000;
+
+	static unsigned bank(int fn) { return (fn / 104) & 1; }
+	void processPeriod(unsigned bank);
+	void serviceLoop();
+	static void *serviceLoopAdapter(MeasurementEngine *me) { me->serviceLoop(); return NULL; }
+
+	public:
+	MeasurementEngine() : mStarted(false), mNumSlots(0) {}
+
+	/** Register a SACCH and its host channel before the engine starts and return its slot, or -1 if it is too late. */
+	int meRegister(SACCHL1FEC *sacch, L1FEC *host);
+	void meStart();
+
+	/** Clear the accumulated data for a slot when its SACCH is opened. */
+	void meReset(int slot);
+
+	/** Add an uplink burst measurement; called from L1 for every SACCH burst. */
+	void meAddBurst(int slot, int fn, float RSSI, float timingError) {
+		if (!mStarted || slot < 0) { return; }
+		unsigned b = bank(fn);
+		mBurstRSSI[b][slot] += RSSI;
+		mBurstTimingError[b][slot] += timingError;
+		mBurstCount[b][slot]++;
+	}
+
+	/** Push down the averaged RSSI of the slot at the next period, to induce the handset to push more power. */
+	void meBumpDown(int slot, float dB);
+
+	/** Add the serving cell part of a measurement report from the MS. */
+	void meAddReport(int slot, bool valid, int rxlev, int rxqual);
+
+	/** Averaged serving cell RXLEV as reported by the MS, for handover. */
+	float meAvgServingRxlev(int slot) const { return slot < 0 || !mStarted ? 0 : mAvgServRxlev[slot]; }
+	/** Averaged serving cell RXQUAL as reported by the MS. */
+	float meAvgServingRxqual(int slot) const { return slot < 0 || !mStarted ? 0 : mAvgServRxqual[slot]; }
+	/** Current downlink power reduction, dB. */
+	int meDownlinkReduction(int slot) const { return slot < 0 || !mStarted ? 0 : mDLReduction[slot]; }
+};
+
+extern MeasurementEngine gMeasurementEngine;
+
+};	// namespace GSM
+#endif
@@ -0,0 +1,109 @@
+/*
+* Copyright 2014 Range Networks, Inc.
+*
+* This software is distributed under multiple licenses;
+* see the COPYING file in the main directory for licensing
+* information for this specific distribution.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+*/
+
+#include "GSMPowerControl.h"
+
+namespace GSM {
+
+int berToRxqual(float ber)
+{
+	// GSM 05.08 8.2.4: RXQUAL 0 is BER below 0.2%, and each level above doubles it, up to 7 for above 12.8%.
+	float limit = 0.002F;
+	for (int rxqual = 0; rxqual < 7; rxqual++, limit *= 2) {
+		if (ber < limit) { return rxqual; }
+	}
+	return 7;
+}
+
+
+void PowerControlLoop::pclReset()
+{
+	mAvgRxlev = 0;
+	mAvgRxqual = 0;
+	mSamples = 0;
+	mUpVotes = 0;
+	mDownVotes = 0;
+	mSinceChange = 0;
+}
+
+
+static unsigned countVotes(unsigned votes, unsigned P)
+{
+	unsigned count = 0;
+	for (unsigned i = 0; i < P; i++) { if (votes & (1<<i)) count++; }
+	return count;
+}
+
+
+int PowerControlLoop::pclStep(const PowerControlParams &params, float rxlev, float rxqual, int maxUp, int maxDown)
+{
+	// Running average over the window; the first samples get full weight until the window fills.
+	if (mSamples < params.mAverageWindow) { mSamples++; }
+	mAvgRxlev += (rxlev - mAvgRxlev) / mSamples;
+	mAvgRxqual += (rxqual - mAvgRxqual) / mSamples;
+
+	// GSM 05.08 A.3.2.2: each average votes to increase if it is below either lower threshold,
+	// and to reduce if it is above the upper RXLEV threshold and RXQUAL is good.
+	bool up = mAvgRxlev < params.mTarget - params.mHysteresis || mAvgRxqual > params.mRxqualBad;
+	bool down = mAvgRxlev > params.mTarget + params.mHysteresis && mAvgRxqual <= params.mRxqualGood;
+	unsigned mask = params.mVoteP >= 32 ? ~0u : (1u << params.mVoteP) - 1;
+	mUpVotes = ((mUpVotes << 1) | up) & mask;
+	mDownVotes = ((mDownVotes << 1) | down) & mask;
+
+	// Changes are at least mInterval periods apart, ie, a change in period n allows the next one in period n+mInterval.
+	if (++mSinceChange < params.mInterval) { return 0; }
+
+	int change = 0;
+	if (countVotes(mUpVotes,params.mVoteP) >= params.mVoteN) {
+		change = params.mIncreaseStep < maxUp ? params.mIncreaseStep : maxUp;
+	} else if (countVotes(mDownVotes,params.mVoteP) >= params.mVoteN) {
+		change = -(params.mReduceStep < maxDown ? params.mReduceStep : maxDown);
+	}
+	if (change) {
+		// The averages predate the change, so assume it worked rather than voting on stale data,
+		// and start counting votes again.
+		mAvgRxlev += change;
+		mUpVotes = mDownVotes = 0;
+		mSinceChange = 0;
+	}
+	return change;
+}
+
+
+float rssiTargetMSPower(float orderedPower, float actualPower, float RSSI, float RSSITarget,
+	float SNR, float SNRTarget, int damping)
+{
+	// Power expressed in dBm, RSSI in dB wrt max.
+	// (pat) RSSI and RSSITarget are both negative, so deltaP is positive if power is too high.
+	float deltaP = RSSI - RSSITarget;
+	// SNRTarget == 0 disables:
+	if (SNRTarget) {
+		if (deltaP > 0 && SNR < SNRTarget) {	// If RSSITarget is met but SNR looks bad...
+			// We only change upward based on SNR - we rely on RSSITarget to keep the power down.
+			deltaP = SNR - SNRTarget;
+		}
+	}
+	float targetMSPower = actualPower - deltaP;
+	float powerDamping = damping*0.01F;
+	if (damping < 90 && deltaP < 4) {
+		// (pat 2-2014) Adjust the power in the upward direction faster than in the downward direction
+		// if we are in danger of losing the signal.
+		powerDamping /= 2;	// This should probably be log response.
+	}
+	return powerDamping*orderedPower + (1.0F-powerDamping)*targetMSPower;
+}
+
+};	// namespace GSM
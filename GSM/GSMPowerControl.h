@@ -0,0 +1,88 @@
+/*
+* Copyright 2014 Range Networks, Inc.
+*
+* This software is distributed under multiple licenses;
+* see the COPYING file in the main directory for licensing
+* information for this specific distribution.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+*/
+
+#ifndef _GSMPOWERCONTROL_H_
+#define _GSMPOWERCONTROL_H_ 1
+
+// This file has no dependencies on the rest of OpenBTS so the algorithms can be run
+// against recorded measurement traces by PowerControlTest.
+
+namespace GSM {
+
+/** Map a bit error rate, as a fraction, to RXQUAL 0-7 per GSM 05.08 8.2.4. */
+int berToRxqual(float ber);
+
+/** The parameters of one direction of the power control loop. */
+struct PowerControlParams {
+	enum Algorithm {
+		RSSITarget = 0,		///< The original OpenBTS loop: damped tracking of GSM.Radio.RSSITarget, uplink only.
+		Threshold = 1		///< GSM 05.08 A.3.2 style: filtered RXLEV/RXQUAL against thresholds with N out of P voting.
+	};
+	Algorithm mAlgorithm;
+	unsigned mAverageWindow;	///< Number of reporting periods averaged, like Hreqave.
+	float mTarget;				///< Wanted RXLEV, dB; the uplink uses dB wrt full scale, the downlink dBm.
+	float mHysteresis;			///< The RXLEV thresholds are mTarget +- mHysteresis, like L_RXLEV_XX_P and U_RXLEV_XX_P.
+	int mRxqualBad;				///< Increase power if the averaged RXQUAL is worse than this, like L_RXQUAL_XX_P.
+	int mRxqualGood;			///< Only reduce power if the averaged RXQUAL is at least this good, like U_RXQUAL_XX_P.
+	unsigned mVoteN, mVoteP;	///< Change power when mVoteN of the last mVoteP averages are past a threshold.
+	int mIncreaseStep;			///< POW_INCR_STEP_SIZE, dB.
+	int mReduceStep;			///< POW_RED_STEP_SIZE, dB.
+	unsigned mInterval;			///< P_CON_INTERVAL: minimum reporting periods from one change to the next.
+
+	PowerControlParams() :
+		mAlgorithm(RSSITarget), mAverageWindow(4), mTarget(0), mHysteresis(3), mRxqualBad(4), mRxqualGood(1),
+		mVoteN(2), mVoteP(3), mIncreaseStep(4), mReduceStep(2), mInterval(2) {}
+};
+
+
+/** The state of the Threshold algorithm for one direction of one channel. */
+class PowerControlLoop {
+	float mAvgRxlev;
+	float mAvgRxqual;
+	unsigned mSamples;		///< Number of periods averaged so far, up to the window.
+	unsigned mUpVotes;		///< Bit history of the averages below the lower thresholds, newest in bit 0.
+	unsigned mDownVotes;	///< Bit history of the averages above the upper thresholds.
+	unsigned mSinceChange;	///< Reporting periods since the last change.
+
+	public:
+	PowerControlLoop() { pclReset(); }
+	void pclReset();
+
+	/**
+		Add the measurements of one reporting period and return the power change wanted, in dB:
+		positive to increase power, negative to reduce it, 0 to leave it alone.
+		@param rxlev The signal level for the period, in the units of PowerControlParams::mTarget.
+		@param rxqual RXQUAL 0-7 for the period.
+		@param maxUp, maxDown How far the power can still be changed in each direction, dB.
+	*/
+	int pclStep(const PowerControlParams &params, float rxlev, float rxqual, int maxUp, int maxDown);
+
+	float avgRxlev() const { return mAvgRxlev; }
+	float avgRxqual() const { return mAvgRxqual; }
+};
+
+
+/**
+	The original OpenBTS MS power loop, which orders a damped step toward the power that would put the RSSI
+	on target.  Returns the new ordered MS power in dBm, not yet bounded by GSM.MS.Power.Min/Max.
+	@param damping GSM.MS.Power.Damping, percent.
+	@param SNRTarget GSM.Radio.SNRTarget, or 0 to ignore SNR.
+*/
+float rssiTargetMSPower(float orderedPower, float actualPower, float RSSI, float RSSITarget,
+	float SNR, float SNRTarget, int damping);
+
+};	// namespace GSM
+#endif
@@ -86,6 +86,16 @@ bool requestingLUR(unsigned RA)
 	else return ((RA>>4) == 0x00);
 }
 
+// Under a RACH storm, which is usually a flood of location updates, serve the requests that matter most first.
+int rachPriority(unsigned RA)
+{
+	if ((RA>>5) == 0x05) return 0;		// emergency call
+	// Answer to paging, Table 9.9a.
+	if ((RA>>5) == 0x04 || (RA>>4) == 0x01 || (RA>>4) == 0x02 || (RA>>4) == 0x03) return 1;
+	if (requestingLUR(RA)) return 3;
+	return 2;	// Originating call, SMS, supplementary services, GPRS.
+}
+
 
 
 // Return a RACH channel request message (what we call RA) for various types of channel requests.
@@ -32,6 +32,9 @@ struct RadData {
 	RadData(float wRSSI, float wTimingError) : mValid(true),mRSSI(wRSSI),mTimingError(wTimingError) {}
 };
 
+/** Service priority of a channel request from its establishment cause, GSM 04.08 9.1.8; 0 is most urgent. */
+int rachPriority(unsigned RA);
+
 struct RachInfo {
 	unsigned mRA;
 	const GSM::Time mWhen;
@@ -42,13 +45,14 @@ struct RachInfo {
 	// has passed before servicing them by sending an ImmediateAssignment.
 	L2LogicalChannel *mChan;
 	GSM::Time mReadyTime;	// When the SACCH is known to have started transmiting correctly.
+	int mPriority;			// From the establishment cause, see rachPriority(); lower is more urgent.
 
 	int initialTA() const { return mRadData.mTimingError; }
 	float RSSI() const { return mRadData.mRSSI; }
 
 	// Gotta love this language.
 	RachInfo(unsigned wRA, const GSM::Time &wWhen, RadData wRD, unsigned wTN=0)
-		: mRA(wRA), mWhen(wWhen), mRadData(wRD), mTN(wTN), mChan(NULL)
+		: mRA(wRA), mWhen(wWhen), mRadData(wRD), mTN(wTN), mChan(NULL), mPriority(rachPriority(wRA))
 		{ RN_MEMCHKNEW(RachInfo) }
 	~RachInfo() { RN_MEMCHKDEL(RachInfo) }
 
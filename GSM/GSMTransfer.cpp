@@ -412,7 +412,7 @@ ostream& GSM::operator<<(ostream& os, const RxBurst& ts)
 
 // We put this in the .cpp file to avoid a circular dependency.
 TxBurst::TxBurst(const RxBurst& rx)
-	:BitVector((const BitVector&)rx),mTime(rx.time())
+	:BitVector((const BitVector&)rx),mTime(rx.time()),mAtten(0)
 {}
 
 // We put this in the .cpp file to avoid a circular dependency.
@@ -675,6 +675,28 @@ AudioFrameRtp::AudioFrameRtp(AMRMode wMode) : ByteVector((headerSizeBits(wMode)+
 	}
 }
 
+AudioFrameRtp::AudioFrameRtp(AMRMode wMode, AmrFrameType wType) : ByteVector((RtpPlusAmrHeaderSize()+7)/8), mMode(wMode)
+{
+	assert(wMode != TCH_FS);
+	setAppendP(0);
+	appendField(wMode,RtpHeaderSize());
+	appendField(0,1);
+	appendField(wType,4);
+	appendField(1,1);
+	appendField(0,6);		// Pad to the byte boundary.
+}
+
+unsigned AudioFrameRtp::amrFrameType() const
+{
+	if (size() < 2) { return AmrNoData; }
+	// The frame type follows the CMR and the F bit.
+	unsigned type = 0;
+	for (int i = RtpHeaderSize() + 1; i < RtpHeaderSize() + 5; i++) {
+		type = (type << 1) | getBit(i);
+	}
+	return type;
+}
+
 void AudioFrameRtp::getPayload(BitVector *result) const
 {
 	// Cheating: set the BitVector directly.  TODO: move this into the BitVector class.
@@ -145,12 +145,16 @@ class TxBurst : public BitVector {
 	private:
 
 	Time mTime;			///< GSM frame number
+	unsigned char mAtten;	///< transmit attenuation below full power, dB
 
 	public:
 
+	/** An attenuation that means the burst is not transmitted at all. */
+	static const unsigned cAttenOff = 255;
+
 	/** Create an empty TxBurst. */
 	TxBurst(const Time& wTime = Time(0))
-		:BitVector(gSlotLen),mTime(wTime)
+		:BitVector(gSlotLen),mTime(wTime),mAtten(0)
 	{
 		// Zero out the tail bits now.
 		mStart[0]=0; mStart[1]=0; mStart[2]=0;
@@ -159,7 +163,7 @@ class TxBurst : public BitVector {
 
 	/** Create a TxBurst by copying from an existing BitVector. */
 	TxBurst(const BitVector& wSig, const Time& wTime = Time(0))
-		:BitVector(wSig),mTime(wTime)
+		:BitVector(wSig),mTime(wTime),mAtten(0)
 	{ assert(wSig.size()==gSlotLen); }
 
 	/** Create a TxBurst from an RxBurst (for testing). */
@@ -170,6 +174,9 @@ class TxBurst : public BitVector {
 	// Since mTime is volatile, we can't return a reference.
 	Time time() const { return mTime; }
 	void time(const Time& wTime) { mTime = wTime; }
+	/** The power byte of the TRX burst message, sent to the transceiver with the burst. */
+	unsigned atten() const { return mAtten; }
+	void atten(unsigned dB) { mAtten = dB > 255 ? 255 : dB; }
 	//@}
 
 	bool operator>(const TxBurst& other) const
@@ -626,8 +633,11 @@ class L2Frame : public BitVector {
 	/** Get the "more data" bit (M). */
 	bool M() const { return mStart[8*2+6] & 0x01; }
 
-	/** Return the L3 payload part.  Assumes A or B header format. */
-	BitVector L3Part() const { return cloneSegment(8*3,8*L()); }
+	/**
+		Return the L3 payload part.  Assumes A or B header format.
+		This does not copy; the result refers into this frame so it must not outlive it.
+	*/
+	const BitVector L3Part() const { return segment(8*3,8*L()); }
 
 	/** Return NR sequence number, GSM 04.06 3.5.2.4.  Assumes A or B header. */
 	unsigned NR() const { return peekField(8*1+0,3); }
@@ -855,6 +865,15 @@ class AudioFrameRtp : public SIP::AudioFrame {
 	// Load the generic data from a ByteVector (aka AudioFrame) into this object and set the AMRMode so the RTP data can be decoded.
 	AudioFrameRtp(AMRMode wMode, const SIP::AudioFrame *genericFrame) : ByteVector(*genericFrame), mMode(wMode) {}
 
+	// AMR frame type indices with no speech payload, 3GPP 26.101 table 1a.
+	enum AmrFrameType { AmrSid = 8, AmrNoData = 15 };
+
+	// Create an AMR frame of the specified type, which has no speech payload.
+	AudioFrameRtp(AMRMode wMode, AmrFrameType wType);
+
+	// The frame type index from the AMR table of contents.  Not meaningful for TCH_FS.
+	unsigned amrFrameType() const;
+
 	// Put the payload from this RTP frame into the specified BitVector, which must be the correct size.
 	void getPayload(BitVector *result) const;
 };
@@ -0,0 +1,132 @@
+/*
+* Copyright 2014 Range Networks, Inc.
+*
+* This software is distributed under multiple licenses;
+* see the COPYING file in the main directory for licensing
+* information for this specific distribution.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*/
+
+// Checks of the GSM 05.02 6.2.3 hopping sequence generator.
+//
+// Usage: HoppingTest [N HSN MAIO [frames]]
+// With no arguments it runs the built-in checks; the exit status is 0 on success.
+// With arguments it prints the MAI sequence of one channel.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "GSMHopping.h"
+#include "TestCheck.h"
+
+using namespace GSM;
+
+// The frame number repeats every 26*51*64 frames as far as the sequence is concerned.
+static const unsigned cSequenceLength = 26*51*64;
+
+static void builtinTests()
+{
+	// Every MAI is in range and the channels of one HSN never collide.
+	{	bool inRange = true, distinct = true;
+		for (unsigned N = 2; N <= 64; N++) {
+			for (unsigned HSN = 0; HSN < 64; HSN += 7) {
+				for (unsigned FN = 0; FN < cSequenceLength; FN += 37) {
+					std::vector<bool> used(N,false);
+					for (unsigned MAIO = 0; MAIO < N; MAIO++) {
+						unsigned mai = hoppingMAI(FN,N,MAIO,HSN);
+						if (mai >= N) { inRange = false; continue; }
+						if (used[mai]) distinct = false;
+						used[mai] = true;
+					}
+				}
+			}
+		}
+		check(inRange, "MAI always less than N");
+		check(distinct, "no collisions between MAIOs of the same HSN");
+	}
+
+	// HSN 0 is cyclic hopping.
+	{	bool cyclic = true;
+		for (unsigned FN = 0; FN < 1000; FN++) {
+			if (hoppingMAI(FN,4,1,0) != (FN+1)%4) cyclic = false;
+		}
+		check(cyclic, "HSN 0 is cyclic");
+	}
+
+	// The pseudo random sequences use every frequency about equally often.
+	{	bool even = true;
+		for (unsigned N = 2; N <= 8; N++) {
+			std::vector<unsigned> count(N,0);
+			for (unsigned FN = 0; FN < cSequenceLength; FN++) { count[hoppingMAI(FN,N,0,13)]++; }
+			for (unsigned i = 0; i < N; i++) {
+				if (count[i] < 0.8*cSequenceLength/N || count[i] > 1.2*cSequenceLength/N) even = false;
+			}
+		}
+		check(even, "frequencies used evenly");
+	}
+
+	// Different HSNs are nearly uncorrelated: two channels on different HSNs, the situation in
+	// neighboring cells sharing frequencies, collide about 1/N of the time.
+	{	unsigned N = 4, same = 0;
+		for (unsigned FN = 0; FN < cSequenceLength; FN++) {
+			if (hoppingMAI(FN,N,0,5) == hoppingMAI(FN,N,0,22)) same++;
+		}
+		float rate = (float) same / cSequenceLength;
+		check(rate > 0.15 && rate < 0.35, "different HSNs collide about 1/N of the time");
+	}
+
+	// Known answers, worked by hand from the GSM 05.02 6.2.3 algorithm and RNTABLE.
+	// N=4 so NBIN=3; in the first superframe T1R=0, and T2=T3=FN for FN<26, so M=FN+RNTABLE[HSN+FN].
+	// For example FN 3: M=3+RNTABLE[4]=39, M'=7 is not less than N, so S=(M'+T')%N=(7+3)%4=2.
+	{	static const unsigned expect[8] = { 2, 0, 3, 2, 3, 3, 2, 0 };
+		bool ok = true;
+		for (unsigned FN = 0; FN < 8; FN++) { if (hoppingMAI(FN,4,0,1) != expect[FN]) ok = false; }
+		check(ok, "golden sequence N=4 HSN=1 MAIO=0");
+	}
+	// Later in the hyperframe, where T1R, T2 and T3 all differ.  FN 49162: T1R=37, T2=22, T3=49,
+	// HSN xor T1R=8, M=22+RNTABLE[57]=53, NBIN=3, M'=5 < N, S=5, MAI=(5+2)%6=1.
+	{	static const unsigned expect[8] = { 1, 5, 2, 4, 2, 3, 5, 0 };
+		bool ok = true;
+		for (unsigned i = 0; i < 8; i++) { if (hoppingMAI(49162+i,6,2,45) != expect[i]) ok = false; }
+		check(ok, "golden sequence N=6 HSN=45 MAIO=2");
+	}
+
+	// The pseudo random sequence is not just cyclic.
+	{	unsigned cyclic = 0;
+		for (unsigned FN = 1; FN < 1000; FN++) {
+			if (hoppingMAI(FN,4,0,1) == (hoppingMAI(FN-1,4,0,1)+1)%4) cyclic++;
+		}
+		check(cyclic < 500, "HSN 1 is not cyclic");
+	}
+
+	// Cell allocation order puts ARFCN 0 last.
+	{	std::vector<unsigned> arfcns;
+		arfcns.push_back(5); arfcns.push_back(0); arfcns.push_back(124); arfcns.push_back(1);
+		hoppingSortARFCNs(arfcns);
+		check(arfcns[0] == 1 && arfcns[1] == 5 && arfcns[2] == 124 && arfcns[3] == 0, "ARFCN order");
+	}
+
+	check(hoppingMAI(12345,1,0,17) == 0, "a single frequency does not hop");
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 4) {
+		builtinTests();
+		return checkSummary();
+	}
+
+	unsigned N = atoi(argv[1]), HSN = atoi(argv[2]), MAIO = atoi(argv[3]);
+	unsigned frames = argc > 4 ? atoi(argv[4]) : 104;
+	for (unsigned FN = 0; FN < frames; FN++) {
+		printf("%u %u\n",FN,hoppingMAI(FN,N,MAIO,HSN));
+	}
+	return 0;
+}
@@ -72,6 +72,25 @@ static const char* createPhysicalStatus = {
 };
 #endif
 
+// The latest measurement report of a channel and the physical readings that went with it,
+// copied out so they can be published after the channel has moved on.
+struct GSM::PhysStatusRecord {
+	bool prDirty;				// Received since the last flush.
+	const SACCHLogicalChannel *prChan;
+	string prName;				// The channel descriptiveString, which is the database key.
+	string prImsi;				// Filled in by the flush thread, and only if the report is published.
+	unsigned prGeneration;		// The chanGeneration of the host channel when the report came in.
+	unsigned prARFCN, prCN, prTN;
+	TypeAndOffset prTypeAndOffset;
+	float prFER;
+	float prRSSI, prRSSP, prTimingError;
+	int prMSPower, prMSTiming;
+	int prNeighborARFCN;		// ARFCN of the first reported neighbor, or -1.
+	time_t prTime;
+	L3MeasurementResults prResults;
+	PhysStatusRecord() : prDirty(false), prChan(NULL), prGeneration(0) {}
+};
+
 int PhysicalStatus::open(const char* wPath)
 {
 #if RN_DISABLE_PHYSICAL_DB
@@ -92,6 +111,8 @@ int PhysicalStatus::open(const char* wPath)
 		LOG(EMERG) << "Cannot enable WAL mode on database at " << wPath << ", error message: " << sqlite3_errmsg(mDB);
 	}
 #endif
+	mPublish = publishVersion().size() != 0;
+	mFlushThread.start((void*(*)(void*))flushLoopAdapter,this);
 	return 0;
 }
 
@@ -100,41 +121,19 @@ PhysicalStatus::~PhysicalStatus()
 	if (mDB) sqlite3_close(mDB);
 }
 
-bool PhysicalStatus::createEntry(const SACCHLogicalChannel* chan)
-{
-	assert(mDB);
-	assert(chan);
-
-	ScopedLock lock(mLock);
-
-	const char* chanString = chan->descriptiveString();
-	LOG(DEBUG) << chan->descriptiveString();
-
-	/* Check to see if the key exists. */
-	if (!sqlite3_exists(mDB, "PHYSTATUS", "CN_TN_TYPE_AND_OFFSET", chanString)) {
-		/* No? Ok, it should now. */
-		char query[500];
-		sprintf(query, "INSERT INTO PHYSTATUS (CN_TN_TYPE_AND_OFFSET, ACCESSED) VALUES "
-					   "(\"%s\", %u)",
-				chanString, (unsigned)time(NULL));
-		return sqlite3_command(mDB, query);
-	}
-
-	return false;
-}
-
 bool PhysicalStatus::setPhysical(const SACCHLogicalChannel* chan,
 								const L3MeasurementResults& measResults)
 {
-	// TODO -- It would be better if the argument what just the channel
-	// and the key was just the descriptiveString.
 	assert(chan);
 
-	if (!measResults.isServingCellValid()) {
+	// Nobody wants the report.
+	if (!mPublish && !mDB) {
 		return true;
 	}
 
-	ScopedLock lock(mLock);
+	if (!measResults.isServingCellValid()) {
+		return true;
+	}
 
 	int CN = -1;
 	if (measResults.NO_NCELL()>0) CN = measResults.BCCH_FREQ_NCELL(0);
@@ -151,115 +150,189 @@ bool PhysicalStatus::setPhysical(const SACCHLogicalChannel* chan,
 	}
 
 	MSPhysReportInfo *phys = chan->getPhysInfo();
-	if (gConfig.getStr("NodeManager.API.PhysicalStatus").compare("0.1") == 0) {
-		std::stringstream tao;
-		tao << chan->typeAndOffset();
 
-		JsonBox::Object eData;
-		eData["channel"]["IMSI"] = JsonBox::Value(chan->hostChan()->chanGetImsi(true));
-		eData["channel"]["ARFCN"] = JsonBox::Value((int)chan->ARFCN());
-		eData["channel"]["uplinkFrameErrorRate"] = JsonBox::Value(chan->FER());
-		eData["channel"]["carrierNumber"] = JsonBox::Value((int)chan->CN());
-		eData["channel"]["timeslotNumber"] = JsonBox::Value((int)chan->TN());
-		eData["channel"]["typeAndOffset"] = JsonBox::Value(tao.str());
-		eData["burst"]["RSSI"] = JsonBox::Value(phys->getRSSI());
-		eData["burst"]["RSSP"] = JsonBox::Value(phys->getRSSP());
-		eData["burst"]["actualMSTimingAdvance"] = JsonBox::Value(phys->actualMSTiming());
-		eData["burst"]["actualMSPower"] = JsonBox::Value(phys->actualMSPower());
-		eData["burst"]["timingError"] = JsonBox::Value(phys->timingError());
-		eData["reports"]["servingCell"]["RXLEVEL_FULL_dBm"] = JsonBox::Value(measResults.RXLEV_FULL_SERVING_CELL_dBm());
-		eData["reports"]["servingCell"]["RXLEVEL_SUB_dBm"] = JsonBox::Value(measResults.RXLEV_SUB_SERVING_CELL_dBm());
-		eData["reports"]["servingCell"]["RXQUALITY_FULL_BER"] = JsonBox::Value(measResults.RXQUAL_FULL_SERVING_CELL_BER());
-		eData["reports"]["servingCell"]["RXQUALITY_SUB_BER"] = JsonBox::Value(measResults.RXQUAL_SUB_SERVING_CELL_BER());
-
-		JsonBox::Array neighbors;
-		unsigned nCount = measResults.NO_NCELL();
-		if (nCount != 0 && nCount != 7) {
-			for (unsigned i = 0; i < nCount; i++) {
-				int freq = (int)measResults.BCCH_FREQ_NCELL(i);
-				if (freq) {
-					JsonBox::Object neighbor;
-					neighbor["BCCH_FREQ"] = JsonBox::Value(freq);
-					neighbor["RXLEVEL_dBm"] = JsonBox::Value(measResults.RXLEV_NCELL_dBm(i));
-					neighbor["BSIC"] = JsonBox::Value((int)measResults.BSIC_NCELL(i));
-					neighbors.push_back(neighbor);
-				}
+	ScopedLock lock(mLock);
+	PhysStatusRecord *&rec = mRecords[chan];
+	if (rec == NULL) {
+		rec = new PhysStatusRecord;
+		rec->prChan = chan;
+		rec->prName = chan->descriptiveString();
+	}
+	rec->prDirty = true;
+	rec->prGeneration = chan->hostChan()->chanGeneration();
+	rec->prARFCN = chan->ARFCN();
+	rec->prCN = chan->CN();
+	rec->prTN = chan->TN();
+	rec->prTypeAndOffset = chan->typeAndOffset();
+	rec->prFER = chan->FER();
+	rec->prRSSI = phys->getRSSI();
+	rec->prRSSP = phys->getRSSP();
+	rec->prTimingError = phys->timingError();
+	rec->prMSPower = phys->actualMSPower();
+	rec->prMSTiming = phys->actualMSTiming();
+	rec->prNeighborARFCN = ARFCN;
+	rec->prTime = time(NULL);
+	rec->prResults = measResults;
+	return true;
+}
+
+// The data of a version 0.1 event.  Version 0.2 sends an array of these in one event.
+static JsonBox::Object physEventData(const PhysStatusRecord &rec)
+{
+	const L3MeasurementResults &measResults = rec.prResults;
+	std::stringstream tao;
+	tao << rec.prTypeAndOffset;
+
+	JsonBox::Object eData;
+	eData["channel"]["IMSI"] = JsonBox::Value(rec.prImsi);
+	eData["channel"]["ARFCN"] = JsonBox::Value((int)rec.prARFCN);
+	eData["channel"]["uplinkFrameErrorRate"] = JsonBox::Value(rec.prFER);
+	eData["channel"]["carrierNumber"] = JsonBox::Value((int)rec.prCN);
+	eData["channel"]["timeslotNumber"] = JsonBox::Value((int)rec.prTN);
+	eData["channel"]["typeAndOffset"] = JsonBox::Value(tao.str());
+	eData["burst"]["RSSI"] = JsonBox::Value(rec.prRSSI);
+	eData["burst"]["RSSP"] = JsonBox::Value(rec.prRSSP);
+	eData["burst"]["actualMSTimingAdvance"] = JsonBox::Value(rec.prMSTiming);
+	eData["burst"]["actualMSPower"] = JsonBox::Value(rec.prMSPower);
+	eData["burst"]["timingError"] = JsonBox::Value(rec.prTimingError);
+	eData["reports"]["servingCell"]["RXLEVEL_FULL_dBm"] = JsonBox::Value(measResults.RXLEV_FULL_SERVING_CELL_dBm());
+	eData["reports"]["servingCell"]["RXLEVEL_SUB_dBm"] = JsonBox::Value(measResults.RXLEV_SUB_SERVING_CELL_dBm());
+	eData["reports"]["servingCell"]["RXQUALITY_FULL_BER"] = JsonBox::Value(measResults.RXQUAL_FULL_SERVING_CELL_BER());
+	eData["reports"]["servingCell"]["RXQUALITY_SUB_BER"] = JsonBox::Value(measResults.RXQUAL_SUB_SERVING_CELL_BER());
+
+	JsonBox::Array neighbors;
+	unsigned nCount = measResults.NO_NCELL();
+	if (nCount != 0 && nCount != 7) {
+		for (unsigned i = 0; i < nCount; i++) {
+			int freq = (int)measResults.BCCH_FREQ_NCELL(i);
+			if (freq) {
+				JsonBox::Object neighbor;
+				neighbor["BCCH_FREQ"] = JsonBox::Value(freq);
+				neighbor["RXLEVEL_dBm"] = JsonBox::Value(measResults.RXLEV_NCELL_dBm(i));
+				neighbor["BSIC"] = JsonBox::Value((int)measResults.BSIC_NCELL(i));
+				neighbors.push_back(neighbor);
 			}
 		}
-		eData["reports"]["neighboringCells"] = JsonBox::Array(neighbors);
+	}
+	eData["reports"]["neighboringCells"] = JsonBox::Array(neighbors);
+	return eData;
+}
+
+// The PhysicalStatus event version to publish, or empty if the events are disabled.
+string PhysicalStatus::publishVersion()
+{
+	string version = gConfig.getStr("NodeManager.API.PhysicalStatus");
+	if (version != "0.1" && version != "0.2") { version.clear(); }
+	return version;
+}
 
-		gNodeManager.publishEvent("PhysicalStatus", "0.1", eData);
+void PhysicalStatus::flush()
+{
+	string version = publishVersion();
+	mPublish = version.size() != 0;
+
+	vector<PhysStatusRecord> records;
+	{	ScopedLock lock(mLock);
+		for (std::map<const SACCHLogicalChannel*,PhysStatusRecord*>::iterator it = mRecords.begin(); it != mRecords.end(); ++it) {
+			if (!it->second->prDirty) { continue; }
+			records.push_back(*it->second);
+			it->second->prDirty = false;
+		}
+	}
+	if (records.empty()) { return; }
+
+	if (mPublish) {
+		// The IMSI lookup takes gMMLock, so it is done here once per interval rather than on every report.
+		// If the channel has been released or reassigned since the report, whoever is on it now did not send it,
+		// so the report goes out without an IMSI.
+		for (vector<PhysStatusRecord>::iterator it = records.begin(); it != records.end(); ++it) {
+			if (!it->prChan->hostChan()->chanGetImsiOfGeneration(it->prGeneration,it->prImsi)) {
+				LOG(DEBUG) << "channel reassigned since its report, no IMSI for " << it->prName;
+			}
+		}
 	}
+	if (version == "0.1") {
+		for (vector<PhysStatusRecord>::iterator it = records.begin(); it != records.end(); ++it) {
+			gNodeManager.publishEvent("PhysicalStatus", "0.1", physEventData(*it));
+		}
+	} else if (version == "0.2") {
+		JsonBox::Array channels;
+		for (vector<PhysStatusRecord>::iterator it = records.begin(); it != records.end(); ++it) {
+			channels.push_back(physEventData(*it));
+		}
+		JsonBox::Object eData;
+		eData["channels"] = JsonBox::Array(channels);
+		gNodeManager.publishEvent("PhysicalStatus", "0.2", eData);
+	}
+
+	writeRecords(records);
+}
 
+void PhysicalStatus::flushLoop()
+{
+	while (true) {
+		msleep(gConfig.getNum("NodeManager.API.PhysicalStatus.Interval"));
+		flush();
+	}
+}
 
+bool PhysicalStatus::writeRecords(const vector<PhysStatusRecord> &records)
+{
 #if RN_DISABLE_PHYSICAL_DB
-	if (ARFCN) {}	// shuts up gcc.
+	if (records.size()) {}	// shuts up gcc.
 	return true;
 #else
-	assert(mDB);
-	createEntry(chan);
-
-	char query[500];
-	if (ARFCN<0) {
-		sprintf(query,
-			"UPDATE PHYSTATUS SET "
-			"RXLEV_FULL_SERVING_CELL=%d, "
-			"RXLEV_SUB_SERVING_CELL=%d, "
-			"RXQUAL_FULL_SERVING_CELL_BER=%f, "
-			"RXQUAL_SUB_SERVING_CELL_BER=%f, "
-			"RSSI=%f, "
-			"TIME_ERR=%f, "
-			"TRANS_PWR=%u, "
-			"TIME_ADVC=%u, "
-			"FER=%f, "
-			"ACCESSED=%u, "
-			"ARFCN=%u "
-			"WHERE CN_TN_TYPE_AND_OFFSET==\"%s\"",
-			measResults.RXLEV_FULL_SERVING_CELL_dBm(),
-			measResults.RXLEV_SUB_SERVING_CELL_dBm(),
-			measResults.RXQUAL_FULL_SERVING_CELL_BER(),
-			measResults.RXQUAL_SUB_SERVING_CELL_BER(),
-			phys->RSSI(), phys->timingError(),
-			phys->actualMSPower(), phys->actualMSTiming(),
-			chan->FER(),
-			(unsigned)time(NULL),
-			chan->ARFCN(),
-			chan->descriptiveString());
-	} else {
-		sprintf(query,
-			"UPDATE PHYSTATUS SET "
-			"RXLEV_FULL_SERVING_CELL=%d, "
-			"RXLEV_SUB_SERVING_CELL=%d, "
-			"RXQUAL_FULL_SERVING_CELL_BER=%f, "
-			"RXQUAL_SUB_SERVING_CELL_BER=%f, "
-			"RSSI=%f, "
-			"TIME_ERR=%f, "
-			"TRANS_PWR=%u, "
-			"TIME_ADVC=%u, "
-			"FER=%f, "
-			"ACCESSED=%u, "
-			"ARFCN=%u ,"
-			"NCELL_ARFCN=%u, "
-			"NCELL_RSSI=%d "
-			"WHERE CN_TN_TYPE_AND_OFFSET==\"%s\"",
+	if (!mDB) { return false; }
+	if (!sqlite3_command(mDB,"BEGIN TRANSACTION")) {
+		LOG(ERR) << "PhysicalStatus database begin failed: " << sqlite3_errmsg(mDB);
+		return false;
+	}
+	bool ok = true;
+	for (vector<PhysStatusRecord>::const_iterator it = records.begin(); it != records.end(); ++it) {
+		const PhysStatusRecord &rec = *it;
+		const L3MeasurementResults &measResults = rec.prResults;
+		char ncellArfcn[20] = "NULL", ncellRssi[20] = "NULL";
+		if (rec.prNeighborARFCN >= 0) {
+			snprintf(ncellArfcn,sizeof(ncellArfcn),"%u",(unsigned)rec.prNeighborARFCN);
+			snprintf(ncellRssi,sizeof(ncellRssi),"%d",measResults.RXLEV_NCELL_dBm(0));
+		}
+		char query[700];
+		snprintf(query,sizeof(query),
+			"INSERT OR REPLACE INTO PHYSTATUS ("
+			"CN_TN_TYPE_AND_OFFSET, "
+			"RXLEV_FULL_SERVING_CELL, "
+			"RXLEV_SUB_SERVING_CELL, "
+			"RXQUAL_FULL_SERVING_CELL_BER, "
+			"RXQUAL_SUB_SERVING_CELL_BER, "
+			"RSSI, "
+			"TIME_ERR, "
+			"TRANS_PWR, "
+			"TIME_ADVC, "
+			"FER, "
+			"ACCESSED, "
+			"ARFCN, "
+			"NCELL_ARFCN, "
+			"NCELL_RSSI"
+			") VALUES (\"%s\",%d,%d,%f,%f,%f,%f,%d,%d,%f,%u,%u,%s,%s)",
+			rec.prName.c_str(),
 			measResults.RXLEV_FULL_SERVING_CELL_dBm(),
 			measResults.RXLEV_SUB_SERVING_CELL_dBm(),
 			measResults.RXQUAL_FULL_SERVING_CELL_BER(),
 			measResults.RXQUAL_SUB_SERVING_CELL_BER(),
-			phys->RSSI(), phys->timingError(),
-			phys->actualMSPower(), phys->actualMSTiming(),
-			chan->FER(),
-			(unsigned)time(NULL),
-			chan->ARFCN(),
-			(unsigned)ARFCN,
-			measResults.RXLEV_NCELL_dBm(0),
-			chan->descriptiveString()
-			);
+			rec.prRSSI, rec.prTimingError,
+			rec.prMSPower, rec.prMSTiming,
+			rec.prFER,
+			(unsigned)rec.prTime,
+			rec.prARFCN,
+			ncellArfcn, ncellRssi);
+		LOG(DEBUG) << "Query: " << query;
+		if (!sqlite3_command(mDB, query)) { ok = false; }
 	}
-
-	LOG(DEBUG) << "Query: " << query;
-
-	return sqlite3_command(mDB, query);
+	if (!sqlite3_command(mDB,"COMMIT TRANSACTION")) {
+		LOG(ERR) << "PhysicalStatus database commit failed: " << sqlite3_errmsg(mDB);
+		return false;
+	}
+	return ok;
 #endif
 }
 
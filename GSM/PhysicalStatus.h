@@ -22,6 +22,8 @@
 #define PHYSICALSTATUS_H
 
 #include <map>
+#include <vector>
+#include <string>
 
 #include <Timeval.h>
 #include <Threads.h>
@@ -34,21 +36,38 @@ namespace GSM {
 
 class L3MeasurementResults;
 class SACCHLogicalChannel;
+struct PhysStatusRecord;
 
 /**
 	A table for tracking the state of channels.
+	The SACCH threads only record the latest measurement report of each channel in memory.
+	A separate thread publishes the reports to the NodeManager and writes them to the
+	database in one transaction every NodeManager.API.PhysicalStatus.Interval, so each channel
+	costs at most one event and one row update per interval no matter how often it reports.
 */
 class PhysicalStatus {
 
 private:
 
-	Mutex mLock;		///< to reduce the load on the filesystem locking
-	sqlite3 *mDB;		///< database connection
+	Mutex mLock;		///< protects mRecords
+	sqlite3 *mDB;		///< database connection, used only by the flush thread
+	volatile bool mPublish;	///< PhysicalStatus events are enabled, refreshed by the flush thread
+	/** The latest report of every channel that has reported.  The channels are never deleted, so neither are these. */
+	std::map<const SACCHLogicalChannel*,PhysStatusRecord*> mRecords;
+	Thread mFlushThread;
+
+	void flushLoop();
+	static void *flushLoopAdapter(PhysicalStatus *ps) { ps->flushLoop(); return NULL; }
+	/** Publish and store the reports received since the last flush. */
+	void flush();
+	static std::string publishVersion();
 
 public:
 
+	PhysicalStatus() : mDB(NULL), mPublish(false) {}
+
 	/**
-		Initialize a physical status reporting table.
+		Initialize a physical status reporting table and start the flush thread.
 		@param path Path fto sqlite3 database file.
 		@return 0 if the database was successfully opened and initialized; 1 otherwise
 	*/
@@ -57,10 +76,11 @@ public:
 	~PhysicalStatus();
 
 	/** 
-		Add reporting information associated with a channel to the table.
+		Record the latest reporting information associated with a channel.
+		Nothing is recorded while the events and the database are both disabled.
 		@param chan The channel to report.
 		@param measResults The measurement report.
-		@return The result of the SQLite query: true for the query being executed successfully, false otherwise.
+		@return true; the report is published later by the flush thread.
 	*/
 	bool setPhysical(const SACCHLogicalChannel* chan, const L3MeasurementResults& measResults);
 
@@ -73,11 +93,10 @@ public:
 	private:
 
 	/** 
-		Create entry in table. This is for the initial creation.
-		@param chan The channel to create an entry for.
+		Write the records to the table in one transaction.
 		@return The result of the SQLite query: true for the query being executed successfully, false otherwise.
 	*/
-	bool createEntry(const SACCHLogicalChannel* chan);
+	bool writeRecords(const std::vector<PhysStatusRecord> &records);
 
 
 };
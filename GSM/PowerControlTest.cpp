@@ -0,0 +1,201 @@
+/*
+* Copyright 2014 Range Networks, Inc.
+*
+* This software is distributed under multiple licenses;
+* see the COPYING file in the main directory for licensing
+* information for this specific distribution.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*/
+
+// Closed loop replay of measurement traces through the power control algorithms.
+//
+// A trace has one line per SACCH reporting period:
+//		<uplink RSSI> <uplink RXQUAL> <downlink RXLEV> <downlink RXQUAL>
+// where the levels are what would be measured with the MS and the BTS both at full power:
+// uplink RSSI in dB wrt full scale, downlink RXLEV in dBm as the MS reports it.  Lines starting with # are ignored.
+// The harness applies the ordered power changes to the trace, feeds the result back to the
+// algorithms and prints what they did.
+//
+// Usage: PowerControlTest [trace-file]
+// With no trace file it runs built-in traces and checks the results; the exit status is 0 on success.
+
+#include <stdio.h>
+#include <vector>
+
+#include "GSMPowerControl.h"
+#include "TestCheck.h"
+
+using namespace GSM;
+
+struct TracePoint { float ulRSSI; int ulRxqual; float dlRxlev; int dlRxqual; };
+
+// Bounds, as in the default config.
+static const int cMSPowerMax = 33, cMSPowerMin = 5;
+static const int cDLMaxReduction = 20;
+
+struct ReplayResult {
+	std::vector<int> msPower;		// Ordered MS power each period, dBm.
+	std::vector<int> dlReduction;	// Downlink power reduction each period, dB.
+	std::vector<float> ulMeasured, dlMeasured;
+};
+
+static void replay(const std::vector<TracePoint> &trace, const PowerControlParams &ul, const PowerControlParams &dl,
+	ReplayResult &result, bool verbose)
+{
+	PowerControlLoop ulLoop, dlLoop;
+	int msPower = cMSPowerMax, reduction = 0;
+	if (verbose) printf("# period ulRSSI ulRxqual msPower dlRxlev dlRxqual dlReduction\n");
+	for (unsigned i = 0; i < trace.size(); i++) {
+		const TracePoint &tp = trace[i];
+		float ulMeasured = tp.ulRSSI - (cMSPowerMax - msPower);
+		float dlMeasured = tp.dlRxlev - reduction;
+		if (ul.mAlgorithm == PowerControlParams::RSSITarget) {
+			int ordered = (int) (rssiTargetMSPower(msPower,msPower,ulMeasured,ul.mTarget,0,0,50) + 0.5F);
+			msPower = ordered > cMSPowerMax ? cMSPowerMax : ordered < cMSPowerMin ? cMSPowerMin : ordered;
+		} else {
+			msPower += ulLoop.pclStep(ul,ulMeasured,tp.ulRxqual,cMSPowerMax-msPower,msPower-cMSPowerMin);
+		}
+		reduction -= dlLoop.pclStep(dl,dlMeasured,tp.dlRxqual,reduction,cDLMaxReduction-reduction);
+		result.msPower.push_back(msPower);
+		result.dlReduction.push_back(reduction);
+		result.ulMeasured.push_back(ulMeasured);
+		result.dlMeasured.push_back(dlMeasured);
+		if (verbose) printf("%u %.1f %d %d %.1f %d %d\n",i,ulMeasured,tp.ulRxqual,msPower,dlMeasured,tp.dlRxqual,reduction);
+	}
+}
+
+static void defaultParams(PowerControlParams &ul, PowerControlParams &dl)
+{
+	ul.mAlgorithm = dl.mAlgorithm = PowerControlParams::Threshold;
+	ul.mTarget = -50;		// GSM.Radio.RSSITarget
+	dl.mTarget = -75;		// GSM.PowerControl.DL.Target
+}
+
+static unsigned changesAfter(const std::vector<int> &v, unsigned start)
+{
+	unsigned changes = 0;
+	for (unsigned i = start+1; i < v.size(); i++) { if (v[i] != v[i-1]) changes++; }
+	return changes;
+}
+
+static void builtinTests()
+{
+	PowerControlParams ul, dl;
+	defaultParams(ul,dl);
+
+	// An MS close to the BTS: both directions should back off into the hysteresis band and stay there.
+	{	std::vector<TracePoint> trace(200);
+		for (unsigned i = 0; i < trace.size(); i++) {
+			TracePoint tp = { -30, 0, -55, 0 };
+			// Some measurement noise.
+			tp.ulRSSI += (int)(i*7 % 5) - 2;
+			tp.dlRxlev += (int)(i*3 % 5) - 2;
+			trace[i] = tp;
+		}
+		ReplayResult r;
+		replay(trace,ul,dl,r,false);
+		check(r.msPower.back() < cMSPowerMax - 10, "near MS: uplink power reduced");
+		check(r.dlReduction.back() >= 10, "near MS: downlink power reduced");
+		check(r.ulMeasured.back() >= ul.mTarget - ul.mHysteresis - 2 && r.ulMeasured.back() <= ul.mTarget + ul.mHysteresis + 2,
+			"near MS: uplink level settles near target");
+		check(changesAfter(r.msPower,150) == 0 && changesAfter(r.dlReduction,150) == 0, "near MS: no oscillation once settled");
+	}
+
+	// The MS walks away: power must come back up as the path loss grows.
+	{	std::vector<TracePoint> trace(300);
+		for (unsigned i = 0; i < trace.size(); i++) {
+			TracePoint tp = { -30 - i*0.1F, 0, -55 - i*0.1F, 0 };
+			trace[i] = tp;
+		}
+		ReplayResult r;
+		replay(trace,ul,dl,r,false);
+		check(r.msPower.back() == cMSPowerMax, "receding MS: uplink back to full power");
+		check(r.dlReduction.back() == 0, "receding MS: downlink back to full power");
+		bool neverLow = true;
+		for (unsigned i = 20; i < r.ulMeasured.size(); i++) {
+			if (r.msPower[i] < cMSPowerMax && r.ulMeasured[i] < ul.mTarget - ul.mHysteresis - ul.mIncreaseStep - 2) neverLow = false;
+		}
+		check(neverLow, "receding MS: uplink kept near target while power was available");
+	}
+
+	// Good level but bad quality, eg interference: power goes up, not down.
+	{	std::vector<TracePoint> trace(100);
+		for (unsigned i = 0; i < trace.size(); i++) {
+			TracePoint tp = { -30, 6, -55, 6 };
+			trace[i] = tp;
+		}
+		ReplayResult r;
+		replay(trace,ul,dl,r,false);
+		check(r.msPower.back() == cMSPowerMax && r.dlReduction.back() == 0, "bad RXQUAL: full power");
+	}
+
+	// Limits are respected even with a huge surplus of signal.
+	{	std::vector<TracePoint> trace(400);
+		for (unsigned i = 0; i < trace.size(); i++) {
+			TracePoint tp = { 0, 0, -20, 0 };
+			trace[i] = tp;
+		}
+		ReplayResult r;
+		replay(trace,ul,dl,r,false);
+		check(r.msPower.back() == cMSPowerMin && r.dlReduction.back() == cDLMaxReduction, "strong signal: stops at the limits");
+	}
+
+	// The original algorithm still tracks the target.
+	{	PowerControlParams legacy = ul;
+		legacy.mAlgorithm = PowerControlParams::RSSITarget;
+		std::vector<TracePoint> trace(100);
+		for (unsigned i = 0; i < trace.size(); i++) {
+			TracePoint tp = { -30, 0, -55, 0 };
+			trace[i] = tp;
+		}
+		ReplayResult r;
+		replay(trace,legacy,dl,r,false);
+		check(r.ulMeasured.back() >= legacy.mTarget - 2 && r.ulMeasured.back() <= legacy.mTarget + 2, "RSSITarget: uplink on target");
+	}
+
+	// With every average voting to reduce, the changes come exactly Interval periods apart.
+	{	PowerControlParams p = ul;
+		p.mVoteN = 1;
+		PowerControlLoop loop;
+		std::vector<unsigned> changes;
+		for (unsigned i = 0; i < 12; i++) {
+			if (loop.pclStep(p,0,0,100,100)) { changes.push_back(i); }
+		}
+		bool spaced = changes.size() >= 2;
+		for (unsigned i = 1; i < changes.size(); i++) { if (changes[i] - changes[i-1] != p.mInterval) spaced = false; }
+		check(spaced, "interval: changes are Interval periods apart");
+	}
+
+	check(berToRxqual(0) == 0 && berToRxqual(0.003) == 1 && berToRxqual(0.05) == 5 && berToRxqual(0.5) == 7, "berToRxqual");
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		builtinTests();
+		return checkSummary();
+	}
+
+	FILE *fp = fopen(argv[1],"r");
+	if (!fp) { perror(argv[1]); return 2; }
+	std::vector<TracePoint> trace;
+	char line[200];
+	while (fgets(line,sizeof(line),fp)) {
+		if (line[0] == '#') continue;
+		TracePoint tp;
+		if (sscanf(line,"%f %d %f %d",&tp.ulRSSI,&tp.ulRxqual,&tp.dlRxlev,&tp.dlRxqual) == 4) trace.push_back(tp);
+	}
+	fclose(fp);
+
+	PowerControlParams ul, dl;
+	defaultParams(ul,dl);
+	ReplayResult r;
+	replay(trace,ul,dl,r,true);
+	return 0;
+}
@@ -0,0 +1,39 @@
+/*
+* Copyright 2014 Range Networks, Inc.
+*
+* This software is distributed under multiple licenses;
+* see the COPYING file in the main directory for licensing
+* information for this specific distribution.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*/
+
+// Pass/fail reporting for the built-in checks of the test programs in this directory.
+// Each test program is a single file, so the state lives here rather than in a library.
+
+#ifndef _TESTCHECK_H_
+#define _TESTCHECK_H_ 1
+
+#include <stdio.h>
+
+static int sFailures = 0;
+
+static inline void check(bool ok, const char *what)
+{
+	printf("%s: %s\n", ok ? "ok" : "FAIL", what);
+	if (!ok) sFailures++;
+}
+
+/** Print the number of failed checks and return the exit status for main. */
+static inline int checkSummary()
+{
+	printf("%d failures\n",sFailures);
+	return sFailures ? 1 : 0;
+}
+
+#endif
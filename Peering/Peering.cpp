@@ -554,7 +554,7 @@ void PeerInterface::processHandoverRequest(const struct sockaddr_in* peer, const
 
 	L3Frame handoverFrame(handoverMsg);
 	string handoverHex = handoverFrame.hexstr();
-	char rsp[50];
+	char rsp[200];	// Room for a Handover Command with the hopping elements.
 	sprintf(rsp,"RSP HANDOVER %u 0 0x%s",oldTransID,handoverHex.c_str());
 #else
 	char rsp[50];
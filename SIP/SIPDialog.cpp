@@ -26,6 +26,7 @@
 #include <L3TranEntry.h>
 #include <L3TermCause.h>
 #include <L3StateMachine.h>
+#include <CallTrace.h>
 #include <GSML3MMElements.h>	// for L3CMServiceType
 #include <GSML3CCElements.h>	// for L3Cause
 #include <algorithm>
@@ -128,7 +129,7 @@ void SipMOInviteClientTransactionLayer::MOUssdSendINVITE(string ussd, const L3Lo
 	static const string cInviteStr("INVITE");
 	SipMessage *invite = makeInitialRequest(cInviteStr);
 	// This is dumber than snot.  We have to put in a dummy sdp with port 0.
-	mRTPPort = 0;
+	rtpReleasePort();
 	invite->smAddBody(string("application/sdp"),makeSDPOffer());
 
 	// Add RFC-4119 geolocation XML to content area, if available.
@@ -226,6 +227,7 @@ void SipMOInviteClientTransactionLayer::MOCSendINVITE(const L3LogicalChannel *ch
 	moWriteLowSide(invite);
 	delete invite;
 	setSipState(Starting);
+	gCallTrace.ctMark(mTranId,ctInvite);
 };
 
 
@@ -407,6 +409,7 @@ void SipMTInviteServerTransactionLayer::MTCSendTrying()
 	if (getSipState()==SSFail) return;
 	SipMessageReply trying(invite,100,string("Trying"),this);
 	mtWriteLowSide(&trying);
+	gCallTrace.ctMark(mTranId,ct100);
 	setSipState(Proceeding);
 }
 
@@ -425,6 +428,7 @@ void SipMTInviteServerTransactionLayer::MTCSendRinging()
 	LOG(DEBUG) << "send ringing" <<sdbText();
 	SipMessageReply ringing(invite,180,string("Ringing"),this);
 	mtWriteLowSide(&ringing);
+	gCallTrace.ctMark(mTranId,ct180);
 	setSipState(Proceeding);
 }
 
@@ -433,7 +437,7 @@ void SipMTInviteServerTransactionLayer::MTCSendOK(CodecSet wCodec, const L3Logic
 	if (getSipState()==SSFail) { devassert(0); }
 	SipMessage *invite = getInvite();
 	gReports.incr("OpenBTS.SIP.INVITE-OK.Out");
-	mRTPPort = allocateRTPPorts();
+	rtpAllocatePort();
 	mCodec = wCodec;
 	LOG(INFO) <<sdbText();
 	SipMessageReply ok(invite,200,string("OK"),this);
@@ -441,6 +445,7 @@ void SipMTInviteServerTransactionLayer::MTCSendOK(CodecSet wCodec, const L3Logic
 	// (pat) Chan is NULL when in a weird special handled in dialogCancel.
 	if (chan) SipCallbacks::writePrivateHeaders(&ok,chan);
 	mtWriteLowSide(&ok);
+	gCallTrace.ctMark(mTranId,ct200);
 	setSipState(Connecting);
 	// In RFC-3261 the Transaction Layer no longer handles timers after the OK is sent.
 	// The Transport Layer alone is not capabable of sending the 200 OK reliably because then the
@@ -856,7 +861,7 @@ SipDialog *SipDialog::newSipDialogMOC(
 		//if (pAssertedIdentity.size()) { invite->smAddHeader("P-Asserted-Identity",pAssertedIdentity); }
 	}
 
-	dialog->mRTPPort = Control::allocateRTPPorts();
+	dialog->rtpAllocatePort();
 	dialog->mCodec = wCodecs;
 
 	// Must lock once we do dmAddCallDialog to prevent the SIPInterface threads from accessing this dialog
@@ -896,7 +901,7 @@ SipDialog *SipDialog::newSipDialogHandover(TranEntry *tran, string sipReferStr)
 
 	// Get remote RTP from SIP REFER message, init RTP, create new SDP offer from previous SDP response.
 	// The incoming SDP has the codec previously negotiated, so it should still be ok.
-	dialog->mRTPPort = Control::allocateRTPPorts();
+	dialog->rtpAllocatePort();
 	SdpInfo sdpRemote;
 	sdpRemote.sdpParse(msg->msmBody);
 	SdpInfo sdpLocal = sdpRemote;	// In particular, we are copying the sessionId and versionId.
@@ -1353,10 +1358,12 @@ void SipDialog::handleInviteResponse(int status,
 		case 181:	// Call Is Being Forwarded
 		case 182:	// Queued
 		case 183:	// Session Progress FIXME we need to setup the sound channel (early media)
+			if (status == 100) { gCallTrace.ctMark(mTranId,ct100); }
 			dialogPushState(Proceeding,status);
 			break;
 		case 180:	// Ringing
 			mReceived180 = true;
+			gCallTrace.ctMark(mTranId,ct180);
 			dialogPushState(Ringing,status);
 			break;
 
@@ -1364,6 +1371,7 @@ void SipDialog::handleInviteResponse(int status,
 		case 200:	// OK
 				// Save the response and update the state,
 				// but the ACK doesn't happen until the call connects.
+			gCallTrace.ctMark(mTranId,ct200);
 			dialogPushState(Active,status);
 			break;
 
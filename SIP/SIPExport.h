@@ -21,6 +21,9 @@
 namespace SIP {
 extern void startRegister(TranEntryId tid, const Control::FullMobileId &msic, const string rand, const string sres, L3LogicalChannel *chan);
 extern void startUnregister(const FullMobileId &msid, L3LogicalChannel *chan);
+// Called with the RAND of the challenge the Registrar issued for the prefetch, or an empty string if it issued none.
+typedef void (*AuthPrefetchHandler)(const string &imsi, const string &rand);
+extern void startAuthPrefetch(const string &imsi, AuthPrefetchHandler handler);
 class SipDialog;
 extern SipDialog *getRegistrar();
 
@@ -59,6 +59,21 @@ void SipRtp::rtpStop()
 		gCountRtpSessions--;
 		gCountRtpSockets--;
 	}
+	rtpReleasePort();
+}
+
+void SipRtp::rtpAllocatePort()
+{
+	rtpReleasePort();	// In case we already had one.
+	mRTPPort = Control::allocateRTPPorts();
+}
+
+void SipRtp::rtpReleasePort()
+{
+	if (mRTPPort) {
+		Control::releaseRTPPorts(mRTPPort);
+		mRTPPort = 0;
+	}
 }
 
 void SipRtp::rtpInit()
@@ -86,6 +86,8 @@ class SipRtp {
 
 	void rtpInit();
 	SipRtp() { rtpInit(); }
+	void rtpAllocatePort();		// Take a port pair from the RTP port pool.
+	void rtpReleasePort();		// Give it back.
 	void rtpStop();
 	// The virtual keyword is not currently needed since we dont use pointers to SipRtp as a base class.
 	virtual ~SipRtp() { rtpStop(); }
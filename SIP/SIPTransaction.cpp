@@ -541,6 +541,17 @@ void SipRegisterTU::TUWriteHighSideV(SipMessage *sipmsg)
 	static const char *pRejectCauseHeader = "P-GSM-Reject-Cause";
 	static const char *whatami = stKind == KindRegister ? "SIP Register " : "SIP UnRegister ";
 	LOG(DEBUG) <<LOGVAR(code);
+	if (stKind == KindPrefetch) {
+		// Only the challenge is wanted.  Any other final answer means the Registrar will not give us one now.
+		if (code == 0) {
+			LOG(ERR) << "SIP Register prefetch received unexpected message:"<<sipmsg;
+			stDestroyV();
+		} else if (code >= 200) {
+			stPrefetchHandler(stImsi,code == 401 ? sipmsg->smGetRand401() : string(""));
+			if (code == 401) { setTransactionState(stCompleted); }
+		}
+		return;
+	}
 	if (code == 0) {
 		// A register transaction does not receive any requests.
 		LOG(ERR) << whatami <<"received unexpected message:"<<sipmsg;
@@ -575,6 +586,7 @@ SipRegisterTU::SipRegisterTU(SipRegisterTU::Kind wKind, SipDialog *registrar, Tr
 	//SipMessage *request = registrar->makeRegisterMsg(SIPDTRegister,chan,rand,msid,sres.c_str());
 	// It is in the dummy dialog established for the registrar.
 	stKind = wKind;
+	stPrefetchHandler = NULL;
 	sctInitRegisterClientTransaction(registrar, tid, request, request->smGetBranch());
 }
 
@@ -589,6 +601,19 @@ void startRegister(TranEntryId tid, const FullMobileId &msid, const string rand,
 	reg->sctStart();
 }
 
+// Send a REGISTER without a response to get a challenge for the next location update of this IMSI.
+void startAuthPrefetch(const string &imsi, AuthPrefetchHandler handler)
+{
+	FullMobileId msid(imsi);
+	SipDialog *registrar = getRegistrar();
+	SipMessage *request = registrar->makeRegisterMsg(SIPDTRegister,NULL,"",msid,NULL);
+	SipRegisterTU *reg = new SipRegisterTU(SipRegisterTU::KindPrefetch,registrar,(TranEntryId)0,request);
+	reg->stImsi = imsi;
+	reg->stPrefetchHandler = handler;
+	delete request;		// sctInitRegisterTransaction made a copy.
+	reg->sctStart();
+}
+
 void startUnregister(const FullMobileId &msid, L3LogicalChannel *chan)
 {
 	LOG(DEBUG) <<LOGVAR(msid);
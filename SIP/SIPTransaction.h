@@ -19,6 +19,7 @@
 
 #include "SIPUtility.h"	// For SipTimer, IPAddressSpec
 #include "SIPBase.h"
+#include "SIPExport.h"	// For AuthPrefetchHandler
 
 namespace SIP {
 using namespace std;
@@ -199,7 +200,9 @@ class SipInviteClientTrLayer : public SipClientTrLayer
 // and has only one reply, but we need to know when to destroy it.
 struct SipRegisterTU : public SipClientTrLayer
 {
-	enum Kind { KindRegister=1, KindUnRegister=2 } stKind;
+	enum Kind { KindRegister=1, KindUnRegister=2, KindPrefetch=3 } stKind;
+	string stImsi;		// For KindPrefetch, whose responses do not go to a transaction.
+	AuthPrefetchHandler stPrefetchHandler;	// For KindPrefetch, where the answer goes instead.
 	string stGetMethodNameV() { static const string registerStr("REGISTER"); return registerStr; }
 	void TUWriteHighSideV(SipMessage *sipmsg);
 	//SipRegisterTU(const FullMobileId &msid, const string &rand, const string &sres, L3LogicalChannel *chan); 		// msid is imsi and/or tmsi
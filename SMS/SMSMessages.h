@@ -300,6 +300,8 @@ class TLMessage {
 
 	// Accessors
 	bool MMS() const { return mMMS; }
+	/** Set TP-MMS to tell the MS whether more messages are waiting for it. */
+	void setMoreMessages(bool more) { mMMS = !more; }
 
 	protected:
 
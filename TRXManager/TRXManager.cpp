@@ -43,12 +43,23 @@ using namespace std;
 TransceiverManager::TransceiverManager(int numARFCNs,
 		const char* wTRXAddress, int wBasePort)
 	:mHaveClock(false),
-	mClockSocket(wBasePort+100)
+	mClockSocket(wBasePort+100),
+	mHopN(0),mHSN(0),mHopSlots(0)
 {
 	// set up the ARFCN managers
 	for (int i=0; i<numARFCNs; i++) {
 		int thisBasePort = wBasePort + 1 + 2*i;
-		mARFCNs.push_back(new ::ARFCNManager(wTRXAddress,thisBasePort,*this));
+		mARFCNs.push_back(new ::ARFCNManager(wTRXAddress,thisBasePort,*this,i));
+	}
+	for (unsigned tn=0; tn<8; tn++) { mHopHandover[tn] = 0; }
+}
+
+
+
+void TransceiverManager::configUpdate()
+{
+	for (unsigned i=0; i<mARFCNs.size(); i++) {
+		mARFCNs[i]->configUpdate();
 	}
 }
 
@@ -56,6 +67,25 @@ TransceiverManager::TransceiverManager(int numARFCNs,
 
 void TransceiverManager::start()
 {
+	// Hopping needs at least two carriers besides C0, and GPRS does not know about it.
+	if (gConfig.getBool("GSM.Radio.Hopping")) {
+		if (mARFCNs.size() < 3) {
+			LOG(ALERT) << "GSM.Radio.Hopping needs GSM.Radio.ARFCNs of at least 3, hopping disabled";
+		} else if (gConfig.getBool("GPRS.Enable")) {
+			LOG(ALERT) << "GSM.Radio.Hopping is not supported with GPRS.Enable, hopping disabled";
+		} else {
+			mHopN = mARFCNs.size() - 1;
+			mHSN = gConfig.getNum("GSM.Radio.Hopping.HSN");
+		}
+	}
+	// The bursts of a hopping channel arrive on the receive threads of several carriers,
+	// so it must be decoded on a decode worker, which sees them one at a time and in order.
+	unsigned decodeThreads = gConfig.getNum("GSM.Radio.DecodeThreads");
+	if (mHopN && decodeThreads == 0) {
+		LOG(NOTICE) << "frequency hopping needs the decode stage, using one decode thread";
+		decodeThreads = 1;
+	}
+	mDecodeStage.start(decodeThreads);
 	mClockThread.start((void*(*)(void*))ClockLoopAdapter,this);
 	for (unsigned i=0; i<mARFCNs.size(); i++) {
 		mARFCNs[i]->start();
@@ -64,6 +94,136 @@ void TransceiverManager::start()
 
 
 
+void TransceiverManager::startHopping()
+{
+	if (mHopN == 0) { return; }
+	// A timeslot hops if it is TCH/F on every hopping carrier, so the channels that
+	// trade frequencies all have the same TDMA mapping and the transceivers the same slot setup.
+	unsigned slots = 0;
+	for (unsigned tn=0; tn<8; tn++) {
+		bool allTCH = true;
+		for (unsigned cn=1; cn<mARFCNs.size(); cn++) {
+			if (mARFCNs[cn]->slotCombination(tn) != 1) { allTCH = false; break; }
+		}
+		if (allTCH) { slots |= 1<<tn; }
+	}
+	if (slots == 0) {
+		LOG(ALERT) << "GSM.Radio.Hopping is enabled but no timeslot is TCH/F on all of C1..C" << mHopN << ", nothing hops";
+		return;
+	}
+	// The Mobile Allocation numbers the frequencies in hoppingSortARFCNs order, so find the carrier of each MAI.
+	// The MAIO of carrier CN is CN-1 whatever its frequency.
+	std::vector<unsigned> arfcns;
+	for (unsigned cn=1; cn<mARFCNs.size(); cn++) { arfcns.push_back(mARFCNs[cn]->ARFCN()); }
+	GSM::hoppingSortARFCNs(arfcns);
+	mHopCarrier.assign(mHopN,0);
+	mHopMAI.assign(mARFCNs.size(),0);
+	ostringstream ss;
+	for (unsigned mai=0; mai<arfcns.size(); mai++) {
+		for (unsigned cn=1; cn<mARFCNs.size(); cn++) {
+			if (mARFCNs[cn]->ARFCN() == arfcns[mai]) { mHopCarrier[mai] = cn; mHopMAI[cn] = mai; break; }
+		}
+		ss << " " << arfcns[mai];
+	}
+	for (unsigned tn=0; tn<8; tn++) { mHopRx[tn].mSeen.assign(mARFCNs.size(),-1); }
+	mHopSlots = slots;
+	LOG(NOTICE) << "frequency hopping on timeslots 0x" << hex << slots << dec << " with HSN " << mHSN << " over ARFCNs" << ss.str();
+}
+
+
+std::vector<unsigned> TransceiverManager::hoppingARFCNs()
+{
+	std::vector<unsigned> result;
+	if (!hopping()) { return result; }
+	for (unsigned mai=0; mai<mHopCarrier.size(); mai++) { result.push_back(mARFCNs[mHopCarrier[mai]]->ARFCN()); }
+	return result;
+}
+
+
+// A hopping channel gets its bursts from the receive threads of all the hopping carriers, which do not
+// keep pace with each other, so a burst cannot go in the batch of the carrier that received it:
+// a later burst from another carrier could reach the worker first.  Instead the bursts of each timeslot
+// are collected by frame and a frame is released once every hopping carrier has delivered a burst
+// at least that new, or once it is cHopRxWindow frames old, so the decoders see each channel in FN order.
+// Only a burst for a frame that has already been released is dropped.
+void TransceiverManager::hopReceive(unsigned rxCN, GSM::L1Decoder *proc, const GSM::RxBurst& burst)
+{
+	unsigned TN = burst.time().TN();
+	int32_t FN = burst.time().FN();
+	ScopedLock lock(mHopRxLock[TN]);
+	HopRxSlot &rx = mHopRx[TN];
+	if (rx.mReleased >= 0 && GSM::FNCompare(FN,rx.mReleased) <= 0) {
+		LOG(NOTICE) << "dropping late hopping burst " << burst << " after FN=" << rx.mReleased;
+		return;
+	}
+	if (rx.mSeen[rxCN] < 0 || GSM::FNCompare(FN,rx.mSeen[rxCN]) > 0) { rx.mSeen[rxCN] = FN; }
+
+	// The window slot still holds a frame cHopRxWindow or more older than this one; let it go first.
+	L1DecodeBatch *&pending = rx.mPending[FN % cHopRxWindow];
+	if (pending && pending->mFN != FN) { hopRelease(TN,pending->mFN); }
+	if (pending == NULL) { pending = new L1DecodeBatch(FN); }
+	pending->push_back(new L1DecodeJob(proc,burst));
+
+	// Nothing older than the slowest carrier's last burst can arrive any more.
+	int32_t upTo = FN;
+	for (unsigned cn=1; cn<rx.mSeen.size(); cn++) {
+		if (rx.mSeen[cn] < 0) { upTo = -1; break; }
+		if (GSM::FNCompare(rx.mSeen[cn],upTo) < 0) { upTo = rx.mSeen[cn]; }
+	}
+	int32_t oldest = (FN + GSM::gHyperframe - (cHopRxWindow-1)) % GSM::gHyperframe;
+	if (upTo < 0 || GSM::FNCompare(upTo,oldest) < 0) { upTo = oldest; }
+	hopRelease(TN,upTo);
+}
+
+
+void TransceiverManager::hopRelease(unsigned TN, int32_t upTo)
+{
+	HopRxSlot &rx = mHopRx[TN];
+	// At most cHopRxWindow frames are pending, so a selection sort is fine.
+	while (true) {
+		L1DecodeBatch **next = NULL;
+		for (unsigned i=0; i<cHopRxWindow; i++) {
+			L1DecodeBatch *batch = rx.mPending[i];
+			if (batch == NULL || GSM::FNCompare(batch->mFN,upTo) > 0) { continue; }
+			if (next == NULL || GSM::FNCompare(batch->mFN,(*next)->mFN) < 0) { next = &rx.mPending[i]; }
+		}
+		if (next == NULL) { break; }
+		L1DecodeBatch *batch = *next;
+		*next = NULL;
+		rx.mReleased = batch->mFN;
+		if (mDecodeStage.numWorkers() == 0) {
+			for (L1DecodeBatch::iterator it = batch->begin(); it != batch->end(); it++) {
+				(*it)->mDecoder->writeLowSideRx((*it)->mBurst);
+			}
+			delete batch;
+		} else {
+			// All the hopping channels of the timeslot share one worker so one batch per frame keeps each in order.
+			mDecodeStage.post(mDecodeStage.workerFor(1,TN),batch);
+		}
+	}
+	if (rx.mReleased < 0 || GSM::FNCompare(upTo,rx.mReleased) > 0) { rx.mReleased = upTo; }
+}
+
+
+bool TransceiverManager::hopHandover(unsigned TN, bool on)
+{
+	// Any of the carriers may pick up the handover access burst, and the correlator
+	// stays on until the last of the channels on the timeslot is done with it.
+	ScopedLock lock(mHopHandoverLock);
+	if (on) {
+		if (mHopHandover[TN]++) { return true; }
+	} else {
+		if (mHopHandover[TN] == 0) { return true; }
+		if (--mHopHandover[TN]) { return true; }
+	}
+	bool ok = true;
+	for (unsigned cn=1; cn<mARFCNs.size(); cn++) {
+		ok = mARFCNs[cn]->sendHandover(TN,on) && ok;
+	}
+	return ok;
+}
+
+
 
 
 void* ClockLoopAdapter(TransceiverManager *transceiver)
@@ -144,23 +304,91 @@ unsigned TransceiverManager::C0() const
 
 
 
+void L1DecodeStage::start(unsigned wNumWorkers)
+{
+	if (wNumWorkers > maxWorkers) {
+		LOG(WARNING) << "limiting GSM.Radio.DecodeThreads to " << maxWorkers;
+		wNumWorkers = maxWorkers;
+	}
+	LOG(INFO) << "starting " << wNumWorkers << " uplink decode threads";
+	for (unsigned i=0; i<wNumWorkers; i++) {
+		Worker *worker = new Worker(this);
+		mWorkers.push_back(worker);
+		worker->mThread.start(DecodeLoopAdapter,worker);
+	}
+}
 
 
+void L1DecodeStage::post(unsigned worker, L1DecodeBatch *batch)
+{
+	Worker *wp = mWorkers[worker];
+	wp->mBatchQ.write(batch);
+	// Unlocked statistics; an occasional lost update does not matter.
+	unsigned backlog = wp->mBatchQ.size();
+	if (backlog > wp->mMaxBacklog) { wp->mMaxBacklog = backlog; }
+}
+
 
-::ARFCNManager::ARFCNManager(const char* wTRXAddress, int wBasePort, TransceiverManager &wTransceiver)
-	:mTransceiver(wTransceiver),
-	mDataSocket(wBasePort+100+1,wTRXAddress,wBasePort+1),
-	mControlSocket(wBasePort+100,wTRXAddress,wBasePort)
+void L1DecodeStage::serviceLoop(Worker *worker)
 {
-	// The default demux table is full of NULL pointers.
-	for (int i=0; i<8; i++) {
-		for (unsigned j=0; j<maxModulus; j++) {
-			mDemuxTable[i][j] = NULL;
+	while (! gBTS.btsShutdown()) {
+		L1DecodeBatch *batch = worker->mBatchQ.read();
+		for (L1DecodeBatch::iterator it = batch->begin(); it != batch->end(); it++) {
+			L1DecodeJob *job = *it;
+			job->mDecoder->writeLowSideRx(job->mBurst);
 		}
+		worker->mBatches++;
+		worker->mBursts += batch->size();
+		delete batch;
 	}
 }
 
 
+void* DecodeLoopAdapter(void *arg)
+{
+	L1DecodeStage::Worker *worker = (L1DecodeStage::Worker*)arg;
+	worker->mStage->serviceLoop(worker);
+	return NULL;
+}
+
+
+void L1DecodeStage::text(std::ostream& os) const
+{
+	if (mWorkers.size() == 0) {
+		os << "uplink decoding inline on the TRX receive threads" << endl;
+		return;
+	}
+	for (unsigned i=0; i<mWorkers.size(); i++) {
+		const Worker *wp = mWorkers[i];
+		os << "decode worker " << i << LOGVAR2("batches",wp->mBatches) << LOGVAR2("bursts",wp->mBursts)
+			<< LOGVAR2("backlog",wp->mBatchQ.size()) << LOGVAR2("maxBacklog",wp->mMaxBacklog) << endl;
+	}
+}
+
+
+
+
+
+
+
+::ARFCNManager::ARFCNManager(const char* wTRXAddress, int wBasePort, TransceiverManager &wTransceiver, unsigned wCN)
+	:mTransceiver(wTransceiver),
+	mCN(wCN),
+	mDataSocket(wBasePort+100+1,wTRXAddress,wBasePort+1),
+	mControlSocket(wBasePort+100,wTRXAddress,wBasePort),
+	mRxEpoch(0)
+{
+	// The default demux table has no slots installed.
+	DemuxTable *table = new DemuxTable;
+	for (int i=0; i<8; i++) { table->mSlot[i] = NULL; }
+	table->mMinimumRxRSSI = gConfig.getNum("TRX.MinimumRxRSSI");
+	mDemuxTable = table;
+	for (unsigned i=0; i<L1DecodeStage::maxWorkers; i++) { mDecodeBatch[i] = NULL; }
+	mDecodeBatchFN = -1;
+	for (int i=0; i<8; i++) { mSlotCombination[i] = 0; }
+}
+
+
 
 
 void ::ARFCNManager::start()
@@ -180,20 +408,82 @@ void ::ARFCNManager::installDecoder(GSM::L1Decoder *wL1d)
 
 	LOG(DEBUG) << "ARFCNManager::installDecoder TN: " << TN << " repeatLength: " << mapping.repeatLength();
 
-	mTableLock.lock();
+	ScopedLock lock(mTableLock);
+	const DemuxTable *current = mDemuxTable;
+	DemuxSlot *oldSlot = current->mSlot[TN];
+	DemuxSlot *slot = new DemuxSlot;
+	if (oldSlot) {
+		memcpy(slot,oldSlot,sizeof(DemuxSlot));
+	} else {
+		for (unsigned j=0; j<maxModulus; j++) { slot->mDecoder[j] = NULL; }
+	}
 	for (unsigned i=0; i<mapping.numFrames(); i++) {
 		unsigned FN = mapping.frameMapping(i);
 		while (FN<maxModulus) {
 			// Don't overwrite existing entries.
-			assert(mDemuxTable[TN][FN]==NULL);
-			mDemuxTable[TN][FN] = wL1d;
+			assert(slot->mDecoder[FN]==NULL);
+			slot->mDecoder[FN] = wL1d;
 			FN += mapping.repeatLength();
 		}
 	}
-	mTableLock.unlock();
+	DemuxTable *table = new DemuxTable(*current);
+	table->mSlot[TN] = slot;
+	publishTable(table,oldSlot);
+}
+
+
+void ::ARFCNManager::configUpdate()
+{
+	// Called from the config update hook, so no LOG here.
+	ScopedLock lock(mTableLock);
+	const DemuxTable *current = mDemuxTable;
+	int minimumRxRSSI = gConfig.getNum("TRX.MinimumRxRSSI");
+	if (minimumRxRSSI == current->mMinimumRxRSSI) { return; }
+	DemuxTable *table = new DemuxTable(*current);
+	table->mMinimumRxRSSI = minimumRxRSSI;
+	publishTable(table,NULL);
 }
 
 
+void ::ARFCNManager::publishTable(DemuxTable *table, DemuxSlot *oldSlot)
+{
+	// Make the new table visible before the pointer to it.
+	__sync_synchronize();
+	DemuxTable *old = __sync_lock_test_and_set(&mDemuxTable,table);
+	__sync_synchronize();
+	RetiredTable retired = { old, oldSlot, std::vector<unsigned>(), std::vector<unsigned>() };
+	readers(retired.mReaders);
+	for (unsigned i=0; i<retired.mReaders.size(); i++) {
+		retired.mEpochs.push_back(mTransceiver.ARFCN(retired.mReaders[i])->mRxEpoch);
+	}
+	mRetiredTables.push_back(retired);
+
+	// Any burst that could have picked up a retired table was in progress when it was retired,
+	// so once the mRxEpoch of every thread that reads it has moved on it is done with it.
+	// If no bursts are arriving yet the retired tables wait for the next publish.
+	for (std::list<RetiredTable>::iterator it = mRetiredTables.begin(); it != mRetiredTables.end();) {
+		bool done = true;
+		for (unsigned i=0; i<it->mReaders.size(); i++) {
+			if (it->mEpochs[i] == mTransceiver.ARFCN(it->mReaders[i])->mRxEpoch) { done = false; break; }
+		}
+		if (!done) { it++; continue; }
+		delete it->mTable;
+		delete it->mSlot;
+		it = mRetiredTables.erase(it);
+	}
+}
+
+
+void ::ARFCNManager::readers(std::vector<unsigned> &carriers) const
+{
+	// With hopping, the receive thread of any hopping carrier may use our table.
+	if (mCN == 0 || !mTransceiver.hopping()) {
+		carriers.push_back(mCN);
+		return;
+	}
+	for (unsigned cn=1; cn<mTransceiver.numARFCNs(); cn++) { carriers.push_back(cn); }
+}
+
 
 
 // (pat) renamed overloaded function to clarify code
@@ -213,28 +503,44 @@ void ::ARFCNManager::writeHighSideTx(const GSM::TxBurst& burst,const char *culpr
 	*wp++ = (FN>>16) & 0x0ff;
 	*wp++ = (FN>>8) & 0x0ff;
 	*wp++ = (FN) & 0x0ff;
-	// power level
-	/// FIXME -- We hard-code gain to 0 dB for now.
-	*wp++ = 0;
+	// power level, as attenuation below full power in dB
+	*wp++ = burst.atten();
 	// copy data
 	const char *dp = burst.begin();
 	for (unsigned i=0; i<gSlotLen; i++) {
 		*wp++ = (unsigned char)((*dp++) & 0x01);
 	}
-	// write to the socket
-	mDataSocketLock.lock();
-	mDataSocket.write(buffer,bufferSize);
-	mDataSocketLock.unlock();
+	// write to the socket; a hopping channel goes out on the carrier it hops to in this frame
+	::ARFCNManager *radio = this;
+	if (mTransceiver.hops(mCN,burst.time().TN())) { radio = mTransceiver.ARFCN(mTransceiver.hopTxCarrier(mCN,FN)); }
+	radio->mDataSocketLock.lock();
+	radio->mDataSocket.write(buffer,bufferSize);
+	radio->mDataSocketLock.unlock();
 }
 
 
 
 
+// The transceiver only sends the bursts it detected, so on a quiet carrier the next burst may be many frames away.
+// With decode workers the receive thread waits at most this long for it before releasing the pending batches.
+// It is about one TDMA frame.
+static const unsigned cDecodeFlushMs = 5;
+
 void ::ARFCNManager::driveRx()
 {
 	// read the message
 	char buffer[MAX_UDP_LENGTH];
-	int msgLen = mDataSocket.read(buffer);
+	int msgLen;
+	if (mTransceiver.decodeStage().numWorkers()) {
+		msgLen = mDataSocket.read(buffer,cDecodeFlushMs);
+		if (msgLen<0) {		// Timed out.
+			flushDecodeBatches();
+			__sync_fetch_and_add(&mRxEpoch,1);	// We are not using a demux table either.
+			return;
+		}
+	} else {
+		msgLen = mDataSocket.read(buffer);
+	}
 	if (msgLen<=0) SOCKET_ERROR;
 	// decode
 	unsigned char *rp = (unsigned char*)buffer;
@@ -259,6 +565,8 @@ void ::ARFCNManager::driveRx()
 	for (unsigned i=0; i<gSlotLen; i++) data[i] = (*rp++) / 256.0F;
 	// demux
 	receiveBurst(RxBurst(data,GSM::Time(FN,TN),timingError/256.0F,-RSSI));
+	// Tell publishTable we are done with the demux table we used; this is also a full barrier.
+	__sync_fetch_and_add(&mRxEpoch,1);
 }
 
 
@@ -520,6 +828,7 @@ bool ::ARFCNManager::setSlot(unsigned TN, unsigned combination)
 		LOG(ALERT) << "SETSLOT("<<TN<<","<<combination<<") failed with status " << status;
 		return false;
 	}
+	mSlotCombination[TN] = combination;
 	return true;
 }
 
@@ -548,21 +857,25 @@ signed ::ARFCNManager::setRxGain(signed rxGain)
 bool ::ARFCNManager::setHandover(unsigned TN)
 {
 	assert(TN<8);
-	int status = sendCommand("HANDOVER",TN);
-	if (status!=0) {
-		LOG(ALERT) << "HANDOVER("<<TN<<") failed with status " << status;
-		return false;
-	}
-	return true;
+	if (mTransceiver.hops(mCN,TN)) { return mTransceiver.hopHandover(TN,true); }
+	return sendHandover(TN,true);
 }
 
 
 bool ::ARFCNManager::clearHandover(unsigned TN)
 {
 	assert(TN<8);
-	int status = sendCommand("NOHANDOVER",TN);
+	if (mTransceiver.hops(mCN,TN)) { return mTransceiver.hopHandover(TN,false); }
+	return sendHandover(TN,false);
+}
+
+
+bool ::ARFCNManager::sendHandover(unsigned TN, bool on)
+{
+	const char *command = on ? "HANDOVER" : "NOHANDOVER";
+	int status = sendCommand(command,TN);
 	if (status!=0) {
-		LOG(ALERT) << "NOHANDOVER("<<TN<<") failed with status " << status;
+		LOG(ALERT) << command << "("<<TN<<") failed with status " << status;
 		return false;
 	}
 	return true;
@@ -616,7 +929,9 @@ signed ::ARFCNManager::getFactoryCalibration(const char * param)
 
 void ::ARFCNManager::receiveBurst(const RxBurst& inBurst)
 {
-	if (inBurst.RSSI() < gConfig.getNum("TRX.MinimumRxRSSI")) {
+	// No lock: the table is immutable and only freed after we bump mRxEpoch in driveRx.
+	const DemuxTable *table = mDemuxTable;
+	if (inBurst.RSSI() < table->mMinimumRxRSSI) {
 		LOG(DEBUG) << "ignoring " << inBurst;
 		return;
 	}
@@ -625,13 +940,53 @@ void ::ARFCNManager::receiveBurst(const RxBurst& inBurst)
 	uint32_t FN = inBurst.time().FN() % maxModulus;
 	unsigned TN = inBurst.time().TN();
 
-	ScopedLock lock(mTableLock);
-	L1Decoder *proc = mDemuxTable[TN][FN];
+	// On a hopping timeslot the burst belongs to the channel that hopped onto our frequency in this frame.
+	// Its decoder is in the table of its own carrier, which the carrier's readers() covers.
+	bool hopping = mTransceiver.hops(mCN,TN);
+	if (hopping) {
+		table = mTransceiver.ARFCN(mTransceiver.hopRxCarrier(mCN,inBurst.time().FN()))->mDemuxTable;
+	}
+
+	const DemuxSlot *slot = table->mSlot[TN];
+	L1Decoder *proc = slot ? slot->mDecoder[FN] : NULL;
 	if (proc==NULL) {
 		LOG(DEBUG) << "ARFNManager::receiveBurst time " << inBurst.time() << " in unconfigured TDMA position T" << TN << " FN=" << FN << ".";
 		return;
 	}
-	proc->writeLowSideRx(inBurst);
+	if (hopping) {
+		mTransceiver.hopReceive(mCN,proc,inBurst);
+		return;
+	}
+
+	L1DecodeStage &stage = mTransceiver.decodeStage();
+	if (stage.numWorkers() == 0) {
+		proc->writeLowSideRx(inBurst);
+		return;
+	}
+
+	// Collect the bursts of this frame, one batch per worker, and release them
+	// when the frame is complete, ie, after TN 7 or when the next frame starts,
+	// or when driveRx has waited cDecodeFlushMs for another burst.
+	int32_t burstFN = inBurst.time().FN();
+	if (burstFN != mDecodeBatchFN) {
+		flushDecodeBatches();
+		mDecodeBatchFN = burstFN;
+	}
+	unsigned worker = stage.workerFor(proc->CN(),TN);
+	if (mDecodeBatch[worker] == NULL) { mDecodeBatch[worker] = new L1DecodeBatch(burstFN); }
+	mDecodeBatch[worker]->push_back(new L1DecodeJob(proc,inBurst));
+	if (TN == 7) { flushDecodeBatches(); }
+}
+
+
+void ::ARFCNManager::flushDecodeBatches()
+{
+	L1DecodeStage &stage = mTransceiver.decodeStage();
+	for (unsigned i=0; i<stage.numWorkers(); i++) {
+		if (mDecodeBatch[i] == NULL) continue;
+		stage.post(i,mDecodeBatch[i]);
+		mDecodeBatch[i] = NULL;
+	}
 }
 
 
@@ -27,6 +27,7 @@
 #include "Interthread.h"
 #include "GSMCommon.h"
 #include "GSMTransfer.h"
+#include "GSMHopping.h"
 #include <list>
 
 
@@ -41,6 +42,76 @@ class L1Decoder;
 class ARFCNManager;
 
 
+
+/** One uplink burst waiting to be delivered to the L1Decoder that owns its TDMA position. */
+struct L1DecodeJob {
+	GSM::L1Decoder *mDecoder;
+	GSM::RxBurst mBurst;		///< a private copy; the radio receive buffer is reused
+	L1DecodeJob(GSM::L1Decoder *wDecoder, const GSM::RxBurst& wBurst)
+		:mDecoder(wDecoder),mBurst(wBurst)
+	{}
+};
+
+
+/** The bursts of one TDMA frame on one ARFCN that belong to a single decode worker. */
+class L1DecodeBatch : public std::vector<L1DecodeJob*> {
+	public:
+	int32_t mFN;
+	L1DecodeBatch(int32_t wFN) :mFN(wFN) {}
+	~L1DecodeBatch() { for (iterator it = begin(); it != end(); it++) { delete *it; } }
+};
+
+
+/**
+	The uplink decode stage.
+	Without it each ARFCNManager receive thread runs the deinterleaver and Viterbi decoder inline
+	when the last burst of an interleaving block arrives, so the socket reader is stalled for the
+	whole decode and all the decoding for one carrier is done on one core.
+	With it, the receive threads only demultiplex: they collect the bursts of each TDMA frame
+	into one batch per worker and hand the batches to a fixed pool of decode threads.
+	Timeslot (CN,TN) is always decoded by the same worker, so every L1Decoder (and the SACCH
+	and GPRS PDCH sharing its timeslot) still sees its bursts in order from a single thread,
+	which is what the decoders have always assumed, and frames go up to L2 in order.
+*/
+class L1DecodeStage {
+
+	private:
+
+	struct Worker {
+		L1DecodeStage *mStage;
+		InterthreadQueue<L1DecodeBatch> mBatchQ;	///< frames waiting to be decoded
+		Thread mThread;
+		unsigned mBatches;			///< total batches decoded, for the CLI
+		unsigned mBursts;			///< total bursts decoded, for the CLI
+		unsigned mMaxBacklog;		///< high water mark of mBatchQ
+		Worker(L1DecodeStage *wStage) :mStage(wStage),mBatches(0),mBursts(0),mMaxBacklog(0) {}
+	};
+	std::vector<Worker*> mWorkers;
+
+	/** Worker service loop. */
+	void serviceLoop(Worker *worker);
+	friend void* DecodeLoopAdapter(void*);
+
+	public:
+
+	static const unsigned maxWorkers=16;
+
+	/** Number of decode workers; 0 means the receive threads decode inline as before. */
+	unsigned numWorkers() const { return mWorkers.size(); }
+
+	/** Start the workers.  Called once from TransceiverManager::start(). */
+	void start(unsigned wNumWorkers);
+
+	/** Which worker owns this timeslot. */
+	unsigned workerFor(unsigned CN, unsigned TN) const { return (CN*8 + TN) % mWorkers.size(); }
+
+	/** Hand a completed frame to a worker.  The worker deletes the batch. */
+	void post(unsigned worker, L1DecodeBatch *batch);
+
+	void text(std::ostream& os) const;
+};
+
+
 /**
 	The TransceiverManager processes the complete transcevier interface.
 	There is one of these for each access point.
@@ -58,6 +129,37 @@ class TransceiverManager {
 	UDPSocket mClockSocket;		
 	/// a thread to monitor the global clock socket
 	Thread mClockThread;	
+	/// the uplink decode workers shared by all ARFCNs
+	L1DecodeStage mDecodeStage;
+
+	/**@name Baseband frequency hopping.
+		The channels of carriers C1..CN on a hopping timeslot hop over the frequencies of those carriers:
+		the channel created on carrier CN uses MAIO CN-1, and in each frame its bursts are sent to and
+		taken from whichever carrier the GSM 05.02 sequence puts it on.  C0 never hops.
+		The Mobile Allocation numbers the frequencies in hoppingSortARFCNs order, which need not be carrier order,
+		so MAI i is on carrier mHopCarrier[i].
+		Set up once at startup, before any hopping channel is opened. */
+	//@{
+	unsigned mHopN;				///< number of hopping carriers, 0 if hopping is off
+	unsigned mHSN;				///< hopping sequence number
+	unsigned mHopSlots;			///< bit TN is set if timeslot TN hops
+	Mutex mHopHandoverLock;
+	unsigned mHopHandover[8];	///< pending handovers on each hopping timeslot, protected by mHopHandoverLock
+	std::vector<unsigned> mHopCarrier;	///< the carrier of each MAI
+	std::vector<unsigned> mHopMAI;		///< the MAI of each carrier, indexed by CN
+	static const unsigned cHopRxWindow = 8;	///< frames an uplink burst may wait for the slower carriers; divides the hyperframe
+	/** The uplink reorder window of a hopping timeslot, protected by its mHopRxLock. */
+	struct HopRxSlot {
+		int32_t mReleased;			///< FN of the last frame passed to the decoders, -1 if none
+		std::vector<int32_t> mSeen;	///< FN of the last burst from the receive thread of each carrier, -1 if none
+		L1DecodeBatch *mPending[cHopRxWindow];	///< frames waiting for the slower carriers, by FN % cHopRxWindow
+		HopRxSlot() :mReleased(-1) { for (unsigned i=0; i<cHopRxWindow; i++) { mPending[i] = NULL; } }
+	};
+	Mutex mHopRxLock[8];		///< serializes the uplink bursts of each hopping timeslot
+	HopRxSlot mHopRx[8];
+	/** Pass the pending frames of timeslot TN up to and including upTo to the decoders, in FN order. */
+	void hopRelease(unsigned TN, int32_t upTo);
+	//@}
 
 
 	public:
@@ -81,12 +183,41 @@ class TransceiverManager {
 	unsigned C0() const;
 	unsigned numARFCNs() const { return mARFCNs.size(); }
 
+	L1DecodeStage& decodeStage() { return mDecodeStage; }
+
+	/**@name Frequency hopping. */
+	//@{
+	/** Pick the timeslots that hop, once all the channels are created.  Does nothing unless GSM.Radio.Hopping is in effect. */
+	void startHopping();
+	bool hopping() const { return mHopSlots != 0; }
+	/** True if the channels of carrier CN on timeslot TN hop. */
+	bool hops(unsigned CN, unsigned TN) const { return mHopSlots && CN > 0 && (mHopSlots >> TN) & 1; }
+	unsigned HSN() const { return mHSN; }
+	/** The MAIO of the hopping channels of carrier CN. */
+	unsigned MAIO(unsigned CN) const { return CN - 1; }
+	/** The carrier that carries the hopping channel of carrier CN in frame FN. */
+	unsigned hopTxCarrier(unsigned CN, uint32_t FN) const
+		{ return mHopCarrier[GSM::hoppingMAI(FN,mHopN,MAIO(CN),mHSN)]; }
+	/** The carrier whose hopping channel is on carrier CN in frame FN. */
+	unsigned hopRxCarrier(unsigned CN, uint32_t FN) const
+		{ return 1 + (mHopMAI[CN] + mHopN - GSM::hoppingMAI(FN,mHopN,0,mHSN)) % mHopN; }
+	/** The ARFCNs the hopping channels hop over in hoppingSortARFCNs order, which is MAI order, empty if nothing hops. */
+	std::vector<unsigned> hoppingARFCNs();
+	/** Turn the handover correlator on or off for a hopping timeslot, on every carrier it hops to. */
+	bool hopHandover(unsigned TN, bool on);
+	/** Pass an uplink burst received on carrier rxCN on a hopping timeslot to its decoder, in FN order whichever carrier received it. */
+	void hopReceive(unsigned rxCN, GSM::L1Decoder *proc, const GSM::RxBurst& burst);
+	//@}
+
 	/** Block until the clock is set over the UDP link. */
 	//void waitForClockInit() const;
 
 	/** Start the clock management thread and all ARFCN managers. */
 	void start();
 
+	/** Called when the configuration changes. */
+	void configUpdate();
+
 	/** Clock service loop. */
 	friend void* ClockLoopAdapter(TransceiverManager*);
 
@@ -101,6 +232,9 @@ class TransceiverManager {
 
 void* ClockLoopAdapter(TransceiverManager *TRXm);
 
+/** C interface for L1DecodeStage worker threads. */
+void* DecodeLoopAdapter(void *arg);
+
 
 
 
@@ -113,6 +247,7 @@ class ARFCNManager {
 	private:
 
 	TransceiverManager &mTransceiver;
+	unsigned mCN;					///< our carrier index under mTransceiver
 
 	Mutex mDataSocketLock;			///< lock to prevent contentional for the socket
 	UDPSocket mDataSocket;			///< socket for data transfer
@@ -122,23 +257,57 @@ class ARFCNManager {
 	Thread mRxThread;				///< thread to receive data from rx
 
 	/**@name The demux table. */
+	// The receive thread reads the table for every burst, so it is published RCU-style:
+	// a table is never modified once published; installDecoder() and configUpdate() build a
+	// new one and swap the pointer.  The replaced table is freed once the receive thread
+	// has finished the burst it may have been working on, which we know from mRxEpoch.
 	//@{
-	Mutex mTableLock;
 	static const unsigned maxModulus=51*26*4;	///< maximum unified repeat period
-	GSM::L1Decoder* mDemuxTable[8][maxModulus];		///< the demultiplexing table for received bursts
+	/** The decoders for one timeslot, indexed by FN % maxModulus. */
+	struct DemuxSlot {
+		GSM::L1Decoder* mDecoder[maxModulus];
+	};
+	/** The demultiplexing table for received bursts. */
+	struct DemuxTable {
+		DemuxSlot* mSlot[8];		///< NULL for a timeslot with nothing installed
+		int mMinimumRxRSSI;			///< TRX.MinimumRxRSSI, cached so the burst path never reads the config
+	};
+	struct RetiredTable {
+		DemuxTable *mTable;
+		DemuxSlot *mSlot;			///< the slot replaced along with mTable, if any
+		std::vector<unsigned> mReaders;	///< the carriers whose receive threads may be reading mTable
+		std::vector<unsigned> mEpochs;	///< the mRxEpoch of each of mReaders when mTable was replaced
+	};
+	Mutex mTableLock;						///< serializes writers; the receive thread does not take it
+	DemuxTable* volatile mDemuxTable;		///< the current table
+	volatile unsigned mRxEpoch;				///< incremented by the receive thread after each burst
+	std::list<RetiredTable> mRetiredTables;	///< replaced tables not yet freed, protected by mTableLock
+
+	/** Swap in a new table; oldSlot is a DemuxSlot no longer referenced by it.  Caller holds mTableLock. */
+	void publishTable(DemuxTable *table, DemuxSlot *oldSlot);
+	/** The carriers whose receive threads may read our table: just us, or all the hopping carriers. */
+	void readers(std::vector<unsigned> &carriers) const;
+	//@}
+
+	/**@name Uplink bursts of the current frame waiting to go to the decode stage. */
+	//@{
+	L1DecodeBatch* mDecodeBatch[L1DecodeStage::maxWorkers];	///< one per worker, NULL if empty
+	int32_t mDecodeBatchFN;							///< frame number of the pending batches
 	//@}
 
 	unsigned mARFCN;						///< the current ARFCN
+	unsigned mSlotCombination[8];			///< the last setSlot on each timeslot
 
 
 	public:
 
-	ARFCNManager(const char* wTRXAddress, int wBasePort, TransceiverManager &wTRX);
+	ARFCNManager(const char* wTRXAddress, int wBasePort, TransceiverManager &wTRX, unsigned wCN);
 
 	/** Start the uplink thread. */
 	void start();
 
 	unsigned ARFCN() const { return mARFCN; }
+	unsigned CN() const { return mCN; }
 
 	 // (pat) This passes the message through to UDPSocket::write(),
 	 // which maps to DatagramSocket::write() which does an immediate sendto() on the socket.
@@ -262,12 +431,21 @@ class ARFCNManager {
 	*/
 	bool clearHandover(unsigned TN);
 
+	/** Send HANDOVER or NOHANDOVER to this transceiver, whether or not the timeslot hops. */
+	bool sendHandover(unsigned TN, bool on);
+
+	/** Combination set on a timeslot by setSlot. */
+	unsigned slotCombination(unsigned TN) const { return mSlotCombination[TN]; }
+
 	//@}
 
 
 	/** Install a decoder on this ARFCN. */
 	void installDecoder(GSM::L1Decoder* wL1);
 
+	/** Refresh the config values cached in the demux table. */
+	void configUpdate();
+
 
 
 	private:
@@ -278,6 +456,9 @@ class ARFCNManager {
 	/** Demultiplex and process a received burst. */
 	void receiveBurst(const GSM::RxBurst&);
 
+	/** Send the pending batches of the current frame to the decode stage. */
+	void flushDecodeBatches();
+
 	/** Receiver loop. */
 	friend void* ReceiveLoopAdapter(ARFCNManager*);
 
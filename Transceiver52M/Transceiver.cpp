@@ -75,6 +75,12 @@ Transceiver::Transceiver(int wBasePort,
   txFullScale = mRadioInterface->fullScaleInputValue();
   rxFullScale = mRadioInterface->fullScaleOutputValue();
 
+  // Precompute the burst amplitude for each attenuation so fixRadioVector does not call pow per burst.
+  // The attenuation is a power ratio, so the amplitude goes as 10^(-dB/20).
+  for (int dB = 0; dB <= cMaxTxAtten; dB++) {
+    mTxScale[dB] = txFullScale * pow(10.0,-dB/20.0);
+  }
+
   mOn = false;
   mTxFreq = 0.0;
   mRxFreq = 0.0;
@@ -125,18 +131,20 @@ bool Transceiver::init()
 }
  
 radioVector *Transceiver::fixRadioVector(BitVector &burst,
-				 int RSSI,
+				 int atten,
 				 GSM::Time &wTime)
 {
+  // The core sends 0 for the beacon carrier, which must stay at full power.
+  // Anything past the table, normally 255, is a burst that is not transmitted, eg during downlink DTX.
+  if (atten < 0) atten = 0;
 
   // modulate and stick into queue 
   signalVector* modBurst = modulateBurst(burst,
 					 8 + (wTime.TN() % 4 == 0),
 					 mSPSTx);
-  scaleVector(*modBurst,txFullScale * pow(10,-RSSI/10));
+  scaleVector(*modBurst,atten > cMaxTxAtten ? 0.0 : mTxScale[atten]);
 
   radioVector *newVec = new radioVector(*modBurst,wTime);
-  //fillerActive[ARFCN][wTime.TN()] = (ARFCN==0) || (RSSI != 255);
 
   delete modBurst;
   return newVec;
@@ -700,7 +708,7 @@ bool Transceiver::driveTransmitPriorityQueue()
 
   LOG(DEBUG) << "rcvd. burst at: " << GSM::Time(frameNum,timeSlot) <<LOGVAR(fillerFlag);
   
-  int RSSI = (int) buffer[5];
+  int atten = (unsigned char) buffer[5];	// Transmit attenuation below full power, dB.
   static BitVector newBurst(gSlotLen);
   BitVector::iterator itr = newBurst.begin();
   char *bufferItr = buffer+6;
@@ -709,7 +717,7 @@ bool Transceiver::driveTransmitPriorityQueue()
   
   GSM::Time currTime = GSM::Time(frameNum,timeSlot);
 
-  radioVector *newVec = fixRadioVector(newBurst,RSSI,currTime);
+  radioVector *newVec = fixRadioVector(newBurst,atten,currTime);
 
   if (fillerFlag) {
 	setFiller(newVec,false,true);
@@ -717,7 +725,7 @@ bool Transceiver::driveTransmitPriorityQueue()
 	mTransmitPriorityQueue.write(newVec);
   }
   
-  //LOG(DEBUG) "added burst - time: " << currTime << ", RSSI: " << RSSI; // << ", data: " << newBurst; 
+  //LOG(DEBUG) "added burst - time: " << currTime << ", atten: " << atten; // << ", data: " << newBurst; 
 
   return true;
 
@@ -66,6 +66,10 @@ private:
 
   RadioInterface *mRadioInterface;	  ///< associated radioInterface object
   double txFullScale;                     ///< full scale input to radio
+
+  /** Burst amplitude for each attenuation in the power byte of the burst message, dB below full power. */
+  static const int cMaxTxAtten = 63;
+  double mTxScale[cMaxTxAtten+1];
   double rxFullScale;                     ///< full scale output to radio
 
   /** Codes for burst types of received bursts*/
@@ -103,7 +107,7 @@ private:
   void setFiller(radioVector *rv, bool allocate, bool force);
 
   /** modulate and add a burst to the transmit queue */
-  radioVector *fixRadioVector(BitVector &burst, int RSSI, GSM::Time &wTime);
+  radioVector *fixRadioVector(BitVector &burst, int atten, GSM::Time &wTime);
 
   /** Push modulated burst into transmit FIFO corresponding to a particular timestamp */
   void pushRadioVector(GSM::Time &nowTime);
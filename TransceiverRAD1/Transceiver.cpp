@@ -81,6 +81,13 @@ Transceiver::Transceiver(int wBasePort,
   mFreqOffset = 0.0;
   mMultipleARFCN = (mNumARFCNs > 1);
 
+  // Precompute the burst amplitude for each attenuation so fixRadioVector does not call pow per burst.
+  // The attenuation is a power ratio, so the amplitude goes as 10^(-dB/20).
+  float headRoom = mMultipleARFCN ? 0.5 : 1.0;
+  for (int dB = 0; dB <= cMaxTxAtten; dB++) {
+    mTxScale[dB] = txFullScale * headRoom * pow(10.0,-dB/20.0) / mNumARFCNs;
+  }
+
   // initialize other per-timeslot variables
   for (int tn = 0; tn < 8; tn++) {
 	  for (int arfcn = 0; arfcn < mNumARFCNs; arfcn++) {
@@ -157,10 +164,13 @@ Transceiver::~Transceiver()
   
 
 radioVector *Transceiver::fixRadioVector(BitVector &burst,
-				 int RSSI,
+				 int atten,
 				 GSM::Time &wTime,
 				 int ARFCN)
 {
+  // The beacon carrier is always sent at full power, GSM 05.08 7.1.
+  // Anything past the table, normally 255, is a burst that is not transmitted, eg during downlink DTX.
+  if (ARFCN == 0 || atten < 0) atten = 0;
 
   // modulate and stick into queue 
   signalVector* modBurst = modulateBurst(burst,*gsmPulse,
@@ -170,10 +180,8 @@ radioVector *Transceiver::fixRadioVector(BitVector &burst,
   rScale = rScale/rScale.abs();
   scaleVector(*modBurst,rScale);*/
 
-  float headRoom = (mNumARFCNs > 1) ? 0.5 : 1.0;
-  scaleVector(*modBurst,txFullScale * headRoom * pow(10,-RSSI/10)/mNumARFCNs);
+  scaleVector(*modBurst,atten > cMaxTxAtten ? 0.0 : mTxScale[atten]);
   radioVector *newVec = new radioVector(*modBurst,wTime,ARFCN);
-  //fillerActive[ARFCN][wTime.TN()] = (ARFCN==0) || (RSSI != 255);
 
   // upsample and filter and freq shift
   if (mMultipleARFCN) {
@@ -767,7 +775,7 @@ bool Transceiver::driveTransmitPriorityQueue(unsigned ARFCN)
 
   LOG(DEBUG) << "rcvd. burst at: " << GSM::Time(frameNum,timeSlot) <<LOGVAR(fillerFlag);
   
-  int RSSI = (int) buffer[5];	// (pat) It is not RSSI, it is transmit gain, always set to 0.
+  int atten = (unsigned char) buffer[5];	// Transmit attenuation below full power, dB.
   static BitVector newBurst(gSlotLen);
   BitVector::iterator itr = newBurst.begin();
   char *bufferItr = buffer+6;
@@ -776,14 +784,14 @@ bool Transceiver::driveTransmitPriorityQueue(unsigned ARFCN)
   
   GSM::Time currTime = GSM::Time(frameNum,timeSlot);
   
-  radioVector *newVec = fixRadioVector(newBurst,RSSI,currTime,ARFCN);
+  radioVector *newVec = fixRadioVector(newBurst,atten,currTime,ARFCN);
   if (fillerFlag) {
 	setFiller(newVec,false,true);
   } else {
 	mTransmitPriorityQueue.write(newVec);
   }
   
-  //LOG(DEBUG) "added burst - time: " << currTime << ", RSSI: " << RSSI; // << ", data: " << newBurst; 
+  //LOG(DEBUG) "added burst - time: " << currTime << ", atten: " << atten; // << ", data: " << newBurst; 
 
   return true;
 
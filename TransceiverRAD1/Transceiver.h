@@ -83,6 +83,10 @@ private:
 
   RadioInterface *mRadioInterface;	  ///< associated radioInterface object
   double txFullScale;                     ///< full scale input to radio
+
+  /** Burst amplitude for each attenuation in the power byte of the burst message, dB below full power. */
+  static const int cMaxTxAtten = 63;
+  double mTxScale[cMaxTxAtten+1];
   double rxFullScale;
 
   Mutex mControlLock;
@@ -114,7 +118,7 @@ private:
 
   void setFiller(radioVector *rv, bool allocate, bool force);
   /** modulate and add a burst to the transmit queue */
-  radioVector *fixRadioVector(BitVector &burst, int RSSI, GSM::Time &wTime, int CN);
+  radioVector *fixRadioVector(BitVector &burst, int atten, GSM::Time &wTime, int CN);
 
   /** Push modulated burst into transmit FIFO corresponding to a particular timestamp */
   void pushRadioVector(GSM::Time &nowTime);
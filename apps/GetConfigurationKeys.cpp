@@ -131,17 +131,8 @@ static void makeHandoverKeys(ConfigurationKeyMap &map)
 	}
 
 	// (pat) There used to be a Handover.History.Min, but it was replaced by individual history counts for each handover parameter.
-	{ ConfigurationKey tmp("GSM.Handover.History.Max","32",
-		"reports",
-		ConfigurationKey::DEVELOPER,
-		ConfigurationKey::VALRANGE,
-		"2:128",
-		false,
-		"Maximum neighbor history to consider for handover.  "
-		"Units are number of measurement reports, which occur once each 480ms.  "
-	);
-	map[tmp.getName()] = tmp;
-	}
+	// GSM.Handover.History.Max went the same way: the serving cell average is kept by the measurement engine,
+	// and the neighbor histories keep only the RXLEV_DL.History points that are averaged.
 
 
 	// (pat) All these handover keys are almost identical, so simplify a bit...
@@ -312,6 +303,19 @@ ConfigurationKeyMap getConfigurationKeys()
 	}
 
 
+	{ ConfigurationKey tmp("Control.DCCHDispatch.Workers","8",
+		"threads",
+		ConfigurationKey::DEVELOPER,
+		ConfigurationKey::VALRANGE,
+		"1:64",
+		true,
+		"Number of worker threads servicing Layer 3 on the SDCCHs and TCHs.  "
+			"A worker that blocks, for example for the duration of a voice call, is replaced by a new one, "
+			"so this is the number of workers available for signalling, not a limit on the number of active channels."
+	);
+	map[tmp.getName()] = tmp;
+	}
+
 	{ ConfigurationKey tmp("Control.GSMTAP.GPRS","0",
 		"",
 		ConfigurationKey::CUSTOMERWARN,
@@ -359,6 +363,55 @@ ConfigurationKeyMap getConfigurationKeys()
 	map[tmp.getName()] = tmp;
 	}
 
+	{ ConfigurationKey tmp("Control.LUR.AuthPrefetch","0",
+		"",
+		ConfigurationKey::CUSTOMERTUNE,
+		ConfigurationKey::BOOLEAN,
+		"",
+		false,
+		"After each successful registration in which the Registrar challenged the MS, get the authentication challenge "
+			"for the next location update from the Registrar in the background, so that location update can skip the first REGISTER.  "
+			"The Registrar must keep the challenges it issues for Control.LUR.AuthPrefetch.Lifetime.  "
+			"If the Registrar does not accept a prefetched challenge the MS is challenged again with a new one."
+	);
+	map[tmp.getName()] = tmp;
+	}
+
+	{ ConfigurationKey tmp("Control.LUR.AuthPrefetch.Lifetime","3600",
+		"seconds",
+		ConfigurationKey::CUSTOMERTUNE,
+		ConfigurationKey::VALRANGE,
+		"60:86400",
+		false,
+		"How long a prefetched authentication challenge is kept.  "
+			"Set it no longer than the Registrar remembers the challenges it issues."
+	);
+	map[tmp.getName()] = tmp;
+	}
+
+	{ ConfigurationKey tmp("Control.LUR.AuthPrefetch.MaxEntries","10000",
+		"challenges",
+		ConfigurationKey::CUSTOMERTUNE,
+		ConfigurationKey::VALRANGE,
+		"100:1000000",
+		false,
+		"Maximum number of prefetched authentication challenges kept, and of prefetches waiting to be sent.  "
+			"The oldest challenges are discarded first."
+	);
+	map[tmp.getName()] = tmp;
+	}
+
+	{ ConfigurationKey tmp("Control.LUR.AuthPrefetch.Rate","10",
+		"requests per second",
+		ConfigurationKey::CUSTOMERTUNE,
+		ConfigurationKey::VALRANGE,
+		"1:1000",
+		false,
+		"Maximum rate of authentication prefetch requests sent to the Registrar."
+	);
+	map[tmp.getName()] = tmp;
+	}
+
 	{ ConfigurationKey tmp("Control.LUR.RegistrationMessageFrequency","FIRST",
 		"^PLMN|NORMAL|FIRST$",
 		ConfigurationKey::CUSTOMERWARN,
@@ -680,6 +733,18 @@ ConfigurationKeyMap getConfigurationKeys()
 	map[tmp.getName()] = tmp;
 	}
 
+	{ ConfigurationKey tmp("Control.TMSITable.WriteBehind","1000",
+		"milliseconds",
+		ConfigurationKey::CUSTOMERTUNE,
+		ConfigurationKey::VALRANGE,
+		"10:60000",
+		false,
+		"The TMSITable is kept in memory and changes are written to the database in one transaction this often.  "
+		"Changes made since the last write are lost if OpenBTS crashes."
+	);
+	map[tmp.getName()] = tmp;
+	}
+
 	{ ConfigurationKey tmp("Control.Reporting.TransactionMaxCompletedRecords","100",
 		"record",
 		ConfigurationKey::DEVELOPER,
@@ -713,6 +778,19 @@ ConfigurationKeyMap getConfigurationKeys()
 	map[tmp.getName()] = tmp;
 	}
 
+	{ ConfigurationKey tmp("Control.SMS.Linger","1000",
+		"milliseconds",
+		ConfigurationKey::CUSTOMERTUNE,
+		ConfigurationKey::VALRANGE,
+		"0:10000",// educated guess
+		false,
+		"How long to hold a dedicated channel after an MT-SMS is delivered, "
+			"so the next message for the same MS, for example the next part of a concatenated message, is delivered on it without a new page.  "
+			"The channel is not held when no more than Control.SMS.SDCCHReserve SDCCHs are free."
+	);
+	map[tmp.getName()] = tmp;
+	}
+
 	{ ConfigurationKey tmp("Control.SMS.QueryRRLP","0",
 		"",
 		ConfigurationKey::DEVELOPER,
@@ -724,6 +802,19 @@ ConfigurationKeyMap getConfigurationKeys()
 	map[tmp.getName()] = tmp;
 	}
 
+	{ ConfigurationKey tmp("Control.SMS.SDCCHReserve","2",
+		"SDCCHs",
+		ConfigurationKey::CUSTOMERTUNE,
+		ConfigurationKey::VALRANGE,
+		"0:20",// educated guess
+		false,
+		"Number of free SDCCHs that paging for MT-SMS leaves for calls and location updates.  "
+			"MSs with only MT-SMS waiting are paged only as fast as SDCCHs beyond this reserve are free; the rest wait for a later paging cycle.  "
+			"Paging for MT calls is not limited."
+	);
+	map[tmp.getName()] = tmp;
+	}
+
 	// It is CBS [Cell Broadcast Service].
 	{ ConfigurationKey tmp("Control.SMSCB.Table","",
 		"",
@@ -1620,6 +1711,19 @@ ConfigurationKeyMap getConfigurationKeys()
 	map[tmp.getName()] = tmp;
 	}
 
+	{ ConfigurationKey tmp("GSM.CCCH.ImmediateAssignmentExtended","0",
+		"",
+		ConfigurationKey::CUSTOMERTUNE,
+		ConfigurationKey::BOOLEAN,
+		"",
+		false,
+		"When two handsets are waiting for a dedicated channel, assign both in a single Immediate Assignment Extended message, GSM 04.08 9.1.19, "
+			"doubling the number of assignments per AGCH block during a RACH burst.  "
+			"Off by default because some handsets ignore the second assignment."
+	);
+	map[tmp.getName()] = tmp;
+	}
+
 #if unused	// (pat 4-24-2014) no longer implemented
 	// (pat) This option is here so it can be disabled to help testing Immediate Assignment Reject behavior;
 	// if this is non-zero you cant test it in the lab because the phone is always close enough to not be rejected.
@@ -1774,6 +1878,23 @@ ConfigurationKeyMap getConfigurationKeys()
 	map[tmp.getName()] = tmp;
 	}
 
+	{ ConfigurationKey tmp("GSM.Channels.Placement","0",
+		"",
+		ConfigurationKey::CUSTOMERTUNE,
+		ConfigurationKey::CHOICE,
+		"0|Pack,"
+			"1|Spread,"
+			"2|Quality",
+		false,
+		"How to pick among free SDCCHs and TCHs.  "
+			"Pack allocates from the front of the channel list, filling C0 first.  "
+			"Spread allocates on the ARFCN with the fewest channels of that type in use.  "
+			"Quality allocates the free channel whose previous user had the lowest uplink frame error rate.  "
+			"GPRS always uses Pack."
+	);
+	map[tmp.getName()] = tmp;
+	}
+
 	{ ConfigurationKey tmp("GSM.Channels.SDCCHReserve","0",
 		"SDCCHs",
 		ConfigurationKey::CUSTOMERTUNE,
@@ -1842,6 +1963,32 @@ ConfigurationKeyMap getConfigurationKeys()
 	map[tmp.getName()] = tmp;
 	}
 
+	{ ConfigurationKey tmp("GSM.DTX.Downlink","0",
+		"",
+		ConfigurationKey::CUSTOMERTUNE,
+		ConfigurationKey::BOOLEAN,
+		"",
+		false,
+		"Discontinuous transmission on downlink TCH/FS, GSM 06.31.  "
+			"During speech pauses the BTS sends a SID frame once per SACCH multiframe instead of continuous filler, "
+			"and the other bursts of the channel are sent as dummy bursts, at full power on C0 and switched off on other carriers.  "
+			"AMR channels always transmit continuously."
+	);
+	map[tmp.getName()] = tmp;
+	}
+
+	{ ConfigurationKey tmp("GSM.DTX.Uplink","0",
+		"",
+		ConfigurationKey::CUSTOMERTUNE,
+		ConfigurationKey::BOOLEAN,
+		"",
+		false,
+		"Allow handsets to use discontinuous transmission on uplink TCH/F, announced in the Cell Options of SI3 and SI6, GSM 04.08 10.5.2.3.  "
+			"Blocks the handset did not send are not channel decoded; comfort noise from the last SID frame is sent to the network instead."
+	);
+	map[tmp.getName()] = tmp;
+	}
+
 
 	{ ConfigurationKey tmp("GSM.Timer.Handover.Holdoff","10",
 		"seconds",
@@ -1954,6 +2101,18 @@ ConfigurationKeyMap getConfigurationKeys()
 	map[tmp.getName()] = tmp;
 	}
 
+	{ ConfigurationKey tmp("GSM.LAPDm.Workers","4",
+		"threads",
+		ConfigurationKey::DEVELOPER,
+		ConfigurationKey::VALRANGE,
+		"1:32",
+		true,
+		"Number of worker threads running LAPDm for all the dedicated channels.  "
+			"A worker blocked writing to L1 is replaced by a new one, so this is the number kept free to run."
+	);
+	map[tmp.getName()] = tmp;
+	}
+
 	{ ConfigurationKey tmp("GSM.MS.Power.Damping","75",
 		"damping value in percent",
 		ConfigurationKey::CUSTOMERTUNE,
@@ -2089,6 +2248,147 @@ ConfigurationKeyMap getConfigurationKeys()
 	map[tmp.getName()] = tmp;
 	}
 
+	{ ConfigurationKey tmp("GSM.PowerControl.Algorithm","0",
+		"",
+		ConfigurationKey::CUSTOMERTUNE,
+		ConfigurationKey::CHOICE,
+		"0|RSSITarget,"
+			"1|Threshold",
+		false,
+		"Algorithm for MS power control.  "
+			"RSSITarget orders a damped step toward the power that puts the uplink RSSI on GSM.Radio.RSSITarget, controlled by GSM.MS.Power.Damping.  "
+			"Threshold is the GSM 05.08 style algorithm: the uplink RSSI and RXQUAL are averaged over GSM.PowerControl.AverageWindow reporting periods "
+			"and the power is stepped when GSM.PowerControl.VoteN of the last GSM.PowerControl.VoteP averages are outside GSM.Radio.RSSITarget +- GSM.PowerControl.Hysteresis "
+			"or the RXQUAL thresholds.  Downlink power control always uses Threshold."
+	);
+	map[tmp.getName()] = tmp;
+	}
+
+	{ ConfigurationKey tmp("GSM.PowerControl.AverageWindow","4",
+		"reporting periods",
+		ConfigurationKey::DEVELOPER,
+		ConfigurationKey::VALRANGE,
+		"1:32",
+		false,
+		"Number of SACCH reporting periods, each 480ms, averaged by the Threshold power control algorithm.  Like Hreqave in GSM 05.08."
+	);
+	map[tmp.getName()] = tmp;
+	}
+
+	{ ConfigurationKey tmp("GSM.PowerControl.DL.MaxReduction","0",
+		"dB",
+		ConfigurationKey::CUSTOMERTUNE,
+		ConfigurationKey::VALRANGE,
+		"0:30(2)",
+		false,
+		"Maximum downlink power reduction on a dedicated channel when the MS reports a strong signal.  "
+			"0 disables downlink power control.  Every timeslot of the BCCH carrier C0 is always sent at full power, "
+			"since the MS measures the cell on it, so only dedicated channels on the other carriers are reduced."
+	);
+	map[tmp.getName()] = tmp;
+	}
+
+	{ ConfigurationKey tmp("GSM.PowerControl.DL.Target","-75",
+		"dBm",
+		ConfigurationKey::CUSTOMERTUNE,
+		ConfigurationKey::VALRANGE,
+		"-110:-48",
+		false,
+		"Downlink RXLEV reported by the MS that downlink power control aims for, within GSM.PowerControl.Hysteresis."
+	);
+	map[tmp.getName()] = tmp;
+	}
+
+	{ ConfigurationKey tmp("GSM.PowerControl.Hysteresis","3",
+		"dB",
+		ConfigurationKey::DEVELOPER,
+		ConfigurationKey::VALRANGE,
+		"0:20",
+		false,
+		"Half width of the band around the target level inside which the Threshold power control algorithm leaves the power alone."
+	);
+	map[tmp.getName()] = tmp;
+	}
+
+	{ ConfigurationKey tmp("GSM.PowerControl.IncreaseStep","4",
+		"dB",
+		ConfigurationKey::DEVELOPER,
+		ConfigurationKey::CHOICE,
+		"2,4,6",
+		false,
+		"Power increase step of the Threshold power control algorithm, POW_INCR_STEP_SIZE in GSM 05.08."
+	);
+	map[tmp.getName()] = tmp;
+	}
+
+	{ ConfigurationKey tmp("GSM.PowerControl.Interval","2",
+		"reporting periods",
+		ConfigurationKey::DEVELOPER,
+		ConfigurationKey::VALRANGE,
+		"0:16",
+		false,
+		"Minimum number of reporting periods from one power change by the Threshold algorithm to the next, P_CON_INTERVAL in GSM 05.08.  "
+			"This gives the MS time to report the effect of the last change."
+	);
+	map[tmp.getName()] = tmp;
+	}
+
+	{ ConfigurationKey tmp("GSM.PowerControl.ReduceStep","2",
+		"dB",
+		ConfigurationKey::DEVELOPER,
+		ConfigurationKey::CHOICE,
+		"2,4",
+		false,
+		"Power reduction step of the Threshold power control algorithm, POW_RED_STEP_SIZE in GSM 05.08."
+	);
+	map[tmp.getName()] = tmp;
+	}
+
+	{ ConfigurationKey tmp("GSM.PowerControl.RxqualBad","4",
+		"",
+		ConfigurationKey::DEVELOPER,
+		ConfigurationKey::VALRANGE,
+		"0:7",
+		false,
+		"The Threshold power control algorithm increases power when the averaged RXQUAL is worse than this, regardless of level."
+	);
+	map[tmp.getName()] = tmp;
+	}
+
+	{ ConfigurationKey tmp("GSM.PowerControl.RxqualGood","1",
+		"",
+		ConfigurationKey::DEVELOPER,
+		ConfigurationKey::VALRANGE,
+		"0:7",
+		false,
+		"The Threshold power control algorithm reduces power only when the averaged RXQUAL is this good or better."
+	);
+	map[tmp.getName()] = tmp;
+	}
+
+	{ ConfigurationKey tmp("GSM.PowerControl.VoteN","2",
+		"",
+		ConfigurationKey::DEVELOPER,
+		ConfigurationKey::VALRANGE,
+		"1:16",
+		false,
+		"The Threshold power control algorithm changes power when VoteN of the last GSM.PowerControl.VoteP averages call for it, N1/N2 in GSM 05.08.  "
+			"Must not be greater than GSM.PowerControl.VoteP."
+	);
+	map[tmp.getName()] = tmp;
+	}
+
+	{ ConfigurationKey tmp("GSM.PowerControl.VoteP","3",
+		"",
+		ConfigurationKey::DEVELOPER,
+		ConfigurationKey::VALRANGE,
+		"1:16",
+		false,
+		"Number of averages over which GSM.PowerControl.VoteN is counted, P1/P2 in GSM 05.08."
+	);
+	map[tmp.getName()] = tmp;
+	}
+
 	{ ConfigurationKey tmp("GSM.RACH.AC","0x0400",
 		"",
 		ConfigurationKey::CUSTOMERWARN,
@@ -2105,6 +2405,21 @@ ConfigurationKeyMap getConfigurationKeys()
 	map[tmp.getName()] = tmp;
 	}
 
+	{ ConfigurationKey tmp("GSM.RACH.DuplicateWindow","0",
+		"frames",
+		ConfigurationKey::CUSTOMERTUNE,
+		ConfigurationKey::VALRANGE,
+		"0:102",
+		false,
+		"A RACH with the same random access reference and timing advance as one accepted less than this many frames earlier is treated as a duplicate and dropped, "
+			"so only one channel is allocated for it.  "
+			"The random reference has only 5 random bits, so during a RACH burst different handsets can collide and one of them gets no assignment; "
+			"keep the window short.  "
+			"0 disables duplicate detection."
+	);
+	map[tmp.getName()] = tmp;
+	}
+
 	{ ConfigurationKey tmp("GSM.RACH.MaxRetrans","1",
 		"",
 		ConfigurationKey::CUSTOMERTUNE,
@@ -2335,6 +2650,61 @@ ConfigurationKeyMap getConfigurationKeys()
 	map[tmp.getName()] = tmp;
 	}
 
+	{ ConfigurationKey tmp("GSM.Radio.ChaseCombining","0",
+		"",
+		ConfigurationKey::CUSTOMERTUNE,
+		ConfigurationKey::BOOLEAN,
+		"",
+		false,
+		"Keep the soft bits of uplink SDCCH, SACCH and FACCH blocks that fail decoding and combine them with the next failed block "
+			"on the same channel before giving up.  "
+			"Recovers LAPDm retransmissions and SACCH repetitions at the cell edge.  "
+			"The number of blocks recovered this way is shown in the Frames column of 'chans -l'."
+	);
+	map[tmp.getName()] = tmp;
+	}
+
+	{ ConfigurationKey tmp("GSM.Radio.DecodeThreads","0",
+		"threads",
+		ConfigurationKey::CUSTOMERTUNE,
+		ConfigurationKey::VALRANGE,
+		"0:16",
+		true,
+		"Number of threads used to deinterleave and decode uplink bursts.  "
+			"Each timeslot is always decoded by the same thread.  "
+			"0 decodes inline on the transceiver receive thread of each ARFCN.  "
+			"On multi-ARFCN systems set this to about the number of spare cores."
+	);
+	map[tmp.getName()] = tmp;
+	}
+
+	{ ConfigurationKey tmp("GSM.Radio.Hopping","0",
+		"",
+		ConfigurationKey::CUSTOMERWARN,
+		ConfigurationKey::BOOLEAN,
+		"",
+		true,
+		"Enable baseband frequency hopping on the traffic channels of the non-C0 ARFCNs.  "
+			"The hopping set is C0+2, C0+4, etc., so GSM.Radio.ARFCNs must be at least 3; C0 never hops.  "
+			"Only timeslots configured as TCH/F on every non-C0 ARFCN hop.  "
+			"Not supported with GPRS.Enable; hopping is disabled at startup if GPRS is enabled."
+	);
+	map[tmp.getName()] = tmp;
+	}
+
+	{ ConfigurationKey tmp("GSM.Radio.Hopping.HSN","1",
+		"",
+		ConfigurationKey::CUSTOMERTUNE,
+		ConfigurationKey::VALRANGE,
+		"0:63",
+		true,
+		"Hopping Sequence Number, GSM 05.02 6.2.3, used when GSM.Radio.Hopping is enabled.  "
+			"0 is cyclic hopping.  "
+			"Give cells that share frequencies different HSNs so their channels collide only occasionally."
+	);
+	map[tmp.getName()] = tmp;
+	}
+
 	{ ConfigurationKey tmp("GSM.Radio.MaxExpectedDelaySpread","4",
 		"symbol periods",
 		ConfigurationKey::CUSTOMERTUNE,
@@ -2575,9 +2945,23 @@ ConfigurationKeyMap getConfigurationKeys()
 		ConfigurationKey::DEVELOPER,
 		ConfigurationKey::CHOICE,
 		"disabled,"
-			"0.1",
+			"0.1,"
+			"0.2",
+		false,
+		"Which version of the PhysicalStatus event stream should be enabled.  "
+			"Version 0.1 sends one event per channel, version 0.2 sends one event holding all the channels."
+	);
+	map[tmp.getName()] = tmp;
+	}
+
+	{ ConfigurationKey tmp("NodeManager.API.PhysicalStatus.Interval","1000",
+		"milliseconds",
+		ConfigurationKey::CUSTOMERTUNE,
+		ConfigurationKey::VALRANGE,
+		"100:60000",// educated guess
 		false,
-		"Which version of the PhysicalStatus event stream should be enabled."
+		"How often the PhysicalStatus events are published.  "
+			"Each publication carries the latest measurement report of every channel that reported since the previous one."
 	);
 	map[tmp.getName()] = tmp;
 	}
@@ -2663,6 +3047,18 @@ ConfigurationKeyMap getConfigurationKeys()
 	map[tmp.getName()] = tmp;
 	}
 
+	{ ConfigurationKey tmp("RTP.Quarantine","2",
+		"seconds",
+		ConfigurationKey::CUSTOMERTUNE,
+		ConfigurationKey::VALRANGE,
+		"0:30",// educated guess
+		false,
+		"Seconds a released RTP port pair is held before it is given to another call, "
+			"so late packets from the previous call are not received by the next one."
+	);
+	map[tmp.getName()] = tmp;
+	}
+
 	{ ConfigurationKey tmp("RTP.Range","98",
 		"ports",
 		ConfigurationKey::CUSTOMERTUNE,
@@ -3187,6 +3583,89 @@ ConfigurationKeyMap getConfigurationKeys()
 	map[tmp.getName()] = tmp;
 	}
 
+	{ ConfigurationKey tmp("Control.CDR.Format","CSV",
+		"",
+		ConfigurationKey::DEVELOPER,
+		ConfigurationKey::CHOICE,
+		"CSV,BINARY",
+		false,
+		"Format of the CDR files.  CSV is one comma separated line per record after a two line header of field names and types.  "
+			"BINARY is more compact: an 8 byte 'OBTSCDR1' file header, then each record as a 2 byte length followed by the same fields in the same order, "
+			"strings as a 1 byte length and the bytes, integers as 4 bytes and the termination side as 1 byte, all big-endian.  "
+			"A change takes effect when the next file is opened."
+	);
+	map[tmp.getName()] = tmp;
+	}
+
+	{ ConfigurationKey tmp("Control.CDR.MaxFileSize","0",
+		"kilobytes",
+		ConfigurationKey::DEVELOPER,
+		ConfigurationKey::VALRANGE,
+		"0:1048576",
+		false,
+		"Start a new CDR file when the current one reaches this size.  0 means no limit; a new file is still started each day."
+	);
+	map[tmp.getName()] = tmp;
+	}
+
+	{ ConfigurationKey tmp("Control.CDR.MaxQueue","10000",
+		"records",
+		ConfigurationKey::DEVELOPER,
+		ConfigurationKey::VALRANGE,
+		"100:1000000",
+		false,
+		"Maximum number of CDRs waiting to be written.  Further CDRs are dropped and counted in OpenBTS.CDR.Dropped, "
+			"so a slow disk never holds up call processing."
+	);
+	map[tmp.getName()] = tmp;
+	}
+
+	{ ConfigurationKey tmp("Control.CDR.RotateInterval","0",
+		"seconds",
+		ConfigurationKey::DEVELOPER,
+		ConfigurationKey::VALRANGE,
+		"0:86400",
+		false,
+		"Start a new CDR file after this many seconds.  0 means only start a new file each day or when Control.CDR.MaxFileSize is reached."
+	);
+	map[tmp.getName()] = tmp;
+	}
+
+	{ ConfigurationKey tmp("Control.CDR.SyncInterval","10",
+		"seconds",
+		ConfigurationKey::DEVELOPER,
+		ConfigurationKey::VALRANGE,
+		"0:3600",
+		false,
+		"The CDRs are written in batches and flushed after each batch, but only synced to disk this often.  0 syncs after every batch."
+	);
+	map[tmp.getName()] = tmp;
+	}
+
+	{ ConfigurationKey tmp("Control.CallTrace.Filename","",
+		"filename",
+		ConfigurationKey::DEVELOPER,
+		ConfigurationKey::FILEPATH_OPT,
+		"",
+		true,
+		"If set, the call setup trace of each MOC and MTC is appended to this file when the transaction ends, one line per call: "
+			"the time of the first milestone, the transaction id and direction, then each milestone seen as name=msecs from the first.  "
+			"The same traces and their percentiles are available from the CLI 'calltrace' command."
+	);
+	map[tmp.getName()] = tmp;
+	}
+
+	{ ConfigurationKey tmp("Control.CallTrace.History","100",
+		"calls",
+		ConfigurationKey::DEVELOPER,
+		ConfigurationKey::VALRANGE,
+		"0:10000",
+		false,
+		"Number of finished call setup traces kept for the CLI 'calltrace recent' command."
+	);
+	map[tmp.getName()] = tmp;
+	}
+
 	return map;
 }
 
@@ -3195,11 +3674,30 @@ void OpenBTSConfig::configUpdateKeys()
 {
 	// (pat) Doesnt hurt to use float (unless overflow) for integer keys, but not vice versa.
 #define SAVE_NUMERIC_KEY(keyname) { keyname = getFloat(#keyname); } 		// if (defines(#keyname)) { keyname = getNum(#keyname); }
+#define SAVE_BOOL_KEY(keyname) { keyname = getBool(#keyname); }
+	SAVE_BOOL_KEY(Control.GSMTAP.GSM);
+	SAVE_NUMERIC_KEY(Control.SACCHTimeout.BumpDown);
+
+	SAVE_BOOL_KEY(GSM.CCCH.ImmediateAssignmentExtended);
+	SAVE_NUMERIC_KEY(GSM.RACH.DuplicateWindow);
+	SAVE_NUMERIC_KEY(GSM.Channels.Placement);
+	// Randomize is an undocumented key that is not in the schema, so all we can check is whether it is set.
+	GSM.Channels.Randomize = defines("GSM.Channels.Randomize");
+	SAVE_NUMERIC_KEY(GSM.Cipher.CCHBER);
+	SAVE_BOOL_KEY(GSM.DTX.Downlink);
+	SAVE_BOOL_KEY(GSM.DTX.Uplink);
+	SAVE_NUMERIC_KEY(GSM.MaxSpeechLatency);
+
+	SAVE_BOOL_KEY(GSM.Radio.ChaseCombining);
+	SAVE_NUMERIC_KEY(GSM.Radio.RSSIAveragePeriod);
+	SAVE_NUMERIC_KEY(GSM.Radio.RSSITarget);
+	SAVE_NUMERIC_KEY(GSM.Radio.SNRAveragePeriod);
+	SAVE_NUMERIC_KEY(GSM.Radio.SNRTarget);
+
 	SAVE_NUMERIC_KEY(GSM.Handover.FailureHoldoff);
 	SAVE_NUMERIC_KEY(GSM.Handover.Margin);
 	SAVE_NUMERIC_KEY(GSM.Handover.Ny1);
 
-	SAVE_NUMERIC_KEY(GSM.Handover.History.Max);
 	//not implemented: SAVE_NUMERIC_KEY(GSM.Handover.Penalty.Damping);
 
 	SAVE_NUMERIC_KEY(GSM.Handover.RXLEV_DL.Target);
@@ -3214,10 +3712,27 @@ void OpenBTSConfig::configUpdateKeys()
 	SAVE_NUMERIC_KEY(GSM.MS.TA.Damping);
 	SAVE_NUMERIC_KEY(GSM.MS.TA.Max);
 
+	SAVE_NUMERIC_KEY(GSM.PowerControl.Algorithm);
+	SAVE_NUMERIC_KEY(GSM.PowerControl.AverageWindow);
+	SAVE_NUMERIC_KEY(GSM.PowerControl.Hysteresis);
+	SAVE_NUMERIC_KEY(GSM.PowerControl.RxqualBad);
+	SAVE_NUMERIC_KEY(GSM.PowerControl.RxqualGood);
+	SAVE_NUMERIC_KEY(GSM.PowerControl.VoteN);
+	SAVE_NUMERIC_KEY(GSM.PowerControl.VoteP);
+	SAVE_NUMERIC_KEY(GSM.PowerControl.IncreaseStep);
+	SAVE_NUMERIC_KEY(GSM.PowerControl.ReduceStep);
+	SAVE_NUMERIC_KEY(GSM.PowerControl.Interval);
+	SAVE_NUMERIC_KEY(GSM.PowerControl.DL.Target);
+	SAVE_NUMERIC_KEY(GSM.PowerControl.DL.MaxReduction);
+
 	SAVE_NUMERIC_KEY(GSM.Timer.T3103);
 	SAVE_NUMERIC_KEY(GSM.Timer.T3105);
 	SAVE_NUMERIC_KEY(GSM.Timer.T3109);
 	SAVE_NUMERIC_KEY(GSM.Timer.T3113);
 	SAVE_NUMERIC_KEY(GSM.Timer.T3212);
 	SAVE_NUMERIC_KEY(GSM.BTS.RADIO_LINK_TIMEOUT);
+
+	SAVE_NUMERIC_KEY(Test.GSM.SimulatedFER.Downlink);
+	SAVE_NUMERIC_KEY(Test.GSM.SimulatedFER.Uplink);
+	SAVE_NUMERIC_KEY(Test.GSM.UplinkFuzzingRate);
 }
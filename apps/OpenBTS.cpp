@@ -133,6 +133,7 @@ void purgeConfig(void*,int,char const*, char const*, sqlite3_int64)
 	// LOG(INFO) << "purging configuration cache";
 	gConfig.purge();
 	gConfig.configUpdateKeys();
+	gTRX.configUpdate();
 	// (pat) FIXME: We cannot regenerate the beacon too often because the changemark is only 2 bits;
 	// we need to be more careful to update the beacon only when it really changes.
 	gBTS.regenerateBeacon();
@@ -248,6 +249,9 @@ void createStats()
 	// count of BYE-OKs received in SIP layer (final disconnect handshake)
 	gReports.create("OpenBTS.SIP.BYE-OK.In");
 
+	// count of CDRs dropped because the CDR writer fell behind
+	gReports.create("OpenBTS.CDR.Dropped");
+
 	// count of initiated LUR attempts
 	gReports.create("OpenBTS.GSM.MM.LUR.Start");
 	// count of LUR attempts where the server timed out
@@ -592,6 +596,7 @@ int main(int argc, char *argv[])
 	srandom(time(NULL));
 
 	gConfig.setUpdateHook(purgeConfig);
+	gConfig.configUpdateKeys();		// Load the typed config values; after this the update hook keeps them current.
 	LOG(ALERT) << "OpenBTS (re)starting, ver " << VERSION << " build date/time " << TIMESTAMP_ISO;
 	LOG(ALERT) << "OpenBTS reading config file "<<cOpenBTSConfigFile;
 
@@ -794,6 +799,9 @@ int main(int argc, char *argv[])
 	}
 
 
+	// Now that the timeslots are configured, pick the ones that hop.
+	gTRX.startHopping();
+
 	// OK, now it is safe to start the BTS.
 	gBTS.gsmStart();
 
@@ -882,6 +890,17 @@ vector<string> configurationCrossCheck(const string& key) {
 			warning.str(std::string());
 		}
 
+	// GSM.PowerControl.VoteN can be no more than GSM.PowerControl.VoteP
+	} else if (key.compare("GSM.PowerControl.VoteN") == 0 || key.compare("GSM.PowerControl.VoteP") == 0) {
+		int voteN = gConfig.getNum("GSM.PowerControl.VoteN");
+		int voteP = gConfig.getNum("GSM.PowerControl.VoteP");
+		if (voteN > voteP) {
+			warning << "GSM.PowerControl.VoteN (" << voteN << ") must not be greater than GSM.PowerControl.VoteP (" << voteP << "), "
+				<< "the Threshold power control algorithm will use VoteP for both";
+			warnings.push_back(warning.str());
+			warning.str(std::string());
+		}
+
 	// TODO : This NEEDS to be an error not a warning. OpenBTS will fail to start because of an assert if an invalid value is used.
 	// GSM.Radio.C0 needs to be inside the valid range of ARFCNs for GSM.Radio.Band
 	} else if (key.compare("GSM.Radio.C0") == 0 || key.compare("GSM.Radio.Band") == 0) {
@@ -982,6 +1001,21 @@ vector<string> configurationCrossCheck(const string& key) {
 			warning.str(std::string());
 		}
 
+	// GSM.Radio.Hopping needs two ARFCNs besides C0 and does not work with GPRS.
+	} else if (key.compare("GSM.Radio.Hopping") == 0 || key.compare("GPRS.Enable") == 0) {
+		if (gConfig.getBool("GSM.Radio.Hopping")) {
+			if (gConfig.getNum("GSM.Radio.ARFCNs") < 3) {
+				warning << "GSM.Radio.Hopping is enabled but GSM.Radio.ARFCNs is less than 3, so nothing will hop";
+				warnings.push_back(warning.str());
+				warning.str(std::string());
+			}
+			if (gConfig.getBool("GPRS.Enable")) {
+				warning << "GSM.Radio.Hopping is not supported with GPRS.Enable; hopping will be disabled";
+				warnings.push_back(warning.str());
+				warning.str(std::string());
+			}
+		}
+
 	// GSM.Channels.NumC1s + GSM.Channels.NumC1s must fall within allowed timeslots.
 	} else if (key.compare("GSM.Radio.ARFCNs") == 0 || key.compare("GSM.Channels.NumC1s") == 0 || key.compare("GSM.Channels.NumC7s") == 0) {
 		int max = TimeSlots::maxC1plusC7();
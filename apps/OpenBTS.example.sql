@@ -131,7 +131,6 @@ INSERT OR IGNORE INTO "CONFIG" VALUES('GSM.Cipher.RandomNeighbor','0',0,0,'Proba
 INSERT OR IGNORE INTO "CONFIG" VALUES('GSM.Cipher.ScrambleFiller','0',0,0,'1=enabled, 0=disabled - Scramble filler in layer 2 for cracking protection.');
 INSERT OR IGNORE INTO "CONFIG" VALUES('GSM.Control.GPRSMaxIgnore','5',0,0,'Ignore GPRS messages on GSM control channels.  Value is number of consecutive messages to ignore.');
 INSERT OR IGNORE INTO "CONFIG" VALUES('GSM.Handover.FailureHoldoff','20',0,0,'The number of seconds to wait before attempting another handover with a given neighbor BTS.');
-INSERT OR IGNORE INTO "CONFIG" VALUES('GSM.Handover.History.Max','32',0,0,'Maximum neighbor history to consider for handover.  Units are number of measurement reports, which occur once each 480ms.  ');
 INSERT OR IGNORE INTO "CONFIG" VALUES('GSM.Handover.Margin','15',1,0,'Unconditional handover if RXDIFF exceeds this margin.  The GSM.Handover.RXLEV_DL.PenaltyTime will prevent reverse handovers for that period.    Static.');
 INSERT OR IGNORE INTO "CONFIG" VALUES('GSM.Handover.Ny1','50',1,0,'Maximum number of repeats of the Physical Information Message during handover procedure, GSM 04.08 11.1.3.  Static.');
 INSERT OR IGNORE INTO "CONFIG" VALUES('GSM.Handover.RXLEV_DL.History','6',0,0,'The number of 480ms periods to consider for this handover criteria.');
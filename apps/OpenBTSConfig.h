@@ -32,13 +32,28 @@ class OpenBTSConfig : public ConfigurationTable {
 	// This structure mirrors the config variable names in GetConfigurationKeys.cpp.
 	// Any value added here must also be added to configUpdateKeys(), which function is
 	// called after any change to the config to update the values in this structure.
+	// Code that runs per burst or per frame should read its config from here rather than
+	// through the string API; each value is a single word so readers need no lock.
+	struct Control {
+		struct GSMTAP { bool GSM; } GSMTAP;
+		struct SACCHTimeout { int BumpDown; } SACCHTimeout;
+	} Control;
 	struct GSM {
+		struct CCCH { bool ImmediateAssignmentExtended; } CCCH;
+		struct RACH { int DuplicateWindow; } RACH;
+		struct Channels { int Placement; bool Randomize; } Channels;
+		struct Cipher { float CCHBER; } Cipher;
+		struct DTX { bool Downlink, Uplink; } DTX;
+		int MaxSpeechLatency;
+		struct Radio {
+			bool ChaseCombining;
+			int RSSIAveragePeriod, RSSITarget, SNRAveragePeriod, SNRTarget;
+		} Radio;
 		struct Handover {
 			int FailureHoldoff;
 			int Margin;
 			int Ny1;
 
-			struct History { int Max; } History;
 			struct Noise { int Factor; } Noise;
 
 			struct RXLEV_DL { float Target; int History, Margin, PenaltyTime; } RXLEV_DL;
@@ -47,6 +62,11 @@ class OpenBTSConfig : public ConfigurationTable {
 			struct Power { int Min, Max, Damping; } Power;
 			struct TA { int Damping, Max; } TA;
 		} MS;
+		struct PowerControl {
+			int Algorithm, AverageWindow, Hysteresis, RxqualBad, RxqualGood, VoteN, VoteP;
+			int IncreaseStep, ReduceStep, Interval;
+			struct DL { int Target, MaxReduction; } DL;
+		} PowerControl;
 		struct {
 			int T3103, T3105, T3109, T3113, T3212;
 		} Timer;
@@ -54,6 +74,12 @@ class OpenBTSConfig : public ConfigurationTable {
 			int RADIO_LINK_TIMEOUT;
 		} BTS;
 	} GSM;
+	struct Test {
+		struct {
+			struct { int Downlink, Uplink; } SimulatedFER;
+			int UplinkFuzzingRate;
+		} GSM;
+	} Test;
 };
 
 extern OpenBTSConfig gConfig;